@@ -0,0 +1,244 @@
+// Benchmark for the software occlusion culler. Needs no GL context or
+// window: a grid city like the generator's is built on the CPU, the most
+// covering nearby buildings are rasterised as occluders the way Renderer3D
+// picks them, and a large batch of vehicle, light and building boxes inside
+// the view frustum is tested against the buffer.
+//
+//   occlusion_bench [--quick] [--out results.json]
+//
+// JSON goes to stdout (or --out), progress to stderr.
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "occlusionculler.h"
+#include "threadpool.h"
+
+namespace {
+
+const int BOXES = 100000;
+const int MAX_OCCLUDERS = 48;           // As Renderer3D
+const float OCCLUDER_RANGE = 400.0f;
+const int BLOCKS = 31;                  // Per side, centred on the origin
+const float BLOCK_SIZE = 40.0f;
+const float VIEW_DISTANCE = 1000.0f;
+const int RUNS = 3; // Calls at least, fastest reported
+
+struct View {
+    std::string name;
+    glm::vec3 eye, target;
+};
+
+struct Result {
+    std::string view;
+    int occluders;
+    int boxes;
+    double hiddenFraction;
+    double rasterMs;
+    double nsPerBox;            // testBoxRange on the calling thread
+    double batchMs;             // testBoxes on the thread pool
+};
+
+std::vector<BVHBox> makeBuildings(std::mt19937& rng) {
+    std::uniform_real_distribution<float> size(15.0f, 30.0f);
+    std::uniform_real_distribution<float> height(10.0f, 90.0f);
+    
+    std::vector<BVHBox> buildings;
+    for (int i = -BLOCKS / 2; i <= BLOCKS / 2; ++i) {
+        for (int j = -BLOCKS / 2; j <= BLOCKS / 2; ++j) {
+            glm::vec3 corner(i * BLOCK_SIZE + 5.0f, 0.0f, j * BLOCK_SIZE + 5.0f);
+            buildings.push_back(BVHBox(corner, corner + glm::vec3(size(rng), height(rng), size(rng))));
+        }
+    }
+    return buildings;
+}
+
+// Any corner on screen and in front of the eye
+bool inFrustum(const glm::mat4& viewProjection, const BVHBox& box) {
+    for (int i = 0; i < 8; ++i) {
+        glm::vec3 corner(i & 1 ? box.max.x : box.min.x, i & 2 ? box.max.y : box.min.y, i & 4 ? box.max.z : box.min.z);
+        glm::vec4 clip = viewProjection * glm::vec4(corner, 1.0f);
+        if (clip.w > 0.0f && std::fabs(clip.x) <= clip.w && std::fabs(clip.y) <= clip.w) return true;
+    }
+    return false;
+}
+
+// Renderer3D::cullOccluded's choice: footprint times height over squared distance
+std::vector<BVHBox> pickOccluders(const std::vector<BVHBox>& buildings, const View& view, const glm::mat4& viewProjection) {
+    std::vector<std::pair<float, int>> candidates;
+    for (size_t i = 0; i < buildings.size(); ++i) {
+        const BVHBox& box = buildings[i];
+        if (!inFrustum(viewProjection, box)) continue;
+        glm::vec2 center(0.5f * (box.min.x + box.max.x), 0.5f * (box.min.z + box.max.z));
+        glm::vec2 offset = center - glm::vec2(view.eye.x, view.eye.z);
+        float distanceSquared = std::max(glm::dot(offset, offset), 1.0f);
+        if (distanceSquared > OCCLUDER_RANGE * OCCLUDER_RANGE) continue;
+        glm::vec3 size = box.max - box.min;
+        candidates.push_back(std::make_pair(std::max(size.x, size.z) * size.y / distanceSquared, static_cast<int>(i)));
+    }
+    std::sort(candidates.begin(), candidates.end(),
+              [](const std::pair<float, int>& a, const std::pair<float, int>& b) { return a.first > b.first; });
+    if (candidates.size() > static_cast<size_t>(MAX_OCCLUDERS)) candidates.resize(MAX_OCCLUDERS);
+    
+    std::vector<BVHBox> occluders;
+    for (const auto& candidate : candidates) occluders.push_back(buildings[candidate.second]);
+    return occluders;
+}
+
+// The buildings in view, then vehicle and street light boxes (same extents
+// as Renderer3D's) scattered over the ground until there are BOXES in view
+std::vector<BVHBox> makeOccludees(const std::vector<BVHBox>& buildings, const glm::mat4& viewProjection, std::mt19937& rng) {
+    std::vector<BVHBox> boxes;
+    for (const auto& building : buildings) {
+        if (inFrustum(viewProjection, building)) boxes.push_back(building);
+    }
+    
+    float extent = 0.5f * BLOCKS * BLOCK_SIZE;
+    std::uniform_real_distribution<float> ground(-extent, extent);
+    std::uniform_int_distribution<int> kind(0, 3);
+    while (static_cast<int>(boxes.size()) < BOXES) {
+        glm::vec3 position(ground(rng), 0.0f, ground(rng));
+        BVHBox box = kind(rng) == 0
+            ? BVHBox(position - glm::vec3(2.0f, 0.0f, 2.0f), position + glm::vec3(2.0f, 18.0f, 2.0f))
+            : BVHBox(position - glm::vec3(5.5f, 0.0f, 5.5f), position + glm::vec3(5.5f, 8.0f, 5.5f));
+        if (inFrustum(viewProjection, box)) boxes.push_back(box);
+    }
+    return boxes;
+}
+
+double millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Fastest single call of body over at least RUNS calls and minSeconds.
+// Each call takes about a millisecond, well above the clock's resolution,
+// so the fastest one is the least disturbed by other work on the machine.
+template <typename Body>
+double bestMs(double minSeconds, Body&& body) {
+    double best = -1.0;
+    auto begin = std::chrono::steady_clock::now();
+    for (int calls = 0; calls < RUNS || millisecondsSince(begin) < minSeconds * 1000.0; ++calls) {
+        auto start = std::chrono::steady_clock::now();
+        body();
+        double ms = millisecondsSince(start);
+        if (best < 0.0 || ms < best) best = ms;
+    }
+    return best;
+}
+
+Result benchView(const View& view, const std::vector<BVHBox>& buildings, double minSeconds, std::mt19937& rng) {
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, VIEW_DISTANCE);
+    glm::mat4 viewProjection = projection * glm::lookAt(view.eye, view.target, glm::vec3(0.0f, 1.0f, 0.0f));
+    std::vector<BVHBox> occluders = pickOccluders(buildings, view, viewProjection);
+    std::vector<BVHBox> boxes = makeOccludees(buildings, viewProjection, rng);
+    
+    OcclusionCuller culler;
+    auto prepare = [&]() {
+        culler.begin(viewProjection, view.eye);
+        for (const auto& occluder : occluders) culler.addOccluder(occluder);
+        culler.rasterize();
+    };
+    
+    Result result;
+    result.view = view.name;
+    result.boxes = static_cast<int>(boxes.size());
+    result.rasterMs = bestMs(minSeconds, prepare);
+    result.occluders = culler.getOccluderCount();
+    
+    std::vector<uint8_t> occluded(boxes.size());
+    double serialMs = bestMs(minSeconds, [&]() {
+        culler.testBoxRange(boxes.data(), static_cast<int>(boxes.size()), occluded.data());
+    });
+    result.nsPerBox = serialMs * 1e6 / boxes.size();
+    result.hiddenFraction = static_cast<double>(std::count(occluded.begin(), occluded.end(), 1)) / boxes.size();
+    
+    result.batchMs = bestMs(minSeconds, [&]() { culler.testBoxes(boxes, occluded); });
+    return result;
+}
+
+std::string toJSON(const std::vector<Result>& results, bool quick) {
+    std::ostringstream out;
+    out << "{\n";
+    out << "  \"benchmark\": \"occlusion\",\n";
+    out << "  \"buffer\": [" << OcclusionCuller::WIDTH << ", " << OcclusionCuller::HEIGHT << "],\n";
+    out << "  \"threads\": " << ThreadPool::shared().size() + 1 << ",\n";
+    out << "  \"quick\": " << (quick ? "true" : "false") << ",\n";
+    out << "  \"fields\": {\n";
+    out << "    \"raster_ms\": \"begin, addOccluder for each occluder and rasterize, on the thread pool\",\n";
+    out << "    \"ns_per_box\": \"testBoxRange over every box, on the calling thread\",\n";
+    out << "    \"batch_ms\": \"testBoxes over every box, on the thread pool\"\n";
+    out << "  },\n";
+    out << "  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& r = results[i];
+        char fields[256];
+        std::snprintf(fields, sizeof(fields),
+                      "\"occluders\": %d, \"boxes\": %d, \"hidden_fraction\": %.3f, "
+                      "\"raster_ms\": %.4f, \"ns_per_box\": %.2f, \"batch_ms\": %.4f",
+                      r.occluders, r.boxes, r.hiddenFraction, r.rasterMs, r.nsPerBox, r.batchMs);
+        out << "    {\"view\": \"" << r.view << "\", " << fields << "}"
+            << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n";
+    out << "}\n";
+    return out.str();
+}
+
+}
+
+int main(int argc, char** argv) {
+    bool quick = false;
+    std::string outPath;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--quick") == 0) {
+            quick = true;
+        } else if (std::strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            outPath = argv[++i];
+        } else {
+            std::cerr << "Usage: occlusion_bench [--quick] [--out results.json]" << std::endl;
+            return 1;
+        }
+    }
+    
+    double minSeconds = quick ? 0.02 : 0.2;
+    std::mt19937 rng(2024); // Same city and boxes in every build
+    std::vector<BVHBox> buildings = makeBuildings(rng);
+    
+    // Down a street between two rows of blocks, over the roofs, and from above
+    const View views[] = {
+        { "street", glm::vec3(0.0f, 6.0f, 300.0f), glm::vec3(0.0f, 6.0f, -300.0f) },
+        { "rooftop", glm::vec3(20.0f, 60.0f, 300.0f), glm::vec3(-20.0f, 20.0f, 0.0f) },
+        { "aerial", glm::vec3(0.0f, 250.0f, 400.0f), glm::vec3(0.0f, 0.0f, 0.0f) },
+    };
+    std::vector<Result> results;
+    for (const auto& view : views) {
+        std::cerr << "[BENCH] " << view.name << " view..." << std::endl;
+        results.push_back(benchView(view, buildings, minSeconds, rng));
+    }
+    
+    std::string json = toJSON(results, quick);
+    if (outPath.empty()) {
+        std::cout << json;
+        return 0;
+    }
+    
+    std::ofstream file(outPath);
+    if (!file) {
+        std::cerr << "ERROR::BENCH::FILE_NOT_WRITTEN: " << outPath << std::endl;
+        return 1;
+    }
+    file << json;
+    std::cerr << "[BENCH] Wrote " << results.size() << " results to " << outPath << std::endl;
+    return 0;
+}
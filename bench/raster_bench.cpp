@@ -0,0 +1,375 @@
+// Micro-benchmarks for the 2D raster algorithms. Needs no GL context or
+// window: every variant writes into the same CPU-side instance streams
+// Renderer2D uploads, so the numbers are the per-frame CPU cost.
+//
+//   raster_bench [--quick] [--out results.json]
+//
+// JSON goes to stdout (or --out), progress to stderr.
+
+#include <glm/glm.hpp>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "raster2d.h"
+#include "softrasterizer.h"
+
+namespace {
+
+const int SCREEN_WIDTH = 1024;
+const int SCREEN_HEIGHT = 768;
+const int PRIMITIVES_PER_SET = 4096;
+const int RUNS = 3; // Best of
+
+// The point stream before spans: one 8-byte vertex per plotted position
+struct PointVertex {
+    int16_t x, y;
+    uint32_t color;
+};
+
+// Same layout as Renderer2D's SpanInstance
+struct SpanVertex {
+    int16_t x0, y0, x1, y1;
+    uint32_t color;
+};
+
+struct Result {
+    std::string primitive, distribution, variant;
+    long long items;        // Primitives drawn
+    long long pixels;       // Plotted positions (lines, outlines) or area the fill spans cover
+    long long instances;    // Vertices or span instances pushed
+    double seconds;
+    bool fill;              // Spans stand for whole rows, so pixels is coverage, not pixels written
+};
+
+struct LineCase {
+    int x1, y1, x2, y2;
+};
+
+struct CircleCase {
+    int cx, cy, radius;
+};
+
+RasterRect screen() {
+    return RasterRect(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
+}
+
+std::vector<PointVertex> points;
+std::vector<SpanVertex> spans;
+
+void pushPoint(int x, int y) {
+    PointVertex vertex = { static_cast<int16_t>(x), static_cast<int16_t>(y), 0xFFFFFFFFu };
+    points.push_back(vertex);
+}
+
+void pushSpan(const RasterRect& rect) {
+    SpanVertex vertex = { static_cast<int16_t>(rect.x0), static_cast<int16_t>(rect.y0),
+                          static_cast<int16_t>(rect.x1), static_cast<int16_t>(rect.y1), 0xFFFFFFFFu };
+    spans.push_back(vertex);
+}
+
+long long spanLength(const RasterSpan& span) {
+    return static_cast<long long>(span.x1 - span.x0 + 1) * (span.y1 - span.y0 + 1);
+}
+
+// Runs body over the whole set until minSeconds have passed; best of RUNS.
+// body returns the pixels it produced and leaves its output in points/spans.
+template <typename Body>
+Result measure(const std::string& primitive, const std::string& distribution, const std::string& variant,
+               int setSize, double minSeconds, Body&& body) {
+    Result result;
+    result.primitive = primitive;
+    result.distribution = distribution;
+    result.variant = variant;
+    result.seconds = 0.0;
+    result.fill = false;
+    
+    double bestRate = -1.0;
+    for (int run = 0; run < RUNS; ++run) {
+        long long items = 0, pixels = 0, instances = 0;
+        auto start = std::chrono::steady_clock::now();
+        double elapsed = 0.0;
+        do {
+            // One "frame": streams start empty but keep their capacity
+            points.clear();
+            spans.clear();
+            pixels += body();
+            instances += static_cast<long long>(points.size() + spans.size());
+            items += setSize;
+            elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        } while (elapsed < minSeconds);
+        
+        double rate = items / elapsed;
+        if (rate > bestRate) {
+            bestRate = rate;
+            result.items = items;
+            result.pixels = pixels;
+            result.instances = instances;
+            result.seconds = elapsed;
+        }
+    }
+    return result;
+}
+
+// Lines of a fixed length whose direction comes from the slope class,
+// centred anywhere on a screen-sized area around the screen. Long lines
+// and off-centre ones spill off-screen, which is what clipping is for.
+std::vector<LineCase> makeLines(int length, const std::string& slope, std::mt19937& rng) {
+    std::uniform_real_distribution<float> centreX(-0.25f * SCREEN_WIDTH, 1.25f * SCREEN_WIDTH);
+    std::uniform_real_distribution<float> centreY(-0.25f * SCREEN_HEIGHT, 1.25f * SCREEN_HEIGHT);
+    std::uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+    
+    std::vector<LineCase> lines;
+    for (int i = 0; i < PRIMITIVES_PER_SET; ++i) {
+        glm::vec2 direction;
+        if (slope == "horizontal") {
+            direction = glm::vec2(1.0f, 0.0f);
+        } else if (slope == "vertical") {
+            direction = glm::vec2(0.0f, 1.0f);
+        } else if (slope == "diagonal") {
+            direction = glm::normalize(glm::vec2(1.0f, 1.0f));
+        } else if (slope == "shallow") {
+            direction = glm::normalize(glm::vec2(8.0f, 1.0f));
+        } else {
+            float a = angle(rng);
+            direction = glm::vec2(std::cos(a), std::sin(a));
+        }
+        glm::vec2 centre(centreX(rng), centreY(rng));
+        glm::vec2 half = direction * (0.5f * length);
+        LineCase line = { static_cast<int>(centre.x - half.x), static_cast<int>(centre.y - half.y),
+                          static_cast<int>(centre.x + half.x), static_cast<int>(centre.y + half.y) };
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+std::vector<CircleCase> makeCircles(int radius, std::mt19937& rng) {
+    std::uniform_int_distribution<int> centreX(-SCREEN_WIDTH / 4, SCREEN_WIDTH * 5 / 4);
+    std::uniform_int_distribution<int> centreY(-SCREEN_HEIGHT / 4, SCREEN_HEIGHT * 5 / 4);
+    
+    std::vector<CircleCase> circles;
+    for (int i = 0; i < PRIMITIVES_PER_SET; ++i) {
+        CircleCase circle = { centreX(rng), centreY(rng), radius };
+        circles.push_back(circle);
+    }
+    return circles;
+}
+
+void benchLines(std::vector<Result>& results, double minSeconds, std::mt19937& rng) {
+    const int lengths[] = { 8, 64, 512, 2048 };
+    const char* slopes[] = { "horizontal", "vertical", "diagonal", "shallow", "random" };
+    RasterRect plotClip = SoftwareRasterizer::plotArea(screen());
+    
+    for (int length : lengths) {
+        for (const char* slope : slopes) {
+            std::vector<LineCase> lines = makeLines(length, slope, rng);
+            std::string distribution = "length" + std::to_string(length) + "_" + slope;
+            int count = static_cast<int>(lines.size());
+            
+            // Every position as its own vertex; off-screen ones are left to the GPU
+            results.push_back(measure("line", distribution, "points", count, minSeconds, [&]() {
+                for (const auto& l : lines) rasterBresenhamLine(l.x1, l.y1, l.x2, l.y2, pushPoint);
+                return static_cast<long long>(points.size());
+            }));
+            
+            results.push_back(measure("line", distribution, "spans", count, minSeconds, [&]() {
+                long long pixels = 0;
+                for (const auto& l : lines) {
+                    rasterBresenhamSpans(l.x1, l.y1, l.x2, l.y2, [&](const RasterSpan& span) {
+                        pixels += spanLength(span);
+                        pushSpan(SoftwareRasterizer::pointFootprint(span));
+                    });
+                }
+                return pixels;
+            }));
+            
+            // What Renderer2D::drawBresenhamLine does now
+            results.push_back(measure("line", distribution, "clipped_spans", count, minSeconds, [&]() {
+                long long pixels = 0;
+                for (const auto& l : lines) {
+                    rasterBresenhamSpans(l.x1, l.y1, l.x2, l.y2, plotClip, [&](const RasterSpan& span) {
+                        pixels += spanLength(span);
+                        pushSpan(SoftwareRasterizer::pointFootprint(span));
+                    });
+                }
+                return pixels;
+            }));
+        }
+    }
+}
+
+void benchCircles(std::vector<Result>& results, double minSeconds, std::mt19937& rng) {
+    const int radii[] = { 4, 32, 256, 1024 };
+    RasterRect plotClip = SoftwareRasterizer::plotArea(screen());
+    
+    for (int radius : radii) {
+        std::vector<CircleCase> circles = makeCircles(radius, rng);
+        std::string distribution = "radius" + std::to_string(radius);
+        int count = static_cast<int>(circles.size());
+        
+        // plot8Points straight into the vertex stream
+        results.push_back(measure("circle", distribution, "points", count, minSeconds, [&]() {
+            for (const auto& c : circles) rasterMidpointCircle(c.cx, c.cy, c.radius, pushPoint);
+            return static_cast<long long>(points.size());
+        }));
+        
+        results.push_back(measure("circle", distribution, "spans", count, minSeconds, [&]() {
+            long long pixels = 0;
+            for (const auto& c : circles) {
+                rasterMidpointCircleSpans(c.cx, c.cy, c.radius, [&](const RasterSpan& span) {
+                    pixels += spanLength(span);
+                    pushSpan(SoftwareRasterizer::pointFootprint(span));
+                });
+            }
+            return pixels;
+        }));
+        
+        // Renderer2D::drawMidpointCircle: skip circles that miss the screen
+        // or enclose it, clipped spans for the rest
+        results.push_back(measure("circle", distribution, "culled_spans", count, minSeconds, [&]() {
+            long long pixels = 0;
+            for (const auto& c : circles) {
+                if (!SoftwareRasterizer::circleTouches(c.cx, c.cy, c.radius, screen())) continue;
+                rasterMidpointCircleSpans(c.cx, c.cy, c.radius, plotClip, [&](const RasterSpan& span) {
+                    pixels += spanLength(span);
+                    pushSpan(SoftwareRasterizer::pointFootprint(span));
+                });
+            }
+            return pixels;
+        }));
+        
+        // Scanline disc fill, one clipped run per row
+        results.push_back(measure("disc", distribution, "clipped_spans", count, minSeconds, [&]() {
+            long long pixels = 0;
+            for (const auto& c : circles) {
+                rasterFillCircleSpans(c.cx, c.cy, c.radius, screen(), [&](const RasterSpan& span) {
+                    pixels += spanLength(span);
+                    pushSpan(RasterRect(span.x0, span.y0, span.x1 + 1, span.y1 + 1));
+                });
+            }
+            return pixels;
+        }));
+        results.back().fill = true;
+    }
+}
+
+// Building-like footprints: rotated rectangles, filled with the active
+// edge table
+void benchPolygons(std::vector<Result>& results, double minSeconds, std::mt19937& rng) {
+    const int sizes[] = { 16, 128, 512 };
+    
+    for (int size : sizes) {
+        std::vector<CircleCase> centres = makeCircles(size / 2, rng);
+        std::uniform_real_distribution<float> angle(0.0f, 1.5707963f);
+        std::vector<Point2D> corners;
+        for (const auto& centre : centres) {
+            float a = angle(rng);
+            glm::vec2 u = glm::vec2(std::cos(a), std::sin(a)) * (0.5f * size);
+            glm::vec2 v = glm::vec2(-u.y, u.x) * 0.6f;
+            glm::vec2 c(centre.cx, centre.cy);
+            glm::vec2 quad[] = { c - u - v, c + u - v, c + u + v, c - u + v };
+            for (const auto& q : quad) corners.push_back(Point2D(static_cast<int>(q.x), static_cast<int>(q.y)));
+        }
+        
+        std::string distribution = "size" + std::to_string(size) + "_rotated";
+        int count = static_cast<int>(centres.size());
+        results.push_back(measure("polygon", distribution, "clipped_spans", count, minSeconds, [&]() {
+            long long pixels = 0;
+            for (int i = 0; i < count; ++i) {
+                rasterFillPolygonSpans(corners.data() + 4 * i, 4, screen(), [&](const RasterSpan& span) {
+                    pixels += spanLength(span);
+                    pushSpan(RasterRect(span.x0, span.y0, span.x1 + 1, span.y1 + 1));
+                });
+            }
+            return pixels;
+        }));
+        results.back().fill = true;
+    }
+}
+
+std::string toJSON(const std::vector<Result>& results, bool quick) {
+    std::ostringstream out;
+    out << "{\n";
+    out << "  \"benchmark\": \"raster2d\",\n";
+    out << "  \"screen\": [" << SCREEN_WIDTH << ", " << SCREEN_HEIGHT << "],\n";
+    out << "  \"primitives_per_set\": " << PRIMITIVES_PER_SET << ",\n";
+    out << "  \"quick\": " << (quick ? "true" : "false") << ",\n";
+    out << "  \"fields\": {\n";
+    out << "    \"pixels_per_s\": \"lines and circle outlines: pixels plotted (one per position)\",\n";
+    out << "    \"spans_per_s\": \"disc and polygon fills: row spans emitted\",\n";
+    out << "    \"covered_pixels_per_s\": \"disc and polygon fills: area the spans cover, not comparable with pixels_per_s\"\n";
+    out << "  },\n";
+    out << "  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& r = results[i];
+        char rates[256];
+        if (r.fill) {
+            std::snprintf(rates, sizeof(rates),
+                          "\"items_per_s\": %.1f, \"spans_per_s\": %.1f, \"covered_pixels_per_s\": %.1f, "
+                          "\"instances_per_item\": %.3f, \"seconds\": %.4f",
+                          r.items / r.seconds, r.instances / r.seconds, r.pixels / r.seconds,
+                          static_cast<double>(r.instances) / r.items, r.seconds);
+        } else {
+            std::snprintf(rates, sizeof(rates),
+                          "\"items_per_s\": %.1f, \"pixels_per_s\": %.1f, \"instances_per_item\": %.3f, \"seconds\": %.4f",
+                          r.items / r.seconds, r.pixels / r.seconds,
+                          static_cast<double>(r.instances) / r.items, r.seconds);
+        }
+        out << "    {\"primitive\": \"" << r.primitive << "\", \"distribution\": \"" << r.distribution
+            << "\", \"variant\": \"" << r.variant << "\", " << rates << "}"
+            << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n";
+    out << "}\n";
+    return out.str();
+}
+
+}
+
+int main(int argc, char** argv) {
+    bool quick = false;
+    std::string outPath;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--quick") == 0) {
+            quick = true;
+        } else if (std::strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            outPath = argv[++i];
+        } else {
+            std::cerr << "Usage: raster_bench [--quick] [--out results.json]" << std::endl;
+            return 1;
+        }
+    }
+    
+    double minSeconds = quick ? 0.02 : 0.2;
+    std::mt19937 rng(2024); // Same primitives in every build
+    std::vector<Result> results;
+    
+    std::cerr << "[BENCH] Lines..." << std::endl;
+    benchLines(results, minSeconds, rng);
+    std::cerr << "[BENCH] Circles and discs..." << std::endl;
+    benchCircles(results, minSeconds, rng);
+    std::cerr << "[BENCH] Polygons..." << std::endl;
+    benchPolygons(results, minSeconds, rng);
+    
+    std::string json = toJSON(results, quick);
+    if (outPath.empty()) {
+        std::cout << json;
+        return 0;
+    }
+    
+    std::ofstream file(outPath);
+    if (!file) {
+        std::cerr << "ERROR::BENCH::FILE_NOT_WRITTEN: " << outPath << std::endl;
+        return 1;
+    }
+    file << json;
+    std::cerr << "[BENCH] Wrote " << results.size() << " results to " << outPath << std::endl;
+    return 0;
+}
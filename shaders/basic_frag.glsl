@@ -1,10 +1,10 @@
 #version 330 core
 
-out vec4 FragColor;
+in vec4 vertexColor;
 
-uniform vec3 color;
+out vec4 FragColor;
 
 void main()
 {
-    FragColor = vec4(color, 1.0);
+    FragColor = vertexColor;
 }
@@ -1,10 +1,15 @@
 #version 330 core
 
-layout (location = 0) in vec2 aPos;
+layout (location = 0) in vec2 aCorner;
+layout (location = 1) in vec4 aRect;   // x0, y0, x1, y1 in pixels
+layout (location = 2) in vec4 aColor;
 
 uniform mat4 projection;
 
+out vec4 vertexColor;
+
 void main()
 {
-    gl_Position = projection * vec4(aPos, 0.0, 1.0);
+    gl_Position = projection * vec4(mix(aRect.xy, aRect.zw, aCorner), 0.0, 1.0);
+    vertexColor = aColor;
 }
@@ -0,0 +1,33 @@
+#version 330 core
+
+out vec4 FragColor;
+
+in vec2 TexCoordA;
+in vec2 TexCoordB;
+
+uniform sampler2D atlas;
+uniform float variantBlend; // 0 = variant A, 1 = variant B
+uniform int lodDither; // 0 = solid, 1 = fading in, 2 = fading out
+uniform float lodCut; // Share of pixels the level fading in keeps
+
+// 4 x 4 ordered dither, as in tex_frag.glsl
+const float BAYER[16] = float[16](0.0, 8.0, 2.0, 10.0, 12.0, 4.0, 14.0, 6.0,
+                                  3.0, 11.0, 1.0, 9.0, 15.0, 7.0, 13.0, 5.0);
+
+bool ditheredOut()
+{
+    if (lodDither == 0) return false;
+    ivec2 pixel = ivec2(gl_FragCoord.xy) & 3;
+    float threshold = (BAYER[pixel.y * 4 + pixel.x] + 0.5) / 16.0;
+    return lodDither == 1 ? threshold >= lodCut : threshold < lodCut;
+}
+
+void main()
+{
+    if (ditheredOut()) discard;
+    
+    vec4 color = mix(texture(atlas, TexCoordA), texture(atlas, TexCoordB), variantBlend);
+    if (color.a < 0.5) discard; // Outside the baked silhouette
+    
+    FragColor = vec4(color.rgb, 1.0);
+}
@@ -0,0 +1,36 @@
+#version 330 core
+
+layout (location = 0) in vec2 aCorner;      // x across [-0.5, 0.5], y up [0, 1]
+layout (location = 1) in vec4 aFootprint;   // Per instance: building x, z, width, depth
+layout (location = 2) in vec2 aShape;       // Per instance: height, atlas column
+
+out vec2 TexCoordA;
+out vec2 TexCoordB;
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform vec3 viewPos;
+uniform vec2 atlasCells;    // Columns (archetypes), rows (time-of-day variants)
+uniform float padding;      // Cell area around the baked building, as a scale
+uniform int variantA;
+uniform int variantB;
+
+void main()
+{
+    // Turned about the vertical axis to face the camera
+    vec2 center = aFootprint.xy + aFootprint.zw * 0.5;
+    vec2 toCamera = viewPos.xz - center;
+    vec2 facing = dot(toCamera, toCamera) > 1e-6 ? normalize(toCamera) : vec2(0.0, 1.0);
+    vec2 across = vec2(-facing.y, facing.x);
+    
+    // As wide as the box seen from here
+    float width = (abs(across.x) * aFootprint.z + abs(across.y) * aFootprint.w) * padding;
+    vec2 ground = center + across * aCorner.x * width;
+    vec3 worldPos = vec3(ground.x, aCorner.y * aShape.x * padding, ground.y);
+    
+    vec2 uv = vec2(aCorner.x + 0.5, aCorner.y);
+    TexCoordA = (vec2(aShape.y, float(variantA)) + uv) / atlasCells;
+    TexCoordB = (vec2(aShape.y, float(variantB)) + uv) / atlasCells;
+    
+    gl_Position = projection * view * vec4(worldPos, 1.0);
+}
@@ -0,0 +1,18 @@
+#version 330 core
+
+in vec2 TexCoord;
+
+out vec4 FragColor;
+
+uniform sampler2D layer;
+
+void main()
+{
+    vec4 texel = texture(layer, TexCoord);
+    
+    // Unpainted texels let the clear colour through
+    if (texel.a < 0.5)
+        discard;
+    
+    FragColor = texel;
+}
@@ -0,0 +1,15 @@
+#version 330 core
+
+layout (location = 0) in vec2 aPos;
+layout (location = 1) in vec2 aTexCoord;
+
+uniform mat4 projection;
+uniform vec4 uvRect; // Texture area shown: min.xy, max.zw
+
+out vec2 TexCoord;
+
+void main()
+{
+    gl_Position = projection * vec4(aPos, 0.0, 1.0);
+    TexCoord = mix(uvRect.xy, uvRect.zw, aTexCoord);
+}
@@ -5,14 +5,18 @@ out vec4 FragColor;
 in vec3 FragPos;
 in vec3 Normal;
 in vec2 TexCoord;
+flat in vec4 Footprint; // Building x, z, width, depth
+flat in float Height;
+flat in vec4 Material; // Colour when not using texture, emissive (0.0 = normal lighting, 1.0 = full glow)
 
 uniform sampler2D diffuseTexture;
 uniform vec3 lightPos;
 uniform vec3 lightColor;
 uniform vec3 viewPos;
-uniform float emissive; // 0.0 = normal lighting, 1.0 = full glow
 uniform int useTexture; // 0 = use material color, 1 = use texture
-uniform vec3 materialColor; // Color when not using texture
+uniform int facadeWindows; // 1 = building at night: light the window grid on its walls, 2 = average glow only
+uniform int lodDither; // 0 = solid, 1 = fading in, 2 = fading out
+uniform float lodCut; // Share of pixels the level fading in keeps
 
 // Street light point lights (max 100 for better coverage)
 uniform int numPointLights;
@@ -45,12 +49,68 @@ vec3 calculatePointLight(vec3 lightPos, vec3 lightColor, vec3 normal, vec3 fragP
     return (diffuse + specular) * attenuation;
 }
 
+// Window grid: 4 x 3 windows every 15 across and 12 up, first centres 10
+// in from the corner and 8 above the ground
+const vec2 WINDOW_SPACING = vec2(15.0, 12.0);
+const vec2 WINDOW_FIRST = vec2(10.0, 8.0);
+const vec2 WINDOW_HALF_SIZE = vec2(2.0, 1.5);
+const float WINDOW_LIT_FRACTION = 0.7;
+const vec3 WINDOW_COLOR = vec3(1.0, 0.9, 0.4); // Bright warm yellow
+
+// Lit share of a wall far away: lit fraction times window area per cell
+const float WINDOW_COVERAGE = WINDOW_LIT_FRACTION * 4.0 * WINDOW_HALF_SIZE.x * WINDOW_HALF_SIZE.y / (WINDOW_SPACING.x * WINDOW_SPACING.y);
+
+// 4 x 4 ordered dither, thresholds in (0, 1)
+const float BAYER[16] = float[16](0.0, 8.0, 2.0, 10.0, 12.0, 4.0, 14.0, 6.0,
+                                  3.0, 11.0, 1.0, 9.0, 15.0, 7.0, 13.0, 5.0);
+
+// Levels crossing over keep complementary pixels, so together they cover
+// each pixel exactly once
+bool ditheredOut()
+{
+    if (lodDither == 0) return false;
+    ivec2 pixel = ivec2(gl_FragCoord.xy) & 3;
+    float threshold = (BAYER[pixel.y * 4 + pixel.x] + 0.5) / 16.0;
+    return lodDither == 1 ? threshold >= lodCut : threshold < lodCut;
+}
+
+float hash(vec3 p)
+{
+    return fract(sin(dot(p, vec3(12.9898, 78.233, 37.719))) * 43758.5453);
+}
+
+// True when the fragment lies in a lit window of the building's walls
+bool inLitWindow(vec3 normal)
+{
+    if (abs(normal.y) > 0.5) return false; // Roof and floor
+    
+    // Facade coordinates: distance along the wall from its corner, and height
+    bool alongX = abs(normal.z) > abs(normal.x);
+    float u = alongX ? FragPos.x - Footprint.x : FragPos.z - Footprint.y;
+    float wallWidth = alongX ? Footprint.z : Footprint.w;
+    vec2 facade = vec2(u, FragPos.y);
+    
+    vec2 cell = floor((facade - WINDOW_FIRST) / WINDOW_SPACING + 0.5);
+    vec2 center = WINDOW_FIRST + cell * WINDOW_SPACING;
+    if (any(greaterThan(abs(facade - center), WINDOW_HALF_SIZE))) return false;
+    
+    vec2 count = max(floor(vec2(wallWidth, Height) / WINDOW_SPACING), vec2(1.0));
+    if (any(lessThan(cell, vec2(0.0))) || any(greaterThanEqual(cell, count))) return false;
+    if (center.x > wallWidth - WINDOW_FIRST.x) return false;
+    
+    // Each wall of each building gets its own pattern
+    float wall = alongX ? sign(normal.z) : 2.0 * sign(normal.x);
+    return hash(vec3(Footprint.xy + cell * vec2(0.37, 1.71), wall)) < WINDOW_LIT_FRACTION;
+}
+
 void main()
 {
+    if (ditheredOut()) discard;
+    
     // If emissive, output the appropriate color directly (for glowing objects)
-    if (emissive > 0.5) {
+    if (Material.a > 0.5) {
         if (useTexture == 0) {
-            FragColor = vec4(materialColor, 1.0);
+            FragColor = vec4(Material.rgb, 1.0);
         } else {
             FragColor = vec4(lightColor, 1.0);
         }
@@ -59,6 +119,12 @@ void main()
     
     // Normal Phong lighting for non-emissive objects
     vec3 norm = normalize(Normal);
+    
+    if (facadeWindows == 1 && inLitWindow(norm)) {
+        FragColor = vec4(WINDOW_COLOR, 1.0);
+        return;
+    }
+    
     vec3 viewDir = normalize(viewPos - FragPos);
     
     // Main directional light (sun/moon)
@@ -85,7 +151,12 @@ void main()
     if (useTexture == 1) {
         result *= texture(diffuseTexture, TexCoord).rgb;
     } else {
-        result *= materialColor;
+        result *= Material.rgb;
+    }
+    
+    // Distant buildings: the windows' average instead of the grid
+    if (facadeWindows == 2 && abs(norm.y) <= 0.5) {
+        result = mix(result, WINDOW_COLOR, WINDOW_COVERAGE);
     }
     
     FragColor = vec4(result, 1.0);
@@ -4,18 +4,85 @@ layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoord;
 
+// Building box: footprint (x, z, width, depth) and height. Per vertex in
+// merged geometry, a constant when drawn per object (instanced buildings
+// read theirs from the instance state buffer).
+layout (location = 3) in vec4 aFootprint;
+layout (location = 4) in float aHeight;
+// Instanced building, vehicle, pedestrian or street light: index into the instance state buffer
+layout (location = 5) in int aInstance;
+
 out vec3 FragPos;
 out vec3 Normal;
 out vec2 TexCoord;
+flat out vec4 Footprint;
+flat out float Height;
+flat out vec4 Material; // Colour and emissive: the uniforms, or a street light piece's own
 
 uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
+uniform int instanced; // 1 = place the unit cube as a building instead of by model, 2 = as a vehicle, 3 = as a street light piece, 4 = as a pedestrian
+uniform vec3 materialColor;
+uniform float emissive;
+// Instance state. Per building two texels: footprint, then height. Per
+// vehicle two texels: position and heading x, velocity
+// and heading z, as of the last simulation tick (simulationLag is the time
+// since it). Per pedestrian one texel: x, z, velocity x, velocity z, also
+// as of the last tick. Per street light a pole then a bulb, three texels each:
+// centre, size, colour and emissive.
+uniform samplerBuffer instanceStates;
+uniform float simulationLag;
+uniform int lightPart; // 0 = pole, 1 = bulb
 
 void main()
 {
-    FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(model))) * aNormal;
+    mat4 world = model;
+    Footprint = aFootprint;
+    Height = aHeight;
+    if (instanced == 1) {
+        Footprint = texelFetch(instanceStates, aInstance * 2);
+        Height = texelFetch(instanceStates, aInstance * 2 + 1).x;
+        vec3 size = vec3(Footprint.z, Height, Footprint.w);
+        vec3 center = vec3(Footprint.x, 0.0, Footprint.y) + size * 0.5;
+        world = mat4(vec4(size.x, 0.0, 0.0, 0.0),
+                     vec4(0.0, size.y, 0.0, 0.0),
+                     vec4(0.0, 0.0, size.z, 0.0),
+                     vec4(center, 1.0));
+    } else if (instanced == 2) {
+        vec4 state = texelFetch(instanceStates, aInstance * 2);
+        vec4 velocity = texelFetch(instanceStates, aInstance * 2 + 1);
+        vec2 heading = vec2(state.w, velocity.w);
+        vec3 center = state.xyz + velocity.xyz * simulationLag;
+        // 8 long along the heading, 4 wide and high (vehicleModel in renderer3d.cpp)
+        world = mat4(vec4(heading.x * 8.0, 0.0, heading.y * 8.0, 0.0),
+                     vec4(0.0, 4.0, 0.0, 0.0),
+                     vec4(-heading.y * 4.0, 0.0, heading.x * 4.0, 0.0),
+                     vec4(center, 1.0));
+    } else if (instanced == 4) {
+        vec4 state = texelFetch(instanceStates, aInstance);
+        vec2 position = state.xy + state.zw * simulationLag;
+        // 1.5 wide, 3.5 high, standing on the ground (pedestrianModel in renderer3d.cpp)
+        world = mat4(vec4(1.5, 0.0, 0.0, 0.0),
+                     vec4(0.0, 3.5, 0.0, 0.0),
+                     vec4(0.0, 0.0, 1.5, 0.0),
+                     vec4(position.x, 1.75, position.y, 1.0));
+    }
+    
+    Material = vec4(materialColor, emissive);
+    if (instanced == 3) {
+        int piece = (aInstance * 2 + lightPart) * 3;
+        vec3 center = texelFetch(instanceStates, piece).xyz;
+        vec3 size = texelFetch(instanceStates, piece + 1).xyz;
+        Material = texelFetch(instanceStates, piece + 2);
+        world = mat4(vec4(size.x, 0.0, 0.0, 0.0),
+                     vec4(0.0, size.y, 0.0, 0.0),
+                     vec4(0.0, 0.0, size.z, 0.0),
+                     vec4(center, 1.0));
+    }
+    
+    FragPos = vec3(world * vec4(aPos, 1.0));
+    Normal = mat3(transpose(inverse(world))) * aNormal;
     TexCoord = aTexCoord;
     
     gl_Position = projection * view * vec4(FragPos, 1.0);
@@ -0,0 +1,83 @@
+#include "buildinglod.h"
+#include <algorithm>
+
+namespace {
+
+const float SWITCH_DISTANCE[BuildingLOD::LEVEL_COUNT - 1] = { 250.0f, 550.0f }; // Full -> box, box -> impostor
+const float HYSTERESIS = 0.1f;  // Leave a level 10% past its switch distance, return 10% short of it
+const float FADE_TIME = 0.4f;   // Seconds
+
+// From the eye to the nearest point of the building
+float distanceTo(const Building& building, const glm::vec3& eye) {
+    glm::vec3 low(building.position.x, 0.0f, building.position.y);
+    glm::vec3 high(building.position.x + building.size.x, building.height, building.position.y + building.size.y);
+    return glm::length(glm::clamp(eye, low, high) - eye);
+}
+
+bool drawOrder(const BuildingLOD::Item& a, const BuildingLOD::Item& b) {
+    if (a.level != b.level) return a.level < b.level;
+    if (a.dither != b.dither) return a.dither < b.dither;
+    if (a.step != b.step) return a.step < b.step;
+    if (a.material != b.material) return a.material < b.material;
+    return a.building < b.building;
+}
+
+}
+
+BuildingLOD::BuildingLOD() : enabled(true), frame(0), impostorStart(0) {}
+
+int BuildingLOD::targetLevel(int current, float distance) {
+    int result = current;
+    while (result < LEVEL_COUNT - 1 && distance > SWITCH_DISTANCE[result] * (1.0f + HYSTERESIS)) ++result;
+    while (result > 0 && distance < SWITCH_DISTANCE[result - 1] * (1.0f - HYSTERESIS)) --result;
+    return result;
+}
+
+void BuildingLOD::update(const std::vector<Building>& buildings, const std::vector<int>& visible,
+                         const glm::vec3& eye, float deltaTime) {
+    // A different city: every building starts settled where it stands
+    if (level.size() != buildings.size()) {
+        level.assign(buildings.size(), FULL);
+        fromLevel.assign(buildings.size(), FULL);
+        fade.assign(buildings.size(), 1.0f);
+        seenFrame.assign(buildings.size(), 0);
+    }
+    ++frame;
+    
+    items.clear();
+    for (int index : visible) {
+        const Building& building = buildings[index];
+        uint8_t material = building.textureIndex == 0 ? 0 : 1;
+        if (!enabled) {
+            items.push_back({ index, FULL, SOLID, 0, material });
+            continue;
+        }
+        
+        // Buildings coming into view snap to their level; nothing to fade from
+        bool seen = seenFrame[index] != 0 && seenFrame[index] + 1 == frame;
+        seenFrame[index] = frame;
+        int target = targetLevel(level[index], distanceTo(building, eye));
+        if (!seen) {
+            level[index] = static_cast<uint8_t>(target);
+            fade[index] = 1.0f;
+        } else if (fade[index] >= 1.0f && target != level[index]) {
+            fromLevel[index] = level[index];
+            level[index] = static_cast<uint8_t>(target);
+            fade[index] = 0.0f;
+        } else if (fade[index] < 1.0f) {
+            fade[index] = std::min(fade[index] + deltaTime / FADE_TIME, 1.0f);
+        }
+        
+        if (fade[index] >= 1.0f) {
+            items.push_back({ index, level[index], SOLID, 0, material });
+        } else {
+            uint8_t step = static_cast<uint8_t>(std::min(static_cast<int>(fade[index] * FADE_STEPS), FADE_STEPS - 1));
+            items.push_back({ index, level[index], FADE_IN, step, material });
+            items.push_back({ index, fromLevel[index], FADE_OUT, step, material });
+        }
+    }
+    
+    std::sort(items.begin(), items.end(), drawOrder);
+    Item firstImpostor = { 0, IMPOSTOR, SOLID, 0, 0 };
+    impostorStart = std::lower_bound(items.begin(), items.end(), firstImpostor, drawOrder) - items.begin();
+}
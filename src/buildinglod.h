@@ -0,0 +1,61 @@
+#ifndef BUILDINGLOD_H
+#define BUILDINGLOD_H
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+#include "citygenerator.h"
+
+// Distance-based level of detail for buildings: full facade (lit windows,
+// street lights), a plain box, then a camera-facing impostor from the baked
+// atlas. Levels change with hysteresis around each switch distance, and a
+// change cross-fades with complementary screen-door dither, so both levels
+// are drawn for a moment and neither pops.
+class BuildingLOD {
+public:
+    enum Level { FULL, BOX, IMPOSTOR, LEVEL_COUNT };
+    enum Dither { SOLID, FADE_IN, FADE_OUT };
+    
+    static const int FADE_STEPS = 8;            // Dither cut quantised so runs can share a draw
+    
+    // One draw of one building. A fading building has two: the level it
+    // leaves (FADE_OUT) and the level it enters (FADE_IN) at the same step.
+    struct Item {
+        int building;
+        uint8_t level;
+        uint8_t dither;
+        uint8_t step;
+        uint8_t material;                       // Facade texture
+    };
+    
+    BuildingLOD();
+    
+    void setEnabled(bool value) { enabled = value; }
+    bool isEnabled() const { return enabled; }
+    
+    // Steps the fades and fills getItems() for the visible buildings, sorted
+    // by level, dither, step and material so equal runs are one draw each
+    void update(const std::vector<Building>& buildings, const std::vector<int>& visible,
+                const glm::vec3& eye, float deltaTime);
+    
+    const std::vector<Item>& getItems() const { return items; }
+    // Items before this index are boxes (full or plain); the rest impostors
+    size_t getImpostorStart() const { return impostorStart; }
+    
+    // Share of a dithered fragment kept at this step
+    static float ditherCut(int step) { return (step + 0.5f) / FADE_STEPS; }
+    
+private:
+    bool enabled;
+    uint32_t frame;
+    std::vector<uint8_t> level;                 // Per building: level shown (or faded to)
+    std::vector<uint8_t> fromLevel;             // Level being faded out
+    std::vector<float> fade;                    // 1 = settled
+    std::vector<uint32_t> seenFrame;            // Last frame it was visible (0 = never)
+    std::vector<Item> items;
+    size_t impostorStart;
+    
+    static int targetLevel(int current, float distance);
+};
+
+#endif
@@ -0,0 +1,183 @@
+#include "bvh.h"
+#include <algorithm>
+
+namespace {
+
+BVHBox unite(const BVHBox& a, const BVHBox& b) {
+    return BVHBox(glm::min(a.min, b.min), glm::max(a.max, b.max));
+}
+
+float surfaceArea(const BVHBox& box) {
+    glm::vec3 size = glm::max(box.max - box.min, glm::vec3(0.0f));
+    return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+Frustum::Result classify(const Frustum& frustum, const BVHBox& box) {
+    return frustum.classify((box.min + box.max) * 0.5f, (box.max - box.min) * 0.5f);
+}
+
+}
+
+BVH::BVH() {}
+
+void BVH::clear() {
+    nodes.clear();
+    items.clear();
+    order.clear();
+    leafOf.clear();
+}
+
+void BVH::build(const std::vector<BVHBox>& boxes) {
+    clear();
+    if (boxes.empty()) return;
+    
+    int count = static_cast<int>(boxes.size());
+    items = boxes;
+    order.resize(count);
+    leafOf.assign(count, -1);
+    centroids.resize(count);
+    for (int i = 0; i < count; ++i) {
+        order[i] = i;
+        centroids[i] = (boxes[i].min + boxes[i].max) * 0.5f;
+    }
+    
+    nodes.reserve(2 * (count / MAX_LEAF_ITEMS + 1));
+    buildNode(-1, 0, count);
+}
+
+int BVH::buildNode(int parent, int first, int count) {
+    int index = static_cast<int>(nodes.size());
+    nodes.emplace_back();
+    
+    BVHBox bounds = items[order[first]];
+    for (int i = first + 1; i < first + count; ++i) bounds = unite(bounds, items[order[i]]);
+    
+    Node& node = nodes[index];
+    node.box = bounds;
+    node.parent = parent;
+    node.left = node.right = -1;
+    node.first = first;
+    node.count = count;
+    
+    if (count <= MAX_LEAF_ITEMS) {
+        for (int i = first; i < first + count; ++i) leafOf[order[i]] = index;
+        return index;
+    }
+    
+    int middle = partition(first, count);
+    int left = buildNode(index, first, middle - first);
+    int right = buildNode(index, middle, first + count - middle);
+    nodes[index].left = left;   // Not through node: the vector may have grown
+    nodes[index].right = right;
+    return index;
+}
+
+// Splits the run at the cheapest of the bin boundaries along the widest
+// centroid axis (surface area heuristic) and returns where the right half
+// starts. Falls back to a median split when every centroid coincides.
+int BVH::partition(int first, int count) {
+    glm::vec3 low = centroids[order[first]], high = low;
+    for (int i = first + 1; i < first + count; ++i) {
+        low = glm::min(low, centroids[order[i]]);
+        high = glm::max(high, centroids[order[i]]);
+    }
+    glm::vec3 spread = high - low;
+    int axis = spread.x >= spread.y && spread.x >= spread.z ? 0 : (spread.y >= spread.z ? 1 : 2);
+    
+    if (spread[axis] <= 0.0f) {
+        return first + count / 2;
+    }
+    
+    int binCount[SAH_BINS] = {};
+    BVHBox binBox[SAH_BINS];
+    float scale = SAH_BINS / spread[axis];
+    auto binOf = [&](int id) {
+        int bin = static_cast<int>((centroids[id][axis] - low[axis]) * scale);
+        return std::min(bin, SAH_BINS - 1);
+    };
+    for (int i = first; i < first + count; ++i) {
+        int bin = binOf(order[i]);
+        binBox[bin] = binCount[bin] ? unite(binBox[bin], items[order[i]]) : items[order[i]];
+        binCount[bin]++;
+    }
+    
+    // Sweep from the right for suffix areas, then from the left for the cost
+    float rightArea[SAH_BINS];
+    int rightCount[SAH_BINS];
+    BVHBox accumulated;
+    int accumulatedCount = 0;
+    for (int bin = SAH_BINS - 1; bin > 0; --bin) {
+        if (binCount[bin]) {
+            accumulated = accumulatedCount ? unite(accumulated, binBox[bin]) : binBox[bin];
+            accumulatedCount += binCount[bin];
+        }
+        rightArea[bin] = accumulatedCount ? surfaceArea(accumulated) : 0.0f;
+        rightCount[bin] = accumulatedCount;
+    }
+    
+    int bestSplit = -1; // Bins below it go left
+    float bestCost = 0.0f;
+    accumulatedCount = 0;
+    for (int split = 1; split < SAH_BINS; ++split) {
+        int bin = split - 1;
+        if (binCount[bin]) {
+            accumulated = accumulatedCount ? unite(accumulated, binBox[bin]) : binBox[bin];
+            accumulatedCount += binCount[bin];
+        }
+        if (accumulatedCount == 0 || rightCount[split] == 0) continue;
+        
+        float cost = accumulatedCount * surfaceArea(accumulated) + rightCount[split] * rightArea[split];
+        if (bestSplit < 0 || cost < bestCost) {
+            bestSplit = split;
+            bestCost = cost;
+        }
+    }
+    
+    if (bestSplit < 0) {
+        return first + count / 2;
+    }
+    auto middle = std::partition(order.begin() + first, order.begin() + first + count,
+                                 [&](int id) { return binOf(id) < bestSplit; });
+    return static_cast<int>(middle - order.begin());
+}
+
+void BVH::refit(int id, const BVHBox& box) {
+    if (id < 0 || id >= size()) return;
+    items[id] = box;
+    
+    for (int index = leafOf[id]; index != -1; index = nodes[index].parent) {
+        Node& node = nodes[index];
+        if (node.left == -1) {
+            node.box = items[order[node.first]];
+            for (int i = node.first + 1; i < node.first + node.count; ++i) node.box = unite(node.box, items[order[i]]);
+        } else {
+            node.box = unite(nodes[node.left].box, nodes[node.right].box);
+        }
+    }
+}
+
+void BVH::cull(const Frustum& frustum, std::vector<int>& visible) const {
+    if (nodes.empty()) return;
+    
+    std::vector<int> stack;
+    stack.reserve(64);
+    stack.push_back(0);
+    while (!stack.empty()) {
+        const Node& node = nodes[stack.back()];
+        stack.pop_back();
+        
+        Frustum::Result result = classify(frustum, node.box);
+        if (result == Frustum::OUTSIDE) continue;
+        
+        if (result == Frustum::INSIDE) {
+            visible.insert(visible.end(), order.begin() + node.first, order.begin() + node.first + node.count);
+        } else if (node.left == -1) {
+            for (int i = node.first; i < node.first + node.count; ++i) {
+                if (classify(frustum, items[order[i]]) != Frustum::OUTSIDE) visible.push_back(order[i]);
+            }
+        } else {
+            stack.push_back(node.left);
+            stack.push_back(node.right);
+        }
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <glm/glm.hpp>
+#include <vector>
+#include "frustum.h"
+
+// Axis-aligned box in world space
+struct BVHBox {
+    glm::vec3 min, max;
+    BVHBox() : min(0.0f), max(0.0f) {}
+    BVHBox(const glm::vec3& min, const glm::vec3& max) : min(min), max(max) {}
+};
+
+// Bounding volume hierarchy over static boxes identified by their index in
+// build(). Built top-down with binned SAH splits; an edited box is refitted
+// in place (its leaf and every ancestor grow or shrink, the topology stays),
+// which keeps culling exact while local edits only slowly loosen the tree.
+// Every node covers a contiguous run of the item order, so a node fully
+// inside the frustum is accepted without visiting its children.
+class BVH {
+public:
+    static const int MAX_LEAF_ITEMS = 4;
+    static const int SAH_BINS = 12;
+    
+    BVH();
+    
+    void build(const std::vector<BVHBox>& boxes);
+    void clear();
+    void refit(int id, const BVHBox& box);
+    
+    // Appends the ids of boxes that are at least partly in the frustum
+    void cull(const Frustum& frustum, std::vector<int>& visible) const;
+    
+    int size() const { return static_cast<int>(items.size()); }
+    
+private:
+    struct Node {
+        BVHBox box;
+        int parent;             // -1 for the root
+        int left, right;        // Children, -1 in leaves
+        int first, count;       // Run of the item order this node covers
+    };
+    
+    std::vector<Node> nodes;
+    std::vector<BVHBox> items;  // By id
+    std::vector<int> order;     // Ids grouped so every node's items are contiguous
+    std::vector<int> leafOf;    // Leaf holding each id
+    std::vector<glm::vec3> centroids; // Build scratch
+    
+    int buildNode(int parent, int first, int count);
+    int partition(int first, int count);
+};
+
+#endif
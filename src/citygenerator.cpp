@@ -3,10 +3,49 @@
 #include <ctime>
 #include <cmath>
 #include <algorithm>
+#include <functional>
 #include <iostream>
+#include <unordered_map>
+
+namespace {
+
+// Car following: full speed with nobody within FOLLOW_DISTANCE ahead,
+// slowing to MIN_FOLLOW_SCALE at MIN_GAP (never a full stop, so two cars
+// that see each other at a crossing can't deadlock)
+const float FOLLOW_DISTANCE = 25.0f;
+const float MIN_GAP = 8.0f;
+const float MIN_FOLLOW_SCALE = 0.2f;
+const float AHEAD_COS = 0.866f; // 30 degree cone
+
+// Gravity model for trips: a destination attracts in proportion to its size,
+// damped by network distance over this scale
+const float TRIP_LENGTH_SCALE = 300.0f;
+
+// Global so revisions stay unique across copies of the generator
+uint64_t lastRevision = 0;
+
+RTreeBox footprintOf(const Building& building) {
+    return RTreeBox(building.position, building.position + building.size);
+}
+
+float distanceToRoad(const glm::vec2& point, const Road& road) {
+    glm::vec2 a(road.start.x, road.start.y);
+    glm::vec2 ab = glm::vec2(road.end.x, road.end.y) - a;
+    float lengthSq = glm::dot(ab, ab);
+    float t = lengthSq > 0.0f ? glm::clamp(glm::dot(point - a, ab) / lengthSq, 0.0f, 1.0f) : 0.0f;
+    return glm::length(point - (a + ab * t));
+}
 
-CityGenerator::CityGenerator() : layoutSize(600) {
-    std::srand(static_cast<unsigned int>(std::time(nullptr)));
+}
+
+CityGenerator::CityGenerator() : buildingRevision(0), roadRevision(0), vehicleRevision(0), streetLightRevision(0), pendingVehicles(0), layoutSize(600), simTime(0.0f), trafficLodRadius(350.0f) {
+    touchBuildings();
+    setSeed(static_cast<uint64_t>(std::time(nullptr)));
+}
+
+void CityGenerator::setSeed(uint64_t newSeed) {
+    seed = newSeed;
+    random.setSeed(newSeed);
 }
 
 void CityGenerator::generateCity(int numBuildings, int layoutSize, RoadType roadType, SkylineType skylineType) {
@@ -19,8 +58,9 @@ void CityGenerator::generateCity(int numBuildings, int layoutSize, RoadType road
     generateRoads(roadType, layoutSize);
     generateBuildings(numBuildings, skylineType, layoutSize);
     generateParks(3, layoutSize);
-    generateVehicles(8);
     generateStreetLights();
+    // Last, so the road graph contracts in the background meanwhile
+    generateVehicles(8);
 }
 
 void CityGenerator::generateRoads(RoadType type, int size) {
@@ -38,6 +78,20 @@ void CityGenerator::generateRoads(RoadType type, int size) {
             generateRandomRoads(size);
             break;
     }
+    
+    // Routing hierarchy, reused from disk when this exact network was seen
+    // before; contracted on the thread pool
+    roadGraph.build(roads);
+    roadGraph.prepare("cache");
+    roadRevision = ++lastRevision;
+    
+    // Vehicles belong to links of the old network. Their trips need the
+    // hierarchy, so they come back at the start of the next tick instead
+    // of waiting for it here.
+    pendingVehicles += static_cast<int>(vehicles.size());
+    vehicles.clear();
+    resetTrafficLinks();
+    vehicleRevision = ++lastRevision;
 }
 
 void CityGenerator::generateGridRoads(int size) {
@@ -95,10 +149,10 @@ void CityGenerator::generateRandomRoads(int size) {
     int numRoads = 15;
     
     for (int i = 0; i < numRoads; ++i) {
-        int x1 = std::rand() % size;
-        int y1 = std::rand() % size;
-        int x2 = std::rand() % size;
-        int y2 = std::rand() % size;
+        int x1 = random.nextInt(size);
+        int y1 = random.nextInt(size);
+        int x2 = random.nextInt(size);
+        int y2 = random.nextInt(size);
         
         roads.push_back({Point2D(x1, y1), Point2D(x2, y2)});
     }
@@ -109,22 +163,30 @@ void CityGenerator::generateBuildings(int numBuildings, SkylineType skylineType,
     int maxAttempts = numBuildings * 10;
     
     while (buildings.size() < static_cast<size_t>(numBuildings) && attempts < maxAttempts) {
-        glm::vec2 size(30.0f + (std::rand() % 40), 30.0f + (std::rand() % 40));
-        glm::vec2 pos(std::rand() % (layoutSize - static_cast<int>(size.x)), 
-                      std::rand() % (layoutSize - static_cast<int>(size.y)));
+        glm::vec2 size(30.0f + random.nextInt(40), 30.0f + random.nextInt(40));
+        glm::vec2 pos(random.nextInt(layoutSize - static_cast<int>(size.x)), 
+                      random.nextInt(layoutSize - static_cast<int>(size.y)));
         
         if (isValidBuildingPosition(pos, size, layoutSize)) {
             Building building;
             building.position = pos;
             building.size = size;
             building.height = getHeightForSkyline(skylineType);
-            building.textureIndex = std::rand() % 2;
+            building.textureIndex = random.nextInt(2);
             
+            buildingIndex.insert(static_cast<int>(buildings.size()), footprintOf(building));
             buildings.push_back(building);
         }
         
         attempts++;
     }
+    
+    // Repack the finished layout for tighter nodes than incremental inserts give
+    std::vector<RTreeBox> footprints;
+    footprints.reserve(buildings.size());
+    for (const auto& building : buildings) footprints.push_back(footprintOf(building));
+    buildingIndex.build(footprints);
+    touchBuildings();
 }
 
 void CityGenerator::generateParks(int numParks, int layoutSize) {
@@ -156,8 +218,11 @@ bool CityGenerator::isValidBuildingPosition(const glm::vec2& pos, const glm::vec
         return false;
     }
     
-    // Check overlap with existing buildings
-    for (const auto& building : buildings) {
+    // Check overlap with existing buildings near the candidate
+    std::vector<int> nearby;
+    buildingIndex.queryRect(RTreeBox(pos - glm::vec2(10.0f), pos + size + glm::vec2(10.0f)), nearby);
+    for (int index : nearby) {
+        const Building& building = buildings[index];
         if (pos.x < building.position.x + building.size.x + 10.0f &&
             pos.x + size.x + 10.0f > building.position.x &&
             pos.y < building.position.y + building.size.y + 10.0f &&
@@ -169,14 +234,22 @@ bool CityGenerator::isValidBuildingPosition(const glm::vec2& pos, const glm::vec
     return true;
 }
 
+void CityGenerator::setSkylineType(SkylineType type) {
+    currentSkylineType = type;
+    for (auto& building : buildings) {
+        building.height = getHeightForSkyline(type);
+    }
+    touchBuildings();
+}
+
 float CityGenerator::getHeightForSkyline(SkylineType type) {
     switch (type) {
         case SkylineType::LOW_RISE:
-            return 20.0f + (std::rand() % 30);
+            return 20.0f + random.nextInt(30);
         case SkylineType::MID_RISE:
-            return 50.0f + (std::rand() % 50);
+            return 50.0f + random.nextInt(50);
         case SkylineType::SKYSCRAPER:
-            return 100.0f + (std::rand() % 100);
+            return 100.0f + random.nextInt(100);
         default:
             return 50.0f;
     }
@@ -184,32 +257,127 @@ float CityGenerator::getHeightForSkyline(SkylineType type) {
 
 void CityGenerator::clear() {
     buildings.clear();
+    buildingIndex.clear();
+    touchBuildings();
     roads.clear();
     parks.clear();
     vehicles.clear();
+    vehicleRevision = ++lastRevision;
     streetLights.clear();
+    streetLightRevision = ++lastRevision;
+    trafficLinks.clear();
+    pendingVehicles = 0;
+    simTime = 0.0f; // A regenerated city must replay exactly like a fresh one
 }
 
+// Each vehicle starts next to a random building and drives its road toward
+// a destination drawn by the gravity model over network distances (one
+// batched OD matrix). Waits for the road graph hierarchy.
 void CityGenerator::generateVehicles(int numVehicles) {
-    if (roads.empty()) return;
+    if (roads.empty() || numVehicles <= 0) return;
+    
+    // Origin road per vehicle: nearest to a random building, or any road
+    std::vector<int> roadIndices(numVehicles);
+    for (int i = 0; i < numVehicles; ++i) {
+        if (buildings.empty()) {
+            roadIndices[i] = random.nextInt(static_cast<int>(roads.size()));
+            continue;
+        }
+        const Building& origin = buildings[random.nextInt(static_cast<int>(buildings.size()))];
+        glm::vec2 center = origin.position + origin.size * 0.5f;
+        int nearest = 0;
+        float nearestDist = distanceToRoad(center, roads[0]);
+        for (size_t r = 1; r < roads.size(); ++r) {
+            float dist = distanceToRoad(center, roads[r]);
+            if (dist < nearestDist) {
+                nearestDist = dist;
+                nearest = static_cast<int>(r);
+            }
+        }
+        roadIndices[i] = nearest;
+    }
+    
+    // Destinations: the graph node next to every building and park, with
+    // their attraction summed per node
+    std::vector<int> targets;
+    std::vector<float> attraction;
+    std::unordered_map<int, int> targetSlot;
+    auto addDestination = [&](const glm::vec2& position, float weight) {
+        int node = roadGraph.nearestNode(position);
+        if (node < 0 || weight <= 0.0f) return;
+        auto it = targetSlot.find(node);
+        if (it != targetSlot.end()) {
+            attraction[it->second] += weight;
+            return;
+        }
+        targetSlot[node] = static_cast<int>(targets.size());
+        targets.push_back(node);
+        attraction.push_back(weight);
+    };
+    for (const auto& building : buildings) {
+        addDestination(building.position + building.size * 0.5f, building.size.x * building.size.y * building.height);
+    }
+    for (const auto& park : parks) {
+        addDestination(glm::vec2(park.center.x, park.center.y), static_cast<float>(park.radius * park.radius));
+    }
+    
+    // Both ends of every origin road
+    std::vector<int> sources(numVehicles * 2);
+    for (int i = 0; i < numVehicles; ++i) {
+        const Road& road = roads[roadIndices[i]];
+        sources[i * 2] = roadGraph.nearestNode(glm::vec2(road.start.x, road.start.y));
+        sources[i * 2 + 1] = roadGraph.nearestNode(glm::vec2(road.end.x, road.end.y));
+    }
+    std::vector<float> distances = roadGraph.queryMatrix(sources, targets);
+    int numTargets = static_cast<int>(targets.size());
     
+    std::vector<float> weights(numTargets);
     for (int i = 0; i < numVehicles; ++i) {
-        const Road& road = roads[std::rand() % roads.size()];
+        const Road& road = roads[roadIndices[i]];
+        const float* fromStart = distances.data() + static_cast<size_t>(i * 2) * numTargets;
+        const float* fromEnd = fromStart + numTargets;
         
-        Vehicle vehicle;
-        vehicle.position = glm::vec3(road.start.x, 5.0f, road.start.y);
+        float totalWeight = 0.0f;
+        for (int j = 0; j < numTargets; ++j) {
+            float dist = std::min(fromStart[j], fromEnd[j]);
+            weights[j] = std::isinf(dist) ? 0.0f : attraction[j] * std::exp(-dist / TRIP_LENGTH_SCALE);
+            totalWeight += weights[j];
+        }
         
+        // Drive toward the end closer to the destination; with no reachable
+        // destination the draw is still taken to keep the stream in step
+        float pick = random.nextFloat() * totalWeight;
+        int destination = -1;
+        for (int j = 0; j < numTargets; ++j) {
+            if (weights[j] <= 0.0f) continue;
+            destination = j;
+            pick -= weights[j];
+            if (pick < 0.0f) break;
+        }
+        bool towardStart = destination >= 0 && fromStart[destination] < fromEnd[destination];
+        glm::vec3 roadStart(road.start.x, 5.0f, road.start.y);
         glm::vec3 roadEnd(road.end.x, 5.0f, road.end.y);
-        vehicle.direction = glm::normalize(roadEnd - vehicle.position);
-        vehicle.speed = 20.0f + (std::rand() % 20); // 20-40 units per second
+        if (towardStart) std::swap(roadStart, roadEnd);
+        
+        Vehicle vehicle;
+        vehicle.roadIndex = roadIndices[i];
+        vehicle.mesoscopic = false;
+        vehicle.linkEntryTime = simTime;
+        vehicle.position = roadStart;
+        vehicle.direction = glm::normalize(roadEnd - roadStart);
+        vehicle.speed = 20.0f + random.nextInt(20); // 20-40 units per second
+        vehicle.speedScale = 1.0f;
         vehicle.pathIndex = 0;
         
-        // Create simple path along the road
-        vehicle.path.push_back(vehicle.position);
+        // Simple path along the road
+        vehicle.path.push_back(roadStart);
         vehicle.path.push_back(roadEnd);
         
         vehicles.push_back(vehicle);
     }
+    
+    resetTrafficLinks();
+    vehicleRevision = ++lastRevision;
 }
 
 void CityGenerator::generateStreetLights() {
@@ -238,41 +406,253 @@ void CityGenerator::generateStreetLights() {
             streetLights.push_back(light);
         }
     }
+    streetLightRevision = ++lastRevision;
+}
+
+void CityGenerator::updateVehicles(float deltaTime, const glm::vec3& focus) {
+    // Vehicles waiting on a new road network
+    if (pendingVehicles > 0) {
+        generateVehicles(pendingVehicles);
+        pendingVehicles = 0;
+    }
+    
+    // Hand vehicles over between the two models before stepping, while
+    // positions still belong to simTime
+    updateTrafficLOD(focus);
+    simTime += deltaTime;
+    
+    // Neighbour queries see everyone's position from the start of the tick,
+    // so the result doesn't depend on stepping order
+    vehiclePositions.resize(vehicles.size());
+    for (size_t i = 0; i < vehicles.size(); ++i) {
+        vehiclePositions[i] = glm::vec2(vehicles[i].position.x, vehicles[i].position.z);
+    }
+    vehicleHash.build(vehiclePositions);
+    
+    // Only links near the camera pay per-vehicle cost
+    for (auto& link : trafficLinks) {
+        if (link.microscopic) {
+            for (int index : link.vehicles) {
+                stepMicroscopic(vehicles[index], link, deltaTime, followingSpeedScale(index));
+            }
+        } else {
+            stepMesoscopic(link);
+        }
+    }
+    vehicleRevision = ++lastRevision;
 }
 
-void CityGenerator::updateVehicles(float deltaTime) {
-    for (auto& vehicle : vehicles) {
-        if (vehicle.path.size() < 2) continue;
+float CityGenerator::followingSpeedScale(int vehicleIndex) {
+    const Vehicle& vehicle = vehicles[vehicleIndex];
+    glm::vec2 position = vehiclePositions[vehicleIndex];
+    glm::vec2 heading(vehicle.direction.x, vehicle.direction.z);
+    
+    float scale = 1.0f;
+    vehicleHash.queryRadius(position, FOLLOW_DISTANCE, neighbourScratch);
+    for (int other : neighbourScratch) {
+        // Queued (mesoscopic) vehicles only have estimated positions
+        if (other == vehicleIndex || vehicles[other].mesoscopic) continue;
         
-        // Move vehicle along its direction
-        vehicle.position += vehicle.direction * vehicle.speed * deltaTime;
+        glm::vec2 offset = vehiclePositions[other] - position;
+        float dist = glm::length(offset);
+        if (dist < 0.001f || glm::dot(offset, heading) < dist * AHEAD_COS) continue;
         
-        // Check if reached end of current path segment
-        glm::vec3 target = vehicle.path[vehicle.pathIndex + 1];
-        float distToTarget = glm::length(target - vehicle.position);
+        scale = std::min(scale, glm::clamp((dist - MIN_GAP) / (FOLLOW_DISTANCE - MIN_GAP), MIN_FOLLOW_SCALE, 1.0f));
+    }
+    return scale;
+}
+
+void CityGenerator::stepMicroscopic(Vehicle& vehicle, TrafficLink& link, float deltaTime, float speedScale) {
+    if (vehicle.path.size() < 2) return;
+    
+    // Move vehicle along its direction
+    vehicle.speedScale = speedScale;
+    vehicle.position += vehicle.direction * vehicle.speed * speedScale * deltaTime;
+    
+    // Check if reached end of current path segment
+    glm::vec3 target = vehicle.path[vehicle.pathIndex + 1];
+    float distToTarget = glm::length(target - vehicle.position);
+    
+    if (distToTarget < 5.0f) {
+        recordTravelTime(link, simTime - vehicle.linkEntryTime);
+        vehicle.linkEntryTime = simTime;
         
-        if (distToTarget < 5.0f) {
-            // Move to next path segment or loop back
-            vehicle.pathIndex++;
-            if (vehicle.pathIndex >= static_cast<int>(vehicle.path.size()) - 1) {
-                // Loop back to start
-                vehicle.pathIndex = 0;
-                vehicle.position = vehicle.path[0];
-            }
-            
-            // Update direction for next segment
-            if (vehicle.pathIndex < static_cast<int>(vehicle.path.size()) - 1) {
-                target = vehicle.path[vehicle.pathIndex + 1];
-                vehicle.direction = glm::normalize(target - vehicle.position);
-            }
+        // Move to next path segment or loop back
+        vehicle.pathIndex++;
+        if (vehicle.pathIndex >= static_cast<int>(vehicle.path.size()) - 1) {
+            // Loop back to start
+            vehicle.pathIndex = 0;
+            vehicle.position = vehicle.path[0];
+        }
+        
+        // Update direction for next segment
+        if (vehicle.pathIndex < static_cast<int>(vehicle.path.size()) - 1) {
+            target = vehicle.path[vehicle.pathIndex + 1];
+            vehicle.direction = glm::normalize(target - vehicle.position);
+        }
+    }
+}
+
+// Mesoscopic links only process vehicles whose exit time has passed
+void CityGenerator::stepMesoscopic(TrafficLink& link) {
+    std::greater<std::pair<float, int>> later;
+    
+    while (!link.exitQueue.empty() && link.exitQueue.front().first <= simTime) {
+        std::pop_heap(link.exitQueue.begin(), link.exitQueue.end(), later);
+        std::pair<float, int> exit = link.exitQueue.back();
+        link.exitQueue.pop_back();
+        
+        Vehicle& vehicle = vehicles[exit.second];
+        recordTravelTime(link, exit.first - vehicle.linkEntryTime);
+        
+        // Same segment order as the microscopic model, looping at the end
+        vehicle.pathIndex++;
+        if (vehicle.pathIndex >= static_cast<int>(vehicle.path.size()) - 1) {
+            vehicle.pathIndex = 0;
+        }
+        vehicle.linkEntryTime = exit.first;
+        
+        link.exitQueue.push_back({exit.first + linkTravelTime(link, vehicle), exit.second});
+        std::push_heap(link.exitQueue.begin(), link.exitQueue.end(), later);
+    }
+    
+    // Still drawn and culled, so each car is placed where it would be
+    for (int index : link.vehicles) placeOnLink(vehicles[index], link);
+}
+
+void CityGenerator::updateTrafficLOD(const glm::vec3& focus) {
+    glm::vec2 camera(focus.x, focus.z);
+    
+    for (size_t i = 0; i < trafficLinks.size(); ++i) {
+        TrafficLink& link = trafficLinks[i];
+        const Road& road = roads[i];
+        
+        // Distance from the camera (ground plane) to the road segment
+        glm::vec2 a(road.start.x, road.start.y);
+        glm::vec2 b(road.end.x, road.end.y);
+        glm::vec2 ab = b - a;
+        float lengthSq = glm::dot(ab, ab);
+        float t = lengthSq > 0.0f ? glm::clamp(glm::dot(camera - a, ab) / lengthSq, 0.0f, 1.0f) : 0.0f;
+        float dist = glm::length(camera - (a + ab * t));
+        
+        // 20% hysteresis so links on the boundary don't flip every frame
+        bool wantMicroscopic = link.microscopic ? dist < trafficLodRadius * 1.2f
+                                                : dist < trafficLodRadius;
+        if (wantMicroscopic == link.microscopic) continue;
+        
+        link.microscopic = wantMicroscopic;
+        if (wantMicroscopic) {
+            for (int index : link.vehicles) enterMicroscopic(index);
+            link.exitQueue.clear();
+        } else {
+            for (int index : link.vehicles) enterMesoscopic(index);
         }
     }
 }
 
+// Convert a moving vehicle into a queue entry that exits when it would have
+// reached the end of its segment. The entry time is set back so that
+// placeOnLink puts the car where it is now.
+void CityGenerator::enterMesoscopic(int vehicleIndex) {
+    Vehicle& vehicle = vehicles[vehicleIndex];
+    if (vehicle.path.size() < 2) return;
+    
+    const glm::vec3& from = vehicle.path[vehicle.pathIndex];
+    glm::vec3 segment = vehicle.path[vehicle.pathIndex + 1] - from;
+    float segmentLength = glm::length(segment);
+    float drivable = std::max(segmentLength - 5.0f, 0.0f);
+    float progress = 0.0f;
+    if (drivable > 0.0f) {
+        progress = glm::clamp(glm::dot(vehicle.position - from, segment / segmentLength) / drivable, 0.0f, 1.0f);
+    }
+    
+    TrafficLink& link = trafficLinks[vehicle.roadIndex];
+    float travelTime = linkTravelTime(link, vehicle);
+    vehicle.mesoscopic = true;
+    vehicle.linkEntryTime = simTime - progress * travelTime;
+    
+    link.exitQueue.push_back({vehicle.linkEntryTime + travelTime, vehicleIndex});
+    std::push_heap(link.exitQueue.begin(), link.exitQueue.end(), std::greater<std::pair<float, int>>());
+}
+
+// Hand a queued vehicle back from where placeOnLink last put it
+void CityGenerator::enterMicroscopic(int vehicleIndex) {
+    Vehicle& vehicle = vehicles[vehicleIndex];
+    if (vehicle.path.size() < 2) return;
+    
+    placeOnLink(vehicle, trafficLinks[vehicle.roadIndex]);
+    vehicle.mesoscopic = false;
+    vehicle.speedScale = 1.0f;
+}
+
+float CityGenerator::segmentTravelTime(const Vehicle& vehicle) const {
+    // Microscopic vehicles finish a segment 5 units before its end
+    float length = glm::length(vehicle.path[vehicle.pathIndex + 1] - vehicle.path[vehicle.pathIndex]);
+    return std::max((length - 5.0f) / vehicle.speed, 0.1f);
+}
+
+// What a queued vehicle takes for its segment: the link's observed mean,
+// or its free-flow time before anything has been observed
+float CityGenerator::linkTravelTime(const TrafficLink& link, const Vehicle& vehicle) const {
+    return link.meanTravelTime > 0.0f ? link.meanTravelTime : segmentTravelTime(vehicle);
+}
+
+// Position and pace of a queued vehicle from the time it entered its
+// segment; it waits at the end if its exit is late
+void CityGenerator::placeOnLink(Vehicle& vehicle, const TrafficLink& link) {
+    if (vehicle.path.size() < 2) return;
+    
+    const glm::vec3& from = vehicle.path[vehicle.pathIndex];
+    glm::vec3 segment = vehicle.path[vehicle.pathIndex + 1] - from;
+    float segmentLength = glm::length(segment);
+    if (segmentLength <= 0.0f) return;
+    
+    float travelTime = linkTravelTime(link, vehicle);
+    float drivable = std::max(segmentLength - 5.0f, 0.0f);
+    float progress = glm::clamp((simTime - vehicle.linkEntryTime) / travelTime, 0.0f, 1.0f);
+    vehicle.direction = segment / segmentLength;
+    vehicle.position = from + vehicle.direction * (drivable * progress);
+    vehicle.speedScale = progress < 1.0f ? drivable / (travelTime * vehicle.speed) : 0.0f;
+}
+
+void CityGenerator::recordTravelTime(TrafficLink& link, float travelTime) {
+    if (link.meanTravelTime <= 0.0f) {
+        link.meanTravelTime = travelTime;
+    } else {
+        link.meanTravelTime += (travelTime - link.meanTravelTime) * 0.1f;
+    }
+}
+
+void CityGenerator::resetTrafficLinks() {
+    trafficLinks.assign(roads.size(), TrafficLink());
+    
+    for (size_t i = 0; i < roads.size(); ++i) {
+        float dx = static_cast<float>(roads[i].end.x - roads[i].start.x);
+        float dy = static_cast<float>(roads[i].end.y - roads[i].start.y);
+        trafficLinks[i].length = std::sqrt(dx * dx + dy * dy);
+        trafficLinks[i].microscopic = true; // Re-evaluated on the next update
+    }
+    
+    for (size_t i = 0; i < vehicles.size(); ++i) {
+        trafficLinks[vehicles[i].roadIndex].vehicles.push_back(static_cast<int>(i));
+    }
+}
+
+int CityGenerator::getMicroscopicVehicleCount() const {
+    int count = 0;
+    for (const auto& link : trafficLinks) {
+        if (link.microscopic) count += static_cast<int>(link.vehicles.size());
+    }
+    return count;
+}
+
 void CityGenerator::addBuilding(const Building& building) {
     // Check if the building would overlap with existing buildings
     bool hasOverlap = false;
-    for (const auto& existingBuilding : buildings) {
+    std::vector<int> nearby;
+    buildingIndex.queryRect(RTreeBox(building.position - glm::vec2(15.0f), building.position + building.size + glm::vec2(15.0f)), nearby);
+    for (int index : nearby) {
+        const Building& existingBuilding = buildings[index];
         if (building.position.x < existingBuilding.position.x + existingBuilding.size.x + 15.0f &&
             building.position.x + building.size.x + 15.0f > existingBuilding.position.x &&
             building.position.y < existingBuilding.position.y + existingBuilding.size.y + 15.0f &&
@@ -283,12 +663,34 @@ void CityGenerator::addBuilding(const Building& building) {
     }
     
     if (!hasOverlap) {
+        buildingIndex.insert(static_cast<int>(buildings.size()), footprintOf(building));
         buildings.push_back(building);
+        touchBuildings();
     } else {
         std::cout << "[WARNING] Building placement would cause overlap - not added!" << std::endl;
     }
 }
 
+bool CityGenerator::moveBuilding(int index, const glm::vec2& position) {
+    if (index < 0 || index >= static_cast<int>(buildings.size())) return false;
+    buildings[index].position = position;
+    buildingIndex.update(index, footprintOf(buildings[index]));
+    touchBuildings();
+    return true;
+}
+
+bool CityGenerator::removeLastBuilding() {
+    if (buildings.empty()) return false;
+    buildingIndex.remove(static_cast<int>(buildings.size()) - 1);
+    buildings.pop_back();
+    touchBuildings();
+    return true;
+}
+
+void CityGenerator::touchBuildings() {
+    buildingRevision = ++lastRevision;
+}
+
 void CityGenerator::addPark(const Park& park) {
     parks.push_back(park);
 }
@@ -4,6 +4,10 @@
 #include <vector>
 #include <glm/glm.hpp>
 #include "renderer2d.h"
+#include "roadgraph.h"
+#include "rtree.h"
+#include "simrandom.h"
+#include "spatialhash.h"
 
 enum class RoadType {
     GRID,
@@ -38,8 +42,22 @@ struct Vehicle {
     glm::vec3 position;
     glm::vec3 direction;
     float speed;
+    float speedScale;       // Share of speed driven in the last tick (car following)
     int pathIndex;
     std::vector<glm::vec3> path;
+    int roadIndex;          // Road (traffic link) the vehicle drives on
+    bool mesoscopic;        // True while its link runs as a queue (position is estimated)
+    float linkEntryTime;    // Simulation time the vehicle entered its current segment
+};
+
+// Traffic level of detail: links near the camera step every vehicle
+// (microscopic), distant links only keep a queue of exit times (mesoscopic)
+struct TrafficLink {
+    float length;
+    bool microscopic;
+    std::vector<int> vehicles;                    // Indices into the vehicle list
+    std::vector<std::pair<float, int>> exitQueue; // Min-heap of (exit time, vehicle) while mesoscopic
+    float meanTravelTime;                         // Smoothed observed travel time
 };
 
 struct StreetLight {
@@ -50,29 +68,55 @@ class CityGenerator {
 public:
     CityGenerator();
     
+    // All generation and simulation randomness comes from this seed
+    void setSeed(uint64_t seed);
+    uint64_t getSeed() const { return seed; }
+    
     void generateCity(int numBuildings, int layoutSize, RoadType roadType, SkylineType skylineType);
     void generateRoads(RoadType type, int layoutSize);
     void generateBuildings(int numBuildings, SkylineType skylineType, int layoutSize);
     void generateParks(int numParks, int layoutSize);
     void generateStreetLights(); // Public for runtime regeneration
+    void setSkylineType(SkylineType type); // Re-rolls every building height
     
     void clear();
     
     // Getters
     const std::vector<Building>& getBuildings() const { return buildings; }
-    std::vector<Building>& getBuildings() { return buildings; } // Non-const for editing
     const std::vector<Road>& getRoads() const { return roads; }
     const std::vector<Park>& getParks() const { return parks; }
     const std::vector<Vehicle>& getVehicles() const { return vehicles; }
     const std::vector<StreetLight>& getStreetLights() const { return streetLights; }
+    const std::vector<TrafficLink>& getTrafficLinks() const { return trafficLinks; }
+    const RoadGraph& getRoadGraph() const { return roadGraph; }
+    // Vehicle positions (x, z) as of the start of the current tick
+    const SpatialHash& getVehicleHash() const { return vehicleHash; }
+    // Building footprints keyed by index into getBuildings()
+    const RTree& getBuildingIndex() const { return buildingIndex; }
+    // Changes whenever any building does; equal revisions mean identical
+    // buildings, even across copies (keyframes)
+    uint64_t getBuildingRevision() const { return buildingRevision; }
+    // Changes whenever generateRoads runs (the road graph is rebuilt with it)
+    uint64_t getRoadRevision() const { return roadRevision; }
+    // Changes whenever any vehicle does (every simulation tick)
+    uint64_t getVehicleRevision() const { return vehicleRevision; }
+    // Changes whenever the street lights are placed again or cleared
+    uint64_t getStreetLightRevision() const { return streetLightRevision; }
     
     int getLayoutSize() const { return layoutSize; }
+    float getSimTime() const { return simTime; }
     
-    void updateVehicles(float deltaTime);
+    // focus is the 3D camera position; links within the LOD radius run microscopic
+    void updateVehicles(float deltaTime, const glm::vec3& focus);
+    void setTrafficLodRadius(float radius) { trafficLodRadius = radius; }
+    int getMicroscopicVehicleCount() const;
     
     // Manual object placement
     void addBuilding(const Building& building);
     void addPark(const Park& park);
+    // Footprint edits go through these so the building index stays current
+    bool moveBuilding(int index, const glm::vec2& position);
+    bool removeLastBuilding();
     
 private:
     std::vector<Building> buildings;
@@ -80,8 +124,23 @@ private:
     std::vector<Park> parks;
     std::vector<Vehicle> vehicles;
     std::vector<StreetLight> streetLights;
+    std::vector<TrafficLink> trafficLinks;
+    RoadGraph roadGraph; // Contraction hierarchy for batch routing
+    SimRandom random;
+    SpatialHash vehicleHash;                 // Rebuilt every tick
+    RTree buildingIndex;                     // Updated on every footprint edit
+    uint64_t buildingRevision;
+    uint64_t roadRevision;
+    uint64_t vehicleRevision;
+    uint64_t streetLightRevision;
+    int pendingVehicles;                     // Respawned on the next tick after a road change
+    std::vector<glm::vec2> vehiclePositions; // Ground-plane positions fed to the hash
+    std::vector<int> neighbourScratch;
+    uint64_t seed;
     
     int layoutSize;
+    float simTime;
+    float trafficLodRadius;
     RoadType currentRoadType;
     SkylineType currentSkylineType;
     
@@ -90,6 +149,20 @@ private:
     void generateRandomRoads(int size);
     void generateVehicles(int numVehicles);
     
+    // Traffic level of detail
+    void resetTrafficLinks();
+    void updateTrafficLOD(const glm::vec3& focus);
+    void enterMesoscopic(int vehicleIndex);
+    void enterMicroscopic(int vehicleIndex);
+    void stepMicroscopic(Vehicle& vehicle, TrafficLink& link, float deltaTime, float speedScale);
+    float followingSpeedScale(int vehicleIndex);
+    void stepMesoscopic(TrafficLink& link);
+    float segmentTravelTime(const Vehicle& vehicle) const;
+    float linkTravelTime(const TrafficLink& link, const Vehicle& vehicle) const;
+    void placeOnLink(Vehicle& vehicle, const TrafficLink& link);
+    void recordTravelTime(TrafficLink& link, float travelTime);
+    
+    void touchBuildings();
     bool isValidBuildingPosition(const glm::vec2& pos, const glm::vec2& size, int layoutSize);
     float getHeightForSkyline(SkylineType type);
 };
@@ -0,0 +1,429 @@
+#include "crowd.h"
+#include "citygenerator.h"
+#include "threadpool.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CROWD_USE_SSE 1
+#endif
+
+namespace {
+
+const float INF = std::numeric_limits<float>::infinity();
+const uint8_t NO_DIRECTION = 255;
+
+// Global so revisions stay unique across copies of the simulation
+uint64_t lastRevision = 0;
+
+// Fields stop spreading past this cost so each one covers a bounded
+// region and an edit only invalidates the fields that actually reach it
+const float FIELD_RANGE = 300.0f;
+const float ROAD_HALF_WIDTH = 4.0f;
+
+// 8-neighbourhood, counter-clockwise from +x
+const int NEIGHBOUR_DX[8] = {1, 1, 0, -1, -1, -1, 0, 1};
+const int NEIGHBOUR_DY[8] = {0, 1, 1, 1, 0, -1, -1, -1};
+const float DIAGONAL = 0.70710678f;
+const float NEIGHBOUR_DIR_X[8] = {1.0f, DIAGONAL, 0.0f, -DIAGONAL, -1.0f, -DIAGONAL, 0.0f, DIAGONAL};
+const float NEIGHBOUR_DIR_Y[8] = {0.0f, DIAGONAL, 1.0f, DIAGONAL, 0.0f, -DIAGONAL, -1.0f, -DIAGONAL};
+
+float distanceToSegment(const glm::vec2& p, const glm::vec2& a, const glm::vec2& b) {
+    glm::vec2 ab = b - a;
+    float lengthSq = glm::dot(ab, ab);
+    float t = lengthSq > 0.0f ? glm::clamp(glm::dot(p - a, ab) / lengthSq, 0.0f, 1.0f) : 0.0f;
+    return glm::length(p - (a + ab * t));
+}
+
+}
+
+CrowdSimulation::CrowdSimulation() : cellSize(4.0f), gridWidth(0), gridHeight(0), revision(0) {}
+
+void CrowdSimulation::build(const CityGenerator& city, float size) {
+    cellSize = size;
+    gridWidth = static_cast<int>(std::ceil(city.getLayoutSize() / cellSize));
+    gridHeight = gridWidth;
+    cells.assign(static_cast<size_t>(gridWidth) * gridHeight, CELL_GROUND);
+    
+    rasteriseRect(city, 0, 0, gridWidth - 1, gridHeight - 1);
+    
+    destinations.clear();
+    fieldCache.fields.clear();
+    collectDestinations(city);
+    
+    // Keep existing pedestrians, but their destinations may be gone
+    for (int i = 0; i < getPedestrianCount(); ++i) {
+        if (destination[i] >= static_cast<int>(destinations.size())) pickDestination(i);
+    }
+    buildMissingFields();
+}
+
+void CrowdSimulation::rasteriseRect(const CityGenerator& city, int x0, int y0, int x1, int y1) {
+    x0 = std::max(x0, 0);
+    y0 = std::max(y0, 0);
+    x1 = std::min(x1, gridWidth - 1);
+    y1 = std::min(y1, gridHeight - 1);
+    if (x0 > x1 || y0 > y1) return;
+    
+    for (int y = y0; y <= y1; ++y) {
+        for (int x = x0; x <= x1; ++x) {
+            cells[y * gridWidth + x] = CELL_GROUND;
+        }
+    }
+    
+    // Roads are the preferred walking surface (sidewalks)
+    for (const auto& road : city.getRoads()) {
+        glm::vec2 a(road.start.x, road.start.y);
+        glm::vec2 b(road.end.x, road.end.y);
+        float reach = ROAD_HALF_WIDTH + cellSize * 0.5f;
+        
+        int rx0 = std::max(x0, static_cast<int>(std::floor((std::min(a.x, b.x) - reach) / cellSize)));
+        int ry0 = std::max(y0, static_cast<int>(std::floor((std::min(a.y, b.y) - reach) / cellSize)));
+        int rx1 = std::min(x1, static_cast<int>(std::floor((std::max(a.x, b.x) + reach) / cellSize)));
+        int ry1 = std::min(y1, static_cast<int>(std::floor((std::max(a.y, b.y) + reach) / cellSize)));
+        
+        for (int y = ry0; y <= ry1; ++y) {
+            for (int x = rx0; x <= rx1; ++x) {
+                glm::vec2 center((x + 0.5f) * cellSize, (y + 0.5f) * cellSize);
+                if (distanceToSegment(center, a, b) <= reach) cells[y * gridWidth + x] = CELL_ROAD;
+            }
+        }
+    }
+    
+    // Water
+    for (const auto& park : city.getParks()) {
+        glm::vec2 center(park.center.x, park.center.y);
+        int px0 = std::max(x0, static_cast<int>(std::floor((center.x - park.radius) / cellSize)));
+        int py0 = std::max(y0, static_cast<int>(std::floor((center.y - park.radius) / cellSize)));
+        int px1 = std::min(x1, static_cast<int>(std::floor((center.x + park.radius) / cellSize)));
+        int py1 = std::min(y1, static_cast<int>(std::floor((center.y + park.radius) / cellSize)));
+        
+        for (int y = py0; y <= py1; ++y) {
+            for (int x = px0; x <= px1; ++x) {
+                glm::vec2 cellCenter((x + 0.5f) * cellSize, (y + 0.5f) * cellSize);
+                if (glm::length(cellCenter - center) <= park.radius) cells[y * gridWidth + x] = CELL_BLOCKED;
+            }
+        }
+    }
+    
+    // Building footprints
+    for (const auto& building : city.getBuildings()) {
+        int bx0 = std::max(x0, static_cast<int>(std::floor(building.position.x / cellSize)));
+        int by0 = std::max(y0, static_cast<int>(std::floor(building.position.y / cellSize)));
+        int bx1 = std::min(x1, static_cast<int>(std::floor((building.position.x + building.size.x) / cellSize)));
+        int by1 = std::min(y1, static_cast<int>(std::floor((building.position.y + building.size.y) / cellSize)));
+        
+        for (int y = by0; y <= by1; ++y) {
+            for (int x = bx0; x <= bx1; ++x) {
+                cells[y * gridWidth + x] = CELL_BLOCKED;
+            }
+        }
+    }
+}
+
+void CrowdSimulation::collectDestinations(const CityGenerator& city) {
+    std::vector<Destination> updated;
+    
+    // Parks first: the central pond is the most popular place in town
+    for (const auto& park : city.getParks()) {
+        Destination d;
+        d.position = glm::vec2(park.center.x, park.center.y);
+        d.minCorner = d.position - glm::vec2(static_cast<float>(park.radius));
+        d.maxCorner = d.position + glm::vec2(static_cast<float>(park.radius));
+        d.radius = static_cast<float>(park.radius);
+        updated.push_back(d);
+    }
+    
+    for (const auto& building : city.getBuildings()) {
+        Destination d;
+        d.position = building.position + building.size * 0.5f;
+        d.minCorner = building.position;
+        d.maxCorner = building.position + building.size;
+        d.radius = 0.0f;
+        updated.push_back(d);
+    }
+    
+    // Destinations that moved lose their field
+    fieldCache.fields.resize(updated.size());
+    for (size_t i = 0; i < updated.size(); ++i) {
+        if (i >= destinations.size() ||
+            updated[i].minCorner != destinations[i].minCorner ||
+            updated[i].maxCorner != destinations[i].maxCorner) {
+            fieldCache.fields[i] = FlowField();
+        }
+    }
+    destinations.swap(updated);
+}
+
+void CrowdSimulation::onAreaChanged(const CityGenerator& city, const glm::vec2& minCorner, const glm::vec2& maxCorner) {
+    // One cell of margin covers footprints that straddle a cell border
+    int x0 = static_cast<int>(std::floor(minCorner.x / cellSize)) - 1;
+    int y0 = static_cast<int>(std::floor(minCorner.y / cellSize)) - 1;
+    int x1 = static_cast<int>(std::floor(maxCorner.x / cellSize)) + 1;
+    int y1 = static_cast<int>(std::floor(maxCorner.y / cellSize)) + 1;
+    rasteriseRect(city, x0, y0, x1, y1);
+    
+    collectDestinations(city);
+    
+    for (auto& field : fieldCache.fields) {
+        if (!field.valid) continue;
+        if (field.maxX < x0 || field.minX > x1 || field.maxY < y0 || field.minY > y1) continue;
+        field = FlowField();
+    }
+    
+    for (int i = 0; i < getPedestrianCount(); ++i) {
+        if (destination[i] >= static_cast<int>(destinations.size())) pickDestination(i);
+    }
+    buildMissingFields();
+}
+
+int CrowdSimulation::getCachedFieldCount() const {
+    int count = 0;
+    for (const auto& field : fieldCache.fields) {
+        if (field.valid) count++;
+    }
+    return count;
+}
+
+// Every destination without a field, in parallel. Each job reads only the
+// grid and its destination and writes only its own field.
+void CrowdSimulation::buildMissingFields() {
+    std::vector<int> missing;
+    for (size_t i = 0; i < fieldCache.fields.size(); ++i) {
+        if (!fieldCache.fields[i].valid) missing.push_back(static_cast<int>(i));
+    }
+    if (missing.empty()) return;
+    
+    ThreadPool::shared().parallelFor(static_cast<int>(missing.size()), [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) computeField(missing[i], fieldCache.fields[missing[i]]);
+    });
+}
+
+// Dijkstra wavefront from every goal cell outwards. The neighbour a cell
+// was reached from is its next step towards the goal, so the flow field
+// falls out of the search for free. The search runs on a per-thread
+// full-grid scratch; the field keeps only the box it reached.
+void CrowdSimulation::computeField(int destinationIndex, FlowField& field) const {
+    const Destination& target = destinations[destinationIndex];
+    size_t numCells = cells.size();
+    
+    static thread_local std::vector<float> integration;
+    static thread_local std::vector<uint8_t> direction;
+    static thread_local std::vector<int> reached;
+    if (integration.size() != numCells) {
+        integration.assign(numCells, INF);
+        direction.assign(numCells, NO_DIRECTION);
+    }
+    reached.clear();
+    
+    field.valid = true;
+    field.minX = gridWidth;
+    field.minY = gridHeight;
+    field.maxX = -1;
+    field.maxY = -1;
+    
+    typedef std::pair<float, int> HeapEntry;
+    std::vector<HeapEntry> heap;
+    
+    // Goal: walkable cells hugging the destination
+    float margin = cellSize * 1.5f;
+    int gx0 = std::max(0, static_cast<int>(std::floor((target.minCorner.x - margin) / cellSize)));
+    int gy0 = std::max(0, static_cast<int>(std::floor((target.minCorner.y - margin) / cellSize)));
+    int gx1 = std::min(gridWidth - 1, static_cast<int>(std::floor((target.maxCorner.x + margin) / cellSize)));
+    int gy1 = std::min(gridHeight - 1, static_cast<int>(std::floor((target.maxCorner.y + margin) / cellSize)));
+    
+    for (int y = gy0; y <= gy1; ++y) {
+        for (int x = gx0; x <= gx1; ++x) {
+            int index = y * gridWidth + x;
+            if (cells[index] == CELL_BLOCKED) continue;
+            if (target.radius > 0.0f) {
+                glm::vec2 center((x + 0.5f) * cellSize, (y + 0.5f) * cellSize);
+                if (glm::length(center - target.position) > target.radius + margin) continue;
+            }
+            integration[index] = 0.0f;
+            reached.push_back(index);
+            heap.push_back({0.0f, index});
+        }
+    }
+    std::make_heap(heap.begin(), heap.end(), std::greater<HeapEntry>());
+    
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), std::greater<HeapEntry>());
+        HeapEntry top = heap.back();
+        heap.pop_back();
+        if (top.first > integration[top.second]) continue;
+        
+        int cx = top.second % gridWidth;
+        int cy = top.second / gridWidth;
+        field.minX = std::min(field.minX, cx);
+        field.minY = std::min(field.minY, cy);
+        field.maxX = std::max(field.maxX, cx);
+        field.maxY = std::max(field.maxY, cy);
+        
+        for (int n = 0; n < 8; ++n) {
+            int nx = cx + NEIGHBOUR_DX[n];
+            int ny = cy + NEIGHBOUR_DY[n];
+            if (nx < 0 || ny < 0 || nx >= gridWidth || ny >= gridHeight) continue;
+            int neighbour = ny * gridWidth + nx;
+            if (cells[neighbour] == CELL_BLOCKED) continue;
+            
+            // No cutting corners past blocked cells
+            bool diagonal = NEIGHBOUR_DX[n] != 0 && NEIGHBOUR_DY[n] != 0;
+            if (diagonal && (cells[cy * gridWidth + nx] == CELL_BLOCKED ||
+                             cells[ny * gridWidth + cx] == CELL_BLOCKED)) {
+                continue;
+            }
+            
+            float stepCost = cellSize * (diagonal ? 1.41421356f : 1.0f) *
+                             0.5f * (cells[top.second] + cells[neighbour]);
+            float candidate = top.first + stepCost;
+            if (candidate > FIELD_RANGE || candidate >= integration[neighbour]) continue;
+            
+            if (integration[neighbour] == INF) reached.push_back(neighbour);
+            integration[neighbour] = candidate;
+            direction[neighbour] = static_cast<uint8_t>((n + 4) % 8); // Back towards this cell
+            heap.push_back({candidate, neighbour});
+            std::push_heap(heap.begin(), heap.end(), std::greater<HeapEntry>());
+        }
+    }
+    
+    // Copy out the reached box and leave the scratch clean
+    int boxWidth = std::max(field.maxX - field.minX + 1, 0);
+    int boxHeight = std::max(field.maxY - field.minY + 1, 0);
+    field.integration.assign(static_cast<size_t>(boxWidth) * boxHeight, INF);
+    field.direction.assign(static_cast<size_t>(boxWidth) * boxHeight, NO_DIRECTION);
+    for (int index : reached) {
+        int offset = (index / gridWidth - field.minY) * boxWidth + (index % gridWidth - field.minX);
+        field.integration[offset] = integration[index];
+        field.direction[offset] = direction[index];
+        integration[index] = INF;
+        direction[index] = NO_DIRECTION;
+    }
+}
+
+int CrowdSimulation::fieldCellAt(const FlowField& field, float x, float y) const {
+    int cx = static_cast<int>(std::floor(x / cellSize));
+    int cy = static_cast<int>(std::floor(y / cellSize));
+    if (cx < field.minX || cy < field.minY || cx > field.maxX || cy > field.maxY) return -1;
+    return (cy - field.minY) * (field.maxX - field.minX + 1) + (cx - field.minX);
+}
+
+void CrowdSimulation::spawnPedestrians(int count) {
+    if (destinations.empty() || gridWidth == 0) return;
+    
+    for (int i = 0; i < count; ++i) {
+        // Start on a walkable cell
+        float x = 0.0f, y = 0.0f;
+        for (int attempt = 0; attempt < 20; ++attempt) {
+            x = random.nextFloat() * gridWidth * cellSize;
+            y = random.nextFloat() * gridHeight * cellSize;
+            if (isWalkable(x, y)) break;
+        }
+        
+        posX.push_back(x);
+        posY.push_back(y);
+        dirX.push_back(0.0f);
+        dirY.push_back(0.0f);
+        speed.push_back(4.0f + random.nextFloat() * 3.0f); // 4-7 units per second
+        destination.push_back(0);
+        pickDestination(getPedestrianCount() - 1);
+    }
+    revision = ++lastRevision;
+}
+
+void CrowdSimulation::pickDestination(int pedestrian) {
+    int numDestinations = static_cast<int>(destinations.size());
+    if (numDestinations == 0) {
+        destination[pedestrian] = 0;
+        return;
+    }
+    
+    // Half of all trips go to parks, the rest to a random building
+    int numParks = 0;
+    while (numParks < numDestinations && destinations[numParks].radius > 0.0f) numParks++;
+    
+    if (numParks > 0 && (random.nextInt(2) == 0 || numParks == numDestinations)) {
+        destination[pedestrian] = random.nextInt(numParks);
+    } else {
+        destination[pedestrian] = numParks + random.nextInt(numDestinations - numParks);
+    }
+}
+
+int CrowdSimulation::cellIndexAt(float x, float y) const {
+    int cx = static_cast<int>(std::floor(x / cellSize));
+    int cy = static_cast<int>(std::floor(y / cellSize));
+    if (cx < 0 || cy < 0 || cx >= gridWidth || cy >= gridHeight) return -1;
+    return cy * gridWidth + cx;
+}
+
+bool CrowdSimulation::isWalkable(float x, float y) const {
+    int index = cellIndexAt(x, y);
+    return index >= 0 && cells[index] != CELL_BLOCKED;
+}
+
+void CrowdSimulation::update(float deltaTime) {
+    int count = getPedestrianCount();
+    if (count == 0 || destinations.empty()) return;
+    
+    // Only after a copy (snapshot) was restored
+    buildMissingFields();
+    revision = ++lastRevision;
+    
+    // 1. Sample each pedestrian's flow field
+    for (int i = 0; i < count; ++i) {
+        const FlowField& field = fieldCache.fields[destination[i]];
+        int index = fieldCellAt(field, posX[i], posY[i]);
+        
+        if (index >= 0 && field.integration[index] == 0.0f) {
+            // Arrived: head somewhere else from here
+            pickDestination(i);
+            dirX[i] = 0.0f;
+            dirY[i] = 0.0f;
+        } else if (index >= 0 && field.direction[index] != NO_DIRECTION) {
+            dirX[i] = NEIGHBOUR_DIR_X[field.direction[index]];
+            dirY[i] = NEIGHBOUR_DIR_Y[field.direction[index]];
+        } else {
+            // Outside the field's range: walk straight until it picks us up
+            glm::vec2 toTarget = destinations[destination[i]].position - glm::vec2(posX[i], posY[i]);
+            float length = glm::length(toTarget);
+            dirX[i] = length > 0.0f ? toTarget.x / length : 0.0f;
+            dirY[i] = length > 0.0f ? toTarget.y / length : 0.0f;
+        }
+    }
+    
+    // 2. Integrate positions, four pedestrians per instruction
+    prevX = posX;
+    prevY = posY;
+    
+    int i = 0;
+#ifdef CROWD_USE_SSE
+    __m128 dt4 = _mm_set1_ps(deltaTime);
+    for (; i + 4 <= count; i += 4) {
+        __m128 step = _mm_mul_ps(_mm_loadu_ps(&speed[i]), dt4);
+        _mm_storeu_ps(&posX[i], _mm_add_ps(_mm_loadu_ps(&posX[i]), _mm_mul_ps(_mm_loadu_ps(&dirX[i]), step)));
+        _mm_storeu_ps(&posY[i], _mm_add_ps(_mm_loadu_ps(&posY[i]), _mm_mul_ps(_mm_loadu_ps(&dirY[i]), step)));
+    }
+#endif
+    for (; i < count; ++i) {
+        float step = speed[i] * deltaTime;
+        posX[i] += dirX[i] * step;
+        posY[i] += dirY[i] * step;
+    }
+    
+    // 3. Slide along or stop at walls and water
+    for (int j = 0; j < count; ++j) {
+        if (isWalkable(posX[j], posY[j])) continue;
+        
+        if (isWalkable(posX[j], prevY[j])) {
+            posY[j] = prevY[j];
+        } else if (isWalkable(prevX[j], posY[j])) {
+            posX[j] = prevX[j];
+        } else {
+            posX[j] = prevX[j];
+            posY[j] = prevY[j];
+        }
+    }
+}
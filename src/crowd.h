@@ -0,0 +1,106 @@
+#ifndef CROWD_H
+#define CROWD_H
+
+#include <glm/glm.hpp>
+#include "simrandom.h"
+#include <cstdint>
+#include <vector>
+
+class CityGenerator;
+
+// Flow-field pedestrian crowd. The city is rasterised into a walkable grid
+// and every destination gets one Dijkstra wavefront (integration field)
+// plus a per-cell direction (flow field), shared by all pedestrians heading
+// there. Fields are built up front on the thread pool, never mid-update.
+// Pedestrians are stored as structure-of-arrays and stepped in bulk.
+class CrowdSimulation {
+public:
+    CrowdSimulation();
+    
+    // Rasterise the whole city and register parks and buildings as destinations
+    void build(const CityGenerator& city, float cellSize = 4.0f);
+    void setSeed(uint64_t seed) { random.setSeed(seed); }
+    void spawnPedestrians(int count);
+    void update(float deltaTime);
+    
+    // A building was moved, added or removed inside [minCorner, maxCorner]:
+    // re-rasterise that area and drop only the flow fields that reach it
+    void onAreaChanged(const CityGenerator& city, const glm::vec2& minCorner, const glm::vec2& maxCorner);
+    
+    int getPedestrianCount() const { return static_cast<int>(posX.size()); }
+    const std::vector<float>& getPositionsX() const { return posX; }
+    const std::vector<float>& getPositionsY() const { return posY; }
+    // Walking direction times speed gives each pedestrian's velocity
+    const std::vector<float>& getDirectionsX() const { return dirX; }
+    const std::vector<float>& getDirectionsY() const { return dirY; }
+    const std::vector<float>& getSpeeds() const { return speed; }
+    // Changes whenever any pedestrian moves, is added or turns; unique
+    // across copies (keyframes)
+    uint64_t getRevision() const { return revision; }
+    int getCachedFieldCount() const;
+    
+private:
+    // Per-cell walking cost; 0 = blocked (buildings, water)
+    enum : uint8_t { CELL_BLOCKED = 0, CELL_ROAD = 1, CELL_GROUND = 2 };
+    
+    // Stored only over the bounding box of reached cells, row by row;
+    // everything outside it is unreachable
+    struct FlowField {
+        bool valid;
+        std::vector<float> integration; // Cost to reach the destination
+        std::vector<uint8_t> direction; // Neighbour index 0-7, or NO_DIRECTION
+        int minX, minY, maxX, maxY;     // Bounding box of reached cells
+        
+        FlowField() : valid(false), minX(0), minY(0), maxX(-1), maxY(-1) {}
+    };
+    
+    struct Destination {
+        glm::vec2 position;
+        glm::vec2 minCorner, maxCorner; // Footprint; goal cells ring it
+        float radius;                   // > 0 for round destinations (ponds)
+    };
+    
+    float cellSize;
+    int gridWidth, gridHeight;
+    std::vector<uint8_t> cells;
+    
+    // Fields are derived data, so a copy (snapshot) of the simulation starts
+    // with an empty cache instead of duplicating them; its next update
+    // rebuilds them
+    struct FieldCache {
+        std::vector<FlowField> fields;
+        FieldCache() {}
+        FieldCache(const FieldCache& other) : fields(other.fields.size()) {}
+        FieldCache(FieldCache&&) = default;
+        FieldCache& operator=(const FieldCache& other) {
+            fields.assign(other.fields.size(), FlowField());
+            return *this;
+        }
+        FieldCache& operator=(FieldCache&&) = default;
+    };
+    
+    std::vector<Destination> destinations;
+    FieldCache fieldCache; // Parallel to destinations
+    SimRandom random;
+    uint64_t revision;
+    
+    // Pedestrians (SoA)
+    std::vector<float> posX, posY;
+    std::vector<float> dirX, dirY;
+    std::vector<float> speed;
+    std::vector<int> destination;
+    std::vector<float> prevX, prevY; // Scratch for collision rollback
+    
+    void rasteriseRect(const CityGenerator& city, int x0, int y0, int x1, int y1);
+    void collectDestinations(const CityGenerator& city);
+    void buildMissingFields();
+    void computeField(int destinationIndex, FlowField& field) const;
+    // Offset of the cell holding (x, y) in field, or -1 outside its box
+    int fieldCellAt(const FlowField& field, float x, float y) const;
+    void pickDestination(int pedestrian);
+    
+    int cellIndexAt(float x, float y) const;
+    bool isWalkable(float x, float y) const;
+};
+
+#endif
@@ -0,0 +1,70 @@
+#include "frustum.h"
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FRUSTUM_USE_SSE 1
+#endif
+
+Frustum::Frustum() {
+    // Accepts everything until set from a matrix
+    for (int i = 0; i < 8; ++i) {
+        nx[i] = ny[i] = nz[i] = 0.0f;
+        ax[i] = ay[i] = az[i] = 0.0f;
+        d[i] = 1.0f;
+    }
+}
+
+Frustum::Frustum(const glm::mat4& m) : Frustum() {
+    // Rows of the matrix (glm is column-major: m[column][row])
+    glm::vec4 row[4];
+    for (int r = 0; r < 4; ++r) row[r] = glm::vec4(m[0][r], m[1][r], m[2][r], m[3][r]);
+    
+    // Left, right, bottom, top, near, far
+    glm::vec4 planes[6] = {
+        row[3] + row[0], row[3] - row[0],
+        row[3] + row[1], row[3] - row[1],
+        row[3] + row[2], row[3] - row[2]
+    };
+    for (int i = 0; i < 6; ++i) {
+        float length = glm::length(glm::vec3(planes[i]));
+        if (length > 0.0f) planes[i] /= length;
+        nx[i] = planes[i].x;
+        ny[i] = planes[i].y;
+        nz[i] = planes[i].z;
+        d[i] = planes[i].w;
+        ax[i] = std::fabs(nx[i]);
+        ay[i] = std::fabs(ny[i]);
+        az[i] = std::fabs(nz[i]);
+    }
+}
+
+// Signed distance of the centre to each plane against the box's projected
+// radius: below -radius the box is behind that plane, above +radius it is
+// wholly in front
+Frustum::Result Frustum::classify(const glm::vec3& center, const glm::vec3& extent) const {
+#ifdef FRUSTUM_USE_SSE
+    __m128 cx = _mm_set1_ps(center.x), cy = _mm_set1_ps(center.y), cz = _mm_set1_ps(center.z);
+    __m128 ex = _mm_set1_ps(extent.x), ey = _mm_set1_ps(extent.y), ez = _mm_set1_ps(extent.z);
+    int outside = 0, straddling = 0;
+    for (int i = 0; i < 8; i += 4) {
+        __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_load_ps(&nx[i]), cx), _mm_mul_ps(_mm_load_ps(&ny[i]), cy)),
+                                     _mm_add_ps(_mm_mul_ps(_mm_load_ps(&nz[i]), cz), _mm_load_ps(&d[i])));
+        __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_load_ps(&ax[i]), ex), _mm_mul_ps(_mm_load_ps(&ay[i]), ey)),
+                                   _mm_mul_ps(_mm_load_ps(&az[i]), ez));
+        outside |= _mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+        straddling |= _mm_movemask_ps(_mm_cmplt_ps(_mm_sub_ps(distance, radius), _mm_setzero_ps()));
+    }
+    if (outside) return OUTSIDE;
+    return straddling ? INTERSECTING : INSIDE;
+#else
+    bool straddling = false;
+    for (int i = 0; i < 6; ++i) {
+        float distance = nx[i] * center.x + ny[i] * center.y + nz[i] * center.z + d[i];
+        float radius = ax[i] * extent.x + ay[i] * extent.y + az[i] * extent.z;
+        if (distance + radius < 0.0f) return OUTSIDE;
+        if (distance - radius < 0.0f) straddling = true;
+    }
+    return straddling ? INTERSECTING : INSIDE;
+#endif
+}
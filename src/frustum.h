@@ -0,0 +1,29 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+// View frustum as six inward-facing planes taken from a view-projection
+// matrix (Gribb/Hartmann). Boxes are tested as centre and half extent
+// against four planes per SSE instruction; the two unused plane slots
+// hold an always-passing plane.
+class Frustum {
+public:
+    enum Result { OUTSIDE, INTERSECTING, INSIDE };
+    
+    Frustum();
+    explicit Frustum(const glm::mat4& viewProjection);
+    
+    Result classify(const glm::vec3& center, const glm::vec3& extent) const;
+    bool intersects(const glm::vec3& center, const glm::vec3& extent) const {
+        return classify(center, extent) != OUTSIDE;
+    }
+    
+private:
+    // Structure of arrays: plane i is (nx[i], ny[i], nz[i], d[i]), normals
+    // unit length, and absolute normals kept for the extent projection
+    alignas(16) float nx[8], ny[8], nz[8], d[8];
+    alignas(16) float ax[8], ay[8], az[8];
+};
+
+#endif
@@ -0,0 +1,87 @@
+#include "loosegrid.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Large cities fall back to coarser cells instead of huge grids
+const int MAX_CELLS = 64 * 64;
+
+}
+
+LooseGrid::LooseGrid(float cellSize)
+    : cellSize(cellSize), gridCellSize(cellSize), radius(0.0f), height(0.0f), origin(0), cells(0) {}
+
+glm::ivec2 LooseGrid::cellOf(const glm::vec3& center) const {
+    return glm::ivec2(static_cast<int>(std::floor(center.x / gridCellSize)),
+                      static_cast<int>(std::floor(center.z / gridCellSize))) - origin;
+}
+
+void LooseGrid::build(const std::vector<glm::vec3>& centers, float objectRadius, float objectHeight) {
+    radius = objectRadius;
+    height = objectHeight;
+    entries.clear();
+    entryCenters.clear();
+    cells = glm::ivec2(0);
+    cellStart.assign(1, 0);
+    if (centers.empty()) return;
+    
+    glm::vec2 low(centers[0].x, centers[0].z), high = low;
+    for (const auto& center : centers) {
+        low = glm::min(low, glm::vec2(center.x, center.z));
+        high = glm::max(high, glm::vec2(center.x, center.z));
+    }
+    
+    gridCellSize = cellSize;
+    for (;;) {
+        origin = glm::ivec2(glm::floor(low / gridCellSize));
+        cells = glm::ivec2(glm::floor(high / gridCellSize)) - origin + 1;
+        if (cells.x * cells.y <= MAX_CELLS) break;
+        gridCellSize *= 2.0f;
+    }
+    
+    // Counting sort by cell
+    int cellCount = cells.x * cells.y;
+    int count = static_cast<int>(centers.size());
+    cellStart.assign(cellCount + 1, 0);
+    objectCell.resize(count);
+    for (int i = 0; i < count; ++i) {
+        glm::ivec2 cell = cellOf(centers[i]);
+        objectCell[i] = cell.y * cells.x + cell.x;
+        cellStart[objectCell[i] + 1]++;
+    }
+    for (int c = 0; c < cellCount; ++c) cellStart[c + 1] += cellStart[c];
+    
+    std::vector<int> next(cellStart.begin(), cellStart.end() - 1);
+    entries.resize(count);
+    entryCenters.resize(count);
+    for (int i = 0; i < count; ++i) {
+        int slot = next[objectCell[i]]++;
+        entries[slot] = i;
+        entryCenters[slot] = centers[i];
+    }
+}
+
+void LooseGrid::cull(const Frustum& frustum, std::vector<int>& visible) const {
+    glm::vec3 objectExtent(radius, height * 0.5f, radius);
+    glm::vec3 cellExtent(gridCellSize * 0.5f + radius, height * 0.5f, gridCellSize * 0.5f + radius);
+    
+    for (int y = 0; y < cells.y; ++y) {
+        for (int x = 0; x < cells.x; ++x) {
+            int cell = y * cells.x + x;
+            int begin = cellStart[cell], end = cellStart[cell + 1];
+            if (begin == end) continue;
+            
+            glm::vec3 center((origin.x + x + 0.5f) * gridCellSize, height * 0.5f, (origin.y + y + 0.5f) * gridCellSize);
+            Frustum::Result result = frustum.classify(center, cellExtent);
+            if (result == Frustum::OUTSIDE) continue;
+            
+            for (int i = begin; i < end; ++i) {
+                if (result == Frustum::INSIDE ||
+                    frustum.intersects(glm::vec3(entryCenters[i].x, height * 0.5f, entryCenters[i].z), objectExtent)) {
+                    visible.push_back(entries[i]);
+                }
+            }
+        }
+    }
+}
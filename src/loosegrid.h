@@ -0,0 +1,40 @@
+#ifndef LOOSEGRID_H
+#define LOOSEGRID_H
+
+#include <glm/glm.hpp>
+#include <vector>
+#include "frustum.h"
+
+// Culling grid for small moving objects (vehicles, pedestrians). Renderer3D
+// rebuilds each grid only when its simulation revision changes, so at most
+// once per tick; frames in between reuse it.
+// Each object goes into the one ground cell holding its centre; a cell's
+// box is loosened by the largest object radius, so objects never need to
+// straddle cells. Bucketing is a counting sort into one flat array.
+class LooseGrid {
+public:
+    explicit LooseGrid(float cellSize = 64.0f);
+    
+    // radius bounds every object around its centre; heights span [0, height]
+    void build(const std::vector<glm::vec3>& centers, float radius, float height);
+    
+    // Appends the indices (into build()'s centres) of objects that may be
+    // in the frustum
+    void cull(const Frustum& frustum, std::vector<int>& visible) const;
+    
+private:
+    float cellSize;
+    float gridCellSize;                 // In use: doubled while the grid would be too large
+    float radius;
+    float height;
+    glm::ivec2 origin;                  // Cell of the lowest centre
+    glm::ivec2 cells;                   // Grid size in cells
+    std::vector<int> cellStart;         // Size cells + 1; cell c is [start[c], start[c + 1])
+    std::vector<int> entries;           // Object indices grouped by cell
+    std::vector<glm::vec3> entryCenters;
+    std::vector<int> objectCell;        // Scratch: cell per object
+    
+    glm::ivec2 cellOf(const glm::vec3& center) const;
+};
+
+#endif
@@ -4,8 +4,15 @@
 #include <iostream>
 #include <string>
 #include <limits>
+#include <cstdlib>
+#include <ctime>
+#include <cmath>
+#include <algorithm>
 
 #include "citygenerator.h"
+#include "crowd.h"
+#include "simrecorder.h"
+#include "streambuffer.h"
 #include "renderer2d.h"
 #include "renderer3d.h"
 #include "textrenderer.h"
@@ -31,8 +38,9 @@ int userParkRadius = 50;            // Park/fountain size (Midpoint Circle)
 int userTextureTheme = 0;           // Building facade texture (0-2)
 
 // OBJECT SELECTION & MOVEMENT
-int selectedBuildingIndex = -1;     // Currently selected building (-1 = none)
+std::vector<int> selectedBuildings; // Selected building indices, ascending
 const float MOVE_SPEED = 5.0f;      // Movement speed with arrow keys
+const float DRAG_THRESHOLD_2D = 4.0f; // View pixels before a click becomes a box select
 
 // NEW BUILDING CREATION MODE
 bool isAddingNewBuilding = false;   // True when in "Add Building" mode
@@ -40,42 +48,77 @@ Building newBuildingPreview;        // Preview of building being placed
 const int DEFAULT_BUILDING_WIDTH = 40;
 const int DEFAULT_BUILDING_DEPTH = 40;
 const int DEFAULT_BUILDING_HEIGHT = 80;
+const int NUM_PEDESTRIANS = 20000;
+
+// SIMULATION CLOCK (fixed ticks so runs can be recorded and replayed)
+const int MAX_SIM_TICKS_PER_FRAME = 5;  // Drop time rather than spiral after a stall
+const int SEEK_STEP_TICKS = 300;        // F7/F8 scrub step (5 seconds)
+const char* RECORDING_PATH = "recordings/last.simrec";
+const char* PLAN_EXPORT_PATH = "exports/plan.png";
+float simAccumulator = 0.0f;
 
 // CAMERA & INPUT STATE
 double lastX = SCREEN_WIDTH / 2.0;
 double lastY = SCREEN_HEIGHT / 2.0;
 bool firstMouse = true;
+glm::vec2 lastPan2D(0.0f);          // Cursor at the previous 2D pan event
+bool selectPressed = false;         // Left button held in 2D
+bool rubberBandActive = false;      // Left drag past DRAG_THRESHOLD_2D
+glm::vec2 rubberBandStart(0.0f);    // 2D view pixels
+glm::vec2 rubberBandEnd(0.0f);
+const float ZOOM_STEP_2D = 1.1f;    // 2D zoom factor per scroll notch
 bool keys[6] = {false};             // W, S, A, D, Space, Shift for 3D camera
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
 // GLOBAL OBJECTS
 CityGenerator cityGen;
+CrowdSimulation crowd;
+SimRecorder recorder;
 Renderer2D* renderer2D = nullptr;
 Renderer3D* renderer3D = nullptr;
 TextRenderer* textRenderer = nullptr;
 bool showHelp = true;
+bool scene2DChanged = true;         // 2D element lists need rebuilding
+bool filledPlan2D = false;          // Occupancy view: solid footprints and parks
 
 // FUNCTION DECLARATIONS
 void getUserInputs();
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
+void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
 void processInput(GLFWwindow* window);
-void selectNearestBuilding(const glm::vec2& worldPos);
-void moveSelectedBuilding(int dx, int dy);
+void selectBuildingAt(const glm::vec2& worldPos, bool additive);
+void selectBuildingsInRect(const glm::vec2& cornerA, const glm::vec2& cornerB, bool additive);
+bool isBuildingSelected(int index);
+void moveSelectedBuildings(int dx, int dy);
 void displayWelcomeMessage();
 void displayControls();
-glm::vec2 screenToWorld(const glm::vec2& screenPos, int screenWidth, int screenHeight);
+glm::vec2 windowTo2DView(const glm::vec2& windowPos, int windowWidth, int windowHeight);
 void regenerateRoads();
 void addOneBuilding();
 void removeOneBuilding();
 void cycleSkylineType();
 void cycleTextureTheme();
 void setRoadPattern(RoadType newType);
+void generateCityFromSetup(const SimSetup& setup);
+SimSetup makeSimSetup(uint64_t seed);
+bool applyEdit(const SimEdit& edit);
+void toggleRecording();
+void toggleReplay();
+void rebuild2DScene();
+void addOutlineOverlay(const Building& building, const glm::vec3& color);
+void addRectOverlay(const glm::vec2& cornerA, const glm::vec2& cornerB, const glm::vec3& color);
+void invalidate2DBuilding(const Building& building);
+void invalidate2DAll();
 
 // MAIN ENTRY POINT
 int main() {
+    // UI-only randomness (candidate spots for new buildings); the city and
+    // its simulation use their own seeded generators
+    std::srand(static_cast<unsigned int>(std::time(nullptr)));
+    
     // Display welcome message
     displayWelcomeMessage();
     
@@ -109,6 +152,7 @@ int main() {
     glfwMakeContextCurrent(window);
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
     glfwSetCursorPosCallback(window, mouse_callback);
+    glfwSetScrollCallback(window, scroll_callback);
     glfwSetKeyCallback(window, key_callback);
     
     //GLAD INITIALIZATION 
@@ -135,13 +179,7 @@ int main() {
     
     // Generate city based on user inputs
     std::cout << "\n[GENERATING CITY...]" << std::endl;
-    cityGen.generateCity(userNumBuildings, userLayoutSize, userRoadType, userSkylineType);
-    
-    // Add park with user-specified radius (using Midpoint Circle Algorithm)
-    Park centralPark;
-    centralPark.center = Point2D(userLayoutSize / 2, userLayoutSize / 2);
-    centralPark.radius = userParkRadius;
-    cityGen.addPark(centralPark);
+    generateCityFromSetup(makeSimSetup(static_cast<uint64_t>(std::time(nullptr))));
     
     std::cout << "[CITY GENERATED SUCCESSFULLY]" << std::endl;
     std::cout << "\n-------------------------------------" << std::endl;
@@ -162,7 +200,16 @@ int main() {
         // Update animations in 3D mode
         if (currentMode == AppMode::MODE_3D) {
             renderer3D->updateTimeOfDay(deltaTime);
-            cityGen.updateVehicles(deltaTime);
+            
+            // Simulation runs in fixed ticks, independent of the frame rate
+            simAccumulator += deltaTime;
+            int ticks = 0;
+            while (simAccumulator >= recorder.getTickLength() && ticks < MAX_SIM_TICKS_PER_FRAME) {
+                recorder.advance(cityGen, crowd, renderer3D->getCamera().position);
+                simAccumulator -= recorder.getTickLength();
+                ticks++;
+            }
+            if (ticks == MAX_SIM_TICKS_PER_FRAME) simAccumulator = 0.0f;
         }
         
         // Clear screen
@@ -173,54 +220,32 @@ int main() {
         if (currentMode == AppMode::MODE_2D) {
             glDisable(GL_DEPTH_TEST);
             
-            renderer2D->clearElements();
-            
-            // Draw roads using Bresenham's Line Algorithm
-            for (const auto& road : cityGen.getRoads()) {
-                Line2D line(road.start, road.end, glm::vec3(0.3f, 0.3f, 0.3f));
-                renderer2D->addLine(line);
+            // Static city layer is only re-listed after an edit; the
+            // renderer repaints just the invalidated areas
+            if (scene2DChanged) {
+                rebuild2DScene();
+                scene2DChanged = false;
             }
             
-            // Draw parks using Midpoint Circle Algorithm
-            for (const auto& park : cityGen.getParks()) {
-                glm::vec3 parkColor = glm::vec3(0.0f, 0.8f, 0.2f); // Green
-                Circle2D circle(park.center, park.radius, parkColor);
-                renderer2D->addCircle(circle);
+            // Selection and preview are cheap per-frame overlays
+            renderer2D->clearOverlay();
+            const auto& buildings = cityGen.getBuildings();
+            for (int index : selectedBuildings) {
+                if (index < static_cast<int>(buildings.size())) {
+                    addOutlineOverlay(buildings[index], glm::vec3(1.0f, 1.0f, 0.0f)); // Yellow if selected
+                }
             }
             
-            // Draw building outlines
-            const auto& buildings = cityGen.getBuildings();
-            for (size_t i = 0; i < buildings.size(); ++i) {
-                const auto& building = buildings[i];
-                
-                // Highlight selected building
-                glm::vec3 buildingColor = (i == selectedBuildingIndex) ? 
-                    glm::vec3(1.0f, 1.0f, 0.0f) :  // Yellow if selected
-                    glm::vec3(0.7f, 0.7f, 0.9f);    // Gray-blue otherwise
-                
-                int x1 = building.position.x;
-                int y1 = building.position.y;
-                int x2 = building.position.x + building.size.x;
-                int y2 = building.position.y + building.size.y;
-                
-                renderer2D->addLine(Line2D(Point2D(x1, y1), Point2D(x2, y1), buildingColor));
-                renderer2D->addLine(Line2D(Point2D(x2, y1), Point2D(x2, y2), buildingColor));
-                renderer2D->addLine(Line2D(Point2D(x2, y2), Point2D(x1, y2), buildingColor));
-                renderer2D->addLine(Line2D(Point2D(x1, y2), Point2D(x1, y1), buildingColor));
+            // Rubber band while box selecting
+            if (rubberBandActive) {
+                const Camera2D& camera = renderer2D->getCamera();
+                addRectOverlay(camera.screenToWorld(rubberBandStart), camera.screenToWorld(rubberBandEnd),
+                               glm::vec3(1.0f, 1.0f, 1.0f));
             }
             
             // Draw new building preview if in add mode
             if (isAddingNewBuilding) {
-                glm::vec3 previewColor(0.0f, 1.0f, 1.0f); // Cyan for preview
-                int x1 = newBuildingPreview.position.x;
-                int y1 = newBuildingPreview.position.y;
-                int x2 = newBuildingPreview.position.x + newBuildingPreview.size.x;
-                int y2 = newBuildingPreview.position.y + newBuildingPreview.size.y;
-                
-                renderer2D->addLine(Line2D(Point2D(x1, y1), Point2D(x2, y1), previewColor));
-                renderer2D->addLine(Line2D(Point2D(x2, y1), Point2D(x2, y2), previewColor));
-                renderer2D->addLine(Line2D(Point2D(x2, y2), Point2D(x1, y2), previewColor));
-                renderer2D->addLine(Line2D(Point2D(x1, y2), Point2D(x1, y1), previewColor));
+                addOutlineOverlay(newBuildingPreview, glm::vec3(0.0f, 1.0f, 1.0f)); // Cyan for preview
             }
             
             renderer2D->render();
@@ -229,7 +254,8 @@ int main() {
         // 3D RENDERING  
         else {
             renderer3D->updateCamera(deltaTime, keys, 0.0f, 0.0f);
-            renderer3D->render(cityGen);
+            renderer3D->setSimulationLag(simAccumulator);
+            renderer3D->render(cityGen, crowd, deltaTime);
         }
         
         // ON-SCREEN UI 
@@ -286,6 +312,14 @@ int main() {
                     y += 8 * scale;
                     textRenderer->renderText("Left Click - Select building", 10, y, scale * 0.9f, textColor);
                     y += 8 * scale;
+                    textRenderer->renderText("Left Drag - Box select (Shift adds)", 10, y, scale * 0.9f, textColor);
+                    y += 8 * scale;
+                    textRenderer->renderText("Wheel/Right Drag - Zoom/Pan (HOME resets)", 10, y, scale * 0.9f, textColor);
+                    y += 8 * scale;
+                    textRenderer->renderText("P - Export plan as PNG", 10, y, scale * 0.9f, textColor);
+                    y += 8 * scale;
+                    textRenderer->renderText("F - Filled footprints/parks", 10, y, scale * 0.9f, textColor);
+                    y += 8 * scale;
                     textRenderer->renderText("Arrow Keys - Move building", 10, y, scale * 0.9f, textColor);
                     y += 8 * scale;
                     textRenderer->renderText("N - Add new building", 10, y, scale * 0.9f, textColor);
@@ -302,9 +336,13 @@ int main() {
                     textRenderer->renderText("M - Cycle textures", 10, y, scale * 0.8f, glm::vec3(0.7f, 1.0f, 0.7f));
                     y += 8 * scale;
                     
-                    if (selectedBuildingIndex >= 0) {
+                    if (selectedBuildings.size() == 1) {
                         textRenderer->renderText("Building SELECTED!", 10, y, scale, glm::vec3(1.0f, 1.0f, 0.0f));
                         y += 8 * scale;
+                    } else if (!selectedBuildings.empty()) {
+                        std::string countText = std::to_string(selectedBuildings.size()) + " buildings SELECTED!";
+                        textRenderer->renderText(countText, 10, y, scale, glm::vec3(1.0f, 1.0f, 0.0f));
+                        y += 8 * scale;
                     }
                 }
             } else {
@@ -317,11 +355,20 @@ int main() {
                 textRenderer->renderText("Right Mouse - Look around", 10, y, scale * 0.9f, textColor);
                 y += 8 * scale;
                 textRenderer->renderText("T/Y - Time speed (fast/normal)", 10, y, scale * 0.9f, textColor);
+                y += 8 * scale;
+                textRenderer->renderText("I - Cycle geometry path", 10, y, scale * 0.9f, textColor);
+                y += 8 * scale;
+                textRenderer->renderText("O - Cycle culling mode", 10, y, scale * 0.9f, textColor);
+                y += 8 * scale;
+                textRenderer->renderText("U - Building LOD on/off", 10, y, scale * 0.9f, textColor);
+                y += 8 * scale;
+                textRenderer->renderText("F5/F6 - Record/Replay simulation", 10, y, scale * 0.9f, textColor);
             }
             
             glEnable(GL_DEPTH_TEST);
         }
         
+        StreamBuffer::shared().endFrame();
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
@@ -330,6 +377,7 @@ int main() {
     delete renderer2D;
     delete renderer3D;
     delete textRenderer;
+    StreamBuffer::shared().release();
     
     glfwTerminate();
     
@@ -471,7 +519,13 @@ void displayControls() {
     std::cout << "  ESC         - Exit application" << std::endl;
     std::cout << "\n2D MODE (City Planning):" << std::endl;
     std::cout << "  Left Click  - Select a building" << std::endl;
-    std::cout << "  Arrow Keys  - Move selected building (↑↓←→)" << std::endl;
+    std::cout << "  Left Drag   - Box select buildings (hold Shift to add)" << std::endl;
+    std::cout << "  Mouse Wheel - Zoom in/out at the cursor" << std::endl;
+    std::cout << "  Right Drag  - Pan the view" << std::endl;
+    std::cout << "  HOME        - Reset zoom and pan" << std::endl;
+    std::cout << "  P           - Export the 2D view (" << PLAN_EXPORT_PATH << ")" << std::endl;
+    std::cout << "  F           - Toggle filled building footprints and parks" << std::endl;
+    std::cout << "  Arrow Keys  - Move selected buildings (↑↓←→)" << std::endl;
     std::cout << "  N           - Start adding NEW building" << std::endl;
     std::cout << "\n2D MODE (City Modifications):" << std::endl;
     std::cout << "  1/2/3       - Change road pattern (1=Grid, 2=Radial, 3=Random)" << std::endl;
@@ -490,6 +544,14 @@ void displayControls() {
     std::cout << "  SPACE/SHIFT - Move camera up/down" << std::endl;
     std::cout << "  Right Mouse - Look around (hold and drag)" << std::endl;
     std::cout << "  T/Y         - Time speed (fast/normal)" << std::endl;
+    std::cout << "  I           - Cycle static geometry (merged/instanced/per object)" << std::endl;
+    std::cout << "  O           - Cycle culling: occlusion / frustum / off" << std::endl;
+    std::cout << "  U           - Toggle building LOD (box and impostor levels)" << std::endl;
+    std::cout << "\nSIMULATION RECORDING:" << std::endl;
+    std::cout << "  F5          - Start/stop recording (restarts the city from a new seed)" << std::endl;
+    std::cout << "  F6          - Start/stop replay of the last recording" << std::endl;
+    std::cout << "  F7/F8       - Scrub replay back/forward 5 seconds" << std::endl;
+    std::cout << "  F9/F10      - Save/Load recording (" << RECORDING_PATH << ")" << std::endl;
     std::cout << "\n-------------------------------------\n" << std::endl;
 }
 
@@ -522,9 +584,36 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos) {
         if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_RIGHT) == GLFW_PRESS) {
             renderer3D->updateCamera(deltaTime, keys, xoffset, yoffset);
         }
+    } else {
+        // Right-drag pans the 2D view
+        int width, height;
+        glfwGetWindowSize(window, &width, &height);
+        glm::vec2 viewPos = windowTo2DView(glm::vec2(xpos, ypos), width, height);
+        
+        if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_RIGHT) == GLFW_PRESS) {
+            Camera2D camera = renderer2D->getCamera();
+            camera.pan(viewPos - lastPan2D);
+            renderer2D->setCamera(camera);
+        }
+        lastPan2D = viewPos;
     }
 }
 
+void scroll_callback(GLFWwindow* window, double /*xoffset*/, double yoffset) {
+    if (currentMode != AppMode::MODE_2D || yoffset == 0.0) return;
+    
+    // Zoom about the cursor so the point under it stays put
+    double xpos, ypos;
+    glfwGetCursorPos(window, &xpos, &ypos);
+    int width, height;
+    glfwGetWindowSize(window, &width, &height);
+    
+    Camera2D camera = renderer2D->getCamera();
+    camera.zoomAt(windowTo2DView(glm::vec2(xpos, ypos), width, height),
+                  std::pow(ZOOM_STEP_2D, static_cast<float>(yoffset)));
+    renderer2D->setCamera(camera);
+}
+
 
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
     if (action == GLFW_PRESS) {
@@ -532,16 +621,37 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
         if (key == GLFW_KEY_ENTER) {
             if (currentMode == AppMode::MODE_2D) {
                 currentMode = AppMode::MODE_3D;
-                selectedBuildingIndex = -1; // Deselect when entering 3D
+                selectedBuildings.clear(); // Deselect when entering 3D
                 glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
                 std::cout << "[MODE] Switched to 3D exploration" << std::endl;
             } else {
                 currentMode = AppMode::MODE_2D;
+                invalidate2DAll(); // Replays may have edited the city while in 3D
                 glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
                 std::cout << "[MODE] Switched to 2D planning" << std::endl;
             }
         }
         
+        // Reset the 2D view
+        if (currentMode == AppMode::MODE_2D && key == GLFW_KEY_HOME) {
+            renderer2D->setCamera(Camera2D());
+            std::cout << "[VIEW] 2D zoom and pan reset" << std::endl;
+        }
+        
+        // Export the 2D view as it is on screen (rasterised on the CPU)
+        if (currentMode == AppMode::MODE_2D && key == GLFW_KEY_P) {
+            if (renderer2D->exportPNG(PLAN_EXPORT_PATH, glm::vec3(0.1f, 0.1f, 0.15f))) { // Window clear colour
+                std::cout << "[EXPORT] Saved 2D plan to " << PLAN_EXPORT_PATH << std::endl;
+            }
+        }
+        
+        // Filled occupancy view (scanline-filled footprints and parks)
+        if (currentMode == AppMode::MODE_2D && key == GLFW_KEY_F) {
+            filledPlan2D = !filledPlan2D;
+            invalidate2DAll();
+            std::cout << "[VIEW] Filled plan: " << (filledPlan2D ? "ON" : "OFF") << std::endl;
+        }
+        
         // Toggle help
         if (key == GLFW_KEY_H) {
             showHelp = !showHelp;
@@ -551,7 +661,7 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
         // Start new building mode (N key in 2D)
         if (currentMode == AppMode::MODE_2D && key == GLFW_KEY_N && !isAddingNewBuilding) {
             isAddingNewBuilding = true;
-            selectedBuildingIndex = -1; // Deselect any selected building
+            selectedBuildings.clear(); // Deselect any selected building
             
             // Initialize new building at center
             newBuildingPreview.position.x = userLayoutSize / 2 - DEFAULT_BUILDING_WIDTH / 2;
@@ -629,7 +739,10 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
             
             // Confirm placement (ENTER)
             if (key == GLFW_KEY_ENTER) {
-                cityGen.addBuilding(newBuildingPreview);
+                SimEdit edit = {};
+                edit.type = SimEditType::ADD_BUILDING;
+                edit.building = newBuildingPreview;
+                applyEdit(edit);
                 std::cout << "[ADD] Building placed at (" << newBuildingPreview.position.x 
                           << ", " << newBuildingPreview.position.y << ") - Size: " 
                           << newBuildingPreview.size.x << "x" << newBuildingPreview.size.y 
@@ -644,18 +757,18 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
             }
         }
         // Arrow keys for building movement in 2D mode (only when not adding)
-        else if (currentMode == AppMode::MODE_2D && selectedBuildingIndex >= 0 && !isAddingNewBuilding) {
+        else if (currentMode == AppMode::MODE_2D && !selectedBuildings.empty() && !isAddingNewBuilding) {
             if (key == GLFW_KEY_UP) {
-                moveSelectedBuilding(0, MOVE_SPEED);
+                moveSelectedBuildings(0, MOVE_SPEED);
             }
             if (key == GLFW_KEY_DOWN) {
-                moveSelectedBuilding(0, -MOVE_SPEED);
+                moveSelectedBuildings(0, -MOVE_SPEED);
             }
             if (key == GLFW_KEY_LEFT) {
-                moveSelectedBuilding(-MOVE_SPEED, 0);
+                moveSelectedBuildings(-MOVE_SPEED, 0);
             }
             if (key == GLFW_KEY_RIGHT) {
-                moveSelectedBuilding(MOVE_SPEED, 0);
+                moveSelectedBuildings(MOVE_SPEED, 0);
             }
         }
         
@@ -696,6 +809,32 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
             }
         }
         
+        // Simulation recording and replay
+        if (key == GLFW_KEY_F5) {
+            toggleRecording();
+        }
+        if (key == GLFW_KEY_F6) {
+            toggleReplay();
+            invalidate2DAll();
+        }
+        if ((key == GLFW_KEY_F7 || key == GLFW_KEY_F8) && recorder.getMode() == SimRecorder::Mode::REPLAYING) {
+            int target = recorder.getTick() + (key == GLFW_KEY_F7 ? -SEEK_STEP_TICKS : SEEK_STEP_TICKS);
+            recorder.seek(target, cityGen, crowd);
+            invalidate2DAll();
+            std::cout << "[REPLAY] Tick " << recorder.getTick() << " / " << recorder.getRecordedTicks() << std::endl;
+        }
+        if (key == GLFW_KEY_F9) {
+            if (recorder.getMode() == SimRecorder::Mode::RECORDING) recorder.stopRecording();
+            if (!recorder.save(RECORDING_PATH)) {
+                std::cout << "[RECORD] Nothing to save" << std::endl;
+            }
+        }
+        if (key == GLFW_KEY_F10 && recorder.load(RECORDING_PATH)) {
+            // Rebuild the recorded starting city, then play it back
+            generateCityFromSetup(recorder.getSetup());
+            recorder.startReplay(cityGen, crowd);
+        }
+        
         // Time control in 3D mode
         if (currentMode == AppMode::MODE_3D) {
             if (key == GLFW_KEY_T) {
@@ -706,6 +845,38 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
                 renderer3D->setTimeSpeed(1.0f);
                 std::cout << "[TIME] Normal speed (1x)" << std::endl;
             }
+            if (key == GLFW_KEY_I) {
+                // Merged batches -> instanced buildings -> one draw per object
+                Renderer3D::GeometryPath path = renderer3D->getGeometryPath();
+                if (path == Renderer3D::GeometryPath::MERGED) {
+                    renderer3D->setGeometryPath(Renderer3D::GeometryPath::INSTANCED);
+                    std::cout << "[RENDER] Static geometry: instanced buildings" << std::endl;
+                } else if (path == Renderer3D::GeometryPath::INSTANCED) {
+                    renderer3D->setGeometryPath(Renderer3D::GeometryPath::PER_OBJECT);
+                    std::cout << "[RENDER] Static geometry: one draw per object" << std::endl;
+                } else {
+                    renderer3D->setGeometryPath(Renderer3D::GeometryPath::MERGED);
+                    std::cout << "[RENDER] Static geometry: merged per-material batches" << std::endl;
+                }
+            }
+            if (key == GLFW_KEY_O) {
+                // Occlusion -> frustum only -> off
+                Renderer3D::CullingMode mode = renderer3D->getCullingMode();
+                if (mode == Renderer3D::CullingMode::OCCLUSION) {
+                    renderer3D->setCullingMode(Renderer3D::CullingMode::FRUSTUM);
+                    std::cout << "[RENDER] Culling: frustum only" << std::endl;
+                } else if (mode == Renderer3D::CullingMode::FRUSTUM) {
+                    renderer3D->setCullingMode(Renderer3D::CullingMode::OFF);
+                    std::cout << "[RENDER] Culling: off" << std::endl;
+                } else {
+                    renderer3D->setCullingMode(Renderer3D::CullingMode::OCCLUSION);
+                    std::cout << "[RENDER] Culling: frustum and occlusion" << std::endl;
+                }
+            }
+            if (key == GLFW_KEY_U) {
+                renderer3D->setBuildingLOD(!renderer3D->getBuildingLOD());
+                std::cout << "[RENDER] Building LOD: " << (renderer3D->getBuildingLOD() ? "ON" : "OFF") << std::endl;
+            }
         }
     }
     
@@ -723,135 +894,176 @@ void processInput(GLFWwindow* window) {
         glfwSetWindowShouldClose(window, true);
     }
     
-    // Mouse click for building selection in 2D mode
-    static bool clickProcessed = false;
+    // Building selection in 2D mode: a click picks the building under the
+    // cursor, a drag selects everything the rubber band touches. Both act
+    // on release; Shift adds to the selection instead of replacing it.
+    if (currentMode != AppMode::MODE_2D) {
+        selectPressed = false;
+        rubberBandActive = false;
+        return;
+    }
     
-    if (currentMode == AppMode::MODE_2D && 
-        glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS) {
-        
-        if (!clickProcessed) {
-            double xpos, ypos;
-            glfwGetCursorPos(window, &xpos, &ypos);
-            int width, height;
-            glfwGetWindowSize(window, &width, &height);
-            glm::vec2 worldPos = screenToWorld(glm::vec2(xpos, ypos), width, height);
-            selectNearestBuilding(worldPos);
-            clickProcessed = true;
+    double xpos, ypos;
+    glfwGetCursorPos(window, &xpos, &ypos);
+    int width, height;
+    glfwGetWindowSize(window, &width, &height);
+    glm::vec2 viewPos = windowTo2DView(glm::vec2(xpos, ypos), width, height);
+    
+    if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS) {
+        if (!selectPressed) {
+            selectPressed = true;
+            rubberBandStart = viewPos;
         }
-    } else {
-        clickProcessed = false;
+        rubberBandEnd = viewPos;
+        if (glm::length(rubberBandEnd - rubberBandStart) > DRAG_THRESHOLD_2D) rubberBandActive = true;
+    } else if (selectPressed) {
+        bool additive = glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS ||
+                        glfwGetKey(window, GLFW_KEY_RIGHT_SHIFT) == GLFW_PRESS;
+        const Camera2D& camera = renderer2D->getCamera();
+        if (rubberBandActive) {
+            selectBuildingsInRect(camera.screenToWorld(rubberBandStart), camera.screenToWorld(rubberBandEnd), additive);
+        } else {
+            selectBuildingAt(camera.screenToWorld(rubberBandStart), additive);
+        }
+        selectPressed = false;
+        rubberBandActive = false;
     }
 }
 
 // UTILITY FUNCTIONS
 
 
-// Convert screen coordinates to world coordinates for 2D view
- 
-glm::vec2 screenToWorld(const glm::vec2& screenPos, int screenWidth, int screenHeight) {
-    float worldX = (screenPos.x / screenWidth) * userLayoutSize;
-    float worldY = ((screenHeight - screenPos.y) / screenHeight) * userLayoutSize;
-    return glm::vec2(worldX, worldY);
+// Window (cursor) coordinates to 2D view pixels; the view keeps its
+// SCREEN_WIDTH x SCREEN_HEIGHT resolution stretched over the window
+glm::vec2 windowTo2DView(const glm::vec2& windowPos, int windowWidth, int windowHeight) {
+    return glm::vec2(windowPos.x * SCREEN_WIDTH / windowWidth, windowPos.y * SCREEN_HEIGHT / windowHeight);
 }
 
 
-//Select the nearest building to the clicked position
-//Used for interactive building movement with arrow keys
+//Select the building under the clicked position (Shift toggles it in the
+//selection instead). Used for interactive building movement with arrow keys
 
-void selectNearestBuilding(const glm::vec2& worldPos) {
+void selectBuildingAt(const glm::vec2& worldPos, bool additive) {
     const auto& buildings = cityGen.getBuildings();
-    selectedBuildingIndex = -1;
+    if (!additive) selectedBuildings.clear();
     
     std::cout << "\n[SELECT] Click at world position (" << (int)worldPos.x << ", " << (int)worldPos.y << ")" << std::endl;
     
-    // Find closest building (even if not directly clicked)
-    float closestDist = 999999.0f;
-    int closestIndex = -1;
-    
-    for (size_t i = 0; i < buildings.size(); ++i) {
+    // Footprints touching the click (edges count); the lowest index wins
+    std::vector<int> hits;
+    cityGen.getBuildingIndex().queryPoint(worldPos, hits);
+    if (!hits.empty()) {
+        int i = *std::min_element(hits.begin(), hits.end());
         const auto& building = buildings[i];
         
-        // Check if click is inside building bounds
-        if (worldPos.x >= building.position.x && 
-            worldPos.x <= building.position.x + building.size.x &&
-            worldPos.y >= building.position.y && 
-            worldPos.y <= building.position.y + building.size.y) {
-            
-            selectedBuildingIndex = i;
-            std::cout << "[SELECT] ✓ Building #" << i << " SELECTED (direct hit)!" << std::endl;
-            std::cout << "         Position: (" << building.position.x << ", " << building.position.y << ")" << std::endl;
-            std::cout << "         Size: " << building.size.x << "x" << building.size.y << std::endl;
-            std::cout << "         Bounds: X[" << building.position.x << "-" << (building.position.x + building.size.x) 
-                      << "] Y[" << building.position.y << "-" << (building.position.y + building.size.y) << "]" << std::endl;
+        auto position = std::lower_bound(selectedBuildings.begin(), selectedBuildings.end(), i);
+        if (position != selectedBuildings.end() && *position == i) {
+            selectedBuildings.erase(position);
+            std::cout << "[SELECT] Building #" << i << " removed from selection" << std::endl;
             return;
         }
+        selectedBuildings.insert(position, i);
         
-        // Track closest building for debugging
-        float centerX = building.position.x + building.size.x / 2.0f;
-        float centerY = building.position.y + building.size.y / 2.0f;
-        float dist = std::sqrt((worldPos.x - centerX) * (worldPos.x - centerX) + 
-                              (worldPos.y - centerY) * (worldPos.y - centerY));
-        if (dist < closestDist) {
-            closestDist = dist;
-            closestIndex = i;
-        }
+        std::cout << "[SELECT] ✓ Building #" << i << " SELECTED (direct hit)!" << std::endl;
+        std::cout << "         Position: (" << building.position.x << ", " << building.position.y << ")" << std::endl;
+        std::cout << "         Size: " << building.size.x << "x" << building.size.y << std::endl;
+        std::cout << "         Bounds: X[" << building.position.x << "-" << (building.position.x + building.size.x) 
+                  << "] Y[" << building.position.y << "-" << (building.position.y + building.size.y) << "]" << std::endl;
+        return;
     }
     
-    // If no building was clicked, show closest one
-    if (selectedBuildingIndex == -1) {
-        std::cout << "[SELECT] ✗ No building at click position" << std::endl;
-        if (closestIndex >= 0) {
-            const auto& closest = buildings[closestIndex];
-            std::cout << "         Closest building #" << closestIndex << " is " << (int)closestDist << " units away" << std::endl;
-            std::cout << "         at (" << closest.position.x << ", " << closest.position.y 
-                      << ") size " << closest.size.x << "x" << closest.size.y << std::endl;
-        }
-        std::cout << "         TIP: Click must be INSIDE a building's rectangle area" << std::endl;
+    // If no building was clicked, show the closest footprint
+    std::cout << "[SELECT] ✗ No building at click position" << std::endl;
+    float distanceSquared = 0.0f;
+    int closestIndex = cityGen.getBuildingIndex().nearest(worldPos, &distanceSquared);
+    if (closestIndex >= 0) {
+        const auto& closest = buildings[closestIndex];
+        std::cout << "         Closest building #" << closestIndex << " is " << (int)std::sqrt(distanceSquared) << " units away" << std::endl;
+        std::cout << "         at (" << closest.position.x << ", " << closest.position.y 
+                  << ") size " << closest.size.x << "x" << closest.size.y << std::endl;
     }
+    std::cout << "         TIP: Click must be INSIDE a building's rectangle area" << std::endl;
 }
 
+// Select every building whose footprint touches the rubber band
 
-// Move the currently selected building by dx, dy pixels
-// Demonstrates interactive object manipulation with collision detection
-
-void moveSelectedBuilding(int dx, int dy) {
-    if (selectedBuildingIndex < 0) return;
-    
-    auto& buildings = cityGen.getBuildings();
-    if (selectedBuildingIndex >= buildings.size()) return;
+void selectBuildingsInRect(const glm::vec2& cornerA, const glm::vec2& cornerB, bool additive) {
+    std::vector<int> hits;
+    cityGen.getBuildingIndex().queryRect(RTreeBox(glm::min(cornerA, cornerB), glm::max(cornerA, cornerB)), hits);
     
-    auto& building = buildings[selectedBuildingIndex];
+    if (!additive) selectedBuildings.clear();
+    selectedBuildings.insert(selectedBuildings.end(), hits.begin(), hits.end());
+    std::sort(selectedBuildings.begin(), selectedBuildings.end());
+    selectedBuildings.erase(std::unique(selectedBuildings.begin(), selectedBuildings.end()), selectedBuildings.end());
     
-    // Calculate new position
-    float newX = building.position.x + dx;
-    float newY = building.position.y + dy;
+    std::cout << "[SELECT] Box touched " << hits.size() << " building(s), " 
+              << selectedBuildings.size() << " selected" << std::endl;
+}
+
+bool isBuildingSelected(int index) {
+    return std::binary_search(selectedBuildings.begin(), selectedBuildings.end(), index);
+}
+
+
+// Move the selected buildings by dx, dy pixels
+// Demonstrates interactive object manipulation with collision detection
+
+void moveSelectedBuildings(int dx, int dy) {
+    if (selectedBuildings.empty()) return;
     
-    // Keep building within bounds
-    if (newX < 0 || newX + building.size.x > userLayoutSize ||
-        newY < 0 || newY + building.size.y > userLayoutSize) {
-        std::cout << "[MOVE] Cannot move building outside city bounds" << std::endl;
-        return;
-    }
+    const auto& buildings = cityGen.getBuildings();
+    if (selectedBuildings.back() >= static_cast<int>(buildings.size())) return;
     
-    // Check collision with other buildings (with 10 unit buffer)
-    for (size_t i = 0; i < buildings.size(); ++i) {
-        if (i == selectedBuildingIndex) continue; // Skip self
+    // Check the whole group first so it moves together or not at all
+    std::vector<int> nearby;
+    for (int index : selectedBuildings) {
+        const auto& building = buildings[index];
         
-        const auto& other = buildings[i];
-        if (newX < other.position.x + other.size.x + 10.0f &&
-            newX + building.size.x + 10.0f > other.position.x &&
-            newY < other.position.y + other.size.y + 10.0f &&
-            newY + building.size.y + 10.0f > other.position.y) {
-            std::cout << "[MOVE] Cannot move - would overlap with another building!" << std::endl;
+        // Calculate new position
+        float newX = building.position.x + dx;
+        float newY = building.position.y + dy;
+        
+        // Keep building within bounds
+        if (newX < 0 || newX + building.size.x > userLayoutSize ||
+            newY < 0 || newY + building.size.y > userLayoutSize) {
+            std::cout << "[MOVE] Cannot move building outside city bounds" << std::endl;
             return;
         }
+        
+        // Check collision with unselected buildings (with 10 unit buffer)
+        glm::vec2 newPosition(newX, newY);
+        cityGen.getBuildingIndex().queryRect(RTreeBox(newPosition - glm::vec2(10.0f),
+                                                      newPosition + building.size + glm::vec2(10.0f)), nearby);
+        for (int i : nearby) {
+            if (isBuildingSelected(i)) continue; // Moves along
+            
+            const auto& other = buildings[i];
+            if (newX < other.position.x + other.size.x + 10.0f &&
+                newX + building.size.x + 10.0f > other.position.x &&
+                newY < other.position.y + other.size.y + 10.0f &&
+                newY + building.size.y + 10.0f > other.position.y) {
+                std::cout << "[MOVE] Cannot move - would overlap with another building!" << std::endl;
+                return;
+            }
+        }
     }
     
     // Move is valid
-    building.position.x = newX;
-    building.position.y = newY;
+    for (int index : selectedBuildings) {
+        SimEdit edit = {};
+        edit.type = SimEditType::MOVE_BUILDING;
+        edit.buildingIndex = index;
+        edit.building = buildings[index];
+        edit.building.position += glm::vec2(dx, dy);
+        if (!applyEdit(edit)) return;
+    }
     
-    std::cout << "[MOVE] Building moved to (" << newX << ", " << newY << ")" << std::endl;
+    if (selectedBuildings.size() == 1) {
+        const auto& building = buildings[selectedBuildings[0]];
+        std::cout << "[MOVE] Building moved to (" << building.position.x << ", " << building.position.y << ")" << std::endl;
+    } else {
+        std::cout << "[MOVE] " << selectedBuildings.size() << " buildings moved by (" << dx << ", " << dy << ")" << std::endl;
+    }
 }
 
 // RUNTIME CITY MODIFICATION FUNCTIONS
@@ -860,6 +1072,10 @@ void moveSelectedBuilding(int dx, int dy) {
 // Cycle through road patterns: Grid -> Radial -> Random -> Grid
 
 void setRoadPattern(RoadType newType) {
+    SimEdit edit = {};
+    edit.type = SimEditType::SET_ROAD_PATTERN;
+    edit.roadType = newType;
+    if (!applyEdit(edit)) return;
     userRoadType = newType;
     
     std::string typeName;
@@ -868,13 +1084,6 @@ void setRoadPattern(RoadType newType) {
     else typeName = "RANDOM";
     
     std::cout << "[ROADS] Changed to " << typeName << " pattern" << std::endl;
-    
-    // Regenerate roads with new pattern
-    cityGen.generateRoads(userRoadType, userLayoutSize);
-    
-    // CRITICAL: Regenerate street lights after road changes!
-    cityGen.generateStreetLights();
-    
     std::cout << "[ROADS] Road network and street lights regenerated!" << std::endl;
 }
 
@@ -908,11 +1117,11 @@ void addOneBuilding() {
         }
         
         // Try to add building (will check collision internally)
-        size_t beforeCount = cityGen.getBuildings().size();
-        cityGen.addBuilding(newBuilding);
-        size_t afterCount = cityGen.getBuildings().size();
+        SimEdit edit = {};
+        edit.type = SimEditType::ADD_BUILDING;
+        edit.building = newBuilding;
         
-        if (afterCount > beforeCount) {
+        if (applyEdit(edit)) {
             placed = true;
             userNumBuildings++;
             std::cout << "[BUILDINGS] Added one building. Total: " << userNumBuildings << std::endl;
@@ -935,17 +1144,15 @@ void removeOneBuilding() {
         return;
     }
     
-    userNumBuildings--;
-    
     // Remove last building
-    auto& mutableBuildings = cityGen.getBuildings();
-    if (!mutableBuildings.empty()) {
-        mutableBuildings.pop_back();
-    }
+    SimEdit edit = {};
+    edit.type = SimEditType::REMOVE_BUILDING;
+    if (!applyEdit(edit)) return;
+    userNumBuildings--;
     
-    // Deselect if we removed the selected building
-    if (selectedBuildingIndex >= mutableBuildings.size()) {
-        selectedBuildingIndex = -1;
+    // Deselect the removed building
+    if (!selectedBuildings.empty() && selectedBuildings.back() >= static_cast<int>(buildings.size())) {
+        selectedBuildings.pop_back();
     }
     
     std::cout << "[BUILDINGS] Removed one building. Total: " << userNumBuildings << std::endl;
@@ -956,29 +1163,27 @@ void removeOneBuilding() {
 
 void cycleSkylineType() {
     // Cycle to next skyline type
+    SimEdit edit = {};
+    edit.type = SimEditType::SET_SKYLINE;
     if (userSkylineType == SkylineType::LOW_RISE) {
-        userSkylineType = SkylineType::MID_RISE;
-        std::cout << "[SKYLINE] Changed to MID-RISE (50-100 units)" << std::endl;
+        edit.skylineType = SkylineType::MID_RISE;
     } else if (userSkylineType == SkylineType::MID_RISE) {
-        userSkylineType = SkylineType::SKYSCRAPER;
-        std::cout << "[SKYLINE] Changed to SKYSCRAPER (100-200 units)" << std::endl;
+        edit.skylineType = SkylineType::SKYSCRAPER;
     } else {
-        userSkylineType = SkylineType::LOW_RISE;
-        std::cout << "[SKYLINE] Changed to LOW-RISE (20-50 units)" << std::endl;
+        edit.skylineType = SkylineType::LOW_RISE;
     }
     
     // Update all existing building heights
-    auto& buildings = cityGen.getBuildings();
-    for (auto& building : buildings) {
-        if (userSkylineType == SkylineType::LOW_RISE) {
-            building.height = 20 + rand() % 30;
-        } else if (userSkylineType == SkylineType::MID_RISE) {
-            building.height = 50 + rand() % 50;
-        } else {
-            building.height = 100 + rand() % 100;
-        }
-    }
+    if (!applyEdit(edit)) return;
+    userSkylineType = edit.skylineType;
     
+    if (userSkylineType == SkylineType::LOW_RISE) {
+        std::cout << "[SKYLINE] Changed to LOW-RISE (20-50 units)" << std::endl;
+    } else if (userSkylineType == SkylineType::MID_RISE) {
+        std::cout << "[SKYLINE] Changed to MID-RISE (50-100 units)" << std::endl;
+    } else {
+        std::cout << "[SKYLINE] Changed to SKYSCRAPER (100-200 units)" << std::endl;
+    }
     std::cout << "[SKYLINE] All building heights updated!" << std::endl;
 }
 
@@ -999,3 +1204,163 @@ void cycleTextureTheme() {
     std::cout << "[TEXTURE] Changed to " << themeName << std::endl;
     std::cout << "[TEXTURE] Switch to 3D mode to see the changes!" << std::endl;
 }
+
+
+// SIMULATION SETUP, EDITS & RECORDING
+
+SimSetup makeSimSetup(uint64_t seed) {
+    SimSetup setup = {};
+    setup.seed = seed;
+    setup.numBuildings = userNumBuildings;
+    setup.layoutSize = userLayoutSize;
+    setup.parkRadius = userParkRadius;
+    setup.numPedestrians = NUM_PEDESTRIANS;
+    setup.roadType = userRoadType;
+    setup.skylineType = userSkylineType;
+    return setup;
+}
+
+// Everything random in the city and its simulation derives from setup.seed
+void generateCityFromSetup(const SimSetup& setup) {
+    userNumBuildings = setup.numBuildings;
+    userLayoutSize = setup.layoutSize;
+    userParkRadius = setup.parkRadius;
+    userRoadType = setup.roadType;
+    userSkylineType = setup.skylineType;
+    selectedBuildings.clear();
+    
+    cityGen.setSeed(setup.seed);
+    cityGen.generateCity(setup.numBuildings, setup.layoutSize, setup.roadType, setup.skylineType);
+    
+    // Add park with user-specified radius (using Midpoint Circle Algorithm)
+    Park centralPark;
+    centralPark.center = Point2D(setup.layoutSize / 2, setup.layoutSize / 2);
+    centralPark.radius = setup.parkRadius;
+    cityGen.addPark(centralPark);
+    
+    // Pedestrians share one flow field per destination
+    crowd = CrowdSimulation();
+    crowd.setSeed(setup.seed);
+    crowd.build(cityGen);
+    crowd.spawnPedestrians(setup.numPedestrians);
+    
+    simAccumulator = 0.0f;
+    invalidate2DAll();
+    std::cout << "[CITY] Generated from seed " << setup.seed << std::endl;
+}
+
+// All city edits go through here so a recording sees exactly what changed
+bool applyEdit(const SimEdit& edit) {
+    if (recorder.getMode() == SimRecorder::Mode::REPLAYING) {
+        std::cout << "[REPLAY] Editing is disabled during replay (F6 to stop)" << std::endl;
+        return false;
+    }
+    
+    // Repaint where the outline was and where it ends up
+    const auto& buildings = cityGen.getBuildings();
+    if (edit.type == SimEditType::MOVE_BUILDING && edit.buildingIndex >= 0 &&
+        edit.buildingIndex < static_cast<int>(buildings.size())) {
+        invalidate2DBuilding(buildings[edit.buildingIndex]);
+    }
+    if (edit.type == SimEditType::REMOVE_BUILDING && !buildings.empty()) {
+        invalidate2DBuilding(buildings.back());
+    }
+    
+    if (!applySimEdit(edit, cityGen, crowd)) return false;
+    recorder.recordEdit(edit);
+    
+    if (edit.type == SimEditType::MOVE_BUILDING) invalidate2DBuilding(buildings[edit.buildingIndex]);
+    if (edit.type == SimEditType::ADD_BUILDING) invalidate2DBuilding(edit.building);
+    if (edit.type == SimEditType::SET_ROAD_PATTERN) invalidate2DAll();
+    return true;
+}
+
+void toggleRecording() {
+    if (recorder.getMode() == SimRecorder::Mode::RECORDING) {
+        recorder.stopRecording();
+        return;
+    }
+    recorder.stopReplay();
+    
+    // A recording must be reproducible from its setup alone, so start over
+    // from a fresh city with a new seed
+    SimSetup setup = makeSimSetup(static_cast<uint64_t>(std::time(nullptr)));
+    generateCityFromSetup(setup);
+    recorder.startRecording(setup, cityGen, crowd, true);
+}
+
+void toggleReplay() {
+    if (recorder.getMode() == SimRecorder::Mode::REPLAYING) {
+        recorder.stopReplay();
+        return;
+    }
+    recorder.startReplay(cityGen, crowd);
+}
+
+
+// 2D SCENE (cached raster layer)
+
+// Lists everything the static 2D layer shows. Selection and previews are
+// overlays, so building outlines here always use the normal colour.
+void rebuild2DScene() {
+    renderer2D->clearElements();
+    
+    // Draw roads using Bresenham's Line Algorithm
+    for (const auto& road : cityGen.getRoads()) {
+        Line2D line(road.start, road.end, glm::vec3(0.3f, 0.3f, 0.3f));
+        renderer2D->addLine(line);
+    }
+    
+    // Draw parks using Midpoint Circle Algorithm (scanline disc underneath
+    // in the filled view)
+    for (const auto& park : cityGen.getParks()) {
+        glm::vec3 parkColor = glm::vec3(0.0f, 0.8f, 0.2f); // Green
+        if (filledPlan2D) renderer2D->addCircle(Circle2D(park.center, park.radius, parkColor * 0.4f, true));
+        Circle2D circle(park.center, park.radius, parkColor);
+        renderer2D->addCircle(circle);
+    }
+    
+    // Draw building outlines
+    glm::vec3 buildingColor(0.7f, 0.7f, 0.9f); // Gray-blue
+    for (const auto& building : cityGen.getBuildings()) {
+        int x1 = building.position.x;
+        int y1 = building.position.y;
+        int x2 = building.position.x + building.size.x;
+        int y2 = building.position.y + building.size.y;
+        
+        if (filledPlan2D) {
+            std::vector<Point2D> footprint = { Point2D(x1, y1), Point2D(x2, y1), Point2D(x2, y2), Point2D(x1, y2) };
+            renderer2D->addPolygon(Polygon2D(footprint, buildingColor * 0.45f));
+        }
+        renderer2D->addLine(Line2D(Point2D(x1, y1), Point2D(x2, y1), buildingColor));
+        renderer2D->addLine(Line2D(Point2D(x2, y1), Point2D(x2, y2), buildingColor));
+        renderer2D->addLine(Line2D(Point2D(x2, y2), Point2D(x1, y2), buildingColor));
+        renderer2D->addLine(Line2D(Point2D(x1, y2), Point2D(x1, y1), buildingColor));
+    }
+}
+
+void addOutlineOverlay(const Building& building, const glm::vec3& color) {
+    addRectOverlay(building.position, building.position + building.size, color);
+}
+
+void addRectOverlay(const glm::vec2& cornerA, const glm::vec2& cornerB, const glm::vec3& color) {
+    int x1 = std::min(cornerA.x, cornerB.x);
+    int y1 = std::min(cornerA.y, cornerB.y);
+    int x2 = std::max(cornerA.x, cornerB.x);
+    int y2 = std::max(cornerA.y, cornerB.y);
+    
+    renderer2D->addOverlayLine(Line2D(Point2D(x1, y1), Point2D(x2, y1), color));
+    renderer2D->addOverlayLine(Line2D(Point2D(x2, y1), Point2D(x2, y2), color));
+    renderer2D->addOverlayLine(Line2D(Point2D(x2, y2), Point2D(x1, y2), color));
+    renderer2D->addOverlayLine(Line2D(Point2D(x1, y2), Point2D(x1, y1), color));
+}
+
+void invalidate2DBuilding(const Building& building) {
+    scene2DChanged = true;
+    if (renderer2D) renderer2D->invalidateArea(building.position, building.position + building.size);
+}
+
+void invalidate2DAll() {
+    scene2DChanged = true;
+    if (renderer2D) renderer2D->invalidateAll();
+}
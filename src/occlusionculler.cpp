@@ -0,0 +1,554 @@
+#include "occlusionculler.h"
+#include "threadpool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#include <xmmintrin.h>
+#define OCCLUSION_USE_SSE 1
+#endif
+
+namespace {
+
+const int TILES_X = OcclusionCuller::WIDTH / OcclusionCuller::TILE_SIZE;
+const int TILES_Y = OcclusionCuller::HEIGHT / OcclusionCuller::TILE_SIZE;
+const int TILE_COUNT = TILES_X * TILES_Y;
+const int BANDS = OcclusionCuller::HEIGHT / OcclusionCuller::BAND_HEIGHT;
+
+// Tile ranges are kept for single tiles, then for 2 x 1, 1 x 2 and 2 x 2
+// groups starting at each tile
+const int TILE_GROUPS = 4;
+
+// Shifts for the tile of a pixel and the row of a tile, in the SSE box tests
+const int TILE_SHIFT = 3;
+const int TILES_X_SHIFT = 5;
+
+// Boxes are projected this many at a time before the open ones are finished
+const int BOX_BLOCK = 64;
+
+
+#ifdef OCCLUSION_USE_SSE
+// Low and high ends of one clip space row over four boxes, from their
+// centres and half extents; the row's matrix entries and their sizes are
+// broadcast in entry and spread
+inline void rowRange(const __m128* entry, const __m128* spread,
+                     __m128 centerX, __m128 centerY, __m128 centerZ,
+                     __m128 extentX, __m128 extentY, __m128 extentZ,
+                     __m128& low, __m128& high) {
+    __m128 middle = _mm_add_ps(_mm_add_ps(_mm_mul_ps(entry[0], centerX), _mm_mul_ps(entry[1], centerY)),
+                               _mm_add_ps(_mm_mul_ps(entry[2], centerZ), entry[3]));
+    __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(spread[0], extentX), _mm_mul_ps(spread[1], extentY)),
+                               _mm_mul_ps(spread[2], extentZ));
+    low = _mm_sub_ps(middle, radius);
+    high = _mm_add_ps(middle, radius);
+}
+#endif
+
+// Below this many boxes the tests stay on the calling thread
+const int PARALLEL_THRESHOLD = 2048;
+const int MIN_CHUNK_SIZE = 1024;
+
+glm::vec3 toScreen(const glm::vec4& clip) {
+    float inverseW = 1.0f / clip.w;
+    return glm::vec3((clip.x * inverseW * 0.5f + 0.5f) * OcclusionCuller::WIDTH,
+                     (clip.y * inverseW * 0.5f + 0.5f) * OcclusionCuller::HEIGHT,
+                     inverseW);
+}
+
+// Distance in front of the near plane (z = -w in clip space)
+float nearDistance(const glm::vec4& clip) {
+    return clip.z + clip.w;
+}
+
+// Positive when a, b, c turn counter-clockwise
+float cross(const glm::vec2& a, const glm::vec2& b, const glm::vec2& c) {
+    return (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+}
+
+}
+
+OcclusionCuller::OcclusionCuller()
+    : viewProjection(1.0f), eye(0.0f), bufferFarthestW(0.0f), depth(WIDTH * HEIGHT, 0.0f),
+      tiles(TILE_GROUPS * TILE_COUNT) {
+    begin(viewProjection, eye);
+}
+
+void OcclusionCuller::begin(const glm::mat4& matrix, const glm::vec3& eyePosition) {
+    viewProjection = matrix;
+    eye = eyePosition;
+    occluders.clear();
+    bufferFarthestW = std::numeric_limits<float>::max(); // Nothing is hidden until rasterize()
+    
+    // Rows x, y, near distance (z + w) and w of the matrix, by column
+    for (int i = 0; i < 4; ++i) {
+        columns[i] = glm::vec4(matrix[i].x, matrix[i].y, matrix[i].z + matrix[i].w, matrix[i].w);
+    }
+    for (int i = 0; i < 3; ++i) spreads[i] = glm::abs(columns[i]);
+}
+
+// Boxes reaching behind the near plane are skipped (the buffer only
+// holds what is certainly there)
+void OcclusionCuller::addOccluder(const BVHBox& box) {
+    const glm::vec3& l = box.min;
+    const glm::vec3& h = box.max;
+    glm::vec3 corners[8];
+    glm::vec2 points[8];
+    glm::vec3 screen[8];
+    for (int i = 0; i < 8; ++i) {
+        corners[i] = glm::vec3(i & 1 ? h.x : l.x, i & 2 ? h.y : l.y, i & 4 ? h.z : l.z);
+        glm::vec4 clip = viewProjection * glm::vec4(corners[i], 1.0f);
+        if (nearDistance(clip) <= 0.0f) return;
+        screen[i] = toScreen(clip);
+        points[i] = glm::vec2(screen[i]);
+    }
+    
+    ScreenOccluder occluder;
+    
+    // Silhouette: convex hull of the corners (monotone chain), counter-clockwise
+    std::sort(points, points + 8, [](const glm::vec2& p, const glm::vec2& q) {
+        return p.x < q.x || (p.x == q.x && p.y < q.y);
+    });
+    glm::vec2 hull[16];
+    int count = 0;
+    for (int pass = 0; pass < 2; ++pass) {
+        int start = count;
+        for (int k = 0; k < 8; ++k) {
+            const glm::vec2& p = points[pass == 0 ? k : 7 - k];
+            while (count >= start + 2 && cross(hull[count - 2], hull[count - 1], p) <= 0.0f) --count;
+            hull[count++] = p;
+        }
+        --count; // Each chain's last point starts the other
+    }
+    if (count < 3) return;
+    
+    // Inside when every edge function is positive at all four corners of
+    // the pixel: sampled at the centre, less half the pixel's extent
+    occluder.edgeCount = count;
+    for (int e = 0; e < count; ++e) {
+        const glm::vec2& from = hull[e];
+        const glm::vec2& to = hull[(e + 1) % count];
+        float a = -(to.y - from.y), b = to.x - from.x;
+        occluder.a[e] = a;
+        occluder.b[e] = b;
+        occluder.c[e] = -(a * from.x + b * from.y) - 0.5f * (std::fabs(a) + std::fabs(b));
+    }
+    
+    // Depth: a ray enters a box through the farthest of the eye-facing face
+    // planes, so the smallest of their 1/w is exact; each plane is lowered
+    // to its farthest point in the pixel
+    const int faces[6][3] = { {0, 2, 4}, {1, 3, 5}, {0, 1, 4}, {2, 3, 6}, {0, 1, 2}, {4, 5, 6} };
+    const bool facing[6] = { eye.x < l.x, eye.x > h.x, eye.y < l.y, eye.y > h.y, eye.z < l.z, eye.z > h.z };
+    occluder.planeCount = 0;
+    for (int f = 0; f < 6; ++f) {
+        if (!facing[f]) continue;
+        const glm::vec3& v0 = screen[faces[f][0]];
+        const glm::vec3& v1 = screen[faces[f][1]];
+        const glm::vec3& v2 = screen[faces[f][2]];
+        float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+        if (std::fabs(area) < 1e-3f) return; // Edge-on: its plane cannot be trusted
+        
+        float dzdx = ((v1.z - v0.z) * (v2.y - v0.y) - (v2.z - v0.z) * (v1.y - v0.y)) / area;
+        float dzdy = ((v2.z - v0.z) * (v1.x - v0.x) - (v1.z - v0.z) * (v2.x - v0.x)) / area;
+        int plane = occluder.planeCount++;
+        occluder.dzdx[plane] = dzdx;
+        occluder.dzdy[plane] = dzdy;
+        occluder.z0[plane] = v0.z - dzdx * v0.x - dzdy * v0.y - 0.5f * (std::fabs(dzdx) + std::fabs(dzdy));
+    }
+    if (occluder.planeCount == 0) return; // Eye inside the box
+    
+    float minX = hull[0].x, maxX = minX, minY = hull[0].y, maxY = minY;
+    for (int i = 1; i < count; ++i) {
+        minX = std::min(minX, hull[i].x);
+        maxX = std::max(maxX, hull[i].x);
+        minY = std::min(minY, hull[i].y);
+        maxY = std::max(maxY, hull[i].y);
+    }
+    if (maxX < 0.0f || maxY < 0.0f || minX >= WIDTH || minY >= HEIGHT) return;
+    occluder.x0 = static_cast<int>(std::max(minX, 0.0f)) & ~3;
+    occluder.x1 = static_cast<int>(std::min(maxX, WIDTH - 1.0f));
+    occluder.y0 = static_cast<int>(std::max(minY, 0.0f));
+    occluder.y1 = static_cast<int>(std::min(maxY, HEIGHT - 1.0f));
+    occluders.push_back(occluder);
+}
+
+void OcclusionCuller::rasterize() {
+    // Bands cover disjoint rows (and whole tile rows), so they need no locks
+    ThreadPool::shared().parallelFor(BANDS, [this](int begin, int end) {
+        for (int band = begin; band < end; ++band) rasterizeBand(band);
+    });
+    
+    // Groups of up to 2 x 2 tiles; where a neighbour would be off the
+    // buffer, no rect can reach it, so the tile stands in for it
+    float nearest = 0.0f;
+    for (int ty = 0; ty < TILES_Y; ++ty) {
+        for (int tx = 0; tx < TILES_X; ++tx) {
+            int tile = ty * TILES_X + tx;
+            int right = tx + 1 < TILES_X ? 1 : 0, down = ty + 1 < TILES_Y ? TILES_X : 0;
+            const TileRange* single = &tiles[0];
+            TileRange wide = { std::min(single[tile].farthest, single[tile + right].farthest),
+                               std::min(single[tile].nearest, single[tile + right].nearest) };
+            TileRange tall = { std::min(single[tile].farthest, single[tile + down].farthest),
+                               std::min(single[tile].nearest, single[tile + down].nearest) };
+            TileRange below = { std::min(single[tile + down].farthest, single[tile + down + right].farthest),
+                                std::min(single[tile + down].nearest, single[tile + down + right].nearest) };
+            tiles[TILE_COUNT + tile] = wide;
+            tiles[2 * TILE_COUNT + tile] = tall;
+            tiles[3 * TILE_COUNT + tile] = { std::min(wide.farthest, below.farthest), std::min(wide.nearest, below.nearest) };
+            nearest = std::max(nearest, single[tile].nearest);
+        }
+    }
+    bufferFarthestW = nearest > 0.0f ? 1.0f / nearest : std::numeric_limits<float>::max();
+}
+
+void OcclusionCuller::rasterizeBand(int band) {
+    int rowBegin = band * BAND_HEIGHT;
+    int rowEnd = rowBegin + BAND_HEIGHT;
+    std::fill(depth.begin() + rowBegin * WIDTH, depth.begin() + rowEnd * WIDTH, 0.0f);
+    
+    for (const auto& occluder : occluders) fillOccluder(occluder, rowBegin, rowEnd);
+    
+    for (int ty = rowBegin / TILE_SIZE; ty < rowEnd / TILE_SIZE; ++ty) {
+        for (int tx = 0; tx < TILES_X; ++tx) {
+            float farthest = depth[ty * TILE_SIZE * WIDTH + tx * TILE_SIZE], nearest = farthest;
+            for (int y = ty * TILE_SIZE; y < (ty + 1) * TILE_SIZE; ++y) {
+                const float* row = &depth[y * WIDTH + tx * TILE_SIZE];
+                for (int x = 0; x < TILE_SIZE; ++x) {
+                    farthest = std::min(farthest, row[x]);
+                    nearest = std::max(nearest, row[x]);
+                }
+            }
+            tiles[ty * TILES_X + tx] = { farthest, nearest };
+        }
+    }
+}
+
+// Pixels wholly inside the silhouette keep the nearest (largest) 1/w
+void OcclusionCuller::fillOccluder(const ScreenOccluder& occluder, int rowBegin, int rowEnd) {
+    int y0 = std::max(rowBegin, occluder.y0);
+    int y1 = std::min(rowEnd - 1, occluder.y1);
+    
+    for (int y = y0; y <= y1; ++y) {
+        float py = y + 0.5f;
+        float* row = &depth[y * WIDTH];
+        int x = occluder.x0;
+#ifdef OCCLUSION_USE_SSE
+        __m128 stepX = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+        __m128 zero = _mm_setzero_ps();
+        for (; x <= occluder.x1; x += 4) {
+            __m128 px = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), stepX);
+            __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            for (int e = 0; e < occluder.edgeCount; ++e) {
+                __m128 edge = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(occluder.a[e]), px),
+                                         _mm_set1_ps(occluder.b[e] * py + occluder.c[e]));
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(edge, zero));
+            }
+            if (_mm_movemask_ps(inside) == 0) continue;
+            
+            __m128 z = _mm_set1_ps(std::numeric_limits<float>::max());
+            for (int p = 0; p < occluder.planeCount; ++p) {
+                z = _mm_min_ps(z, _mm_add_ps(_mm_mul_ps(_mm_set1_ps(occluder.dzdx[p]), px),
+                                             _mm_set1_ps(occluder.dzdy[p] * py + occluder.z0[p])));
+            }
+            __m128 old = _mm_loadu_ps(&row[x]);
+            __m128 nearest = _mm_max_ps(old, z);
+            _mm_storeu_ps(&row[x], _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, old)));
+        }
+#endif
+        for (; x <= occluder.x1; ++x) {
+            float px = x + 0.5f;
+            bool inside = true;
+            for (int e = 0; e < occluder.edgeCount && inside; ++e) {
+                inside = occluder.a[e] * px + occluder.b[e] * py + occluder.c[e] >= 0.0f;
+            }
+            if (!inside) continue;
+            
+            float z = std::numeric_limits<float>::max();
+            for (int p = 0; p < occluder.planeCount; ++p) {
+                z = std::min(z, occluder.dzdx[p] * px + occluder.dzdy[p] * py + occluder.z0[p]);
+            }
+            row[x] = std::max(row[x], z);
+        }
+    }
+}
+
+bool OcclusionCuller::isOccluded(const BVHBox& box) const {
+    ScreenRect rect;
+    return projectBox(box, rect) && isRectOccluded(rect);
+}
+
+// x, y, near distance and w are affine over the box, so each ranges over
+// its value at the centre plus or minus the half extents times the matrix
+// entries' sizes; x/w and y/w are then bounded by the ends of those ranges,
+// which is at most slightly looser than projecting the corners. Boxes
+// reaching the near plane, in front of the whole buffer or off screen are
+// visible without a look at the tiles. testBoxRange does the same sums in
+// the same order, so the two always agree.
+bool OcclusionCuller::projectBox(const BVHBox& box, ScreenRect& rect) const {
+#ifdef OCCLUSION_USE_SSE
+    __m128 zero = _mm_setzero_ps(), half = _mm_set1_ps(0.5f);
+    __m128 center = _mm_mul_ps(_mm_add_ps(_mm_setr_ps(box.min.x, box.min.y, box.min.z, 0.0f),
+                                          _mm_setr_ps(box.max.x, box.max.y, box.max.z, 0.0f)), half);
+    __m128 extent = _mm_mul_ps(_mm_sub_ps(_mm_setr_ps(box.max.x, box.max.y, box.max.z, 0.0f),
+                                          _mm_setr_ps(box.min.x, box.min.y, box.min.z, 0.0f)), half);
+    __m128 middle = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&columns[0].x), _mm_shuffle_ps(center, center, _MM_SHUFFLE(0, 0, 0, 0))),
+                                          _mm_mul_ps(_mm_loadu_ps(&columns[1].x), _mm_shuffle_ps(center, center, _MM_SHUFFLE(1, 1, 1, 1)))),
+                               _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&columns[2].x), _mm_shuffle_ps(center, center, _MM_SHUFFLE(2, 2, 2, 2))),
+                                          _mm_loadu_ps(&columns[3].x)));
+    __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&spreads[0].x), _mm_shuffle_ps(extent, extent, _MM_SHUFFLE(0, 0, 0, 0))),
+                                          _mm_mul_ps(_mm_loadu_ps(&spreads[1].x), _mm_shuffle_ps(extent, extent, _MM_SHUFFLE(1, 1, 1, 1)))),
+                               _mm_mul_ps(_mm_loadu_ps(&spreads[2].x), _mm_shuffle_ps(extent, extent, _MM_SHUFFLE(2, 2, 2, 2))));
+    __m128 low = _mm_sub_ps(middle, radius), high = _mm_add_ps(middle, radius);
+    
+    // x and y ends (low x, low y, high x, high y) over both ends of w: the
+    // smaller quotient bounds the low ends, the larger the high ones
+    __m128 ends = _mm_movelh_ps(low, high);
+    __m128 inverseLow = _mm_div_ps(_mm_set1_ps(1.0f), _mm_shuffle_ps(low, low, _MM_SHUFFLE(3, 3, 3, 3)));
+    __m128 inverseHigh = _mm_div_ps(_mm_set1_ps(1.0f), _mm_shuffle_ps(high, high, _MM_SHUFFLE(3, 3, 3, 3)));
+    __m128 overLow = _mm_mul_ps(ends, inverseLow), overHigh = _mm_mul_ps(ends, inverseHigh);
+    __m128 bounds = _mm_shuffle_ps(_mm_min_ps(overLow, overHigh), _mm_max_ps(overLow, overHigh), _MM_SHUFFLE(3, 2, 1, 0));
+    __m128 scale = _mm_setr_ps(0.5f * WIDTH, 0.5f * HEIGHT, 0.5f * WIDTH, 0.5f * HEIGHT);
+    __m128 pixels = _mm_add_ps(_mm_mul_ps(bounds, scale), scale);
+    
+    // Every early out in one mask: near distance, w against the buffer's
+    // farthest, then each rect side against its screen edge
+    __m128 flags = _mm_or_ps(_mm_cmple_ps(_mm_shuffle_ps(low, low, _MM_SHUFFLE(3, 3, 3, 2)), _mm_setr_ps(0.0f, bufferFarthestW, 0.0f, 0.0f)),
+                             _mm_or_ps(_mm_cmpge_ps(pixels, _mm_setr_ps(WIDTH, HEIGHT, 1e30f, 1e30f)),
+                                       _mm_cmplt_ps(pixels, _mm_setr_ps(-1e30f, -1e30f, 0.0f, 0.0f))));
+    if (_mm_movemask_ps(flags)) return false;
+    
+    // Clamped first, so truncation is floor and nothing can overflow
+    pixels = _mm_min_ps(_mm_max_ps(pixels, zero), _mm_setr_ps(WIDTH - 1.0f, HEIGHT - 1.0f, WIDTH - 1.0f, HEIGHT - 1.0f));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&rect.x0), _mm_cvttps_epi32(pixels));
+    rect.nearW = _mm_cvtss_f32(_mm_shuffle_ps(low, low, _MM_SHUFFLE(3, 3, 3, 3)));
+#else
+    glm::vec3 center = (box.min + box.max) * 0.5f, extent = (box.max - box.min) * 0.5f;
+    glm::vec4 middle = (columns[0] * center.x + columns[1] * center.y) + (columns[2] * center.z + columns[3]);
+    glm::vec4 radius = (spreads[0] * extent.x + spreads[1] * extent.y) + spreads[2] * extent.z;
+    glm::vec4 low = middle - radius, high = middle + radius;
+    if (low.z <= 0.0f || low.w <= bufferFarthestW) return false;
+    
+    float inverseLow = 1.0f / low.w, inverseHigh = 1.0f / high.w;
+    float minX = std::min(low.x * inverseLow, low.x * inverseHigh) * (0.5f * WIDTH) + 0.5f * WIDTH;
+    float minY = std::min(low.y * inverseLow, low.y * inverseHigh) * (0.5f * HEIGHT) + 0.5f * HEIGHT;
+    float maxX = std::max(high.x * inverseLow, high.x * inverseHigh) * (0.5f * WIDTH) + 0.5f * WIDTH;
+    float maxY = std::max(high.y * inverseLow, high.y * inverseHigh) * (0.5f * HEIGHT) + 0.5f * HEIGHT;
+    if (maxX < 0.0f || maxY < 0.0f || minX >= WIDTH || minY >= HEIGHT) return false;
+    
+    rect.x0 = static_cast<int>(std::max(minX, 0.0f));
+    rect.y0 = static_cast<int>(std::max(minY, 0.0f));
+    rect.x1 = static_cast<int>(std::min(maxX, WIDTH - 1.0f));
+    rect.y1 = static_cast<int>(std::min(maxY, HEIGHT - 1.0f));
+    rect.nearW = low.w;
+#endif
+    return true;
+}
+
+// Depths are compared as 1/w * nearW against 1, which saves a division
+bool OcclusionCuller::isRectOccluded(const ScreenRect& rect) const {
+    int tx0 = rect.x0 / TILE_SIZE, ty0 = rect.y0 / TILE_SIZE;
+    int tx1 = rect.x1 / TILE_SIZE, ty1 = rect.y1 / TILE_SIZE;
+    
+    // Up to 2 x 2 tiles, as for most boxes: the group's range decides it
+    // unless one of its tiles is partly covered
+    if (tx1 - tx0 <= 1 && ty1 - ty0 <= 1) {
+        const TileRange& group = tiles[(tx1 - tx0 + 2 * (ty1 - ty0)) * TILE_COUNT + ty0 * TILES_X + tx0];
+        bool hidden = group.farthest * rect.nearW > 1.0f;
+        if (hidden | (group.nearest * rect.nearW <= 1.0f)) return hidden;
+#ifdef OCCLUSION_USE_SSE
+        if (rect.x1 - rect.x0 < 8 && rect.y1 - rect.y0 < 8) {
+            int x = std::min(rect.x0, WIDTH - 8);
+            return farthestPixel(x, rect.x0 - x, rect.x1 - x, rect.y0, rect.y1) * rect.nearW > 1.0f;
+        }
+#endif
+    }
+    
+    for (int ty = ty0; ty <= ty1; ++ty) {
+        for (int tx = tx0; tx <= tx1; ++tx) {
+            int tile = ty * TILES_X + tx;
+            if (tiles[tile].farthest * rect.nearW > 1.0f) continue;     // Every occluder pixel in front
+            if (tiles[tile].nearest * rect.nearW <= 1.0f) return false; // None in front
+            
+            int rowBegin = std::max(rect.y0, ty * TILE_SIZE), rowEnd = std::min(rect.y1, (ty + 1) * TILE_SIZE - 1);
+            int columnBegin = std::max(rect.x0, tx * TILE_SIZE), columnEnd = std::min(rect.x1, (tx + 1) * TILE_SIZE - 1);
+#ifdef OCCLUSION_USE_SSE
+            int x = tx * TILE_SIZE;
+            if (farthestPixel(x, columnBegin - x, columnEnd - x, rowBegin, rowEnd) * rect.nearW <= 1.0f) return false;
+#else
+            for (int y = rowBegin; y <= rowEnd; ++y) {
+                const float* row = &depth[y * WIDTH];
+                for (int x = columnBegin; x <= columnEnd; ++x) {
+                    if (row[x] * rect.nearW <= 1.0f) return false;
+                }
+            }
+#endif
+        }
+    }
+    return true;
+}
+
+#ifdef OCCLUSION_USE_SSE
+// Smallest 1/w in columns x + first to x + last (at most eight from x) of
+// rows y0 to y1 (at most eight); a fixed eight rows are read, the last one
+// repeated, so there is no loop to mispredict
+float OcclusionCuller::farthestPixel(int x, int first, int last, int y0, int y1) const {
+    __m128 farthestLeft = _mm_loadu_ps(&depth[y0 * WIDTH + x]), farthestRight = _mm_loadu_ps(&depth[y0 * WIDTH + x + 4]);
+    for (int k = 1; k < 8; ++k) {
+        const float* row = &depth[std::min(y0 + k, y1) * WIDTH + x];
+        farthestLeft = _mm_min_ps(farthestLeft, _mm_loadu_ps(row));
+        farthestRight = _mm_min_ps(farthestRight, _mm_loadu_ps(row + 4));
+    }
+    
+    __m128i before = _mm_set1_epi32(first - 1), after = _mm_set1_epi32(last + 1);
+    __m128i left = _mm_setr_epi32(0, 1, 2, 3), right = _mm_setr_epi32(4, 5, 6, 7);
+    __m128 keepLeft = _mm_castsi128_ps(_mm_and_si128(_mm_cmpgt_epi32(left, before), _mm_cmplt_epi32(left, after)));
+    __m128 keepRight = _mm_castsi128_ps(_mm_and_si128(_mm_cmpgt_epi32(right, before), _mm_cmplt_epi32(right, after)));
+    __m128 none = _mm_set1_ps(std::numeric_limits<float>::max());
+    __m128 farthest = _mm_min_ps(_mm_or_ps(_mm_and_ps(keepLeft, farthestLeft), _mm_andnot_ps(keepLeft, none)),
+                                 _mm_or_ps(_mm_and_ps(keepRight, farthestRight), _mm_andnot_ps(keepRight, none)));
+    farthest = _mm_min_ps(farthest, _mm_movehl_ps(farthest, farthest));
+    farthest = _mm_min_ss(farthest, _mm_shuffle_ps(farthest, farthest, _MM_SHUFFLE(1, 1, 1, 1)));
+    return _mm_cvtss_f32(farthest);
+}
+#endif
+
+// Four boxes at a time, one per lane, through projectBox's sums and the
+// tile group test of isRectOccluded. The boxes that test leaves open are
+// gathered and finished a block later, so that their hard to predict
+// branches do not hold up the projection.
+void OcclusionCuller::testBoxRange(const BVHBox* boxes, int count, uint8_t* occluded) const {
+    int i = 0;
+#ifdef OCCLUSION_USE_SSE
+    static_assert(sizeof(BVHBox) == 6 * sizeof(float), "boxes are loaded as packed floats");
+    static_assert(TILE_SIZE == 1 << TILE_SHIFT && TILES_X == 1 << TILES_X_SHIFT, "tiles are found by shifts");
+    
+    // Per output row (x, y, near distance, w): the matrix entries and their sizes
+    __m128 entry[4][4], spread[4][3];
+    for (int r = 0; r < 4; ++r) {
+        for (int c = 0; c < 4; ++c) entry[r][c] = _mm_set1_ps(columns[c][r]);
+        for (int c = 0; c < 3; ++c) spread[r][c] = _mm_set1_ps(spreads[c][r]);
+    }
+    __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f), half = _mm_set1_ps(0.5f);
+    __m128 halfWidth = _mm_set1_ps(0.5f * WIDTH), halfHeight = _mm_set1_ps(0.5f * HEIGHT);
+    __m128 lastColumn = _mm_set1_ps(WIDTH - 1.0f), lastRow = _mm_set1_ps(HEIGHT - 1.0f);
+    __m128 farthestW = _mm_set1_ps(bufferFarthestW);
+    
+    // Rects by component, four boxes to a register's worth
+    alignas(16) int x0s[BOX_BLOCK], y0s[BOX_BLOCK], x1s[BOX_BLOCK], y1s[BOX_BLOCK];
+    alignas(16) float nearWs[BOX_BLOCK];
+    int open[BOX_BLOCK];
+    for (; i + BOX_BLOCK <= count; i += BOX_BLOCK) {
+        int openCount = 0;
+        for (int quad = 0; quad < BOX_BLOCK; quad += 4) {
+            // Four packed boxes to one register per coordinate, a box per lane
+            const float* packed = &boxes[i + quad].min.x;
+            __m128 first0 = _mm_shuffle_ps(_mm_loadu_ps(packed), _mm_loadu_ps(packed + 4), _MM_SHUFFLE(3, 2, 1, 0));
+            __m128 first1 = _mm_shuffle_ps(_mm_loadu_ps(packed), _mm_loadu_ps(packed + 8), _MM_SHUFFLE(1, 0, 3, 2));
+            __m128 first2 = _mm_shuffle_ps(_mm_loadu_ps(packed + 4), _mm_loadu_ps(packed + 8), _MM_SHUFFLE(3, 2, 1, 0));
+            __m128 second0 = _mm_shuffle_ps(_mm_loadu_ps(packed + 12), _mm_loadu_ps(packed + 16), _MM_SHUFFLE(3, 2, 1, 0));
+            __m128 second1 = _mm_shuffle_ps(_mm_loadu_ps(packed + 12), _mm_loadu_ps(packed + 20), _MM_SHUFFLE(1, 0, 3, 2));
+            __m128 second2 = _mm_shuffle_ps(_mm_loadu_ps(packed + 16), _mm_loadu_ps(packed + 20), _MM_SHUFFLE(3, 2, 1, 0));
+            __m128 minX = _mm_shuffle_ps(first0, second0, _MM_SHUFFLE(2, 0, 2, 0));
+            __m128 minY = _mm_shuffle_ps(first0, second0, _MM_SHUFFLE(3, 1, 3, 1));
+            __m128 minZ = _mm_shuffle_ps(first1, second1, _MM_SHUFFLE(2, 0, 2, 0));
+            __m128 maxX = _mm_shuffle_ps(first1, second1, _MM_SHUFFLE(3, 1, 3, 1));
+            __m128 maxY = _mm_shuffle_ps(first2, second2, _MM_SHUFFLE(2, 0, 2, 0));
+            __m128 maxZ = _mm_shuffle_ps(first2, second2, _MM_SHUFFLE(3, 1, 3, 1));
+            __m128 centerX = _mm_mul_ps(_mm_add_ps(minX, maxX), half), extentX = _mm_mul_ps(_mm_sub_ps(maxX, minX), half);
+            __m128 centerY = _mm_mul_ps(_mm_add_ps(minY, maxY), half), extentY = _mm_mul_ps(_mm_sub_ps(maxY, minY), half);
+            __m128 centerZ = _mm_mul_ps(_mm_add_ps(minZ, maxZ), half), extentZ = _mm_mul_ps(_mm_sub_ps(maxZ, minZ), half);
+            
+            __m128 low[4], high[4];
+            rowRange(entry[0], spread[0], centerX, centerY, centerZ, extentX, extentY, extentZ, low[0], high[0]);
+            rowRange(entry[1], spread[1], centerX, centerY, centerZ, extentX, extentY, extentZ, low[1], high[1]);
+            rowRange(entry[2], spread[2], centerX, centerY, centerZ, extentX, extentY, extentZ, low[2], high[2]);
+            rowRange(entry[3], spread[3], centerX, centerY, centerZ, extentX, extentY, extentZ, low[3], high[3]);
+            
+            __m128 inverseLow = _mm_div_ps(one, low[3]), inverseHigh = _mm_div_ps(one, high[3]);
+            __m128 left = _mm_min_ps(_mm_mul_ps(low[0], inverseLow), _mm_mul_ps(low[0], inverseHigh));
+            __m128 bottom = _mm_min_ps(_mm_mul_ps(low[1], inverseLow), _mm_mul_ps(low[1], inverseHigh));
+            __m128 right = _mm_max_ps(_mm_mul_ps(high[0], inverseLow), _mm_mul_ps(high[0], inverseHigh));
+            __m128 top = _mm_max_ps(_mm_mul_ps(high[1], inverseLow), _mm_mul_ps(high[1], inverseHigh));
+            left = _mm_add_ps(_mm_mul_ps(left, halfWidth), halfWidth);
+            right = _mm_add_ps(_mm_mul_ps(right, halfWidth), halfWidth);
+            bottom = _mm_add_ps(_mm_mul_ps(bottom, halfHeight), halfHeight);
+            top = _mm_add_ps(_mm_mul_ps(top, halfHeight), halfHeight);
+            __m128 visible = _mm_or_ps(_mm_or_ps(_mm_cmple_ps(low[2], zero), _mm_cmple_ps(low[3], farthestW)),
+                                       _mm_or_ps(_mm_or_ps(_mm_cmpge_ps(left, _mm_set1_ps(static_cast<float>(WIDTH))),
+                                                           _mm_cmpge_ps(bottom, _mm_set1_ps(static_cast<float>(HEIGHT)))),
+                                                 _mm_or_ps(_mm_cmplt_ps(right, zero), _mm_cmplt_ps(top, zero))));
+            
+            __m128i x0 = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(left, zero), lastColumn));
+            __m128i y0 = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(bottom, zero), lastRow));
+            __m128i x1 = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(right, zero), lastColumn));
+            __m128i y1 = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(top, zero), lastRow));
+            _mm_store_si128(reinterpret_cast<__m128i*>(&x0s[quad]), x0);
+            _mm_store_si128(reinterpret_cast<__m128i*>(&y0s[quad]), y0);
+            _mm_store_si128(reinterpret_cast<__m128i*>(&x1s[quad]), x1);
+            _mm_store_si128(reinterpret_cast<__m128i*>(&y1s[quad]), y1);
+            _mm_store_ps(&nearWs[quad], low[3]);
+            
+            // The group of up to 2 x 2 tiles under each rect
+            __m128i tileX = _mm_srai_epi32(x0, TILE_SHIFT), tileY = _mm_srai_epi32(y0, TILE_SHIFT);
+            __m128i spanX = _mm_sub_epi32(_mm_srai_epi32(x1, TILE_SHIFT), tileX);
+            __m128i spanY = _mm_sub_epi32(_mm_srai_epi32(y1, TILE_SHIFT), tileY);
+            __m128i small = _mm_and_si128(_mm_cmplt_epi32(spanX, _mm_set1_epi32(2)), _mm_cmplt_epi32(spanY, _mm_set1_epi32(2)));
+            __m128i level = _mm_add_epi32(_mm_and_si128(_mm_cmpeq_epi32(spanX, _mm_set1_epi32(1)), _mm_set1_epi32(TILE_COUNT)),
+                                          _mm_and_si128(_mm_cmpeq_epi32(spanY, _mm_set1_epi32(1)), _mm_set1_epi32(2 * TILE_COUNT)));
+            __m128i group = _mm_add_epi32(level, _mm_add_epi32(_mm_slli_epi32(tileY, TILES_X_SHIFT), tileX));
+            alignas(16) int groups[4];
+            _mm_store_si128(reinterpret_cast<__m128i*>(groups), _mm_and_si128(group, small));
+            __m128 ranges01 = _mm_unpacklo_ps(_mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double*>(&tiles[groups[0]]))),
+                                              _mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double*>(&tiles[groups[1]]))));
+            __m128 ranges23 = _mm_unpacklo_ps(_mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double*>(&tiles[groups[2]]))),
+                                              _mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double*>(&tiles[groups[3]]))));
+            __m128 hidden = _mm_cmpgt_ps(_mm_mul_ps(_mm_movelh_ps(ranges01, ranges23), low[3]), one);
+            __m128 uncovered = _mm_cmple_ps(_mm_mul_ps(_mm_movehl_ps(ranges23, ranges01), low[3]), one);
+            __m128 decided = _mm_or_ps(visible, _mm_and_ps(_mm_castsi128_ps(small), _mm_or_ps(hidden, uncovered)));
+            int hiddenLanes = _mm_movemask_ps(_mm_andnot_ps(visible, _mm_and_ps(_mm_castsi128_ps(small), hidden)));
+            int openLanes = _mm_movemask_ps(decided) ^ 0xF;
+            
+            // One byte per box (x86 is little endian); open boxes are listed
+            // by writing every index and counting only theirs
+            uint32_t bytes = (hiddenLanes & 1) | (hiddenLanes & 2) << 7 | (hiddenLanes & 4) << 14 | (hiddenLanes & 8) << 21;
+            std::memcpy(&occluded[i + quad], &bytes, sizeof(bytes));
+            open[openCount] = quad;
+            openCount += openLanes & 1;
+            open[openCount] = quad + 1;
+            openCount += (openLanes >> 1) & 1;
+            open[openCount] = quad + 2;
+            openCount += (openLanes >> 2) & 1;
+            open[openCount] = quad + 3;
+            openCount += openLanes >> 3;
+        }
+        
+        for (int k = 0; k < openCount; ++k) {
+            int index = open[k];
+            ScreenRect rect = { x0s[index], y0s[index], x1s[index], y1s[index], nearWs[index] };
+            occluded[i + index] = isRectOccluded(rect) ? 1 : 0;
+        }
+    }
+#endif
+    for (; i < count; ++i) occluded[i] = isOccluded(boxes[i]) ? 1 : 0;
+}
+
+void OcclusionCuller::testBoxes(const std::vector<BVHBox>& boxes, std::vector<uint8_t>& occluded) const {
+    int count = static_cast<int>(boxes.size());
+    occluded.resize(count);
+    
+    if (count < PARALLEL_THRESHOLD) {
+        testBoxRange(boxes.data(), count, occluded.data());
+        return;
+    }
+    
+    int numChunks = std::max(1, std::min(static_cast<int>(ThreadPool::shared().size()) + 1, count / MIN_CHUNK_SIZE));
+    int chunkSize = (count + numChunks - 1) / numChunks;
+    ThreadPool::shared().parallelFor(numChunks, [&](int firstChunk, int lastChunk) {
+        for (int chunk = firstChunk; chunk < lastChunk; ++chunk) {
+            int begin = chunk * chunkSize;
+            testBoxRange(boxes.data() + begin, std::min(count, begin + chunkSize) - begin, occluded.data() + begin);
+        }
+    });
+}
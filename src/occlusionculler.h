@@ -0,0 +1,84 @@
+#ifndef OCCLUSIONCULLER_H
+#define OCCLUSIONCULLER_H
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+#include "bvh.h"
+
+// Software occlusion culling. A few large nearby boxes (buildings) are
+// rasterised as occluders into a small depth buffer holding 1/w of the
+// nearest occluder per pixel (0 = nothing). Each 8 x 8 tile also keeps the
+// farthest and nearest of its pixels, so a box is usually decided by a
+// handful of tile reads; only tiles in between are checked pixel by pixel.
+// The buffer errs towards empty: an occluder only marks the pixels its
+// silhouette covers entirely, at the farthest depth it has in them, while a
+// tested box counts every pixel it touches. Silhouettes are filled four
+// pixels at a time with SSE, and both the rasterisation (in horizontal
+// bands) and the box tests run on the shared thread pool.
+class OcclusionCuller {
+public:
+    static const int WIDTH = 256;
+    static const int HEIGHT = 128;
+    static const int TILE_SIZE = 8;
+    static const int BAND_HEIGHT = 16;
+    
+    OcclusionCuller();
+    
+    // Starts a frame: drops the occluders of the last one
+    void begin(const glm::mat4& viewProjection, const glm::vec3& eye);
+    // Queues the box's silhouette; boxes reaching the near plane are skipped
+    void addOccluder(const BVHBox& box);
+    // Clears and fills the depth buffer and its tile level
+    void rasterize();
+    
+    // True if the box lies wholly behind the occluders
+    bool isOccluded(const BVHBox& box) const;
+    // occluded[i] = isOccluded(boxes[i]), on the calling thread
+    void testBoxRange(const BVHBox* boxes, int count, uint8_t* occluded) const;
+    // The same, in parallel for large batches
+    void testBoxes(const std::vector<BVHBox>& boxes, std::vector<uint8_t>& occluded) const;
+    
+    int getOccluderCount() const { return static_cast<int>(occluders.size()); }
+    
+private:
+    // A box in pixel space: a convex polygon, inside where every edge
+    // function is positive, and the 1/w planes of its faces towards the eye
+    struct ScreenOccluder {
+        float a[8], b[8], c[8];             // Edge functions a x + b y + c
+        float dzdx[3], dzdy[3], z0[3];      // 1/w = dzdx x + dzdy y + z0
+        int edgeCount;
+        int planeCount;
+        int x0, x1, y0, y1;                 // Pixel bounds, x0 a multiple of 4
+    };
+    
+    // Smallest 1/w (farthest pixel) and largest (nearest) of a tile; for a
+    // group of tiles, the smallest of each, so nearest is the most open tile's
+    struct TileRange {
+        float farthest, nearest;
+    };
+    
+    // Pixels a box may touch, and the smallest w it reaches
+    struct ScreenRect {
+        int x0, y0, x1, y1;
+        float nearW;
+    };
+    
+    glm::mat4 viewProjection;
+    glm::vec3 eye;
+    glm::vec4 columns[4];           // Per matrix column: x, y, z + w, w rows
+    glm::vec4 spreads[3];           // Their sizes, which scale half extents to ranges
+    float bufferFarthestW;          // Boxes reaching nearer are in front of every pixel
+    std::vector<ScreenOccluder> occluders;
+    std::vector<float> depth;       // WIDTH x HEIGHT
+    std::vector<TileRange> tiles;   // Single tiles, then 2 x 1, 1 x 2 and 2 x 2 groups
+    
+    void rasterizeBand(int band);
+    void fillOccluder(const ScreenOccluder& occluder, int rowBegin, int rowEnd);
+    // False when the box is visible whatever the buffer holds
+    bool projectBox(const BVHBox& box, ScreenRect& rect) const;
+    bool isRectOccluded(const ScreenRect& rect) const;
+    float farthestPixel(int x, int first, int last, int y0, int y1) const;
+};
+
+#endif
@@ -0,0 +1,185 @@
+#include "pngwriter.h"
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace {
+
+// Deflate writes bits LSB first
+class BitWriter {
+public:
+    explicit BitWriter(std::vector<uint8_t>& out) : out(out), buffer(0), count(0) {}
+    
+    void write(uint32_t bits, int length) {
+        buffer |= static_cast<uint64_t>(bits) << count;
+        count += length;
+        while (count >= 8) {
+            out.push_back(static_cast<uint8_t>(buffer));
+            buffer >>= 8;
+            count -= 8;
+        }
+    }
+    
+    // Huffman codes are defined MSB first
+    void writeCode(uint32_t code, int length) {
+        uint32_t reversed = 0;
+        for (int i = 0; i < length; ++i) reversed |= ((code >> i) & 1u) << (length - 1 - i);
+        write(reversed, length);
+    }
+    
+    void flush() {
+        if (count > 0) out.push_back(static_cast<uint8_t>(buffer));
+        buffer = 0;
+        count = 0;
+    }
+    
+private:
+    std::vector<uint8_t>& out;
+    uint64_t buffer;
+    int count;
+};
+
+const int LENGTH_BASE[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                              35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+const int LENGTH_EXTRA[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                               3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+const int MATCH_DISTANCE = 4;       // One RGBA pixel back
+const int MAX_MATCH = 258;
+
+// Fixed literal/length code (RFC 1951, 3.2.6)
+void writeSymbol(BitWriter& bits, int symbol) {
+    if (symbol < 144) bits.writeCode(0x30 + symbol, 8);
+    else if (symbol < 256) bits.writeCode(0x190 + (symbol - 144), 9);
+    else if (symbol < 280) bits.writeCode(symbol - 256, 7);
+    else bits.writeCode(0xC0 + (symbol - 280), 8);
+}
+
+void writeMatch(BitWriter& bits, int length) {
+    int code = 28;
+    while (LENGTH_BASE[code] > length) --code;
+    writeSymbol(bits, 257 + code);
+    bits.write(length - LENGTH_BASE[code], LENGTH_EXTRA[code]);
+    bits.writeCode(MATCH_DISTANCE - 1, 5); // Distance codes 0-3 are distances 1-4, no extra bits
+}
+
+std::vector<uint8_t> deflateRuns(const std::vector<uint8_t>& data) {
+    std::vector<uint8_t> out;
+    BitWriter bits(out);
+    bits.write(1, 1); // BFINAL
+    bits.write(1, 2); // BTYPE = fixed Huffman
+    
+    size_t i = 0;
+    while (i < data.size()) {
+        size_t length = 0;
+        if (i >= MATCH_DISTANCE) {
+            while (length < MAX_MATCH && i + length < data.size() &&
+                   data[i + length] == data[i + length - MATCH_DISTANCE]) {
+                ++length;
+            }
+        }
+        if (length >= 3) {
+            writeMatch(bits, static_cast<int>(length));
+            i += length;
+        } else {
+            writeSymbol(bits, data[i]);
+            ++i;
+        }
+    }
+    writeSymbol(bits, 256); // End of block
+    bits.flush();
+    return out;
+}
+
+std::vector<uint32_t> makeCrcTable() {
+    std::vector<uint32_t> table(256);
+    for (uint32_t n = 0; n < 256; ++n) {
+        uint32_t c = n;
+        for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        table[n] = c;
+    }
+    return table;
+}
+
+uint32_t crc32(const uint8_t* data, size_t size) {
+    static const std::vector<uint32_t> table = makeCrcTable();
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < size; ++i) crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+uint32_t adler32(const std::vector<uint8_t>& data) {
+    uint32_t a = 1, b = 0;
+    for (uint8_t byte : data) {
+        a = (a + byte) % 65521;
+        b = (b + a) % 65521;
+    }
+    return (b << 16) | a;
+}
+
+void appendBigEndian(std::vector<uint8_t>& out, uint32_t value) {
+    out.push_back(static_cast<uint8_t>(value >> 24));
+    out.push_back(static_cast<uint8_t>(value >> 16));
+    out.push_back(static_cast<uint8_t>(value >> 8));
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+void writeChunk(std::ofstream& file, const char* type, const std::vector<uint8_t>& payload) {
+    std::vector<uint8_t> chunk;
+    appendBigEndian(chunk, static_cast<uint32_t>(payload.size()));
+    chunk.insert(chunk.end(), type, type + 4);
+    chunk.insert(chunk.end(), payload.begin(), payload.end());
+    appendBigEndian(chunk, crc32(chunk.data() + 4, chunk.size() - 4));
+    file.write(reinterpret_cast<const char*>(chunk.data()), chunk.size());
+}
+
+}
+
+bool writePNG(const std::string& path, int width, int height, const std::vector<uint32_t>& pixels) {
+    if (width <= 0 || height <= 0 || pixels.size() < static_cast<size_t>(width) * height) return false;
+    
+    // Scanlines with filter type 0 (none)
+    std::vector<uint8_t> raw;
+    raw.reserve(static_cast<size_t>(width * 4 + 1) * height);
+    for (int y = 0; y < height; ++y) {
+        raw.push_back(0);
+        for (int x = 0; x < width; ++x) {
+            uint32_t p = pixels[static_cast<size_t>(y) * width + x];
+            raw.push_back(static_cast<uint8_t>(p));
+            raw.push_back(static_cast<uint8_t>(p >> 8));
+            raw.push_back(static_cast<uint8_t>(p >> 16));
+            raw.push_back(static_cast<uint8_t>(p >> 24));
+        }
+    }
+    
+    // zlib stream: header, deflate data, Adler-32
+    std::vector<uint8_t> compressed = { 0x78, 0x01 };
+    std::vector<uint8_t> deflated = deflateRuns(raw);
+    compressed.insert(compressed.end(), deflated.begin(), deflated.end());
+    appendBigEndian(compressed, adler32(raw));
+    
+    std::vector<uint8_t> header;
+    appendBigEndian(header, static_cast<uint32_t>(width));
+    appendBigEndian(header, static_cast<uint32_t>(height));
+    header.push_back(8);    // Bit depth
+    header.push_back(6);    // Color type RGBA
+    header.push_back(0);    // Compression
+    header.push_back(0);    // Filter
+    header.push_back(0);    // No interlace
+    
+    std::error_code error;
+    std::filesystem::path parent = std::filesystem::path(path).parent_path();
+    if (!parent.empty()) std::filesystem::create_directories(parent, error);
+    
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        std::cerr << "ERROR::PNG::FILE_NOT_WRITTEN: " << path << std::endl;
+        return false;
+    }
+    
+    const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    file.write(reinterpret_cast<const char*>(signature), sizeof(signature));
+    writeChunk(file, "IHDR", header);
+    writeChunk(file, "IDAT", compressed);
+    writeChunk(file, "IEND", std::vector<uint8_t>());
+    return static_cast<bool>(file);
+}
@@ -0,0 +1,14 @@
+#ifndef PNGWRITER_H
+#define PNGWRITER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Writes an 8-bit RGBA PNG. Pixels are packed with R in the low byte (the
+// same layout as the 2D framebuffers), row 0 first. Creates missing parent
+// directories. Compression is a single fixed-Huffman deflate block that
+// only encodes runs of repeated pixels: tiny for flat plan images, no zlib.
+bool writePNG(const std::string& path, int width, int height, const std::vector<uint32_t>& pixels);
+
+#endif
@@ -0,0 +1,456 @@
+#ifndef RASTER2D_H
+#define RASTER2D_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+// GL-free raster algorithms. Each calls plot(x, y) for every pixel it
+// produces, so the same code feeds GPU point lists and CPU images. The
+// span variants emit the same pixels merged into horizontal/vertical runs.
+
+// Half-open pixel rectangle [x0, x1) x [y0, y1)
+struct RasterRect {
+    int x0, y0, x1, y1;
+    RasterRect(int x0 = 0, int y0 = 0, int x1 = 0, int y1 = 0) : x0(x0), y0(y0), x1(x1), y1(y1) {}
+    
+    bool isEmpty() const { return x0 >= x1 || y0 >= y1; }
+    bool intersects(const RasterRect& other) const {
+        return x0 < other.x1 && other.x0 < x1 && y0 < other.y1 && other.y0 < y1;
+    }
+    RasterRect intersection(const RasterRect& other) const {
+        return RasterRect(std::max(x0, other.x0), std::max(y0, other.y0),
+                          std::min(x1, other.x1), std::min(y1, other.y1));
+    }
+    RasterRect united(const RasterRect& other) const {
+        if (isEmpty()) return other;
+        if (other.isEmpty()) return *this;
+        return RasterRect(std::min(x0, other.x0), std::min(y0, other.y0),
+                          std::max(x1, other.x1), std::max(y1, other.y1));
+    }
+    long long area() const { return isEmpty() ? 0 : static_cast<long long>(x1 - x0) * (y1 - y0); }
+};
+
+// Run of plotted pixels from (x0, y0) to (x1, y1) inclusive, one pixel
+// thick: either x0 == x1 or y0 == y1
+struct RasterSpan {
+    int x0, y0, x1, y1;
+    RasterSpan(int x0 = 0, int y0 = 0, int x1 = 0, int y1 = 0) : x0(x0), y0(y0), x1(x1), y1(y1) {}
+};
+
+// Merges a stream of plotted pixels into spans. A pixel extends the current
+// span when it continues it along its row or column; pixels already in the
+// span are dropped, anything else starts a new span. Call flush() at the end.
+template <typename Emit>
+class RasterSpanBuilder {
+public:
+    explicit RasterSpanBuilder(Emit& emit) : emit(emit), active(false) {}
+    
+    void add(int x, int y) {
+        if (!active) {
+            span = RasterSpan(x, y, x, y);
+            active = true;
+            return;
+        }
+        
+        if (x >= span.x0 && x <= span.x1 && y >= span.y0 && y <= span.y1) return;
+        
+        bool horizontal = span.y0 == span.y1; // Single pixels count as both
+        bool vertical = span.x0 == span.x1;
+        if (horizontal && y == span.y0 && (x == span.x0 - 1 || x == span.x1 + 1)) {
+            span.x0 = std::min(span.x0, x);
+            span.x1 = std::max(span.x1, x);
+        } else if (vertical && x == span.x0 && (y == span.y0 - 1 || y == span.y1 + 1)) {
+            span.y0 = std::min(span.y0, y);
+            span.y1 = std::max(span.y1, y);
+        } else {
+            emit(span);
+            span = RasterSpan(x, y, x, y);
+        }
+    }
+    
+    void flush() {
+        if (active) emit(span);
+        active = false;
+    }
+    
+private:
+    Emit& emit;
+    bool active;
+    RasterSpan span;
+};
+
+// Bresenham's Line Algorithm
+template <typename Plot>
+void rasterBresenhamLine(int x1, int y1, int x2, int y2, Plot&& plot) {
+    int dx = std::abs(x2 - x1);
+    int dy = std::abs(y2 - y1);
+    int sx = (x1 < x2) ? 1 : -1;
+    int sy = (y1 < y2) ? 1 : -1;
+    int err = dx - dy;
+    
+    int x = x1;
+    int y = y1;
+    
+    while (true) {
+        plot(x, y);
+        
+        if (x == x2 && y == y2) break;
+        
+        int e2 = 2 * err;
+        if (e2 > -dy) {
+            err -= dy;
+            x += sx;
+        }
+        if (e2 < dx) {
+            err += dx;
+            y += sy;
+        }
+    }
+}
+
+// Bresenham restricted to the pixels inside clip, without walking the rest.
+// Liang-Barsky clips the ideal segment to clip (grown by one pixel, since
+// Bresenham strays at most half a pixel off it), giving a range of major
+// axis steps. The loop state at the first step is computed directly: after
+// k major steps the minor axis has moved the smallest m with
+// (2m + 1) * dMajor >= 2 * dMinor * k. So the plotted pixels are exactly
+// the unclipped line's pixels that fall inside clip.
+template <typename Plot>
+void rasterBresenhamLineClipped(int x1, int y1, int x2, int y2, const RasterRect& clip, Plot&& plot) {
+    if (clip.isEmpty()) return;
+    
+    // Liang-Barsky against the grown clip rectangle
+    double t0 = 0.0, t1 = 1.0;
+    double fdx = static_cast<double>(x2) - x1;
+    double fdy = static_cast<double>(y2) - y1;
+    auto clipEdge = [&](double p, double q) {
+        if (p == 0.0) return q >= 0.0;
+        double t = q / p;
+        if (p < 0.0) {
+            if (t > t1) return false;
+            if (t > t0) t0 = t;
+        } else {
+            if (t < t0) return false;
+            if (t < t1) t1 = t;
+        }
+        return true;
+    };
+    if (!clipEdge(-fdx, x1 - (clip.x0 - 1.0)) || !clipEdge(fdx, (clip.x1 + 1.0) - x1) ||
+        !clipEdge(-fdy, y1 - (clip.y0 - 1.0)) || !clipEdge(fdy, (clip.y1 + 1.0) - y1)) {
+        return;
+    }
+    
+    long long dx = std::abs(static_cast<long long>(x2) - x1);
+    long long dy = std::abs(static_cast<long long>(y2) - y1);
+    int sx = (x1 < x2) ? 1 : -1;
+    int sy = (y1 < y2) ? 1 : -1;
+    bool xMajor = dx >= dy;
+    long long major = xMajor ? dx : dy;
+    long long minor = xMajor ? dy : dx;
+    
+    // A little slack each side covers rounding in the t -> step mapping
+    long long kStart = std::max(0LL, static_cast<long long>(t0 * major) - 1);
+    long long kEnd = std::min(major, static_cast<long long>(t1 * major) + 2);
+    
+    long long m = 0;
+    if (major > 0 && 2 * minor * kStart > major) {
+        m = (2 * minor * kStart - major + 2 * major - 1) / (2 * major);
+    }
+    long long xSteps = xMajor ? kStart : m;
+    long long ySteps = xMajor ? m : kStart;
+    
+    long long x = x1 + sx * xSteps;
+    long long y = y1 + sy * ySteps;
+    long long err = dx - dy - xSteps * dy + ySteps * dx;
+    
+    for (long long k = kStart; ; ++k) {
+        if (x >= clip.x0 && x < clip.x1 && y >= clip.y0 && y < clip.y1) {
+            plot(static_cast<int>(x), static_cast<int>(y));
+        }
+        
+        if (k >= kEnd) break;
+        
+        long long e2 = 2 * err;
+        if (e2 > -dy) {
+            err -= dy;
+            x += sx;
+        }
+        if (e2 < dx) {
+            err += dx;
+            y += sy;
+        }
+    }
+}
+
+// Midpoint Circle Algorithm (plots all eight octants per step)
+template <typename Plot>
+void rasterMidpointCircle(int cx, int cy, int radius, Plot&& plot) {
+    int x = 0;
+    int y = radius;
+    int d = 1 - radius;
+    
+    auto plot8Points = [&](int px, int py) {
+        plot(cx + px, cy + py);
+        plot(cx - px, cy + py);
+        plot(cx + px, cy - py);
+        plot(cx - px, cy - py);
+        plot(cx + py, cy + px);
+        plot(cx - py, cy + px);
+        plot(cx + py, cy - px);
+        plot(cx - py, cy - px);
+    };
+    
+    plot8Points(x, y);
+    
+    while (x < y) {
+        x++;
+        if (d < 0) {
+            d += 2 * x + 1;
+        } else {
+            y--;
+            d += 2 * (x - y) + 1;
+        }
+        plot8Points(x, y);
+    }
+}
+
+// Midpoint circle restricted to the pixels inside clip, one octant at a
+// time, without walking the rest. Along an octant the step x and the
+// circle's y both change monotonically, so the steps that can land inside
+// clip form one range: the coordinate that is x bounds it directly, the one
+// that is y through the circle equation (with a pixel of slack). The loop
+// state at the first step is computed directly: the algorithm gives
+// column x the y with 4x^2 + (2y - 1)^2 < 4r^2 <= 4x^2 + (2y + 1)^2. So
+// the plotted pixels are exactly the unclipped circle's pixels that fall
+// inside clip, each octant in step order.
+inline bool rasterCircleInside(int cx, int cy, int radius, const RasterRect& clip) {
+    long long r = std::abs(static_cast<long long>(radius));
+    return cx - r >= clip.x0 && cx + r < clip.x1 && cy - r >= clip.y0 && cy + r < clip.y1;
+}
+
+template <typename Plot>
+void rasterMidpointCircleClipped(int cx, int cy, int radius, const RasterRect& clip, Plot&& plot) {
+    if (clip.isEmpty()) return;
+    if (rasterCircleInside(cx, cy, radius, clip)) {
+        rasterMidpointCircle(cx, cy, radius, plot);
+        return;
+    }
+    if (radius < 0) {
+        rasterMidpointCircle(cx, cy, radius, [&](int x, int y) {
+            if (x >= clip.x0 && x < clip.x1 && y >= clip.y0 && y < clip.y1) plot(x, y);
+        });
+        return;
+    }
+    
+    long long r = radius;
+    auto columnY = [r](long long x) {
+        long long remaining = 4 * (r * r - x * x);
+        if (remaining <= 0) return 0LL;
+        long long root = static_cast<long long>(std::sqrt(static_cast<double>(remaining)));
+        while (root * root > remaining) root--;
+        while ((root + 1) * (root + 1) <= remaining) root++;
+        if (root * root < remaining) root++; // Ceiling
+        return root / 2;
+    };
+    // Steps whose y lies in [yLow, yHigh], with slack
+    auto stepsForY = [r](long long yLow, long long yHigh, long long& first, long long& last) {
+        yLow = std::max(yLow, 0LL);
+        yHigh = std::min(yHigh, r);
+        if (yLow > yHigh) return false;
+        double outer = static_cast<double>(r * r - (yHigh + 1) * (yHigh + 1));
+        double inner = static_cast<double>(r * r - (yLow - 1) * (yLow - 1));
+        first = std::max(first, static_cast<long long>(std::sqrt(std::max(outer, 0.0))) - 1);
+        last = std::min(last, static_cast<long long>(std::sqrt(std::max(inner, 0.0))) + 1);
+        return true;
+    };
+    
+    // Same octant order as rasterMidpointCircle: (+-x, +-y), then (+-y, +-x)
+    for (int octant = 0; octant < 8; ++octant) {
+        long long sx = (octant & 1) ? -1 : 1;
+        long long sy = (octant & 2) ? -1 : 1;
+        bool swapped = octant >= 4;
+        
+        // Clip ranges of the offsets from the centre along each axis
+        long long dx0 = sx > 0 ? clip.x0 - static_cast<long long>(cx) : cx - (clip.x1 - 1LL);
+        long long dx1 = sx > 0 ? clip.x1 - 1LL - cx : cx - static_cast<long long>(clip.x0);
+        long long dy0 = sy > 0 ? clip.y0 - static_cast<long long>(cy) : cy - (clip.y1 - 1LL);
+        long long dy1 = sy > 0 ? clip.y1 - 1LL - cy : cy - static_cast<long long>(clip.y0);
+        
+        long long first = std::max(swapped ? dy0 : dx0, 0LL);
+        long long last = std::min(swapped ? dy1 : dx1, r);
+        if (!stepsForY(swapped ? dx0 : dy0, swapped ? dx1 : dy1, first, last)) continue;
+        first = std::max(first, 0LL);
+        if (first > last) continue;
+        
+        // The circle may have ended before the first step
+        if (first > 0 && first - 1 >= columnY(first - 1)) continue;
+        long long x = first;
+        long long y = columnY(first);
+        long long d = (x + 1) * (x + 1) + y * y - y - r * r;
+        
+        while (true) {
+            long long px = cx + sx * (swapped ? y : x);
+            long long py = cy + sy * (swapped ? x : y);
+            if (px >= clip.x0 && px < clip.x1 && py >= clip.y0 && py < clip.y1) {
+                plot(static_cast<int>(px), static_cast<int>(py));
+            }
+            
+            if (x >= y || x >= last) break;
+            x++;
+            if (d < 0) {
+                d += 2 * x + 1;
+            } else {
+                y--;
+                d += 2 * (x - y) + 1;
+            }
+        }
+    }
+}
+
+// Bresenham as spans: x-major lines become horizontal runs, y-major lines
+// vertical runs. emit(const RasterSpan&)
+template <typename Emit>
+void rasterBresenhamSpans(int x1, int y1, int x2, int y2, Emit&& emit) {
+    RasterSpanBuilder<Emit> builder(emit);
+    rasterBresenhamLine(x1, y1, x2, y2, [&](int x, int y) { builder.add(x, y); });
+    builder.flush();
+}
+
+// Clipped Bresenham as spans; only the visible runs are produced
+template <typename Emit>
+void rasterBresenhamSpans(int x1, int y1, int x2, int y2, const RasterRect& clip, Emit&& emit) {
+    RasterSpanBuilder<Emit> builder(emit);
+    rasterBresenhamLineClipped(x1, y1, x2, y2, clip, [&](int x, int y) { builder.add(x, y); });
+    builder.flush();
+}
+
+// Midpoint circle as spans. plot8Points visits the octants in a fixed
+// order, so each octant gets its own builder and stays one run per row
+// (or column) instead of interleaving with the other seven.
+template <typename Emit>
+void rasterMidpointCircleSpans(int cx, int cy, int radius, Emit&& emit) {
+    RasterSpanBuilder<Emit> builders[8] = {
+        RasterSpanBuilder<Emit>(emit), RasterSpanBuilder<Emit>(emit),
+        RasterSpanBuilder<Emit>(emit), RasterSpanBuilder<Emit>(emit),
+        RasterSpanBuilder<Emit>(emit), RasterSpanBuilder<Emit>(emit),
+        RasterSpanBuilder<Emit>(emit), RasterSpanBuilder<Emit>(emit)
+    };
+    int octant = 0;
+    rasterMidpointCircle(cx, cy, radius, [&](int x, int y) {
+        builders[octant].add(x, y);
+        octant = (octant + 1) & 7;
+    });
+    for (auto& builder : builders) builder.flush();
+}
+
+// Clipped midpoint circle as spans. The octants come one after another, so
+// one builder keeps each to a run per row (or column).
+template <typename Emit>
+void rasterMidpointCircleSpans(int cx, int cy, int radius, const RasterRect& clip, Emit&& emit) {
+    if (rasterCircleInside(cx, cy, radius, clip)) {
+        rasterMidpointCircleSpans(cx, cy, radius, emit);
+        return;
+    }
+    RasterSpanBuilder<Emit> builder(emit);
+    rasterMidpointCircleClipped(cx, cy, radius, clip, [&](int x, int y) { builder.add(x, y); });
+    builder.flush();
+}
+
+// Smallest integer >= a / b, for b > 0
+inline long long rasterCeilDiv(long long a, long long b) {
+    return a >= 0 ? (a + b - 1) / b : -((-a) / b);
+}
+
+// Scanline polygon fill (even-odd). Vertices are point positions, i.e.
+// pixel corners, and a pixel is inside when its centre is; scanlines run
+// through pixel centres, so they never meet a vertex. Edges go into an
+// edge table sorted by first row, then move through an active edge table
+// that keeps each crossing as an exact fraction stepped once per row.
+// emit(const RasterSpan&) gets one horizontal run of pixels (not point
+// positions) per interior stretch of each row, clipped to clip.
+// Vertex needs int members x and y.
+template <typename Vertex, typename Emit>
+void rasterFillPolygonSpans(const Vertex* vertices, int count, const RasterRect& clip, Emit&& emit) {
+    // Row y is crossed at x = ceil(numerator / denominator): the first
+    // pixel whose centre is at or right of the edge
+    struct Edge {
+        int yTop, yBottom;              // Rows [yTop, yBottom)
+        long long numerator, step, denominator;
+        int crossing;
+    };
+    
+    std::vector<Edge> edgeTable;
+    for (int i = 0; i < count; ++i) {
+        const Vertex& a = vertices[i];
+        const Vertex& b = vertices[(i + 1) % count];
+        if (a.y == b.y) continue;
+        
+        const Vertex& top = a.y < b.y ? a : b;
+        const Vertex& bottom = a.y < b.y ? b : a;
+        long long dx = bottom.x - top.x;
+        long long dy = bottom.y - top.y;
+        Edge edge;
+        edge.yTop = std::max(top.y, clip.y0);
+        edge.yBottom = std::min(bottom.y, clip.y1);
+        if (edge.yTop >= edge.yBottom) continue;
+        
+        // Pixel x is inside from the edge when 2x + 1 >= 2 * crossing x
+        edge.denominator = 2 * dy;
+        edge.numerator = 2 * top.x * dy + (2LL * (edge.yTop - top.y) + 1) * dx - dy;
+        edge.step = 2 * dx;
+        edgeTable.push_back(edge);
+    }
+    std::sort(edgeTable.begin(), edgeTable.end(),
+              [](const Edge& a, const Edge& b) { return a.yTop < b.yTop; });
+    
+    std::vector<Edge> active;
+    size_t next = 0;
+    int y = edgeTable.empty() ? 0 : edgeTable.front().yTop;
+    while (next < edgeTable.size() || !active.empty()) {
+        if (active.empty()) y = std::max(y, edgeTable[next].yTop);
+        while (next < edgeTable.size() && edgeTable[next].yTop == y) active.push_back(edgeTable[next++]);
+        
+        for (auto& edge : active) edge.crossing = static_cast<int>(rasterCeilDiv(edge.numerator, edge.denominator));
+        std::sort(active.begin(), active.end(),
+                  [](const Edge& a, const Edge& b) { return a.crossing < b.crossing; });
+        for (size_t i = 0; i + 1 < active.size(); i += 2) {
+            int x0 = std::max(active[i].crossing, clip.x0);
+            int x1 = std::min(active[i + 1].crossing, clip.x1) - 1;
+            if (x0 <= x1) emit(RasterSpan(x0, y, x1, y));
+        }
+        
+        ++y;
+        for (auto& edge : active) edge.numerator += edge.step;
+        active.erase(std::remove_if(active.begin(), active.end(),
+                                    [y](const Edge& edge) { return edge.yBottom <= y; }), active.end());
+    }
+}
+
+// Filled disc around point position (cx, cy): the pixels whose centres
+// lie within radius, one horizontal run per row, clipped to clip. Same
+// convention as rasterFillPolygonSpans, so it sits under a midpoint outline.
+template <typename Emit>
+void rasterFillCircleSpans(int cx, int cy, int radius, const RasterRect& clip, Emit&& emit) {
+    // Doubled coordinates keep centres integral: a pixel is inside when
+    // (2x + 1 - 2cx)^2 + (2y + 1 - 2cy)^2 <= (2r)^2
+    long long limit = 4LL * radius * radius;
+    int y0 = std::max(cy - radius, clip.y0);
+    int y1 = std::min(cy + radius, clip.y1);
+    for (int y = y0; y < y1; ++y) {
+        long long dy = 2LL * (y - cy) + 1;
+        long long remaining = limit - dy * dy;
+        if (remaining < 0) continue;
+        
+        long long half = static_cast<long long>(std::sqrt(static_cast<double>(remaining)));
+        while (half * half > remaining) half--;
+        while ((half + 1) * (half + 1) <= remaining) half++;
+        
+        int x0 = std::max(static_cast<int>(rasterCeilDiv(2LL * cx - 1 - half, 2)), clip.x0);
+        int x1 = std::min(static_cast<int>(-rasterCeilDiv(-(2LL * cx - 1 + half), 2)), clip.x1 - 1);
+        if (x0 <= x1) emit(RasterSpan(x0, y, x1, y));
+    }
+}
+
+#endif
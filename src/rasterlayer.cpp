@@ -0,0 +1,53 @@
+#include "rasterlayer.h"
+
+RasterLayer::RasterLayer() : width(0), height(0), texture(0) {}
+
+RasterLayer::~RasterLayer() {
+    if (texture) glDeleteTextures(1, &texture);
+}
+
+void RasterLayer::init(int layerWidth, int layerHeight) {
+    width = layerWidth;
+    height = layerHeight;
+    pendingUpload.clear();
+    
+    if (!texture) glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    
+    // One texel per screen pixel, never filtered
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    // Transparent until the first upload
+    std::vector<uint32_t> blank(static_cast<size_t>(width) * height, 0);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, blank.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void RasterLayer::markForUpload(const RasterRect& rect) {
+    RasterRect r = rect.intersection(bounds());
+    if (!r.isEmpty()) pendingUpload.push_back(r);
+}
+
+void RasterLayer::upload(const std::vector<uint32_t>& pixels) {
+    if (pendingUpload.empty() || !texture) return;
+    
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, width);
+    
+    for (const auto& r : pendingUpload) {
+        // Sub-rectangle straight out of the full-width CPU image
+        glPixelStorei(GL_UNPACK_SKIP_PIXELS, r.x0);
+        glPixelStorei(GL_UNPACK_SKIP_ROWS, r.y0);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, r.x0, r.y0, r.x1 - r.x0, r.y1 - r.y0,
+                        GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    }
+    
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+    glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    pendingUpload.clear();
+}
+
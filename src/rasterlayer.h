@@ -0,0 +1,30 @@
+#ifndef RASTERLAYER_H
+#define RASTERLAYER_H
+
+#include <glad/glad.h>
+#include <cstdint>
+#include <vector>
+#include "raster2d.h"
+
+// GL texture mirroring a screen-sized RGBA8 image kept on the CPU (see
+// SoftwareRasterizer). Only rectangles marked since the last upload are sent.
+class RasterLayer {
+public:
+    RasterLayer();
+    ~RasterLayer();
+    
+    void init(int layerWidth, int layerHeight);
+    
+    void markForUpload(const RasterRect& rect);
+    void upload(const std::vector<uint32_t>& pixels); // Pending rectangles only
+    
+    unsigned int getTexture() const { return texture; }
+    RasterRect bounds() const { return RasterRect(0, 0, width, height); }
+    
+private:
+    int width, height;
+    unsigned int texture;
+    std::vector<RasterRect> pendingUpload;
+};
+
+#endif
@@ -1,19 +1,51 @@
 #include "renderer2d.h"
+#include "streambuffer.h"
 #include <glm/gtc/matrix_transform.hpp>
 #include <cmath>
 #include <algorithm>
+#include <cstddef>
 #include <iostream>
 
-Renderer2D::Renderer2D() : VAO(0), VBO(0), width(800), height(600) {}
+namespace {
+
+// Past this many dirty rectangles one bounding repaint is cheaper than
+// walking the element lists once per rectangle
+const size_t MAX_DIRTY_RECTS = 8;
+
+// Below this the screen layer repaints fast enough on every pan and zoom
+const size_t PYRAMID_MIN_PRIMITIVES = 20000;
+
+int16_t clampToInt16(int value) {
+    // Far off-screen spans only need to stay off-screen
+    return static_cast<int16_t>(std::max(-32768, std::min(32767, value)));
+}
+
+}
+
+Renderer2D::Renderer2D() : VAO(0), cornerVBO(0), width(800), height(600),
+                           backend(Renderer2DBackend::OPENGL), quadVAO(0), quadVBO(0),
+                           pyramidThreshold(PYRAMID_MIN_PRIMITIVES), pyramidMode(false), elementsChanged(true) {}
 
 Renderer2D::~Renderer2D() {
     if (VAO) glDeleteVertexArrays(1, &VAO);
-    if (VBO) glDeleteBuffers(1, &VBO);
+    if (cornerVBO) glDeleteBuffers(1, &cornerVBO);
+    if (quadVAO) glDeleteVertexArrays(1, &quadVAO);
+    if (quadVBO) glDeleteBuffers(1, &quadVBO);
+    
+    pyramid.takeAllTextures(evictedTextures);
+    if (!evictedTextures.empty()) glDeleteTextures(static_cast<GLsizei>(evictedTextures.size()), evictedTextures.data());
 }
 
-void Renderer2D::init(int screenWidth, int screenHeight) {
+void Renderer2D::init(int screenWidth, int screenHeight, Renderer2DBackend renderBackend) {
     width = screenWidth;
     height = screenHeight;
+    backend = renderBackend;
+    sceneRaster.resize(width, height);
+    frameRaster.resize(width, height);
+    invalidateAll();
+    
+    // Everything below is GL state
+    if (backend == Renderer2DBackend::SOFTWARE) return;
     
     // Load shader
     shader.load("shaders/basic_vert.glsl", "shaders/basic_frag.glsl");
@@ -23,17 +55,26 @@ void Renderer2D::init(int screenWidth, int screenHeight) {
         return;
     }
     
-    // Create VAO and VBO
+    // Create VAO and the corner VBO (instances live in the stream buffer)
     glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
+    glGenBuffers(1, &cornerVBO);
     
     glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
     
-    // Position attribute
+    // Corner attribute: unit quad as a triangle strip
+    float corners[] = { 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f };
+    glBindBuffer(GL_ARRAY_BUFFER, cornerVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
     glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(0);
     
+    // Per-instance rectangle and colour; pointers are set per flush, since
+    // the instances land at a different stream offset every time
+    glEnableVertexAttribArray(1);
+    glVertexAttribDivisor(1, 1);
+    glEnableVertexAttribArray(2);
+    glVertexAttribDivisor(2, 1);
+    
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindVertexArray(0);
     
@@ -41,121 +82,286 @@ void Renderer2D::init(int screenWidth, int screenHeight) {
     glm::mat4 projection = glm::ortho(0.0f, (float)width, (float)height, 0.0f, -1.0f, 1.0f);
     shader.use();
     shader.setMat4("projection", projection);
+    
+    // Screen-filling quad for the cached layer (texture row 0 at the top)
+    layerShader.load("shaders/layer_vert.glsl", "shaders/layer_frag.glsl");
+    if (layerShader.ID == 0) {
+        std::cerr << "ERROR::RENDERER2D::LAYER_SHADER_FAILED_TO_LOAD" << std::endl;
+        return;
+    }
+    
+    float w = static_cast<float>(width);
+    float h = static_cast<float>(height);
+    float quad[] = {
+        // pos      // uv
+        0.0f, 0.0f, 0.0f, 0.0f,
+        w,    0.0f, 1.0f, 0.0f,
+        0.0f, h,    0.0f, 1.0f,
+        w,    h,    1.0f, 1.0f
+    };
+    
+    glGenVertexArrays(1, &quadVAO);
+    glGenBuffers(1, &quadVBO);
+    glBindVertexArray(quadVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+    
+    layerShader.use();
+    layerShader.setMat4("projection", projection);
+    layerShader.setInt("layer", 0);
+    layerShader.setVec4("uvRect", glm::vec4(0.0f, 0.0f, 1.0f, 1.0f));
+    
+    layer.init(width, height);
 }
 
 void Renderer2D::clear() {
-    pixels.clear();
+    batch.clear();
 }
 
 void Renderer2D::render() {
-    if (shader.ID == 0) return; // Don't render if shader failed to load
-    
-    shader.use();
-    glBindVertexArray(VAO);
+    // Don't render if shader failed to load
+    if (backend == Renderer2DBackend::OPENGL && shader.ID == 0) return;
     
-    // Draw grid
-    drawGrid(width, 50);
-    
-    // Draw all stored lines
-    for (const auto& line : lines) {
-        drawBresenhamLine(line.start.x, line.start.y, line.end.x, line.end.y, line.color);
-    }
+    // Grid, roads, parks and buildings: repaint only what changed, then
+    // one textured quad (or one per visible tile) regardless of city size
+    updateScene();
+    appendOverlays();
     
-    // Draw all stored circles
-    for (const auto& circle : circles) {
-        drawMidpointCircle(circle.center.x, circle.center.y, circle.radius, circle.color);
+    if (backend == Renderer2DBackend::SOFTWARE) {
+        composeFrame();
+    } else {
+        if (pyramidMode) {
+            drawTiles();
+        } else {
+            drawLayer();
+        }
+        flushBatch();
     }
-    
-    // Upload and draw pixels
-    uploadPixels();
-    
-    glBindVertexArray(0);
     clear();
 }
 
-void Renderer2D::drawPixel(int x, int y, glm::vec3 color) {
-    if (x >= 0 && x < width && y >= 0 && y < height) {
-        pixels.push_back(glm::vec2(x, y));
-        shader.setVec3("color", color);
-        uploadPixels();
-        pixels.clear();
+bool Renderer2D::exportPNG(const std::string& path, const glm::vec3& background) {
+    // The GL backend never composes on the CPU, so do it once here
+    if (backend == Renderer2DBackend::OPENGL) {
+        updateScene();
+        appendOverlays();
+        composeFrame();
+        clear();
     }
+    return frameRaster.savePNG(path, SoftwareRasterizer::packColor(background));
 }
 
-// Bresenham's Line Algorithm
-void Renderer2D::drawBresenhamLine(int x1, int y1, int x2, int y2, glm::vec3 color) {
-    int dx = abs(x2 - x1);
-    int dy = abs(y2 - y1);
-    int sx = (x1 < x2) ? 1 : -1;
-    int sy = (y1 < y2) ? 1 : -1;
-    int err = dx - dy;
+// Overlays join whatever was drawn directly (drawPixel, drawCrosshair)
+// since the last frame; each span carries its own colour, so the whole
+// stream goes out in one upload and one draw call
+void Renderer2D::appendOverlays() {
+    for (const auto& line : overlayLines) {
+        Point2D start = toScreen(line.start);
+        Point2D end = toScreen(line.end);
+        drawBresenhamLine(start.x, start.y, end.x, end.y, line.color);
+    }
+}
+
+// CPU equivalent of drawLayer + flushBatch: layer texels are the CPU
+// pixels, and span quads cover exactly their integer rectangles
+void Renderer2D::composeFrame() {
+    if (pyramidMode) {
+        composeTiles();
+    } else {
+        frameRaster.copyPixels(sceneRaster);
+    }
+    for (const auto& instance : batch) {
+        frameRaster.fill(RasterRect(instance.x0, instance.y0, instance.x1, instance.y1), instance.color);
+    }
+}
+
+void Renderer2D::updateScene() {
+    bool wantPyramid = lines.size() + circles.size() + polygons.size() >= pyramidThreshold;
+    if (wantPyramid != pyramidMode) {
+        pyramidMode = wantPyramid;
+        invalidateAll();
+        std::cout << "[2D] " << (pyramidMode ? "Large plan: drawing from the tile pyramid" : "Drawing the screen layer")
+                  << std::endl;
+    }
     
-    int x = x1;
-    int y = y1;
+    if (pyramidMode) {
+        updatePyramid();
+    } else {
+        updateLayer();
+    }
+}
+
+void Renderer2D::updateLayer() {
+    if (dirtyRects.empty()) return;
     
-    shader.setVec3("color", color);
+    if (dirtyRects.size() > MAX_DIRTY_RECTS) {
+        RasterRect merged;
+        for (const auto& rect : dirtyRects) merged = merged.united(rect);
+        dirtyRects.assign(1, merged);
+    }
     
-    while (true) {
-        pixels.push_back(glm::vec2(x, y));
+    for (const auto& rect : dirtyRects) {
+        RasterRect clip = rect.intersection(sceneRaster.bounds());
+        if (clip.isEmpty()) continue;
         
-        if (x == x2 && y == y2) break;
-        
-        int e2 = 2 * err;
-        if (e2 > -dy) {
-            err -= dy;
-            x += sx;
+        // Full repaints use every core, edits repaint just their rectangle
+        if (clip.area() == sceneRaster.bounds().area()) {
+            sceneRaster.render(lines, circles, polygons);
+        } else {
+            sceneRaster.renderRect(clip, lines, circles, polygons);
         }
-        if (e2 < dx) {
-            err += dx;
-            y += sy;
+        if (backend == Renderer2DBackend::OPENGL) layer.markForUpload(clip);
+    }
+    dirtyRects.clear();
+    if (backend == Renderer2DBackend::OPENGL) layer.upload(sceneRaster.getPixels());
+}
+
+void Renderer2D::drawLayer() {
+    if (layerShader.ID == 0 || !quadVAO) return;
+    
+    layerShader.use();
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, layer.getTexture());
+    glBindVertexArray(quadVAO);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+// Tiles that finished rendering go to the GPU, then whatever the view now
+// shows is requested. Nothing here depends on the size of the city.
+void Renderer2D::updatePyramid() {
+    if (elementsChanged) {
+        pyramid.setScene(lines, circles, polygons);
+        elementsChanged = false;
+    }
+    
+    pyramid.collectFinished(arrivedTiles);
+    if (backend == Renderer2DBackend::OPENGL) {
+        for (const auto& key : arrivedTiles) {
+            Tile* tile = pyramid.find(key);
+            if (tile) uploadTile(*tile);
+        }
+        pyramid.takeEvictedTextures(evictedTextures);
+        if (!evictedTextures.empty()) {
+            glDeleteTextures(static_cast<GLsizei>(evictedTextures.size()), evictedTextures.data());
         }
     }
+    pyramid.requestVisible(getCamera(), width, height, visibleTiles);
 }
 
-// Midpoint Circle Algorithm
-void Renderer2D::drawMidpointCircle(int cx, int cy, int radius, glm::vec3 color) {
-    int x = 0;
-    int y = radius;
-    int d = 1 - radius;
+void Renderer2D::uploadTile(Tile& tile) {
+    const int size = TilePyramid::TILE_SIZE;
+    if (!tile.texture) {
+        glGenTextures(1, &tile.texture);
+        glBindTexture(GL_TEXTURE_2D, tile.texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, tile.pixels.data());
+    } else {
+        glBindTexture(GL_TEXTURE_2D, tile.texture);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, size, size, GL_RGBA, GL_UNSIGNED_BYTE, tile.pixels.data());
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+// The layer quad spans the screen; each tile squeezes it onto its own
+// rectangle. Tiles still rendering borrow part of a coarser cached tile.
+void Renderer2D::drawTiles() {
+    if (layerShader.ID == 0 || !quadVAO) return;
     
-    shader.setVec3("color", color);
+    glm::mat4 projection = glm::ortho(0.0f, (float)width, (float)height, 0.0f, -1.0f, 1.0f);
+    layerShader.use();
+    glActiveTexture(GL_TEXTURE0);
+    glBindVertexArray(quadVAO);
     
-    plot8Points(cx, cy, x, y, color);
+    for (const auto& key : visibleTiles) {
+        glm::vec2 uvMin, uvMax;
+        Tile* tile = pyramid.findOrAncestor(key, uvMin, uvMax);
+        if (!tile || !tile->texture) continue;
+        
+        RasterRect rect = TilePyramid::screenRect(key, getCamera());
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(rect.x0, rect.y0, 0.0f));
+        model = glm::scale(model, glm::vec3(static_cast<float>(rect.x1 - rect.x0) / width,
+                                            static_cast<float>(rect.y1 - rect.y0) / height, 1.0f));
+        layerShader.setMat4("projection", projection * model);
+        layerShader.setVec4("uvRect", glm::vec4(uvMin, uvMax));
+        glBindTexture(GL_TEXTURE_2D, tile->texture);
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    }
     
-    while (x < y) {
-        x++;
-        if (d < 0) {
-            d += 2 * x + 1;
-        } else {
-            y--;
-            d += 2 * (x - y) + 1;
-        }
-        plot8Points(cx, cy, x, y, color);
+    layerShader.setMat4("projection", projection);
+    layerShader.setVec4("uvRect", glm::vec4(0.0f, 0.0f, 1.0f, 1.0f));
+    glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+// CPU equivalent of drawTiles
+void Renderer2D::composeTiles() {
+    frameRaster.clear(frameRaster.bounds());
+    for (const auto& key : visibleTiles) {
+        glm::vec2 uvMin, uvMax;
+        Tile* tile = pyramid.findOrAncestor(key, uvMin, uvMax);
+        if (!tile) continue;
+        frameRaster.drawImage(TilePyramid::screenRect(key, getCamera()), tile->pixels,
+                              TilePyramid::TILE_SIZE, TilePyramid::TILE_SIZE, uvMin, uvMax);
     }
 }
 
-void Renderer2D::plot8Points(int cx, int cy, int x, int y, glm::vec3 color) {
-    pixels.push_back(glm::vec2(cx + x, cy + y));
-    pixels.push_back(glm::vec2(cx - x, cy + y));
-    pixels.push_back(glm::vec2(cx + x, cy - y));
-    pixels.push_back(glm::vec2(cx - x, cy - y));
-    pixels.push_back(glm::vec2(cx + y, cy + x));
-    pixels.push_back(glm::vec2(cx - y, cy + x));
-    pixels.push_back(glm::vec2(cx + y, cy - x));
-    pixels.push_back(glm::vec2(cx - y, cy - x));
+void Renderer2D::drawPixel(int x, int y, glm::vec3 color) {
+    if (x >= 0 && x < width && y >= 0 && y < height) {
+        pushSpan(RasterSpan(x, y, x, y), SoftwareRasterizer::packColor(color));
+    }
+}
+
+// Bresenham's Line Algorithm
+void Renderer2D::drawBresenhamLine(int x1, int y1, int x2, int y2, glm::vec3 color) {
+    uint32_t packed = SoftwareRasterizer::packColor(color);
+    rasterBresenhamSpans(x1, y1, x2, y2, SoftwareRasterizer::plotArea(RasterRect(0, 0, width, height)),
+                         [&](const RasterSpan& span) { pushSpan(span, packed); });
+}
+
+// Midpoint Circle Algorithm
+void Renderer2D::drawMidpointCircle(int cx, int cy, int radius, glm::vec3 color) {
+    if (!SoftwareRasterizer::circleTouches(cx, cy, radius, RasterRect(0, 0, width, height))) return;
+    uint32_t packed = SoftwareRasterizer::packColor(color);
+    rasterMidpointCircleSpans(cx, cy, radius, SoftwareRasterizer::plotArea(RasterRect(0, 0, width, height)),
+                              [&](const RasterSpan& span) { pushSpan(span, packed); });
+}
+
+// Scanline polygon fill: spans come straight from the active edge table,
+// so a filled footprint is one instance per row
+void Renderer2D::drawFilledPolygon(const std::vector<Point2D>& points, glm::vec3 color) {
+    if (points.size() < 3) return;
+    uint32_t packed = SoftwareRasterizer::packColor(color);
+    rasterFillPolygonSpans(points.data(), static_cast<int>(points.size()), RasterRect(0, 0, width, height),
+                           [&](const RasterSpan& span) { pushRect(RasterRect(span.x0, span.y0, span.x1 + 1, span.y1 + 1), packed); });
+}
+
+void Renderer2D::drawFilledCircle(int cx, int cy, int radius, glm::vec3 color) {
+    uint32_t packed = SoftwareRasterizer::packColor(color);
+    rasterFillCircleSpans(cx, cy, radius, RasterRect(0, 0, width, height),
+                          [&](const RasterSpan& span) { pushRect(RasterRect(span.x0, span.y0, span.x1 + 1, span.y1 + 1), packed); });
 }
 
 void Renderer2D::drawGrid(int gridSize, int cellSize) {
     glm::vec3 gridColor(0.2f, 0.2f, 0.2f);
-    shader.setVec3("color", gridColor);
     
-    // Vertical lines
-    for (int x = 0; x < gridSize; x += cellSize) {
+    // Vertical lines (none past the right edge)
+    for (int x = 0; x < gridSize && x <= width; x += cellSize) {
         drawBresenhamLine(x, 0, x, height, gridColor);
     }
     
     // Horizontal lines
-    for (int y = 0; y < gridSize; y += cellSize) {
+    for (int y = 0; y < gridSize && y <= height; y += cellSize) {
         drawBresenhamLine(0, y, width, y, gridColor);
     }
 }
@@ -169,25 +375,95 @@ void Renderer2D::drawCrosshair(int x, int y) {
 
 void Renderer2D::addLine(const Line2D& line) {
     lines.push_back(line);
+    elementsChanged = true;
 }
 
 void Renderer2D::addCircle(const Circle2D& circle) {
     circles.push_back(circle);
+    elementsChanged = true;
+}
+
+void Renderer2D::addPolygon(const Polygon2D& polygon) {
+    polygons.push_back(polygon);
+    elementsChanged = true;
 }
 
 void Renderer2D::clearElements() {
     lines.clear();
     circles.clear();
+    polygons.clear();
+    elementsChanged = true;
 }
 
-void Renderer2D::uploadPixels() {
-    if (pixels.empty()) return;
+void Renderer2D::invalidateArea(const glm::vec2& minCorner, const glm::vec2& maxCorner) {
+    // Tiles are in world space, so only the ones under the edit go
+    if (pyramidMode) {
+        pyramid.invalidateArea(minCorner, maxCorner);
+        return;
+    }
     
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, pixels.size() * sizeof(glm::vec2), pixels.data(), GL_DYNAMIC_DRAW);
+    // One extra pixel each way for the 2x2 point footprint (and rounding)
+    glm::vec2 screenMin = getCamera().worldToScreen(minCorner);
+    glm::vec2 screenMax = getCamera().worldToScreen(maxCorner);
+    RasterRect rect(static_cast<int>(std::floor(screenMin.x)) - 1, static_cast<int>(std::floor(screenMin.y)) - 1,
+                    static_cast<int>(std::ceil(screenMax.x)) + 2, static_cast<int>(std::ceil(screenMax.y)) + 2);
+    if (!rect.isEmpty()) dirtyRects.push_back(rect);
+}
+
+void Renderer2D::invalidateAll() {
+    dirtyRects.assign(1, sceneRaster.bounds());
+    pyramid.invalidateAll();
+}
+
+void Renderer2D::addOverlayLine(const Line2D& line) {
+    overlayLines.push_back(line);
+}
+
+void Renderer2D::clearOverlay() {
+    overlayLines.clear();
+}
+
+void Renderer2D::setCamera(const Camera2D& newCamera) {
+    if (newCamera == getCamera()) return;
+    sceneRaster.setCamera(newCamera);
+    dirtyRects.assign(1, sceneRaster.bounds());
+}
+
+Point2D Renderer2D::toScreen(const Point2D& world) const {
+    return SoftwareRasterizer::snapToPixel(getCamera().worldToScreen(glm::vec2(world.x, world.y)));
+}
+
+void Renderer2D::pushSpan(const RasterSpan& span, uint32_t color) {
+    pushRect(SoftwareRasterizer::pointFootprint(span), color);
+}
+
+void Renderer2D::pushRect(const RasterRect& rect, uint32_t color) {
+    SpanInstance instance;
+    instance.x0 = clampToInt16(rect.x0);
+    instance.y0 = clampToInt16(rect.y0);
+    instance.x1 = clampToInt16(rect.x1);
+    instance.y1 = clampToInt16(rect.y1);
+    instance.color = color;
+    batch.push_back(instance);
+}
+
+void Renderer2D::flushBatch() {
+    if (batch.empty()) return;
+    
+    shader.use();
+    glBindVertexArray(VAO);
+    size_t offset = StreamBuffer::shared().write(batch.data(), batch.size() * sizeof(SpanInstance));
+    
+    // Rectangle as int16 (converted to float by the GPU), colour as RGBA8
+    glVertexAttribPointer(1, 4, GL_SHORT, GL_FALSE, sizeof(SpanInstance),
+                          (void*)(offset + offsetof(SpanInstance, x0)));
+    glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(SpanInstance),
+                          (void*)(offset + offsetof(SpanInstance, color)));
     
-    glPointSize(2.0f);
-    glDrawArrays(GL_POINTS, 0, pixels.size());
+    // Quad edges sit on pixel boundaries, so each span covers exactly the
+    // pixels its size-2 points would
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(batch.size()));
     
     glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
 }
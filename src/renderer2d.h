@@ -3,27 +3,27 @@
 
 #include <glad/glad.h>
 #include <glm/glm.hpp>
+#include <cstdint>
 #include <vector>
 #include "shader.h"
+#include "raster2d.h"
+#include "rasterlayer.h"
+#include "softrasterizer.h"
+#include "tilepyramid.h"
 
-struct Point2D {
-    int x, y;
-    Point2D(int x = 0, int y = 0) : x(x), y(y) {}
+// Where frames go. OPENGL draws to the current context; SOFTWARE needs no
+// context and composes each frame into getFrame() (headless renders, tests).
+enum class Renderer2DBackend {
+    OPENGL,
+    SOFTWARE
 };
 
-struct Line2D {
-    Point2D start, end;
-    glm::vec3 color;
-    Line2D(Point2D s, Point2D e, glm::vec3 c = glm::vec3(1.0f)) 
-        : start(s), end(e), color(c) {}
-};
-
-struct Circle2D {
-    Point2D center;
-    int radius;
-    glm::vec3 color;
-    Circle2D(Point2D c, int r, glm::vec3 col = glm::vec3(0.0f, 1.0f, 0.0f)) 
-        : center(c), radius(r), color(col) {}
+// One instance of the batched primitive stream: the screen rectangle a
+// span of size-2 points covers, as int16 [x0, x1) x [y0, y1), plus an RGBA8
+// colour (see SoftwareRasterizer::packColor). Drawn as an instanced quad.
+struct SpanInstance {
+    int16_t x0, y0, x1, y1;
+    uint32_t color;
 };
 
 class Renderer2D {
@@ -31,38 +31,102 @@ public:
     Renderer2D();
     ~Renderer2D();
     
-    void init(int screenWidth, int screenHeight);
+    void init(int screenWidth, int screenHeight, Renderer2DBackend renderBackend = Renderer2DBackend::OPENGL);
     void clear();
     void render();
     
-    // Drawing primitives using algorithms
+    // Drawing primitives using algorithms (screen space, clipped to the screen)
     void drawPixel(int x, int y, glm::vec3 color = glm::vec3(1.0f));
     void drawBresenhamLine(int x1, int y1, int x2, int y2, glm::vec3 color = glm::vec3(1.0f));
     void drawMidpointCircle(int cx, int cy, int radius, glm::vec3 color = glm::vec3(0.0f, 1.0f, 0.0f));
+    // Scanline fills, one span per row (points are pixel corners)
+    void drawFilledPolygon(const std::vector<Point2D>& points, glm::vec3 color);
+    void drawFilledCircle(int cx, int cy, int radius, glm::vec3 color);
     
     // Grid and guides
     void drawGrid(int gridSize, int cellSize);
     void drawCrosshair(int x, int y);
     
-    // Store drawn elements
+    // Store drawn elements (world space). These form the cached static
+    // layer: after changing them, invalidate the area they cover (or everything).
+    // Editing getLines()/getCircles() in place also needs markElementsChanged().
     void addLine(const Line2D& line);
     void addCircle(const Circle2D& circle);
+    void addPolygon(const Polygon2D& polygon); // Filled, under every line
     void clearElements();
+    void invalidateArea(const glm::vec2& minCorner, const glm::vec2& maxCorner);
+    void invalidateAll();
+    void markElementsChanged() { elementsChanged = true; }
+    
+    // From this many lines + circles + polygons on, the static layer comes from the
+    // tile pyramid instead of being repainted for the whole screen
+    void setTilePyramidThreshold(size_t primitives) { pyramidThreshold = primitives; }
+    bool usesTilePyramid() const { return pyramidMode; }
+    const TilePyramid& getTilePyramid() const { return pyramid; }
+    
+    // Drawn on top every frame without touching the layer (selection, previews)
+    void addOverlayLine(const Line2D& line);
+    void clearOverlay();
+    
+    // Changing the view repaints the whole layer (tiles are reused)
+    void setCamera(const Camera2D& newCamera);
+    const Camera2D& getCamera() const { return sceneRaster.getCamera(); }
+    
+    // What the last render() showed, as the CPU rasteriser composes it
+    // (identical to the GL output), over background. Works with either backend.
+    bool exportPNG(const std::string& path, const glm::vec3& background);
     
     std::vector<Line2D>& getLines() { return lines; }
     std::vector<Circle2D>& getCircles() { return circles; }
+    std::vector<Polygon2D>& getPolygons() { return polygons; }
+    const SoftwareRasterizer& getLayer() const { return sceneRaster; } // Static layer only
+    const SoftwareRasterizer& getFrame() const { return frameRaster; } // SOFTWARE backend
+    Renderer2DBackend getBackend() const { return backend; }
     
 private:
     Shader shader;
-    unsigned int VAO, VBO;
+    unsigned int VAO;
+    unsigned int cornerVBO;    // Unit quad shared by every instance; spans go through StreamBuffer
     int width, height;
+    Renderer2DBackend backend;
     
-    std::vector<glm::vec2> pixels;
+    std::vector<SpanInstance> batch; // Everything drawn directly this frame
     std::vector<Line2D> lines;
     std::vector<Circle2D> circles;
+    std::vector<Polygon2D> polygons;
+    std::vector<Line2D> overlayLines;
+    
+    // Static layer: grid, fills, lines and circles rasterised on the CPU, mirrored
+    // in a texture for the GL backend
+    SoftwareRasterizer sceneRaster;
+    SoftwareRasterizer frameRaster; // Layer plus this frame's spans
+    RasterLayer layer;
+    Shader layerShader;
+    unsigned int quadVAO, quadVBO;
+    std::vector<RasterRect> dirtyRects;
+    
+    // Huge cities: zoomable tiles instead of the screen-sized layer
+    TilePyramid pyramid;
+    size_t pyramidThreshold;
+    bool pyramidMode;
+    bool elementsChanged;           // Since the pyramid last took a snapshot
+    std::vector<TileKey> visibleTiles;
+    std::vector<TileKey> arrivedTiles;
+    std::vector<unsigned int> evictedTextures;
     
-    void uploadPixels();
-    void plot8Points(int cx, int cy, int x, int y, glm::vec3 color);
+    void pushSpan(const RasterSpan& span, uint32_t color); // Run of size-2 points
+    void pushRect(const RasterRect& rect, uint32_t color);
+    Point2D toScreen(const Point2D& world) const;
+    void appendOverlays();
+    void flushBatch();
+    void composeFrame();
+    void updateScene();
+    void updateLayer();
+    void drawLayer();
+    void updatePyramid();
+    void uploadTile(Tile& tile);
+    void drawTiles();
+    void composeTiles();
 };
 
 #endif
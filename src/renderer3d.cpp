@@ -4,6 +4,188 @@
 #include <cmath>
 #include <iostream>
 #include <algorithm>
+#include <cstddef>
+#include "streambuffer.h"
+
+namespace {
+
+// Object keys in the static mesh: kind in the high word, index in the low
+enum StaticObjectKind { GROUND_OBJECT, ROAD_OBJECT, BUILDING_OBJECT, WATER_OBJECT, FOUNTAIN_OBJECT };
+
+uint64_t staticKey(StaticObjectKind kind, size_t index) {
+    return (static_cast<uint64_t>(kind) << 32) | static_cast<uint32_t>(index);
+}
+
+// Placement of the unit primitives, shared by every geometry path
+
+glm::mat4 groundModel(int size) {
+    glm::mat4 model = glm::mat4(1.0f);
+    model = glm::translate(model, glm::vec3(size / 2.0f, -1.0f, size / 2.0f));
+    return glm::scale(model, glm::vec3(size, 1.0f, size));
+}
+
+glm::mat4 buildingModel(const Building& building) {
+    glm::mat4 model = glm::mat4(1.0f);
+    model = glm::translate(model, glm::vec3(building.position.x + building.size.x / 2.0f, 
+                                           building.height / 2.0f, 
+                                           building.position.y + building.size.y / 2.0f));
+    return glm::scale(model, glm::vec3(building.size.x, building.height, building.size.y));
+}
+
+// Car body 8 long along its heading (x, z), 4 wide and 4 high; tex_vert.glsl
+// builds the same matrix for instanced vehicles
+glm::mat4 vehicleModel(const glm::vec3& position, const glm::vec2& heading) {
+    return glm::mat4(glm::vec4(heading.x * 8.0f, 0.0f, heading.y * 8.0f, 0.0f),
+                     glm::vec4(0.0f, 4.0f, 0.0f, 0.0f),
+                     glm::vec4(-heading.y * 4.0f, 0.0f, heading.x * 4.0f, 0.0f),
+                     glm::vec4(position, 1.0f));
+}
+
+// Pedestrian 1.5 wide and 3.5 high, standing at (x, z); tex_vert.glsl
+// builds the same matrix for instanced pedestrians
+glm::mat4 pedestrianModel(const glm::vec2& position) {
+    glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(position.x, 1.75f, position.y));
+    return glm::scale(model, glm::vec3(1.5f, 3.5f, 1.5f));
+}
+
+// Pond: thicker than a surface for better visibility
+glm::mat4 waterModel(const Park& park) {
+    glm::mat4 model = glm::mat4(1.0f);
+    model = glm::translate(model, glm::vec3(park.center.x, 1.5f, park.center.y));
+    return glm::scale(model, glm::vec3(park.radius, 3.0f, park.radius));
+}
+
+glm::mat4 fountainModel(const Park& park) {
+    glm::mat4 model = glm::mat4(1.0f);
+    model = glm::translate(model, glm::vec3(park.center.x, 7.5f, park.center.y));
+    return glm::scale(model, glm::vec3(5.0f, 15.0f, 5.0f));
+}
+
+// Culling bounds: generous enough to hold everything drawn for the object
+
+const float VEHICLE_RADIUS = 5.5f;  // Half diagonal of the 8 x 4 body, plus a tick of travel
+const float VEHICLE_TOP = 8.0f;
+const float PEDESTRIAN_RADIUS = 1.5f;   // Half diagonal of the body, plus a tick of travel
+const float PEDESTRIAN_TOP = 3.5f;
+// Farther pedestrians are under a pixel wide; skipped unless culling is off
+const float PEDESTRIAN_DRAW_DISTANCE = 400.0f;
+const float OCCLUDER_RANGE = 400.0f;    // Farther buildings cover too little to pay off
+
+BVHBox buildingBox(const Building& building) {
+    return BVHBox(glm::vec3(building.position.x, 0.0f, building.position.y),
+                  glm::vec3(building.position.x + building.size.x, building.height, building.position.y + building.size.y));
+}
+
+// Pond and fountain
+BVHBox parkBox(const Park& park) {
+    float radius = std::max(static_cast<float>(park.radius), 5.0f);
+    return BVHBox(glm::vec3(park.center.x - radius, 0.0f, park.center.y - radius),
+                  glm::vec3(park.center.x + radius, 15.0f, park.center.y + radius));
+}
+
+// Pole and bulb
+BVHBox lightBox(const StreetLight& light) {
+    return BVHBox(glm::vec3(light.position.x - 2.0f, 0.0f, light.position.z - 2.0f),
+                  glm::vec3(light.position.x + 2.0f, 18.0f, light.position.z + 2.0f));
+}
+
+bool samePark(const Park& a, const Park& b) {
+    return a.center.x == b.center.x && a.center.y == b.center.y && a.radius == b.radius;
+}
+
+bool sameBuilding(const Building& a, const Building& b) {
+    return a.position == b.position && a.size == b.size && a.height == b.height && a.textureIndex == b.textureIndex;
+}
+
+// Mesh plus a per-instance index at location 5 into an instance state
+// buffer (the pointer is set at draw time, into the stream buffer)
+unsigned int createIndexedVAO(const Mesh& mesh) {
+    unsigned int vao;
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.VBO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.EBO);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
+    glEnableVertexAttribArray(2);
+    glEnableVertexAttribArray(5);
+    glVertexAttribDivisor(5, 1);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return vao;
+}
+
+// Buffer read in the vertex shader as RGBA32F texels through a buffer texture
+void createStateBuffer(unsigned int& buffer, unsigned int& texture) {
+    glGenBuffers(1, &buffer);
+    glGenTextures(1, &texture);
+    glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+    glBindTexture(GL_TEXTURE_BUFFER, texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, buffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+// count instances of mesh, their indices streamed at offset
+void drawIndexedInstances(unsigned int vao, const Mesh& mesh, size_t offset, size_t count) {
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, StreamBuffer::shared().getBuffer());
+    glVertexAttribIPointer(5, 1, GL_INT, sizeof(int), (void*)offset);
+    glDrawElementsInstanced(GL_TRIANGLES, static_cast<GLsizei>(mesh.indices.size()), GL_UNSIGNED_INT, 0,
+                            static_cast<GLsizei>(count));
+}
+
+BVHBox vehicleBox(const Vehicle& vehicle) {
+    return BVHBox(glm::vec3(vehicle.position.x - VEHICLE_RADIUS, 0.0f, vehicle.position.z - VEHICLE_RADIUS),
+                  glm::vec3(vehicle.position.x + VEHICLE_RADIUS, VEHICLE_TOP, vehicle.position.z + VEHICLE_RADIUS));
+}
+
+void appendAll(std::vector<int>& list, size_t count) {
+    for (size_t i = 0; i < count; ++i) list.push_back(static_cast<int>(i));
+}
+
+// Building LOD items that can share one draw
+bool sameRun(const BuildingLOD::Item& a, const BuildingLOD::Item& b) {
+    return a.level == b.level && a.dither == b.dither && a.step == b.step && a.material == b.material;
+}
+
+// Impostor atlas: stand-in buildings per height class, baked with some room
+// around them so mip levels do not bleed into the neighbouring cells
+const float IMPOSTOR_FOOTPRINT = 50.0f;
+const float IMPOSTOR_HEIGHTS[] = { 35.0f, 75.0f, 150.0f };
+const float IMPOSTOR_CLASS_LIMITS[] = { 50.0f, 100.0f };    // Upper heights of the lower classes
+const float IMPOSTOR_HOURS[] = { 12.0f, 18.0f, 23.0f };     // Day, dusk, night
+const float IMPOSTOR_PADDING = 1.125f;
+enum ImpostorVariant { IMPOSTOR_DAY, IMPOSTOR_DUSK, IMPOSTOR_NIGHT };
+
+int heightClass(float height) {
+    int result = 0;
+    while (result < 2 && height >= IMPOSTOR_CLASS_LIMITS[result]) ++result;
+    return result;
+}
+
+// Variants to mix at this hour, following the sky: day, fading to dusk in
+// the evening, night while the windows are lit, dusk brightening at dawn
+void impostorVariants(float hour, int& a, int& b, float& blend) {
+    a = b = IMPOSTOR_NIGHT;
+    blend = 0.0f;
+    if (hour >= 7.0f && hour < 17.0f) {
+        a = b = IMPOSTOR_DAY;
+    } else if (hour >= 17.0f && hour < 19.0f) {
+        a = IMPOSTOR_DAY;
+        b = IMPOSTOR_DUSK;
+        blend = (hour - 17.0f) / 2.0f;
+    } else if (hour >= 6.0f && hour < 7.0f) {
+        a = IMPOSTOR_DUSK;
+        b = IMPOSTOR_DAY;
+        blend = hour - 6.0f;
+    }
+}
+
+}
 
 // Camera implementation
 Camera::Camera() 
@@ -75,16 +257,44 @@ void Mesh::draw() {
 }
 
 // Renderer3D implementation
-Renderer3D::Renderer3D() : width(800), height(600), timeOfDay(12.0f), timeSpeed(1.0f) {}
+Renderer3D::Renderer3D()
+    : width(800), height(600), projection(1.0f), timeOfDay(12.0f), timeSpeed(1.0f), pointLightCount(0),
+      geometryPath(GeometryPath::MERGED), buildingVAO(0), buildingStateVBO(0), buildingStateTexture(0),
+      buildingInstanceRevision(0), buildingIdOffset(0),
+      impostorAtlas(0), impostorVAO(0), impostorQuadVBO(0),
+      simulationLag(0.0f), vehicleVAO(0), vehicleStateVBO(0), vehicleStateTexture(0), vehicleRevision(0),
+      pedestrianVAO(0), pedestrianStateVBO(0), pedestrianStateTexture(0), pedestrianRevision(0),
+      lightPoleVAO(0), lightBulbVAO(0), lightStateVBO(0), lightStateTexture(0),
+      staticLayoutSize(-1), staticRoadRevision(0), staticBuildingRevision(0), staticLightRevision(0), cullingMode(CullingMode::OCCLUSION) {
+    std::fill(cullOffsets, cullOffsets + CULL_KINDS + 1, 0);
+}
 
-Renderer3D::~Renderer3D() {}
+Renderer3D::~Renderer3D() {
+    if (buildingVAO) glDeleteVertexArrays(1, &buildingVAO);
+    if (buildingStateVBO) glDeleteBuffers(1, &buildingStateVBO);
+    if (buildingStateTexture) glDeleteTextures(1, &buildingStateTexture);
+    if (impostorAtlas) glDeleteTextures(1, &impostorAtlas);
+    if (impostorVAO) glDeleteVertexArrays(1, &impostorVAO);
+    if (impostorQuadVBO) glDeleteBuffers(1, &impostorQuadVBO);
+    if (vehicleVAO) glDeleteVertexArrays(1, &vehicleVAO);
+    if (vehicleStateVBO) glDeleteBuffers(1, &vehicleStateVBO);
+    if (vehicleStateTexture) glDeleteTextures(1, &vehicleStateTexture);
+    if (pedestrianVAO) glDeleteVertexArrays(1, &pedestrianVAO);
+    if (pedestrianStateVBO) glDeleteBuffers(1, &pedestrianStateVBO);
+    if (pedestrianStateTexture) glDeleteTextures(1, &pedestrianStateTexture);
+    if (lightPoleVAO) glDeleteVertexArrays(1, &lightPoleVAO);
+    if (lightBulbVAO) glDeleteVertexArrays(1, &lightBulbVAO);
+    if (lightStateVBO) glDeleteBuffers(1, &lightStateVBO);
+    if (lightStateTexture) glDeleteTextures(1, &lightStateTexture);
+}
 
 void Renderer3D::init(int screenWidth, int screenHeight) {
     width = screenWidth;
     height = screenHeight;
     
-    // Load shader
+    // Load shaders
     shader.load("shaders/tex_vert.glsl", "shaders/tex_frag.glsl");
+    impostorShader.load("shaders/impostor_vert.glsl", "shaders/impostor_frag.glsl");
     
     // Load textures with fallback colors
     buildingTexture1.load("assets/building1.jpg", true);
@@ -96,15 +306,57 @@ void Renderer3D::init(int screenWidth, int screenHeight) {
     // Set projection
     setProjection(width, height);
     
+    // Shared geometry (segment counts used by parks and street lights)
+    createCubeMesh(unitCube);
+    createQuadMesh(unitQuad);
+    getUnitCylinder(32);
+    getUnitCylinder(16);
+    getUnitCylinder(8);
+    
+    // Impostor VAO: one quad as a strip plus per-instance footprint and
+    // shape (pointers are set at draw time, into the stream buffer)
+    const float quadCorners[] = { -0.5f, 0.0f,  0.5f, 0.0f,  -0.5f, 1.0f,  0.5f, 1.0f };
+    glGenVertexArrays(1, &impostorVAO);
+    glGenBuffers(1, &impostorQuadVBO);
+    glBindVertexArray(impostorVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, impostorQuadVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(quadCorners), quadCorners, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribDivisor(1, 1);
+    glEnableVertexAttribArray(2);
+    glVertexAttribDivisor(2, 1);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    
+    // Buildings, vehicles and pedestrians (cubes) and street light poles
+    // and bulbs: instanced by index into their state buffers
+    buildingVAO = createIndexedVAO(unitCube);
+    vehicleVAO = createIndexedVAO(unitCube);
+    pedestrianVAO = createIndexedVAO(unitCube);
+    lightPoleVAO = createIndexedVAO(getUnitCylinder(8));
+    lightBulbVAO = createIndexedVAO(unitCube);
+    createStateBuffer(buildingStateVBO, buildingStateTexture);
+    createStateBuffer(vehicleStateVBO, vehicleStateTexture);
+    createStateBuffer(pedestrianStateVBO, pedestrianStateTexture);
+    createStateBuffer(lightStateVBO, lightStateTexture);
+    shader.use();
+    shader.setInt("instanceStates", INSTANCE_STATE_UNIT);
+    
+    staticMesh.init(STATIC_MATERIAL_COUNT);
+    
     // Enable depth testing
     glEnable(GL_DEPTH_TEST);
+    
+    bakeImpostorAtlas();
 }
 
 void Renderer3D::setProjection(int w, int h) {
     width = w;
     height = h;
     
-    glm::mat4 projection = glm::perspective(glm::radians(camera.fov), 
+    projection = glm::perspective(glm::radians(camera.fov), 
                                            (float)width / (float)height, 
                                            0.1f, 1000.0f);
     
@@ -112,7 +364,7 @@ void Renderer3D::setProjection(int w, int h) {
     shader.setMat4("projection", projection);
 }
 
-void Renderer3D::render(const CityGenerator& cityGen) {
+void Renderer3D::render(const CityGenerator& cityGen, const CrowdSimulation& crowd, float deltaTime) {
     // Set sky color based on time of day
     glm::vec3 skyColor = getSkyColor();
     glClearColor(skyColor.r, skyColor.g, skyColor.b, 1.0f);
@@ -131,6 +383,8 @@ void Renderer3D::render(const CityGenerator& cityGen) {
     shader.setVec3("lightColor", sunColor);
     shader.setVec3("viewPos", camera.position);
     shader.setFloat("emissive", 0.0f); // Normal lighting by default
+    shader.setInt("instanced", 0);
+    shader.setInt("facadeWindows", 0);
     shader.setInt("useTexture", 1); // Use texture by default
     shader.setVec3("materialColor", glm::vec3(1.0f, 1.0f, 1.0f)); // Default white
     
@@ -140,6 +394,7 @@ void Renderer3D::render(const CityGenerator& cityGen) {
         // Increase limit to 100 for better coverage
         int numLights = std::min(static_cast<int>(streetLights.size()), 100);
         shader.setInt("numPointLights", numLights);
+        pointLightCount = numLights;
         
         for (int i = 0; i < numLights; i++) {
             std::string posName = "pointLightPositions[" + std::to_string(i) + "]";
@@ -151,181 +406,588 @@ void Renderer3D::render(const CityGenerator& cityGen) {
         }
     } else {
         shader.setInt("numPointLights", 0);
+        pointLightCount = 0;
     }
     
     // Render scene components
-    renderGround(cityGen.getLayoutSize());
-    renderRoads(cityGen.getRoads());
-    renderBuildings(cityGen.getBuildings());
-    renderParks(cityGen.getParks());
-    renderVehicles(cityGen.getVehicles());
+    updateStaticScene(cityGen);
+    updateVehicleStates(cityGen.getVehicles(), cityGen.getVehicleRevision());
+    updatePedestrianStates(crowd);
+    cullScene(cityGen);
+    buildingLOD.update(cityGen.getBuildings(), visibleBuildings, camera.position, deltaTime);
+    if (geometryPath == GeometryPath::MERGED) {
+        renderStaticMesh();
+    } else {
+        renderGround(cityGen.getLayoutSize());
+        renderRoads();
+        renderParks(cityGen.getParks());
+    }
+    renderBuildings(cityGen.getBuildings(), cityGen.getBuildingRevision());
+    renderVehicles();
+    renderPedestrians();
     
     // Render street lights at night
     if (isNightTime()) {
-        renderStreetLights(cityGen.getStreetLights());
+        renderStreetLights();
     }
+    
+    // Last, as it switches shaders
+    renderImpostors(cityGen.getBuildings());
 }
 
 void Renderer3D::renderGround(int size) {
     grassTexture.bind(0);
     shader.setInt("diffuseTexture", 0);
     
-    glm::mat4 model = glm::mat4(1.0f);
-    model = glm::translate(model, glm::vec3(size / 2.0f, -1.0f, size / 2.0f));
-    model = glm::scale(model, glm::vec3(size, 1.0f, size));
-    shader.setMat4("model", model);
-    
-    // Create ground quad
-    float vertices[] = {
-        // Positions          // Normals           // TexCoords
-        -0.5f, 0.0f, -0.5f,   0.0f, 1.0f, 0.0f,   0.0f, 0.0f,
-         0.5f, 0.0f, -0.5f,   0.0f, 1.0f, 0.0f,   10.0f, 0.0f,
-         0.5f, 0.0f,  0.5f,   0.0f, 1.0f, 0.0f,   10.0f, 10.0f,
-        -0.5f, 0.0f,  0.5f,   0.0f, 1.0f, 0.0f,   0.0f, 10.0f
-    };
-    
-    unsigned int indices[] = {
-        0, 1, 2,
-        2, 3, 0
-    };
+    shader.setMat4("model", groundModel(size));
     
-    unsigned int VAO, VBO, EBO;
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    glGenBuffers(1, &EBO);
-    
-    glBindVertexArray(VAO);
+    unitQuad.draw();
+}
+
+// Visible buildings by LOD run: each run of equal level, dither step and
+// facade texture is one draw in the merged and instanced paths. Impostors
+// are left to renderImpostors.
+void Renderer3D::renderBuildings(const std::vector<Building>& buildings, uint64_t revision) {
+    const auto& items = buildingLOD.getItems();
+    size_t end = buildingLOD.getImpostorStart();
+    if (end == 0) return;
     
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    if (geometryPath == GeometryPath::INSTANCED) {
+        if (revision != buildingInstanceRevision) {
+            updateBuildingInstances(buildings);
+            buildingInstanceRevision = revision;
+        }
+        
+        // Item order, so every run's ids are one contiguous range
+        buildingIds.resize(end);
+        for (size_t i = 0; i < end; ++i) buildingIds[i] = items[i].building;
+        buildingIdOffset = StreamBuffer::shared().write(buildingIds.data(), buildingIds.size() * sizeof(int));
+        glActiveTexture(GL_TEXTURE0 + INSTANCE_STATE_UNIT);
+        glBindTexture(GL_TEXTURE_BUFFER, buildingStateTexture);
+        shader.setInt("instanced", 1);
+    } else if (geometryPath == GeometryPath::MERGED) {
+        shader.setMat4("model", glm::mat4(1.0f)); // Baked in world space
+    }
+    shader.setInt("diffuseTexture", 0);
     
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+    for (size_t begin = 0; begin < end;) {
+        size_t next = begin + 1;
+        while (next < end && sameRun(items[next], items[begin])) ++next;
+        
+        setBuildingLevel(items[begin]);
+        if (items[begin].material == 0) buildingTexture1.bind(0);
+        else buildingTexture2.bind(0);
+        drawBuildingRun(buildings, begin, next);
+        begin = next;
+    }
     
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-    glEnableVertexAttribArray(2);
+    if (geometryPath == GeometryPath::INSTANCED) {
+        glActiveTexture(GL_TEXTURE0 + INSTANCE_STATE_UNIT);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+        glActiveTexture(GL_TEXTURE0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindVertexArray(0);
+        shader.setInt("instanced", 0);
+    }
+    shader.setInt("facadeWindows", 0);
+    shader.setInt("numPointLights", pointLightCount);
+    shader.setInt("lodDither", BuildingLOD::SOLID);
+}
+
+// Full detail lights the window grid at night and takes the street lights;
+// a plain box only tints its walls by the windows' average and skips them
+void Renderer3D::setBuildingLevel(const BuildingLOD::Item& item) {
+    bool night = isNightTime();
+    bool full = item.level == BuildingLOD::FULL;
+    shader.setInt("facadeWindows", night ? (full ? 1 : 2) : 0);
+    shader.setInt("numPointLights", full ? pointLightCount : 0);
+    shader.setInt("lodDither", item.dither);
+    shader.setFloat("lodCut", BuildingLOD::ditherCut(item.step));
+}
+
+void Renderer3D::drawBuildingRun(const std::vector<Building>& buildings, size_t begin, size_t end) {
+    const auto& items = buildingLOD.getItems();
     
-    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+    if (geometryPath == GeometryPath::MERGED) {
+        visibleKeys.clear();
+        for (size_t i = begin; i < end; ++i) visibleKeys.push_back(staticKey(BUILDING_OBJECT, items[i].building));
+        staticMesh.drawObjects(STATIC_FACADE_1 + items[begin].material, visibleKeys);
+    } else if (geometryPath == GeometryPath::INSTANCED) {
+        // No base-instance draws in GL 3.3: point the ids at the run
+        drawIndexedInstances(buildingVAO, unitCube, buildingIdOffset + begin * sizeof(int), end - begin);
+    } else {
+        for (size_t i = begin; i < end; ++i) {
+            const Building& building = buildings[items[i].building];
+            shader.setMat4("model", buildingModel(building));
+            
+            // The cube VAO has no box arrays, so these constants feed the shader
+            glVertexAttrib4f(3, building.position.x, building.position.y, building.size.x, building.size.y);
+            glVertexAttrib1f(4, building.height);
+            
+            unitCube.draw();
+        }
+    }
+}
+
+// One instance per building, in building order; only rewritten when the
+// buildings change
+void Renderer3D::updateBuildingInstances(const std::vector<Building>& buildings) {
+    buildingInstances.resize(buildings.size());
+    for (size_t i = 0; i < buildings.size(); ++i) {
+        buildingInstances[i].footprint = glm::vec4(buildings[i].position, buildings[i].size);
+        buildingInstances[i].height = glm::vec4(buildings[i].height, 0.0f, 0.0f, 0.0f);
+    }
     
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
-    glDeleteBuffers(1, &EBO);
+    glBindBuffer(GL_TEXTURE_BUFFER, buildingStateVBO);
+    glBufferData(GL_TEXTURE_BUFFER, buildingInstances.size() * sizeof(BuildingInstance),
+                 buildingInstances.data(), GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
 }
 
-void Renderer3D::renderBuildings(const std::vector<Building>& buildings) {
-    for (const auto& building : buildings) {
-        if (building.textureIndex == 0)
-            buildingTexture1.bind(0);
-        else
-            buildingTexture2.bind(0);
+// Renders each archetype at each variant's hour into its atlas cell with the
+// main shader: orthographic, corner-on, street lights off
+void Renderer3D::bakeImpostorAtlas() {
+    int atlasWidth = IMPOSTOR_ARCHETYPES * IMPOSTOR_CELL_WIDTH;
+    int atlasHeight = IMPOSTOR_VARIANTS * IMPOSTOR_CELL_HEIGHT;
+    glGenTextures(1, &impostorAtlas);
+    glBindTexture(GL_TEXTURE_2D, impostorAtlas);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, atlasWidth, atlasHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 2); // Deeper levels would bleed across cells
+    
+    unsigned int framebuffer, depthBuffer;
+    glGenFramebuffers(1, &framebuffer);
+    glGenRenderbuffers(1, &depthBuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, atlasWidth, atlasHeight);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, impostorAtlas, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+    
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "[RENDER] Impostor atlas framebuffer incomplete; building LOD disabled" << std::endl;
+        buildingLOD.setEnabled(false);
+    } else {
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
         
+        shader.use();
+        shader.setInt("instanced", 0);
+        shader.setInt("useTexture", 1);
+        shader.setFloat("emissive", 0.0f);
+        shader.setInt("numPointLights", 0);
+        shader.setInt("lodDither", BuildingLOD::SOLID);
         shader.setInt("diffuseTexture", 0);
         
-        Mesh mesh = createCubeMesh(building.size.x, building.height, building.size.y);
-        
-        glm::mat4 model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(building.position.x + building.size.x / 2.0f, 
-                                               building.height / 2.0f, 
-                                               building.position.y + building.size.y / 2.0f));
-        shader.setMat4("model", model);
-        
-        mesh.draw();
-        
-        // Add glowing windows at night
-        if (isNightTime()) {
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, 0);
-            
-            // Create small window cubes on building facade - multiple sides
-            int numWindowRows = static_cast<int>(building.height / 12.0f);
-            if (numWindowRows < 1) numWindowRows = 1;
+        float savedTime = timeOfDay;
+        glm::vec3 corner = glm::normalize(glm::vec3(1.0f, 0.0f, 1.0f));
+        float across = IMPOSTOR_FOOTPRINT * std::sqrt(2.0f) * 0.5f * IMPOSTOR_PADDING;
+        for (int variant = 0; variant < IMPOSTOR_VARIANTS; ++variant) {
+            timeOfDay = IMPOSTOR_HOURS[variant];
+            shader.setVec3("lightPos", getSunPosition());
+            shader.setVec3("lightColor", getSunLightColor());
+            shader.setInt("facadeWindows", isNightTime() ? 1 : 0);
             
-            for (int i = 0; i < numWindowRows; ++i) {
-                float windowY = 8.0f + i * 12.0f;
+            for (int column = 0; column < IMPOSTOR_ARCHETYPES; ++column) {
+                Building standIn;
+                standIn.position = glm::vec2(-IMPOSTOR_FOOTPRINT * 0.5f);
+                standIn.size = glm::vec2(IMPOSTOR_FOOTPRINT);
+                standIn.height = IMPOSTOR_HEIGHTS[column % IMPOSTOR_HEIGHT_CLASSES];
+                standIn.textureIndex = column / IMPOSTOR_HEIGHT_CLASSES;
                 
-                // Front windows (multiple across facade)
-                int windowsPerRow = static_cast<int>(building.size.x / 15.0f);
-                if (windowsPerRow < 1) windowsPerRow = 1;
+                glm::vec3 eye = corner * IMPOSTOR_FOOTPRINT * 2.0f;
+                shader.setMat4("projection", glm::ortho(-across, across, 0.0f, standIn.height * IMPOSTOR_PADDING,
+                                                        0.1f, IMPOSTOR_FOOTPRINT * 4.0f));
+                shader.setMat4("view", glm::lookAt(eye, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f)));
+                shader.setVec3("viewPos", eye);
+                shader.setMat4("model", buildingModel(standIn));
+                glVertexAttrib4f(3, standIn.position.x, standIn.position.y, standIn.size.x, standIn.size.y);
+                glVertexAttrib1f(4, standIn.height);
+                if (standIn.textureIndex == 0) buildingTexture1.bind(0);
+                else buildingTexture2.bind(0);
                 
-                for (int w = 0; w < windowsPerRow; ++w) {
-                    float windowX = building.position.x + 10.0f + w * 15.0f;
-                    if (windowX > building.position.x + building.size.x - 10.0f) continue;
-                    
-                    Mesh window = createCubeMesh(4.0f, 3.0f, 0.8f);
-                    model = glm::mat4(1.0f);
-                    model = glm::translate(model, glm::vec3(
-                        windowX,
-                        windowY,
-                        building.position.y + building.size.y / 2.0f + building.size.y / 2.0f + 0.5f
-                    ));
-                    shader.setMat4("model", model);
-                    
-                    // Bright warm yellow glow - EMISSIVE!
-                    shader.setFloat("emissive", 1.0f); // Enable glow
-                    shader.setVec3("lightColor", glm::vec3(1.0f, 0.9f, 0.4f)); // Bright warm yellow
-                    window.draw();
-                    shader.setFloat("emissive", 0.0f); // Disable glow
-                }
+                glViewport(column * IMPOSTOR_CELL_WIDTH, variant * IMPOSTOR_CELL_HEIGHT,
+                           IMPOSTOR_CELL_WIDTH, IMPOSTOR_CELL_HEIGHT);
+                unitCube.draw();
             }
-            
-            // Restore lighting
-            glm::vec3 sunColor = getSunLightColor();
-            glm::vec3 sunPos = getSunPosition();
-            shader.setVec3("lightPos", sunPos);
-            shader.setVec3("lightColor", sunColor);
-            shader.setFloat("emissive", 0.0f);
         }
+        timeOfDay = savedTime;
+        
+        shader.setMat4("projection", projection);
+        shader.setInt("facadeWindows", 0);
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+        std::cout << "[RENDER] Baked impostor atlas: " << IMPOSTOR_ARCHETYPES << " archetypes x "
+                  << IMPOSTOR_VARIANTS << " time-of-day variants" << std::endl;
     }
+    
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteRenderbuffers(1, &depthBuffer);
+    glDeleteFramebuffers(1, &framebuffer);
+    glBindTexture(GL_TEXTURE_2D, impostorAtlas);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, 0);
 }
 
-void Renderer3D::renderRoads(const std::vector<Road>& roads) {
-    roadTexture.bind(0);
-    shader.setInt("diffuseTexture", 0);
+// Distant buildings as camera-facing quads from the atlas, streamed each
+// frame; one instanced draw per dither step, the two nearest time-of-day
+// variants mixed in the shader
+void Renderer3D::renderImpostors(const std::vector<Building>& buildings) {
+    const auto& items = buildingLOD.getItems();
+    size_t first = buildingLOD.getImpostorStart();
+    if (first == items.size()) return;
     
-    for (const auto& road : roads) {
-        glm::vec3 start(road.start.x, 0.0f, road.start.y);
-        glm::vec3 end(road.end.x, 0.0f, road.end.y);
-        
-        glm::vec3 direction = end - start;
-        float length = glm::length(direction);
-        direction = glm::normalize(direction);
-        
-        glm::vec3 center = (start + end) / 2.0f;
-        
-        glm::mat4 model = glm::mat4(1.0f);
-        model = glm::translate(model, center);
+    impostorInstances.resize(items.size() - first);
+    for (size_t i = first; i < items.size(); ++i) {
+        const Building& building = buildings[items[i].building];
+        ImpostorInstance& instance = impostorInstances[i - first];
+        instance.footprint = glm::vec4(building.position, building.size);
+        int column = items[i].material * IMPOSTOR_HEIGHT_CLASSES + heightClass(building.height);
+        instance.shape = glm::vec2(building.height, static_cast<float>(column));
+    }
+    
+    int variantA, variantB;
+    float variantBlend;
+    impostorVariants(timeOfDay, variantA, variantB, variantBlend);
+    
+    impostorShader.use();
+    impostorShader.setMat4("view", camera.getViewMatrix());
+    impostorShader.setMat4("projection", projection);
+    impostorShader.setVec3("viewPos", camera.position);
+    impostorShader.setVec2("atlasCells", glm::vec2(IMPOSTOR_ARCHETYPES, IMPOSTOR_VARIANTS));
+    impostorShader.setFloat("padding", IMPOSTOR_PADDING);
+    impostorShader.setInt("variantA", variantA);
+    impostorShader.setInt("variantB", variantB);
+    impostorShader.setFloat("variantBlend", variantBlend);
+    impostorShader.setInt("atlas", 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, impostorAtlas);
+    
+    glBindVertexArray(impostorVAO);
+    size_t offset = StreamBuffer::shared().write(impostorInstances.data(), impostorInstances.size() * sizeof(ImpostorInstance));
+    for (size_t begin = first; begin < items.size();) {
+        size_t next = begin + 1;
+        while (next < items.size() && items[next].dither == items[begin].dither && items[next].step == items[begin].step) ++next;
         
-        float angle = atan2(direction.z, direction.x);
-        model = glm::rotate(model, angle, glm::vec3(0.0f, 1.0f, 0.0f));
-        model = glm::scale(model, glm::vec3(length, 0.5f, 8.0f));
+        impostorShader.setInt("lodDither", items[begin].dither);
+        impostorShader.setFloat("lodCut", BuildingLOD::ditherCut(items[begin].step));
+        size_t runOffset = offset + (begin - first) * sizeof(ImpostorInstance);
+        glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(ImpostorInstance),
+                              (void*)(runOffset + offsetof(ImpostorInstance, footprint)));
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(ImpostorInstance),
+                              (void*)(runOffset + offsetof(ImpostorInstance, shape)));
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(next - begin));
+        begin = next;
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    
+    shader.use();
+}
+
+// Re-bakes only the objects that differ from what the static mesh holds and
+// keeps the culling BVH in step: moved buildings are refitted, anything
+// else (new roads, parks, lights or a different building count) rebuilds
+// it. Buildings and lights are looked at only when their revision has
+// moved on.
+void Renderer3D::updateStaticScene(const CityGenerator& cityGen) {
+    bool rebuild = false;
+    
+    if (cityGen.getLayoutSize() != staticLayoutSize) {
+        staticLayoutSize = cityGen.getLayoutSize();
+        staticMesh.setObject(staticKey(GROUND_OBJECT, 0), STATIC_GRASS, unitQuad.vertices, unitQuad.indices,
+                             groundModel(staticLayoutSize));
+    }
+    
+    if (cityGen.getRoadRevision() != staticRoadRevision) {
+        staticRoadRevision = cityGen.getRoadRevision();
+        size_t oldCount = roadMesh.getPieces().size();
+        roadMesh.build(cityGen.getRoadGraph());
         
-        shader.setMat4("model", model);
+        const auto& pieces = roadMesh.getPieces();
+        for (size_t i = 0; i < pieces.size(); ++i) {
+            staticMesh.setObject(staticKey(ROAD_OBJECT, i), STATIC_ROAD, pieces[i].vertices, pieces[i].indices, glm::mat4(1.0f));
+        }
+        for (size_t i = pieces.size(); i < oldCount; ++i) staticMesh.removeObject(staticKey(ROAD_OBJECT, i));
+        std::cout << "[RENDER] Road mesh: " << pieces.size() << " strips and junctions" << std::endl;
+        rebuild = true;
+    }
+    
+    const auto& parks = cityGen.getParks();
+    bool parksChanged = parks.size() != staticParks.size();
+    for (size_t i = 0; i < parks.size(); ++i) {
+        if (i < staticParks.size() && samePark(parks[i], staticParks[i])) continue;
+        const Mesh& water = getUnitCylinder(32);
+        const Mesh& fountain = getUnitCylinder(16);
+        staticMesh.setObject(staticKey(WATER_OBJECT, i), STATIC_WATER, water.vertices, water.indices, waterModel(parks[i]));
+        staticMesh.setObject(staticKey(FOUNTAIN_OBJECT, i), STATIC_FOUNTAIN, fountain.vertices, fountain.indices,
+                             fountainModel(parks[i]));
+        parksChanged = true;
+    }
+    if (parksChanged) {
+        for (size_t i = parks.size(); i < staticParks.size(); ++i) {
+            staticMesh.removeObject(staticKey(WATER_OBJECT, i));
+            staticMesh.removeObject(staticKey(FOUNTAIN_OBJECT, i));
+        }
+        staticParks = parks;
+        rebuild = true;
+    }
+    
+    // Lights are culled and instanced, not baked (they are drawn at night only)
+    if (cityGen.getStreetLightRevision() != staticLightRevision) {
+        staticLightRevision = cityGen.getStreetLightRevision();
+        staticLights = cityGen.getStreetLights();
+        updateLightPieces();
+        rebuild = true;
+    }
+    
+    if (cityGen.getBuildingRevision() != staticBuildingRevision) {
+        staticBuildingRevision = cityGen.getBuildingRevision();
         
-        Mesh mesh = createCubeMesh(1.0f, 1.0f, 1.0f);
-        mesh.draw();
+        const auto& buildings = cityGen.getBuildings();
+        if (buildings.size() != staticBuildings.size()) rebuild = true;
+        for (size_t i = 0; i < buildings.size(); ++i) {
+            if (i < staticBuildings.size() && sameBuilding(buildings[i], staticBuildings[i])) continue;
+            int material = buildings[i].textureIndex == 0 ? STATIC_FACADE_1 : STATIC_FACADE_2;
+            staticMesh.setObject(staticKey(BUILDING_OBJECT, i), material, unitCube.vertices, unitCube.indices,
+                                 buildingModel(buildings[i]), glm::vec4(buildings[i].position, buildings[i].size),
+                                 buildings[i].height);
+            if (!rebuild) staticBVH.refit(cullOffsets[CULL_BUILDINGS] + static_cast<int>(i), buildingBox(buildings[i]));
+        }
+        for (size_t i = buildings.size(); i < staticBuildings.size(); ++i) {
+            staticMesh.removeObject(staticKey(BUILDING_OBJECT, i));
+        }
+        staticBuildings = buildings;
+    }
+    
+    if (rebuild) rebuildStaticBVH();
+}
+
+void Renderer3D::rebuildStaticBVH() {
+    std::vector<BVHBox> boxes;
+    boxes.reserve(roadMesh.getPieces().size() + staticBuildings.size() + staticParks.size() + staticLights.size());
+    
+    cullOffsets[CULL_ROADS] = 0;
+    for (const auto& piece : roadMesh.getPieces()) boxes.push_back(piece.box);
+    cullOffsets[CULL_BUILDINGS] = static_cast<int>(boxes.size());
+    for (const auto& building : staticBuildings) boxes.push_back(buildingBox(building));
+    cullOffsets[CULL_PARKS] = static_cast<int>(boxes.size());
+    for (const auto& park : staticParks) boxes.push_back(parkBox(park));
+    cullOffsets[CULL_LIGHTS] = static_cast<int>(boxes.size());
+    for (const auto& light : staticLights) boxes.push_back(lightBox(light));
+    cullOffsets[CULL_KINDS] = static_cast<int>(boxes.size());
+    
+    staticBVH.build(boxes);
+}
+
+// Once per simulation tick: the state buffer the vehicle shader reads and
+// the culling grid (both at tick positions)
+void Renderer3D::updateVehicleStates(const std::vector<Vehicle>& vehicles, uint64_t revision) {
+    if (revision == vehicleRevision) return;
+    vehicleRevision = revision;
+    
+    vehicleCenters.resize(vehicles.size());
+    vehicleStates.resize(vehicles.size());
+    for (size_t i = 0; i < vehicles.size(); ++i) {
+        const Vehicle& vehicle = vehicles[i];
+        glm::vec3 velocity = vehicle.direction * vehicle.speed * vehicle.speedScale;
+        vehicleCenters[i] = vehicle.position;
+        vehicleStates[i].position = glm::vec4(vehicle.position, vehicle.direction.x);
+        vehicleStates[i].velocity = glm::vec4(velocity, vehicle.direction.z);
+    }
+    vehicleGrid.build(vehicleCenters, VEHICLE_RADIUS, VEHICLE_TOP);
+    
+    glBindBuffer(GL_TEXTURE_BUFFER, vehicleStateVBO);
+    glBufferData(GL_TEXTURE_BUFFER, vehicleStates.size() * sizeof(VehicleState), vehicleStates.data(), GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+// Once per simulation tick, as for vehicles
+void Renderer3D::updatePedestrianStates(const CrowdSimulation& crowd) {
+    if (crowd.getRevision() == pedestrianRevision) return;
+    pedestrianRevision = crowd.getRevision();
+    
+    const auto& posX = crowd.getPositionsX();
+    const auto& posY = crowd.getPositionsY();
+    const auto& dirX = crowd.getDirectionsX();
+    const auto& dirY = crowd.getDirectionsY();
+    const auto& speeds = crowd.getSpeeds();
+    int count = crowd.getPedestrianCount();
+    
+    pedestrianCenters.resize(count);
+    pedestrianStates.resize(count);
+    for (int i = 0; i < count; ++i) {
+        pedestrianCenters[i] = glm::vec3(posX[i], 0.0f, posY[i]);
+        pedestrianStates[i] = glm::vec4(posX[i], posY[i], dirX[i] * speeds[i], dirY[i] * speeds[i]);
+    }
+    pedestrianGrid.build(pedestrianCenters, PEDESTRIAN_RADIUS, PEDESTRIAN_TOP);
+    
+    glBindBuffer(GL_TEXTURE_BUFFER, pedestrianStateVBO);
+    glBufferData(GL_TEXTURE_BUFFER, pedestrianStates.size() * sizeof(glm::vec4), pedestrianStates.data(), GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+// Fills the visible index lists for this frame (everything when culling is off)
+void Renderer3D::cullScene(const CityGenerator& cityGen) {
+    visibleRoads.clear();
+    visibleBuildings.clear();
+    visibleParks.clear();
+    visibleLights.clear();
+    visibleVehicles.clear();
+    visiblePedestrians.clear();
+    
+    const auto& vehicles = cityGen.getVehicles();
+    if (cullingMode == CullingMode::OFF) {
+        appendAll(visibleRoads, roadMesh.getPieces().size());
+        appendAll(visibleBuildings, staticBuildings.size());
+        appendAll(visibleParks, staticParks.size());
+        appendAll(visibleLights, staticLights.size());
+        appendAll(visibleVehicles, vehicles.size());
+        appendAll(visiblePedestrians, pedestrianStates.size());
+        return;
+    }
+    
+    Frustum frustum(projection * camera.getViewMatrix());
+    
+    // Sorted ids come out grouped by kind and in draw order within each
+    visibleIds.clear();
+    staticBVH.cull(frustum, visibleIds);
+    std::sort(visibleIds.begin(), visibleIds.end());
+    std::vector<int>* lists[CULL_KINDS] = { &visibleRoads, &visibleBuildings, &visibleParks, &visibleLights };
+    int kind = 0;
+    for (int id : visibleIds) {
+        while (id >= cullOffsets[kind + 1]) ++kind;
+        lists[kind]->push_back(id - cullOffsets[kind]);
+    }
+    
+    vehicleGrid.cull(frustum, visibleVehicles);
+    std::sort(visibleVehicles.begin(), visibleVehicles.end());
+    
+    // Too many and too small for occlusion tests; distance limits them instead
+    pedestrianGrid.cull(frustum, visiblePedestrians);
+    glm::vec2 eye(camera.position.x, camera.position.z);
+    size_t kept = 0;
+    for (int index : visiblePedestrians) {
+        glm::vec2 offset = glm::vec2(pedestrianStates[index]) - eye;
+        if (glm::dot(offset, offset) <= PEDESTRIAN_DRAW_DISTANCE * PEDESTRIAN_DRAW_DISTANCE) visiblePedestrians[kept++] = index;
+    }
+    visiblePedestrians.resize(kept);
+    std::sort(visiblePedestrians.begin(), visiblePedestrians.end());
+    
+    if (cullingMode == CullingMode::OCCLUSION) cullOccluded(cityGen);
+}
+
+// Removes frustum-visible objects hidden behind the biggest nearby buildings.
+// Occluders are scored by footprint times height over squared distance.
+void Renderer3D::cullOccluded(const CityGenerator& cityGen) {
+    occlusion.begin(projection * camera.getViewMatrix(), camera.position);
+    
+    occluderCandidates.clear();
+    for (size_t i = 0; i < visibleBuildings.size(); ++i) {
+        const Building& building = staticBuildings[visibleBuildings[i]];
+        glm::vec2 center = building.position + building.size * 0.5f;
+        glm::vec2 offset = center - glm::vec2(camera.position.x, camera.position.z);
+        float distanceSquared = std::max(glm::dot(offset, offset), 1.0f);
+        if (distanceSquared > OCCLUDER_RANGE * OCCLUDER_RANGE) continue;
+        float score = std::max(building.size.x, building.size.y) * building.height / distanceSquared;
+        occluderCandidates.push_back(std::make_pair(score, static_cast<int>(i)));
+    }
+    if (occluderCandidates.size() > static_cast<size_t>(MAX_OCCLUDERS)) {
+        std::nth_element(occluderCandidates.begin(), occluderCandidates.begin() + MAX_OCCLUDERS, occluderCandidates.end(),
+                         [](const std::pair<float, int>& a, const std::pair<float, int>& b) { return a.first > b.first; });
+        occluderCandidates.resize(MAX_OCCLUDERS);
+    }
+    for (const auto& candidate : occluderCandidates) {
+        occlusion.addOccluder(buildingBox(staticBuildings[visibleBuildings[candidate.second]]));
+    }
+    if (occlusion.getOccluderCount() == 0) return;
+    occlusion.rasterize();
+    
+    // Every visible object in one batch, kinds in turn
+    const auto& vehicles = cityGen.getVehicles();
+    occludeeBoxes.clear();
+    for (int index : visibleRoads) occludeeBoxes.push_back(roadMesh.getPieces()[index].box);
+    for (int index : visibleBuildings) occludeeBoxes.push_back(buildingBox(staticBuildings[index]));
+    for (int index : visibleParks) occludeeBoxes.push_back(parkBox(staticParks[index]));
+    for (int index : visibleLights) occludeeBoxes.push_back(lightBox(staticLights[index]));
+    for (int index : visibleVehicles) occludeeBoxes.push_back(vehicleBox(vehicles[index]));
+    occlusion.testBoxes(occludeeBoxes, occludeeHidden);
+    // Occluders stay, whatever rounding says about their own faces
+    for (const auto& candidate : occluderCandidates) occludeeHidden[visibleRoads.size() + candidate.second] = 0;
+    
+    size_t next = 0;
+    std::vector<int>* lists[] = { &visibleRoads, &visibleBuildings, &visibleParks, &visibleLights, &visibleVehicles };
+    for (std::vector<int>* list : lists) {
+        size_t kept = 0;
+        for (int index : *list) {
+            if (!occludeeHidden[next++]) (*list)[kept++] = index;
+        }
+        list->resize(kept);
     }
 }
 
+// Ground, roads, ponds and fountains: one draw per material, limited to the
+// visible objects' index ranges when culling (building shells are drawn by
+// LOD run in renderBuildings)
+void Renderer3D::renderStaticMesh() {
+    shader.setMat4("model", glm::mat4(1.0f)); // Baked in world space
+    shader.setInt("diffuseTexture", 0);
+    
+    grassTexture.bind(0);
+    staticMesh.draw(STATIC_GRASS);
+    renderRoads();
+    
+    // Water is a flat emissive colour, as in renderParks
+    shader.setInt("useTexture", 0);
+    shader.setVec3("materialColor", glm::vec3(0.2f, 0.6f, 1.0f)); // Bright blue water
+    shader.setFloat("emissive", 1.0f);
+    drawStaticMaterial(STATIC_WATER, visibleParks, WATER_OBJECT);
+    shader.setInt("useTexture", 1);
+    shader.setFloat("emissive", 0.0f);
+    
+    fountainTexture.bind(0);
+    drawStaticMaterial(STATIC_FOUNTAIN, visibleParks, FOUNTAIN_OBJECT);
+}
+
+void Renderer3D::drawStaticMaterial(int material, const std::vector<int>& visible, int kind) {
+    if (cullingMode == CullingMode::OFF) {
+        staticMesh.draw(material);
+        return;
+    }
+    
+    visibleKeys.clear();
+    for (int index : visible) visibleKeys.push_back(staticKey(static_cast<StaticObjectKind>(kind), index));
+    staticMesh.drawObjects(material, visibleKeys);
+}
+
+// The road surface is one merged batch in every geometry path
+void Renderer3D::renderRoads() {
+    roadTexture.bind(0);
+    shader.setInt("diffuseTexture", 0);
+    shader.setMat4("model", glm::mat4(1.0f)); // Baked in world space
+    
+    drawStaticMaterial(STATIC_ROAD, visibleRoads, ROAD_OBJECT);
+}
+
 void Renderer3D::renderParks(const std::vector<Park>& parks) {
     // Render beautiful blue water pond
-    for (const auto& park : parks) {
-        // Create blue water surface - thicker for better visibility
-        Mesh waterMesh = createCylinderMesh(park.radius, 3.0f, 32);
+    for (int index : visibleParks) {
+        const Park& park = parks[index];
         
-        glm::mat4 model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(park.center.x, 1.5f, park.center.y));
-        shader.setMat4("model", model);
+        // Blue water surface
+        shader.setMat4("model", waterModel(park));
         
         // Use material color with full emissive for bright blue water
         shader.setInt("useTexture", 0); // Don't use texture
         shader.setVec3("materialColor", glm::vec3(0.2f, 0.6f, 1.0f)); // Bright blue water
         shader.setFloat("emissive", 1.0f); // Full emissive - pure color
         
-        waterMesh.draw();
+        getUnitCylinder(32).draw();
         
         // Restore defaults for other objects
         shader.setInt("useTexture", 1);
@@ -333,22 +995,17 @@ void Renderer3D::renderParks(const std::vector<Park>& parks) {
         
         // Add decorative fountain in center
         fountainTexture.bind(0);
-        Mesh fountain = createCylinderMesh(5.0f, 15.0f, 16);
         
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(park.center.x, 7.5f, park.center.y));
-        shader.setMat4("model", model);
+        shader.setMat4("model", fountainModel(park));
         
-        fountain.draw();
+        getUnitCylinder(16).draw();
     }
 }
 
-Mesh Renderer3D::createCubeMesh(float width, float height, float depth) {
-    Mesh mesh;
-    
-    float w = width / 2.0f;
-    float h = height / 2.0f;
-    float d = depth / 2.0f;
+void Renderer3D::createCubeMesh(Mesh& mesh) {
+    float w = 0.5f;
+    float h = 0.5f;
+    float d = 0.5f;
     
     mesh.vertices = {
         // Positions          // Normals           // TexCoords
@@ -399,13 +1056,28 @@ Mesh Renderer3D::createCubeMesh(float width, float height, float depth) {
     };
     
     mesh.setup();
-    return mesh;
 }
 
-Mesh Renderer3D::createCylinderMesh(float radius, float height, int segments) {
-    Mesh mesh;
+void Renderer3D::createQuadMesh(Mesh& mesh) {
+    mesh.vertices = {
+        // Positions          // Normals           // TexCoords
+        -0.5f, 0.0f, -0.5f,   0.0f, 1.0f, 0.0f,   0.0f, 0.0f,
+         0.5f, 0.0f, -0.5f,   0.0f, 1.0f, 0.0f,   10.0f, 0.0f,
+         0.5f, 0.0f,  0.5f,   0.0f, 1.0f, 0.0f,   10.0f, 10.0f,
+        -0.5f, 0.0f,  0.5f,   0.0f, 1.0f, 0.0f,   0.0f, 10.0f
+    };
     
-    float halfHeight = height / 2.0f;
+    mesh.indices = {
+        0, 1, 2,
+        2, 3, 0
+    };
+    
+    mesh.setup();
+}
+
+void Renderer3D::createCylinderMesh(Mesh& mesh, int segments) {
+    float radius = 1.0f;
+    float halfHeight = 0.5f;
     
     // Generate vertices
     for (int i = 0; i <= segments; ++i) {
@@ -446,6 +1118,11 @@ Mesh Renderer3D::createCylinderMesh(float radius, float height, int segments) {
     }
     
     mesh.setup();
+}
+
+Mesh& Renderer3D::getUnitCylinder(int segments) {
+    Mesh& mesh = unitCylinders[segments];
+    if (!mesh.VAO) createCylinderMesh(mesh, segments);
     return mesh;
 }
 
@@ -540,61 +1217,139 @@ bool Renderer3D::isNightTime() const {
     return timeOfDay < 6.0f || timeOfDay >= 19.0f;
 }
 
-void Renderer3D::renderVehicles(const std::vector<Vehicle>& vehicles) {
+// Cars are drawn simulationLag ahead of their last tick, so they move
+// smoothly between ticks; one instanced draw unless drawing per object
+void Renderer3D::renderVehicles() {
+    if (visibleVehicles.empty()) return;
+    
     roadTexture.bind(0);
     shader.setInt("diffuseTexture", 0);
     
-    for (const auto& vehicle : vehicles) {
-        Mesh carMesh = createCubeMesh(8.0f, 4.0f, 4.0f);
-        
-        glm::mat4 model = glm::mat4(1.0f);
-        model = glm::translate(model, vehicle.position);
+    if (geometryPath == GeometryPath::PER_OBJECT) {
+        for (int index : visibleVehicles) {
+            const VehicleState& state = vehicleStates[index];
+            glm::vec3 position = glm::vec3(state.position) + glm::vec3(state.velocity) * simulationLag;
+            shader.setMat4("model", vehicleModel(position, glm::vec2(state.position.w, state.velocity.w)));
+            unitCube.draw();
+        }
+        return;
+    }
+    
+    size_t offset = StreamBuffer::shared().write(visibleVehicles.data(), visibleVehicles.size() * sizeof(int));
+    glActiveTexture(GL_TEXTURE0 + INSTANCE_STATE_UNIT);
+    glBindTexture(GL_TEXTURE_BUFFER, vehicleStateTexture);
+    shader.setInt("instanced", 2);
+    shader.setFloat("simulationLag", simulationLag);
+    
+    drawIndexedInstances(vehicleVAO, unitCube, offset, visibleVehicles.size());
+    
+    shader.setInt("instanced", 0);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+}
+
+// Like vehicles, in one flat colour
+void Renderer3D::renderPedestrians() {
+    if (visiblePedestrians.empty()) return;
+    
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    shader.setInt("useTexture", 0);
+    shader.setVec3("materialColor", glm::vec3(0.85f, 0.35f, 0.25f));
+    
+    if (geometryPath == GeometryPath::PER_OBJECT) {
+        for (int index : visiblePedestrians) {
+            const glm::vec4& state = pedestrianStates[index];
+            shader.setMat4("model", pedestrianModel(glm::vec2(state.x, state.y) + glm::vec2(state.z, state.w) * simulationLag));
+            unitCube.draw();
+        }
+    } else {
+        size_t offset = StreamBuffer::shared().write(visiblePedestrians.data(), visiblePedestrians.size() * sizeof(int));
+        glActiveTexture(GL_TEXTURE0 + INSTANCE_STATE_UNIT);
+        glBindTexture(GL_TEXTURE_BUFFER, pedestrianStateTexture);
+        shader.setInt("instanced", 4);
+        shader.setFloat("simulationLag", simulationLag);
         
-        // Rotate car to face direction
-        float angle = atan2(vehicle.direction.z, vehicle.direction.x);
-        model = glm::rotate(model, angle, glm::vec3(0.0f, 1.0f, 0.0f));
+        drawIndexedInstances(pedestrianVAO, unitCube, offset, visiblePedestrians.size());
         
-        shader.setMat4("model", model);
-        carMesh.draw();
+        shader.setInt("instanced", 0);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+        glActiveTexture(GL_TEXTURE0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindVertexArray(0);
     }
+    
+    shader.setInt("useTexture", 1);
+    shader.setVec3("materialColor", glm::vec3(1.0f, 1.0f, 1.0f));
 }
 
-void Renderer3D::renderStreetLights(const std::vector<StreetLight>& lights) {
-    // Render glowing street lights at night - disable texturing for solid colors
+// All poles in one instanced draw, then all bulbs; colour and glow come with
+// each piece from the light state buffer
+void Renderer3D::renderStreetLights() {
+    if (visibleLights.empty()) return;
+    
+    // Solid colours, no texture
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_2D, 0);
+    shader.setInt("useTexture", 0);
     
-    // Save current light settings
-    glm::vec3 originalLightPos = getSunPosition();
-    glm::vec3 originalLightColor = getSunLightColor();
-    
-    for (const auto& light : lights) {
-        // Create light pole (dark gray) - normal rendering
-        Mesh pole = createCylinderMesh(0.5f, 14.0f, 8);
-        
-        glm::mat4 model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(light.position.x, 7.0f, light.position.z));
-        shader.setMat4("model", model);
+    if (geometryPath == GeometryPath::PER_OBJECT) {
+        for (int index : visibleLights) {
+            for (int part = 0; part < 2; ++part) {
+                const LightPiece& piece = lightPieces[index * 2 + part];
+                glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(piece.center));
+                shader.setMat4("model", glm::scale(model, glm::vec3(piece.size)));
+                shader.setVec3("materialColor", glm::vec3(piece.material));
+                shader.setFloat("emissive", piece.material.a);
+                if (part == 0) getUnitCylinder(8).draw();
+                else unitCube.draw();
+            }
+        }
+    } else {
+        size_t offset = StreamBuffer::shared().write(visibleLights.data(), visibleLights.size() * sizeof(int));
+        glActiveTexture(GL_TEXTURE0 + INSTANCE_STATE_UNIT);
+        glBindTexture(GL_TEXTURE_BUFFER, lightStateTexture);
+        shader.setInt("instanced", 3);
         
-        shader.setFloat("emissive", 0.0f);
-        shader.setVec3("lightColor", glm::vec3(0.3f, 0.3f, 0.3f));
-        pole.draw();
+        shader.setInt("lightPart", 0);
+        drawIndexedInstances(lightPoleVAO, getUnitCylinder(8), offset, visibleLights.size());
+        shader.setInt("lightPart", 1);
+        drawIndexedInstances(lightBulbVAO, unitCube, offset, visibleLights.size());
         
-        // Create glowing bulb at top - EMISSIVE BRIGHT GLOW!
-        Mesh bulb = createCubeMesh(4.0f, 4.0f, 4.0f); // Even bigger
+        shader.setInt("instanced", 0);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+        glActiveTexture(GL_TEXTURE0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindVertexArray(0);
+    }
+    
+    shader.setInt("useTexture", 1);
+    shader.setVec3("materialColor", glm::vec3(1.0f, 1.0f, 1.0f));
+    shader.setFloat("emissive", 0.0f);
+}
+
+// Pole and bulb of every light, uploaded only when the lights change
+void Renderer3D::updateLightPieces() {
+    lightPieces.resize(staticLights.size() * 2);
+    for (size_t i = 0; i < staticLights.size(); ++i) {
+        const glm::vec3& position = staticLights[i].position;
         
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(light.position.x, 16.0f, light.position.z));
-        shader.setMat4("model", model);
+        // Dark gray pole, lit normally
+        LightPiece& pole = lightPieces[i * 2];
+        pole.center = glm::vec4(position.x, 7.0f, position.z, 0.0f);
+        pole.size = glm::vec4(0.5f, 14.0f, 0.5f, 0.0f);
+        pole.material = glm::vec4(0.3f, 0.3f, 0.3f, 0.0f);
         
-        // PURE EMISSIVE GLOW - no lighting calculation!
-        shader.setFloat("emissive", 1.0f); // Enable emissive mode
-        shader.setVec3("lightColor", glm::vec3(1.0f, 1.0f, 0.6f)); // Bright yellow-white
-        bulb.draw();
-        shader.setFloat("emissive", 0.0f); // Disable emissive
+        // Glowing bulb at the top: bright yellow-white, no lighting
+        LightPiece& bulb = lightPieces[i * 2 + 1];
+        bulb.center = glm::vec4(position.x, 16.0f, position.z, 0.0f);
+        bulb.size = glm::vec4(4.0f, 4.0f, 4.0f, 0.0f);
+        bulb.material = glm::vec4(1.0f, 1.0f, 0.6f, 1.0f);
     }
     
-    // Restore original lighting
-    shader.setVec3("lightPos", originalLightPos);
-    shader.setVec3("lightColor", originalLightColor);
+    glBindBuffer(GL_TEXTURE_BUFFER, lightStateVBO);
+    glBufferData(GL_TEXTURE_BUFFER, lightPieces.size() * sizeof(LightPiece), lightPieces.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
 }
@@ -3,10 +3,18 @@
 
 #include <glad/glad.h>
 #include <glm/glm.hpp>
+#include <map>
 #include <vector>
 #include "shader.h"
 #include "texture.h"
 #include "citygenerator.h"
+#include "crowd.h"
+#include "staticcitymesh.h"
+#include "bvh.h"
+#include "loosegrid.h"
+#include "occlusionculler.h"
+#include "buildinglod.h"
+#include "roadmesh.h"
 
 struct Camera {
     glm::vec3 position;
@@ -30,6 +38,8 @@ struct Mesh {
     
     Mesh();
     ~Mesh();
+    Mesh(const Mesh&) = delete;             // Owns GL objects
+    Mesh& operator=(const Mesh&) = delete;
     void setup();
     void draw();
 };
@@ -40,7 +50,7 @@ public:
     ~Renderer3D();
     
     void init(int screenWidth, int screenHeight);
-    void render(const CityGenerator& cityGen);
+    void render(const CityGenerator& cityGen, const CrowdSimulation& crowd, float deltaTime);
     
     void updateCamera(float deltaTime, bool* keys, float mouseOffsetX, float mouseOffsetY);
     void setProjection(int width, int height);
@@ -48,8 +58,27 @@ public:
     
     Camera& getCamera() { return camera; }
     float getTimeOfDay() const { return timeOfDay; }
+    // How far the simulation clock has run past its last tick; vehicles and
+    // pedestrians are drawn that far ahead along their velocity
+    void setSimulationLag(float seconds) { simulationLag = seconds; }
     void setTimeSpeed(float speed) { timeSpeed = speed; }
     
+    // How static geometry is submitted: merged per-material batches
+    // (default), instanced buildings, or one draw per object (for comparison)
+    enum class GeometryPath { MERGED, INSTANCED, PER_OBJECT };
+    void setGeometryPath(GeometryPath path) { geometryPath = path; }
+    GeometryPath getGeometryPath() const { return geometryPath; }
+    
+    // Which objects are skipped: none, those outside the view frustum, or
+    // also those hidden behind nearby buildings (default)
+    enum class CullingMode { OFF, FRUSTUM, OCCLUSION };
+    void setCullingMode(CullingMode mode) { cullingMode = mode; }
+    CullingMode getCullingMode() const { return cullingMode; }
+    
+    // Distance-based building detail: full, plain box, impostor (on by default)
+    void setBuildingLOD(bool enabled) { buildingLOD.setEnabled(enabled); }
+    bool getBuildingLOD() const { return buildingLOD.isEnabled(); }
+    
 private:
     Shader shader;
     Texture buildingTexture1;
@@ -60,29 +89,160 @@ private:
     
     Camera camera;
     int width, height;
+    glm::mat4 projection;
     
     float timeOfDay; // 0.0 to 24.0 hours
     float timeSpeed; // Speed multiplier for time progression
+    int pointLightCount; // Street lights set on the shader this frame
+    
+    // Unit primitives uploaded once in init; every object reuses them and
+    // is placed and sized by its model matrix
+    Mesh unitCube;                      // 1 x 1 x 1, centred on the origin
+    Mesh unitQuad;                      // 1 x 1 ground plane, texture repeated 10 times
+    std::map<int, Mesh> unitCylinders;  // Radius 1, height 1, by segment count
+    
+    // Instanced buildings: every building's box sits in a state buffer
+    // rebuilt only when the buildings change; a frame streams the visible
+    // items' building indices and tex_vert.glsl scales the unit cube
+    struct BuildingInstance {
+        glm::vec4 footprint;            // x, z, width, depth
+        glm::vec4 height;               // Height, unused
+    };
+    static const int BUILDING_MATERIALS = 2; // Facade textures
+    
+    GeometryPath geometryPath;
+    unsigned int buildingVAO;
+    unsigned int buildingStateVBO;
+    unsigned int buildingStateTexture;
+    uint64_t buildingInstanceRevision;  // Building revision the buffer holds (0 = none)
+    std::vector<BuildingInstance> buildingInstances;
+    std::vector<int> buildingIds;
+    size_t buildingIdOffset;            // This frame's streamed ids
+    
+    // Building LOD. Impostors come from an atlas baked at start-up: one
+    // column per archetype (facade texture and height class), one row per
+    // time-of-day variant, each cell a corner-on view of a stand-in building.
+    static const int IMPOSTOR_HEIGHT_CLASSES = 3;
+    static const int IMPOSTOR_ARCHETYPES = BUILDING_MATERIALS * IMPOSTOR_HEIGHT_CLASSES;
+    static const int IMPOSTOR_VARIANTS = 3;     // Day, dusk, night
+    static const int IMPOSTOR_CELL_WIDTH = 64;
+    static const int IMPOSTOR_CELL_HEIGHT = 128;
+    struct ImpostorInstance {
+        glm::vec4 footprint;            // x, z, width, depth
+        glm::vec2 shape;                // Height, atlas column
+    };
+    BuildingLOD buildingLOD;
+    Shader impostorShader;
+    unsigned int impostorAtlas;
+    unsigned int impostorVAO;
+    unsigned int impostorQuadVBO;
+    std::vector<ImpostorInstance> impostorInstances;
+    
+    // Vehicles: state is uploaded to a texture buffer once per simulation
+    // tick; a frame streams only the visible vehicles' indices and
+    // tex_vert.glsl extrapolates each car from its state
+    struct VehicleState {
+        glm::vec4 position;             // x, y, z, heading x
+        glm::vec4 velocity;             // x, y, z, heading z
+    };
+    static const int INSTANCE_STATE_UNIT = 1; // Texture unit of the building, vehicle, pedestrian or light state buffer
+    float simulationLag;
+    unsigned int vehicleVAO;
+    unsigned int vehicleStateVBO;
+    unsigned int vehicleStateTexture;
+    uint64_t vehicleRevision;           // Vehicle revision the state buffer and grid hold (0 = none)
+    std::vector<VehicleState> vehicleStates;
+    
+    // Pedestrians, the same way: one texel per pedestrian (x, z, velocity
+    // x, velocity z) uploaded once per simulation tick
+    unsigned int pedestrianVAO;
+    unsigned int pedestrianStateVBO;
+    unsigned int pedestrianStateTexture;
+    uint64_t pedestrianRevision;        // Crowd revision the state buffer and grid hold (0 = none)
+    std::vector<glm::vec4> pedestrianStates;
+    
+    // Street lights: a pole and a bulb piece per light in a texture buffer
+    // written only when the lights change; a frame streams the visible
+    // lights' indices once for both instanced draws
+    struct LightPiece {
+        glm::vec4 center;               // x, y, z, unused
+        glm::vec4 size;                 // x, y, z, unused
+        glm::vec4 material;             // Colour, emissive
+    };
+    unsigned int lightPoleVAO;
+    unsigned int lightBulbVAO;
+    unsigned int lightStateVBO;
+    unsigned int lightStateTexture;
+    std::vector<LightPiece> lightPieces; // Pole, bulb per entry of staticLights
+    
+    // Merged static geometry, one batch per material. The copies record what
+    // is baked so only objects that differ are rewritten; the road surface
+    // is generated from the road graph and baked again only with a new one.
+    enum StaticMaterial {
+        STATIC_GRASS, STATIC_ROAD, STATIC_FACADE_1, STATIC_FACADE_2,
+        STATIC_WATER, STATIC_FOUNTAIN, STATIC_MATERIAL_COUNT
+    };
+    StaticCityMesh staticMesh;
+    int staticLayoutSize;               // -1 = ground not baked
+    RoadMesh roadMesh;
+    uint64_t staticRoadRevision;
+    std::vector<Park> staticParks;
+    std::vector<Building> staticBuildings;
+    std::vector<StreetLight> staticLights;
+    uint64_t staticBuildingRevision;
+    uint64_t staticLightRevision;
     
-    Mesh groundMesh;
-    Mesh buildingMesh;
-    Mesh roadMesh;
-    Mesh parkMesh;
+    // Frustum culling. Static objects share one BVH whose ids run through
+    // road pieces, buildings, parks and street lights in turn; vehicles and
+    // pedestrians go into loose grids every tick. The visible lists hold
+    // indices per kind.
+    enum CullKind { CULL_ROADS, CULL_BUILDINGS, CULL_PARKS, CULL_LIGHTS, CULL_KINDS };
+    CullingMode cullingMode;
+    BVH staticBVH;
+    int cullOffsets[CULL_KINDS + 1];    // Ids of kind k are [offsets[k], offsets[k + 1])
+    LooseGrid vehicleGrid;
+    std::vector<glm::vec3> vehicleCenters;
+    LooseGrid pedestrianGrid;
+    std::vector<glm::vec3> pedestrianCenters;
+    std::vector<int> visibleIds;
+    std::vector<int> visibleRoads, visibleBuildings, visibleParks, visibleLights, visibleVehicles;
+    std::vector<int> visiblePedestrians;
+    std::vector<uint64_t> visibleKeys;
     
-    void createGroundMesh(int size);
-    void createBuildingMesh(const Building& building);
-    void createRoadMesh(const std::vector<Road>& roads);
-    void createParkMesh(const Park& park);
+    // Occlusion culling: the largest nearby visible buildings are rasterised
+    // as occluders, then the rest of the visible lists are tested against them
+    static const int MAX_OCCLUDERS = 48;
+    OcclusionCuller occlusion;
+    std::vector<std::pair<float, int>> occluderCandidates; // Score, position in visibleBuildings
+    std::vector<BVHBox> occludeeBoxes;
+    std::vector<uint8_t> occludeeHidden;
     
     void renderGround(int size);
-    void renderBuildings(const std::vector<Building>& buildings);
-    void renderRoads(const std::vector<Road>& roads);
+    void renderBuildings(const std::vector<Building>& buildings, uint64_t revision);
+    void setBuildingLevel(const BuildingLOD::Item& item);
+    void drawBuildingRun(const std::vector<Building>& buildings, size_t begin, size_t end);
+    void updateBuildingInstances(const std::vector<Building>& buildings);
+    void bakeImpostorAtlas();
+    void renderImpostors(const std::vector<Building>& buildings);
+    void updateStaticScene(const CityGenerator& cityGen);
+    void updateVehicleStates(const std::vector<Vehicle>& vehicles, uint64_t revision);
+    void updatePedestrianStates(const CrowdSimulation& crowd);
+    void rebuildStaticBVH();
+    void cullScene(const CityGenerator& cityGen);
+    void cullOccluded(const CityGenerator& cityGen);
+    void renderStaticMesh();
+    void drawStaticMaterial(int material, const std::vector<int>& visible, int kind);
+    void renderRoads();
     void renderParks(const std::vector<Park>& parks);
-    void renderVehicles(const std::vector<Vehicle>& vehicles);
-    void renderStreetLights(const std::vector<StreetLight>& lights);
+    void renderVehicles();
+    void renderPedestrians();
+    void renderStreetLights();
+    void updateLightPieces();
     
-    Mesh createCubeMesh(float width, float height, float depth);
-    Mesh createCylinderMesh(float radius, float height, int segments);
+    void createCubeMesh(Mesh& mesh);
+    void createQuadMesh(Mesh& mesh);
+    void createCylinderMesh(Mesh& mesh, int segments);
+    Mesh& getUnitCylinder(int segments); // Built on first use of a new count
     
     glm::vec3 getSkyColor() const;
     glm::vec3 getSunLightColor() const;
@@ -0,0 +1,550 @@
+#include "roadgraph.h"
+#include "citygenerator.h"
+#include "threadpool.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <queue>
+#include <sstream>
+#include <unordered_map>
+
+namespace {
+
+const float INF = std::numeric_limits<float>::infinity();
+const uint32_t CACHE_MAGIC = 0x48434752; // "RGCH"
+const uint32_t CACHE_VERSION = 1;
+
+// Witness searches give up after this many settled nodes; a missed witness
+// only costs an extra shortcut, never a wrong distance. Priority estimates
+// use a much cheaper search than the real contraction.
+const int WITNESS_SETTLE_LIMIT = 500;
+const int PRIORITY_SETTLE_LIMIT = 10;
+
+typedef std::pair<float, int> HeapEntry;
+typedef std::priority_queue<HeapEntry, std::vector<HeapEntry>, std::greater<HeapEntry>> MinHeap;
+
+struct Shortcut {
+    int from, to;
+    float weight;
+};
+
+// Per-thread buffers for witness searches, reset after every search
+struct WitnessScratch {
+    std::vector<float> dist;
+    std::vector<char> isTarget;
+    std::vector<int> touched;
+    std::vector<HeapEntry> heap; // Binary min-heap, kept to reuse its storage
+    
+    explicit WitnessScratch(int numNodes) : dist(numNodes, INF), isTarget(numNodes, 0) {}
+};
+
+}
+
+RoadGraph::RoadGraph() : networkHash(0) {}
+
+int RoadGraph::addNode(const glm::vec2& position) {
+    nodes.push_back(position);
+    edges.emplace_back();
+    return static_cast<int>(nodes.size()) - 1;
+}
+
+void RoadGraph::addEdge(int a, int b) {
+    if (a == b) return;
+    float weight = glm::length(nodes[a] - nodes[b]);
+    edges[a].push_back({b, weight});
+    edges[b].push_back({a, weight});
+}
+
+void RoadGraph::build(const std::vector<Road>& roads) {
+    nodes.clear();
+    edges.clear();
+    hierarchy = std::shared_future<HierarchyPtr>();
+    
+    // FNV-1a over the road endpoints identifies the network for the cache
+    networkHash = 1469598103934665603ull;
+    auto hashInt = [this](int value) {
+        for (int i = 0; i < 4; ++i) {
+            networkHash ^= static_cast<uint64_t>((value >> (i * 8)) & 0xFF);
+            networkHash *= 1099511628211ull;
+        }
+    };
+    for (const auto& road : roads) {
+        hashInt(road.start.x); hashInt(road.start.y);
+        hashInt(road.end.x); hashInt(road.end.y);
+    }
+    
+    // Split every road where it crosses another one
+    std::vector<std::vector<float>> splits(roads.size(), std::vector<float>{0.0f, 1.0f});
+    for (size_t i = 0; i < roads.size(); ++i) {
+        glm::vec2 p(roads[i].start.x, roads[i].start.y);
+        glm::vec2 r = glm::vec2(roads[i].end.x, roads[i].end.y) - p;
+        
+        for (size_t j = i + 1; j < roads.size(); ++j) {
+            glm::vec2 q(roads[j].start.x, roads[j].start.y);
+            glm::vec2 s = glm::vec2(roads[j].end.x, roads[j].end.y) - q;
+            
+            float denom = r.x * s.y - r.y * s.x;
+            if (std::fabs(denom) < 1e-6f) continue; // Parallel
+            
+            glm::vec2 qp = q - p;
+            float t = (qp.x * s.y - qp.y * s.x) / denom;
+            float u = (qp.x * r.y - qp.y * r.x) / denom;
+            if (t < 0.0f || t > 1.0f || u < 0.0f || u > 1.0f) continue;
+            
+            splits[i].push_back(t);
+            splits[j].push_back(u);
+        }
+    }
+    
+    // Points closer than half a unit become the same node
+    std::unordered_map<int64_t, int> nodeLookup;
+    auto nodeAt = [&](const glm::vec2& position) {
+        int64_t key = (static_cast<int64_t>(std::lround(position.x * 2.0f)) << 32) ^
+                      static_cast<uint32_t>(std::lround(position.y * 2.0f));
+        auto it = nodeLookup.find(key);
+        if (it != nodeLookup.end()) return it->second;
+        int index = addNode(position);
+        nodeLookup[key] = index;
+        return index;
+    };
+    
+    for (size_t i = 0; i < roads.size(); ++i) {
+        glm::vec2 start(roads[i].start.x, roads[i].start.y);
+        glm::vec2 end(roads[i].end.x, roads[i].end.y);
+        
+        std::sort(splits[i].begin(), splits[i].end());
+        int previous = -1;
+        for (float t : splits[i]) {
+            int node = nodeAt(start + (end - start) * t);
+            if (previous >= 0) addEdge(previous, node);
+            previous = node;
+        }
+    }
+}
+
+std::vector<std::pair<int, int>> RoadGraph::getSegments() const {
+    std::vector<std::pair<int, int>> segments;
+    for (size_t a = 0; a < edges.size(); ++a) {
+        for (const auto& edge : edges[a]) {
+            if (static_cast<int>(a) < edge.to) segments.push_back(std::make_pair(static_cast<int>(a), edge.to));
+        }
+    }
+    // Overlapping roads add the same edge twice
+    std::sort(segments.begin(), segments.end());
+    segments.erase(std::unique(segments.begin(), segments.end()), segments.end());
+    return segments;
+}
+
+void RoadGraph::prepare(const std::string& cacheDir) {
+    // The job owns copies of everything it reads, so the graph may be
+    // rebuilt or copied while it runs
+    auto promise = std::make_shared<std::promise<HierarchyPtr>>();
+    hierarchy = promise->get_future().share();
+    
+    std::vector<std::vector<Edge>> graphEdges = edges;
+    uint64_t hash = networkHash;
+    std::string path = cachePath(cacheDir, hash);
+    ThreadPool::shared().submit([promise, graphEdges, hash, path, cacheDir]() {
+        auto startTime = std::chrono::steady_clock::now();
+        int numNodes = static_cast<int>(graphEdges.size());
+        
+        HierarchyPtr built = loadCache(path, hash, numNodes);
+        if (built) {
+            std::cout << "[ROUTING] Contraction hierarchy loaded from cache (" << numNodes << " nodes)" << std::endl;
+            promise->set_value(built);
+            return;
+        }
+        
+        built = contractEdges(graphEdges);
+        std::error_code error;
+        std::filesystem::create_directories(cacheDir, error);
+        saveCache(path, hash, *built);
+        promise->set_value(built);
+        
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime);
+        std::cout << "[ROUTING] Contraction hierarchy built: " << numNodes << " nodes, "
+                  << built->upEdges.size() << " upward edges in " << elapsed.count() << " ms" << std::endl;
+    });
+}
+
+void RoadGraph::contract() {
+    std::promise<HierarchyPtr> promise;
+    promise.set_value(contractEdges(edges));
+    hierarchy = promise.get_future().share();
+}
+
+bool RoadGraph::isContracted() const {
+    return hierarchy.valid() && hierarchy.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+const RoadGraph::Hierarchy* RoadGraph::getHierarchy() const {
+    if (!hierarchy.valid()) return nullptr;
+    return hierarchy.get().get();
+}
+
+RoadGraph::HierarchyPtr RoadGraph::contractEdges(const std::vector<std::vector<Edge>>& edges) {
+    int numNodes = static_cast<int>(edges.size());
+    auto built = std::make_shared<Hierarchy>();
+    std::vector<int>& rank = built->rank;
+    
+    // Working copy that gains shortcuts and loses contracted nodes
+    std::vector<std::vector<Edge>> graph(numNodes);
+    auto addOrLower = [&graph](int from, int to, float weight) {
+        for (auto& edge : graph[from]) {
+            if (edge.to == to) {
+                edge.weight = std::min(edge.weight, weight);
+                return;
+            }
+        }
+        graph[from].push_back({to, weight});
+    };
+    for (int v = 0; v < numNodes; ++v) {
+        for (const auto& edge : edges[v]) addOrLower(v, edge.to, edge.weight);
+    }
+    
+    std::vector<char> removed(numNodes, 0);
+    std::vector<char> inRound(numNodes, 0);
+    std::vector<char> dirty(numNodes, 1);
+    std::vector<int> deletedNeighbours(numNodes, 0);
+    std::vector<float> priority(numNodes, 0.0f);
+    std::vector<std::vector<Shortcut>> shortcuts(numNodes);
+    std::vector<std::vector<Edge>> up(numNodes);
+    rank.assign(numNodes, -1);
+    
+    // Shortcuts needed if v were contracted now: local Dijkstra from each
+    // neighbour that ignores v looks for a path at least as short. Nodes
+    // contracted in the same round are ignored too, otherwise two of them
+    // could each be the other's only witness.
+    auto simulate = [&](int v, int settleLimit, WitnessScratch& scratch) {
+        std::vector<Shortcut>& result = shortcuts[v];
+        result.clear();
+        const auto& neighbours = graph[v];
+        std::vector<float>& dist = scratch.dist;
+        
+        for (size_t a = 0; a + 1 < neighbours.size(); ++a) {
+            float maxWeight = 0.0f;
+            int remainingTargets = 0;
+            for (size_t b = a + 1; b < neighbours.size(); ++b) {
+                maxWeight = std::max(maxWeight, neighbours[a].weight + neighbours[b].weight);
+                if (!scratch.isTarget[neighbours[b].to]) remainingTargets++;
+                scratch.isTarget[neighbours[b].to] = 1;
+            }
+            
+            std::vector<HeapEntry>& heap = scratch.heap;
+            heap.clear();
+            dist[neighbours[a].to] = 0.0f;
+            scratch.touched.push_back(neighbours[a].to);
+            heap.push_back({0.0f, neighbours[a].to});
+            int settled = 0;
+            
+            // Stop once every target is settled or nothing cheaper than the
+            // path through v is left
+            while (!heap.empty() && settled < settleLimit && remainingTargets > 0) {
+                std::pop_heap(heap.begin(), heap.end(), std::greater<HeapEntry>());
+                HeapEntry top = heap.back();
+                heap.pop_back();
+                if (top.first > dist[top.second]) continue;
+                if (top.first > maxWeight) break;
+                settled++;
+                if (scratch.isTarget[top.second]) remainingTargets--;
+                
+                for (const auto& edge : graph[top.second]) {
+                    if (edge.to == v || inRound[edge.to]) continue;
+                    float candidate = top.first + edge.weight;
+                    if (candidate < dist[edge.to]) {
+                        if (dist[edge.to] == INF) scratch.touched.push_back(edge.to);
+                        dist[edge.to] = candidate;
+                        heap.push_back({candidate, edge.to});
+                        std::push_heap(heap.begin(), heap.end(), std::greater<HeapEntry>());
+                    }
+                }
+            }
+            
+            for (size_t b = a + 1; b < neighbours.size(); ++b) {
+                float viaV = neighbours[a].weight + neighbours[b].weight;
+                if (dist[neighbours[b].to] > viaV) {
+                    result.push_back({neighbours[a].to, neighbours[b].to, viaV});
+                }
+                scratch.isTarget[neighbours[b].to] = 0;
+            }
+            
+            for (int node : scratch.touched) dist[node] = INF;
+            scratch.touched.clear();
+        }
+        
+        // Edge difference plus a term that spreads contraction evenly
+        priority[v] = static_cast<float>(result.size()) - static_cast<float>(neighbours.size()) +
+                      static_cast<float>(deletedNeighbours[v]);
+    };
+    
+    std::vector<int> active(numNodes);
+    for (int v = 0; v < numNodes; ++v) active[v] = v;
+    int nextRank = 0;
+    
+    while (!active.empty()) {
+        // Re-simulate nodes whose neighbourhood changed, in parallel
+        std::vector<int> stale;
+        for (int v : active) {
+            if (dirty[v]) stale.push_back(v);
+        }
+        ThreadPool::shared().parallelFor(static_cast<int>(stale.size()), [&](int begin, int end) {
+            WitnessScratch scratch(numNodes);
+            for (int i = begin; i < end; ++i) {
+                simulate(stale[i], PRIORITY_SETTLE_LIMIT, scratch);
+                dirty[stale[i]] = 0;
+            }
+        });
+        
+        // Contract an independent set: nodes that beat all their neighbours,
+        // so no contraction in this round changes another one's neighbours
+        std::vector<int> selected;
+        for (int v : active) {
+            bool localMinimum = true;
+            for (const auto& edge : graph[v]) {
+                int u = edge.to;
+                if (priority[u] < priority[v] || (priority[u] == priority[v] && u < v)) {
+                    localMinimum = false;
+                    break;
+                }
+            }
+            if (localMinimum) selected.push_back(v);
+        }
+        
+        // Final shortcuts with witnesses restricted to surviving nodes
+        for (int v : selected) inRound[v] = 1;
+        ThreadPool::shared().parallelFor(static_cast<int>(selected.size()), [&](int begin, int end) {
+            WitnessScratch scratch(numNodes);
+            for (int i = begin; i < end; ++i) {
+                simulate(selected[i], WITNESS_SETTLE_LIMIT, scratch);
+            }
+        });
+        
+        for (int v : selected) {
+            rank[v] = nextRank++;
+            up[v] = graph[v];
+            removed[v] = 1;
+            
+            for (const auto& edge : graph[v]) {
+                auto& back = graph[edge.to];
+                back.erase(std::remove_if(back.begin(), back.end(),
+                                          [v](const Edge& e) { return e.to == v; }),
+                           back.end());
+                deletedNeighbours[edge.to]++;
+                dirty[edge.to] = 1;
+            }
+            for (const auto& shortcut : shortcuts[v]) {
+                addOrLower(shortcut.from, shortcut.to, shortcut.weight);
+                addOrLower(shortcut.to, shortcut.from, shortcut.weight);
+            }
+            
+            graph[v].clear();
+            shortcuts[v].clear();
+            inRound[v] = 0;
+        }
+        
+        active.erase(std::remove_if(active.begin(), active.end(),
+                                    [&removed](int v) { return removed[v] != 0; }),
+                     active.end());
+    }
+    
+    // Flatten upward edges into CSR
+    std::vector<int>& upFirst = built->upFirst;
+    std::vector<Edge>& upEdges = built->upEdges;
+    upFirst.assign(numNodes + 1, 0);
+    for (int v = 0; v < numNodes; ++v) {
+        upFirst[v] = static_cast<int>(upEdges.size());
+        upEdges.insert(upEdges.end(), up[v].begin(), up[v].end());
+    }
+    upFirst[numNodes] = static_cast<int>(upEdges.size());
+    return built;
+}
+
+std::string RoadGraph::cachePath(const std::string& cacheDir, uint64_t hash) {
+    std::ostringstream name;
+    name << cacheDir << "/roadgraph_" << std::hex << hash << ".ch";
+    return name.str();
+}
+
+RoadGraph::HierarchyPtr RoadGraph::loadCache(const std::string& path, uint64_t hash, int numNodes) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) return nullptr;
+    
+    uint32_t magic = 0, version = 0;
+    uint64_t fileHash = 0;
+    int32_t fileNodes = 0, numUpEdges = 0;
+    file.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+    file.read(reinterpret_cast<char*>(&version), sizeof(version));
+    file.read(reinterpret_cast<char*>(&fileHash), sizeof(fileHash));
+    file.read(reinterpret_cast<char*>(&fileNodes), sizeof(fileNodes));
+    file.read(reinterpret_cast<char*>(&numUpEdges), sizeof(numUpEdges));
+    
+    if (!file || magic != CACHE_MAGIC || version != CACHE_VERSION || fileHash != hash ||
+        fileNodes != numNodes || numUpEdges < 0) {
+        return nullptr;
+    }
+    
+    auto loaded = std::make_shared<Hierarchy>();
+    loaded->rank.resize(numNodes);
+    loaded->upFirst.resize(numNodes + 1);
+    loaded->upEdges.resize(numUpEdges);
+    file.read(reinterpret_cast<char*>(loaded->rank.data()), numNodes * sizeof(int));
+    file.read(reinterpret_cast<char*>(loaded->upFirst.data()), (numNodes + 1) * sizeof(int));
+    file.read(reinterpret_cast<char*>(loaded->upEdges.data()), numUpEdges * sizeof(Edge));
+    if (!file) return nullptr;
+    return loaded;
+}
+
+// Written under a temporary name and renamed, so a concurrent load never
+// sees a partial file
+bool RoadGraph::saveCache(const std::string& path, uint64_t hash, const Hierarchy& built) {
+    std::string partialPath = path + ".tmp";
+    std::ofstream file(partialPath, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        std::cerr << "WARNING::ROADGRAPH::CACHE_NOT_WRITTEN: " << path << std::endl;
+        return false;
+    }
+    
+    int32_t numNodes = static_cast<int32_t>(built.rank.size());
+    int32_t numUpEdges = static_cast<int32_t>(built.upEdges.size());
+    file.write(reinterpret_cast<const char*>(&CACHE_MAGIC), sizeof(CACHE_MAGIC));
+    file.write(reinterpret_cast<const char*>(&CACHE_VERSION), sizeof(CACHE_VERSION));
+    file.write(reinterpret_cast<const char*>(&hash), sizeof(hash));
+    file.write(reinterpret_cast<const char*>(&numNodes), sizeof(numNodes));
+    file.write(reinterpret_cast<const char*>(&numUpEdges), sizeof(numUpEdges));
+    file.write(reinterpret_cast<const char*>(built.rank.data()), numNodes * sizeof(int));
+    file.write(reinterpret_cast<const char*>(built.upFirst.data()), (numNodes + 1) * sizeof(int));
+    file.write(reinterpret_cast<const char*>(built.upEdges.data()), numUpEdges * sizeof(Edge));
+    file.close();
+    if (!file) return false;
+    
+    std::error_code error;
+    std::filesystem::rename(partialPath, path, error);
+    return !error;
+}
+
+void RoadGraph::upwardSearch(const Hierarchy& built, int source, std::vector<std::pair<int, float>>& settled) const {
+    // Per-thread scratch so concurrent queries don't allocate O(nodes) each
+    static thread_local std::vector<float> dist;
+    if (dist.size() < nodes.size()) dist.assign(nodes.size(), INF);
+    
+    settled.clear();
+    MinHeap heap;
+    dist[source] = 0.0f;
+    heap.push({0.0f, source});
+    std::vector<int> touched{source};
+    
+    while (!heap.empty()) {
+        HeapEntry top = heap.top();
+        heap.pop();
+        if (top.first > dist[top.second]) continue;
+        settled.push_back({top.second, top.first});
+        
+        for (int e = built.upFirst[top.second]; e < built.upFirst[top.second + 1]; ++e) {
+            const Edge& edge = built.upEdges[e];
+            float candidate = top.first + edge.weight;
+            if (candidate < dist[edge.to]) {
+                if (dist[edge.to] == INF) touched.push_back(edge.to);
+                dist[edge.to] = candidate;
+                heap.push({candidate, edge.to});
+            }
+        }
+    }
+    
+    for (int node : touched) dist[node] = INF;
+}
+
+float RoadGraph::query(int source, int target) const {
+    if (source < 0 || target < 0) return INF;
+    const Hierarchy* built = getHierarchy();
+    if (!built) return INF;
+    
+    std::vector<std::pair<int, float>> forward, backward;
+    upwardSearch(*built, source, forward);
+    upwardSearch(*built, target, backward);
+    
+    // Shortest path is the best meeting point of the two upward searches
+    std::unordered_map<int, float> reached;
+    for (const auto& entry : forward) reached[entry.first] = entry.second;
+    
+    float best = INF;
+    for (const auto& entry : backward) {
+        auto it = reached.find(entry.first);
+        if (it != reached.end()) best = std::min(best, it->second + entry.second);
+    }
+    return best;
+}
+
+std::vector<float> RoadGraph::queryMatrix(const std::vector<int>& sources, const std::vector<int>& targets) const {
+    std::vector<float> result(sources.size() * targets.size(), INF);
+    if (sources.empty() || targets.empty()) return result;
+    const Hierarchy* built = getHierarchy();
+    if (!built) return result;
+    
+    int numTargets = static_cast<int>(targets.size());
+    ThreadPool& pool = ThreadPool::shared();
+    
+    // Backward upward search from every target
+    std::vector<std::vector<std::pair<int, float>>> targetSpaces(numTargets);
+    pool.parallelFor(numTargets, [&](int begin, int end) {
+        for (int j = begin; j < end; ++j) {
+            if (targets[j] >= 0) upwardSearch(*built, targets[j], targetSpaces[j]);
+        }
+    });
+    
+    // Bucket the search spaces by node (CSR)
+    struct BucketEntry {
+        int target;
+        float dist;
+    };
+    std::vector<int> bucketFirst(nodes.size() + 1, 0);
+    for (const auto& space : targetSpaces) {
+        for (const auto& entry : space) bucketFirst[entry.first + 1]++;
+    }
+    for (size_t v = 0; v < nodes.size(); ++v) bucketFirst[v + 1] += bucketFirst[v];
+    
+    std::vector<BucketEntry> buckets(bucketFirst.back());
+    std::vector<int> fill(bucketFirst.begin(), bucketFirst.end() - 1);
+    for (int j = 0; j < numTargets; ++j) {
+        for (const auto& entry : targetSpaces[j]) {
+            buckets[fill[entry.first]++] = {j, entry.second};
+        }
+    }
+    
+    // Forward upward search from every source scans the buckets it meets
+    pool.parallelFor(static_cast<int>(sources.size()), [&](int begin, int end) {
+        std::vector<std::pair<int, float>> space;
+        for (int i = begin; i < end; ++i) {
+            if (sources[i] < 0) continue;
+            upwardSearch(*built, sources[i], space);
+            
+            float* row = &result[static_cast<size_t>(i) * numTargets];
+            for (const auto& entry : space) {
+                for (int b = bucketFirst[entry.first]; b < bucketFirst[entry.first + 1]; ++b) {
+                    float candidate = entry.second + buckets[b].dist;
+                    if (candidate < row[buckets[b].target]) row[buckets[b].target] = candidate;
+                }
+            }
+        }
+    });
+    
+    return result;
+}
+
+int RoadGraph::nearestNode(const glm::vec2& position) const {
+    int nearest = -1;
+    float bestDistSq = INF;
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        glm::vec2 d = nodes[i] - position;
+        float distSq = glm::dot(d, d);
+        if (distSq < bestDistSq) {
+            bestDistSq = distSq;
+            nearest = static_cast<int>(i);
+        }
+    }
+    return nearest;
+}
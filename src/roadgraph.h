@@ -0,0 +1,78 @@
+#ifndef ROADGRAPH_H
+#define ROADGRAPH_H
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct Road;
+
+// Road network as a graph: nodes at road endpoints and crossings, two-way
+// edges weighted by length. A contraction hierarchy over it lets
+// shortest-path queries only search upward in the node ranking. The
+// hierarchy is immutable once built and shared between copies of the graph.
+class RoadGraph {
+public:
+    RoadGraph();
+    
+    void build(const std::vector<Road>& roads);
+    
+    // Contraction hierarchy preprocessing on the thread pool; returns at
+    // once. Uses the on-disk cache in cacheDir when the network hash
+    // matches, and writes it otherwise. Queries wait until it is ready.
+    void prepare(const std::string& cacheDir);
+    // The same on the calling thread, without the cache
+    void contract();
+    
+    // Queries return infinity for unreachable pairs
+    float query(int source, int target) const;
+    // Many-to-many OD matrix, row-major [source][target], on all cores
+    std::vector<float> queryMatrix(const std::vector<int>& sources, const std::vector<int>& targets) const;
+    
+    int nearestNode(const glm::vec2& position) const;
+    
+    const std::vector<glm::vec2>& getNodes() const { return nodes; }
+    // Every road segment between neighbouring nodes once, as (lower, higher)
+    std::vector<std::pair<int, int>> getSegments() const;
+    uint64_t getNetworkHash() const { return networkHash; }
+    // True once the hierarchy is ready; never waits
+    bool isContracted() const;
+    
+private:
+    struct Edge {
+        int to;
+        float weight;
+    };
+    
+    // Rank per node and upward edges in CSR form. Roads are two-way, so the
+    // same upward graph serves forward and backward searches.
+    struct Hierarchy {
+        std::vector<int> rank;
+        std::vector<int> upFirst;
+        std::vector<Edge> upEdges;
+    };
+    typedef std::shared_ptr<const Hierarchy> HierarchyPtr;
+    
+    std::vector<glm::vec2> nodes;
+    std::vector<std::vector<Edge>> edges; // Original two-way graph
+    uint64_t networkHash;
+    std::shared_future<HierarchyPtr> hierarchy; // Invalid until prepare() or contract()
+    
+    int addNode(const glm::vec2& position);
+    void addEdge(int a, int b);
+    
+    static HierarchyPtr contractEdges(const std::vector<std::vector<Edge>>& edges);
+    static std::string cachePath(const std::string& cacheDir, uint64_t hash);
+    static HierarchyPtr loadCache(const std::string& path, uint64_t hash, int numNodes);
+    static bool saveCache(const std::string& path, uint64_t hash, const Hierarchy& built);
+    // Waits for the hierarchy; null if there is none
+    const Hierarchy* getHierarchy() const;
+    
+    // Upward Dijkstra; fills settled (node, distance) pairs
+    void upwardSearch(const Hierarchy& built, int source, std::vector<std::pair<int, float>>& settled) const;
+};
+
+#endif
@@ -0,0 +1,396 @@
+#include "roadmesh.h"
+#include "roadgraph.h"
+#include "rtree.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+const float HALF_WIDTH = 4.0f;          // As wide as the old road boxes
+const float SURFACE_HEIGHT = 0.25f;     // Their top face
+const float TEXTURE_LENGTH = 8.0f;      // Road texture repeats every road width
+const float MITER_LIMIT = 4.0f;         // In half widths; sharper bends get a junction
+const float PARALLEL_EPSILON = 1e-4f;
+const float EDGE_EPSILON = 1e-3f;       // Pieces sharing an edge don't clip each other
+const float MIN_AREA = 1e-3f;           // Smaller clipped fragments are dropped
+
+typedef std::vector<glm::vec2> Polygon;
+
+glm::vec2 leftOf(const glm::vec2& direction) {
+    return glm::vec2(-direction.y, direction.x);
+}
+
+float cross(const glm::vec2& a, const glm::vec2& b) {
+    return a.x * b.y - a.y * b.x;
+}
+
+// Where the left edge of a strip leaving the node along a meets the right
+// edge of one leaving along b; t and s are the distances along a and b
+// (negative on the outside of a bend). a and b must not be parallel.
+void cornerOf(const glm::vec2& a, const glm::vec2& b, float& t, float& s) {
+    // a t + left(a) h = b s - left(b) h
+    glm::vec2 offset = -(leftOf(a) + leftOf(b)) * HALF_WIDTH;
+    float determinant = cross(a, -b);
+    t = cross(offset, -b) / determinant;
+    s = cross(a, offset) / determinant;
+}
+
+float signedArea(const Polygon& polygon) {
+    float area = 0.0f;
+    for (size_t i = 0; i < polygon.size(); ++i) area += cross(polygon[i], polygon[(i + 1) % polygon.size()]);
+    return 0.5f * area;
+}
+
+// Splits a convex polygon along a line; distances are signed (positive
+// inside), with those within EDGE_EPSILON snapped onto the line
+void splitPolygon(const Polygon& polygon, const float* distances, Polygon& inside, Polygon& outside) {
+    inside.clear();
+    outside.clear();
+    size_t count = polygon.size();
+    for (size_t i = 0; i < count; ++i) {
+        size_t next = (i + 1) % count;
+        float d = distances[i];
+        float dNext = distances[next];
+        if (d >= 0.0f) inside.push_back(polygon[i]);
+        if (d <= 0.0f) outside.push_back(polygon[i]);
+        if ((d > 0.0f && dNext < 0.0f) || (d < 0.0f && dNext > 0.0f)) {
+            glm::vec2 crossing = polygon[i] + (polygon[next] - polygon[i]) * (d / (d - dNext));
+            inside.push_back(crossing);
+            outside.push_back(crossing);
+        }
+    }
+}
+
+// Appends the parts of polygon outside clip (both convex and
+// counter-clockwise) to parts, at most one per edge of clip. Returns false,
+// leaving parts alone, when they don't overlap.
+bool subtractConvex(const Polygon& polygon, const Polygon& clip, std::vector<Polygon>& parts) {
+    Polygon remaining, inside, outside;
+    const Polygon* current = &polygon; // Copied on the first split
+    std::vector<float> distances(polygon.size() + clip.size()); // Each split adds at most one corner
+    size_t firstPart = parts.size();
+    for (size_t e = 0; e < clip.size(); ++e) {
+        glm::vec2 a = clip[e];
+        glm::vec2 edge = clip[(e + 1) % clip.size()] - a;
+        float length = glm::length(edge);
+        
+        bool anyInside = false, anyOutside = false;
+        for (size_t i = 0; i < current->size(); ++i) {
+            float d = cross(edge, (*current)[i] - a) / length;
+            if (std::fabs(d) <= EDGE_EPSILON) d = 0.0f;
+            distances[i] = d;
+            anyInside = anyInside || d > 0.0f;
+            anyOutside = anyOutside || d < 0.0f;
+        }
+        if (!anyInside) {
+            // Nothing left inside clip: the polygon never overlapped it
+            parts.resize(firstPart);
+            return false;
+        }
+        if (!anyOutside) continue;
+        
+        splitPolygon(*current, distances.data(), inside, outside);
+        if (signedArea(outside) > MIN_AREA) parts.push_back(outside);
+        remaining.swap(inside);
+        current = &remaining;
+    }
+    return true;
+}
+
+RTreeBox boundsOf(const Polygon& polygon) {
+    RTreeBox box(polygon[0], polygon[0]);
+    for (const auto& point : polygon) {
+        box.min = glm::min(box.min, point);
+        box.max = glm::max(box.max, point);
+    }
+    return box;
+}
+
+void addVertex(RoadMesh::Piece& piece, const glm::vec2& position, const glm::vec2& texCoord) {
+    const float vertex[] = { position.x, SURFACE_HEIGHT, position.y, 0.0f, 1.0f, 0.0f, texCoord.x, texCoord.y };
+    piece.vertices.insert(piece.vertices.end(), vertex, vertex + 8);
+    glm::vec3 point(position.x, SURFACE_HEIGHT, position.y);
+    if (piece.vertices.size() == 8) {
+        piece.box = BVHBox(glm::vec3(position.x, 0.0f, position.y), point);
+    } else {
+        piece.box.min = glm::min(piece.box.min, glm::vec3(position.x, 0.0f, position.y));
+        piece.box.max = glm::max(piece.box.max, point);
+    }
+}
+
+// Each polygon as its own fan
+template <typename TexCoord>
+void addFans(RoadMesh::Piece& piece, const std::vector<Polygon>& polygons, TexCoord texCoordOf) {
+    for (const auto& polygon : polygons) {
+        unsigned int first = static_cast<unsigned int>(piece.vertices.size() / 8);
+        for (const auto& point : polygon) addVertex(piece, point, texCoordOf(point));
+        for (unsigned int k = 1; k + 1 < polygon.size(); ++k) {
+            piece.indices.push_back(first);
+            piece.indices.push_back(first + k);
+            piece.indices.push_back(first + k + 1);
+        }
+    }
+}
+
+}
+
+RoadMesh::RoadMesh() {}
+
+void RoadMesh::build(const RoadGraph& graph) {
+    pieces.clear();
+    const auto& nodes = graph.getNodes();
+    std::vector<std::pair<int, int>> segments = graph.getSegments();
+    
+    std::vector<std::vector<int>> incident(nodes.size());
+    for (size_t i = 0; i < segments.size(); ++i) {
+        incident[segments[i].first].push_back(static_cast<int>(i));
+        incident[segments[i].second].push_back(static_cast<int>(i));
+    }
+    auto otherNode = [&](int segment, int node) {
+        return segments[segment].first == node ? segments[segment].second : segments[segment].first;
+    };
+    
+    // ends[2 i] is where segment i ends at its first node, ends[2 i + 1] at its second
+    std::vector<SegmentEnd> ends(2 * segments.size());
+    std::vector<std::pair<glm::vec2, std::vector<glm::vec2>>> junctions;
+    std::vector<std::vector<glm::vec2>> stubs; // Per junction, four corners each
+    std::vector<glm::vec2> directions;
+    std::vector<float> lengths, gaps, leftSetback, rightSetback;
+    std::vector<glm::vec2> corners;
+    std::vector<char> cornerUsable;
+    
+    for (size_t node = 0; node < nodes.size(); ++node) {
+        auto& list = incident[node];
+        int degree = static_cast<int>(list.size());
+        if (degree == 0) continue;
+        glm::vec2 center = nodes[node];
+        
+        // Around the node counter-clockwise
+        auto angleOf = [&](int segment) {
+            glm::vec2 offset = nodes[otherNode(segment, static_cast<int>(node))] - center;
+            return std::atan2(offset.y, offset.x);
+        };
+        std::sort(list.begin(), list.end(), [&](int a, int b) { return angleOf(a) < angleOf(b); });
+        
+        directions.resize(degree);
+        lengths.resize(degree);
+        for (int k = 0; k < degree; ++k) {
+            glm::vec2 offset = nodes[otherNode(list[k], static_cast<int>(node))] - center;
+            lengths[k] = glm::length(offset);
+            directions[k] = offset / lengths[k];
+        }
+        auto endAt = [&](int k) -> SegmentEnd& {
+            return ends[2 * list[k] + (segments[list[k]].first == static_cast<int>(node) ? 0 : 1)];
+        };
+        
+        // Dead end: cut square at the node
+        if (degree == 1) {
+            endAt(0).left = center + leftOf(directions[0]) * HALF_WIDTH;
+            endAt(0).right = center - leftOf(directions[0]) * HALF_WIDTH;
+            continue;
+        }
+        
+        // Corner between each segment's left edge and the next one's right
+        // edge; gaps[k] > 0 when the turn between them is under 180 degrees
+        gaps.resize(degree);
+        leftSetback.assign(degree, 0.0f);
+        rightSetback.assign(degree, 0.0f);
+        corners.resize(degree);
+        cornerUsable.resize(degree);
+        bool mitred = degree == 2;
+        for (int k = 0; k < degree; ++k) {
+            int next = (k + 1) % degree;
+            const glm::vec2& a = directions[k];
+            const glm::vec2& b = directions[next];
+            gaps[k] = cross(a, b);
+            if (std::fabs(gaps[k]) < PARALLEL_EPSILON) {
+                // Straight on: the edges continue each other. Doubling back: no corner.
+                bool straight = glm::dot(a, b) < 0.0f;
+                corners[k] = center + leftOf(a) * HALF_WIDTH;
+                cornerUsable[k] = straight;
+                if (!straight) {
+                    leftSetback[k] = rightSetback[next] = HALF_WIDTH * MITER_LIMIT;
+                    gaps[k] = 1.0f; // Treated as the tightest of turns
+                }
+            } else {
+                float t, s;
+                cornerOf(a, b, t, s);
+                corners[k] = center + a * t + leftOf(a) * HALF_WIDTH;
+                cornerUsable[k] = glm::length(corners[k] - center) <= HALF_WIDTH * MITER_LIMIT;
+                leftSetback[k] = t;
+                rightSetback[next] = s;
+            }
+            if (!cornerUsable[k]) mitred = false;
+        }
+        
+        // Two segments: both end on the line between the two corners
+        if (mitred) {
+            for (int k = 0; k < degree; ++k) {
+                endAt(k).left = corners[k];
+                endAt(k).right = corners[(k + degree - 1) % degree];
+            }
+            continue;
+        }
+        
+        // Junction: each segment set back past the corners it shares with
+        // its neighbours on tighter sides; the polygon joins the cut ends
+        std::vector<glm::vec2> ring, stub;
+        for (int k = 0; k < degree; ++k) {
+            int previous = (k + degree - 1) % degree;
+            float setback = 0.0f;
+            if (gaps[k] > PARALLEL_EPSILON) setback = std::max(setback, leftSetback[k]);
+            if (gaps[previous] > PARALLEL_EPSILON) setback = std::max(setback, rightSetback[k]);
+            bool shortened = setback > lengths[k] * 0.45f;
+            setback = std::min(setback, lengths[k] * 0.45f);
+            
+            glm::vec2 cut = center + directions[k] * setback;
+            glm::vec2 side = leftOf(directions[k]) * HALF_WIDTH;
+            endAt(k).left = cut + side;
+            endAt(k).right = cut - side;
+            ring.push_back(cut - side);
+            ring.push_back(cut + side);
+            
+            // A setback cut short leaves the polygon a sliver along the
+            // segment, so its full width up to the cut joins the junction
+            // (clipped against its neighbours below)
+            if (shortened) stub.insert(stub.end(), { center - side, cut - side, cut + side, center + side });
+            
+            // Outside a turn wider than 180 degrees the corner fills the notch
+            if (gaps[k] < -PARALLEL_EPSILON && cornerUsable[k]) ring.push_back(corners[k]);
+        }
+        junctions.push_back(std::make_pair(center, ring));
+        stubs.push_back(stub);
+    }
+    
+    // Every piece as the triangles it is drawn with, junctions first. Each
+    // triangle keeps what no earlier one covers, which also settles a strip
+    // folded over itself or a junction ring that isn't star-shaped.
+    struct Triangle {
+        Polygon corners;
+        int piece;              // Segment index, then segments.size() + junction index
+    };
+    std::vector<Triangle> triangles;
+    auto addTriangle = [&](const glm::vec2& a, const glm::vec2& b, const glm::vec2& c, int piece) {
+        Polygon corners = { a, b, c };
+        float area = signedArea(corners);
+        if (std::fabs(area) <= MIN_AREA) return;
+        if (area < 0.0f) std::swap(corners[1], corners[2]);
+        triangles.push_back({ corners, piece });
+    };
+    int numSegments = static_cast<int>(segments.size());
+    for (size_t j = 0; j < junctions.size(); ++j) {
+        const auto& ring = junctions[j].second;
+        for (size_t k = 0; k < ring.size(); ++k) {
+            addTriangle(junctions[j].first, ring[k], ring[(k + 1) % ring.size()], numSegments + static_cast<int>(j));
+        }
+        for (size_t k = 0; k < stubs[j].size(); k += 4) {
+            addTriangle(stubs[j][k], stubs[j][k + 1], stubs[j][k + 2], numSegments + static_cast<int>(j));
+            addTriangle(stubs[j][k + 2], stubs[j][k + 3], stubs[j][k], numSegments + static_cast<int>(j));
+        }
+    }
+    for (int i = 0; i < numSegments; ++i) {
+        const SegmentEnd& startEnd = ends[2 * i];
+        const SegmentEnd& endEnd = ends[2 * i + 1];
+        addTriangle(startEnd.right, endEnd.left, endEnd.right, i);
+        addTriangle(endEnd.right, startEnd.left, startEnd.right, i);
+    }
+    
+    std::vector<RTreeBox> boxes;
+    boxes.reserve(triangles.size());
+    for (const auto& triangle : triangles) boxes.push_back(boundsOf(triangle.corners));
+    RTree index;
+    index.build(boxes);
+    
+    std::vector<Outline> outlines(segments.size() + junctions.size());
+    std::vector<char> clipped(outlines.size(), 0);
+    std::vector<int> nearby;
+    std::vector<Polygon> parts, next;
+    for (size_t t = 0; t < triangles.size(); ++t) {
+        nearby.clear();
+        index.queryRect(boxes[t], nearby);
+        std::sort(nearby.begin(), nearby.end());
+        
+        parts.assign(1, triangles[t].corners);
+        for (int other : nearby) {
+            if (other >= static_cast<int>(t) || parts.empty()) break;
+            next.clear();
+            for (const auto& part : parts) {
+                if (subtractConvex(part, triangles[other].corners, next)) {
+                    clipped[triangles[t].piece] = 1;
+                } else {
+                    next.push_back(part);
+                }
+            }
+            parts.swap(next);
+        }
+        auto& outline = outlines[triangles[t].piece];
+        outline.insert(outline.end(), parts.begin(), parts.end());
+    }
+    
+    // Unclipped pieces keep their shared-vertex layout; stubs only come
+    // with the outline
+    pieces.reserve(outlines.size());
+    for (int i = 0; i < numSegments; ++i) {
+        const glm::vec2& start = nodes[segments[i].first];
+        const glm::vec2& end = nodes[segments[i].second];
+        if (!clipped[i]) {
+            addStrip(start, end, ends[2 * i], ends[2 * i + 1]);
+        } else if (!outlines[i].empty()) {
+            addClippedStrip(start, end, outlines[i]);
+        }
+    }
+    for (size_t j = 0; j < junctions.size(); ++j) {
+        int piece = numSegments + static_cast<int>(j);
+        if (!clipped[piece] && stubs[j].empty()) {
+            addJunction(junctions[j].first, junctions[j].second);
+        } else if (!outlines[piece].empty()) {
+            addClippedJunction(outlines[piece]);
+        }
+    }
+}
+
+// Texture u runs along the road from its start, v across it (right to left)
+void RoadMesh::addStrip(const glm::vec2& start, const glm::vec2& end, const SegmentEnd& startEnd, const SegmentEnd& endEnd) {
+    glm::vec2 direction = glm::normalize(end - start);
+    auto along = [&](const glm::vec2& point) { return glm::dot(point - start, direction) / TEXTURE_LENGTH; };
+    
+    // The far end's left and right are seen from the other node
+    pieces.emplace_back();
+    Piece& piece = pieces.back();
+    addVertex(piece, startEnd.right, glm::vec2(along(startEnd.right), 0.0f));
+    addVertex(piece, endEnd.left, glm::vec2(along(endEnd.left), 0.0f));
+    addVertex(piece, endEnd.right, glm::vec2(along(endEnd.right), 1.0f));
+    addVertex(piece, startEnd.left, glm::vec2(along(startEnd.left), 1.0f));
+    piece.indices = { 0, 1, 2, 2, 3, 0 };
+}
+
+// Fan around the node, textured in world space
+void RoadMesh::addJunction(const glm::vec2& center, const std::vector<glm::vec2>& ring) {
+    pieces.emplace_back();
+    Piece& piece = pieces.back();
+    addVertex(piece, center, center / TEXTURE_LENGTH);
+    for (const auto& point : ring) addVertex(piece, point, point / TEXTURE_LENGTH);
+    
+    unsigned int count = static_cast<unsigned int>(ring.size());
+    for (unsigned int k = 0; k < count; ++k) {
+        piece.indices.push_back(0);
+        piece.indices.push_back(k + 1);
+        piece.indices.push_back((k + 1) % count + 1);
+    }
+}
+
+// Same texture mapping as addStrip: v is 0 on the right edge, 1 on the left
+void RoadMesh::addClippedStrip(const glm::vec2& start, const glm::vec2& end, const Outline& outline) {
+    glm::vec2 direction = glm::normalize(end - start);
+    glm::vec2 left = leftOf(direction);
+    pieces.emplace_back();
+    addFans(pieces.back(), outline, [&](const glm::vec2& point) {
+        return glm::vec2(glm::dot(point - start, direction) / TEXTURE_LENGTH,
+                         0.5f + glm::dot(point - start, left) / (2.0f * HALF_WIDTH));
+    });
+}
+
+void RoadMesh::addClippedJunction(const Outline& outline) {
+    pieces.emplace_back();
+    addFans(pieces.back(), outline, [](const glm::vec2& point) { return point / TEXTURE_LENGTH; });
+}
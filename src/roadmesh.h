@@ -0,0 +1,53 @@
+#ifndef ROADMESH_H
+#define ROADMESH_H
+
+#include <glm/glm.hpp>
+#include <vector>
+#include "bvh.h"
+
+class RoadGraph;
+
+// Road surface generated once from the road graph (roads split at every
+// crossing). Each segment is a flat strip with texture coordinates running
+// along it; where two segments meet they are mitred, and where three or
+// more meet (or a bend is too sharp to mitre) the strips are set back and
+// the gap is filled by a junction polygon. Where that is not enough (a
+// setback longer than its segment, roads passing closer than a road width
+// without crossing) later pieces are clipped against earlier ones,
+// junctions first, so no two pieces overlap. A piece clipped away entirely
+// is left out.
+// Vertices are position, normal, texcoord (StaticCityMesh::MESH_FLOATS).
+class RoadMesh {
+public:
+    struct Piece {
+        std::vector<float> vertices;
+        std::vector<unsigned int> indices;
+        BVHBox box;
+    };
+    
+    RoadMesh();
+    
+    void build(const RoadGraph& graph);
+    void clear() { pieces.clear(); }
+    
+    // Strips first, then junctions
+    const std::vector<Piece>& getPieces() const { return pieces; }
+    
+private:
+    // Where a segment ends at a node, in the node's outward frame
+    struct SegmentEnd {
+        glm::vec2 left, right;
+    };
+    
+    // Convex counter-clockwise polygons a clipped piece is made of
+    typedef std::vector<std::vector<glm::vec2>> Outline;
+    
+    std::vector<Piece> pieces;
+    
+    void addStrip(const glm::vec2& start, const glm::vec2& end, const SegmentEnd& startEnd, const SegmentEnd& endEnd);
+    void addJunction(const glm::vec2& center, const std::vector<glm::vec2>& ring);
+    void addClippedStrip(const glm::vec2& start, const glm::vec2& end, const Outline& outline);
+    void addClippedJunction(const Outline& outline);
+};
+
+#endif
@@ -0,0 +1,390 @@
+#include "rtree.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <queue>
+
+namespace {
+
+float area(const RTreeBox& box) {
+    return (box.max.x - box.min.x) * (box.max.y - box.min.y);
+}
+
+RTreeBox unite(const RTreeBox& a, const RTreeBox& b) {
+    return RTreeBox(glm::min(a.min, b.min), glm::max(a.max, b.max));
+}
+
+float enlargement(const RTreeBox& box, const RTreeBox& added) {
+    return area(unite(box, added)) - area(box);
+}
+
+float distanceSquared(const RTreeBox& box, const glm::vec2& point) {
+    glm::vec2 d = glm::max(glm::max(box.min - point, point - box.max), glm::vec2(0.0f));
+    return glm::dot(d, d);
+}
+
+}
+
+RTree::RTree() : root(-1), count(0) {
+    clear();
+}
+
+void RTree::clear() {
+    nodes.clear();
+    freeNodes.clear();
+    leafOf.clear();
+    count = 0;
+    root = allocateNode(true);
+}
+
+int RTree::allocateNode(bool leaf) {
+    int index;
+    if (!freeNodes.empty()) {
+        index = freeNodes.back();
+        freeNodes.pop_back();
+    } else {
+        index = static_cast<int>(nodes.size());
+        nodes.emplace_back();
+    }
+    nodes[index].leaf = leaf;
+    nodes[index].parent = -1;
+    nodes[index].count = 0;
+    return index;
+}
+
+void RTree::releaseNode(int index) {
+    nodes[index].count = 0;
+    freeNodes.push_back(index);
+}
+
+RTreeBox RTree::nodeBox(int index) const {
+    const Node& node = nodes[index];
+    RTreeBox box = node.entries[0].box;
+    for (int i = 1; i < node.count; ++i) box = unite(box, node.entries[i].box);
+    return box;
+}
+
+// Sort-Tile-Recursive: sort by x, cut into vertical slices of about
+// sqrt(pages) nodes each, sort every slice by y and pack runs of
+// MAX_ENTRIES; repeat on the new nodes until one remains
+void RTree::build(const std::vector<RTreeBox>& boxes) {
+    nodes.clear();
+    freeNodes.clear();
+    leafOf.assign(boxes.size(), -1);
+    count = static_cast<int>(boxes.size());
+    if (boxes.empty()) {
+        root = allocateNode(true);
+        return;
+    }
+    
+    std::vector<Entry> level(boxes.size());
+    for (size_t i = 0; i < boxes.size(); ++i) level[i] = {boxes[i], static_cast<int>(i)};
+    
+    auto centreX = [](const Entry& a, const Entry& b) { return a.box.min.x + a.box.max.x < b.box.min.x + b.box.max.x; };
+    auto centreY = [](const Entry& a, const Entry& b) { return a.box.min.y + a.box.max.y < b.box.min.y + b.box.max.y; };
+    
+    bool leafLevel = true;
+    while (true) {
+        size_t pages = (level.size() + MAX_ENTRIES - 1) / MAX_ENTRIES;
+        size_t slices = static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(pages))));
+        size_t sliceSize = slices * MAX_ENTRIES;
+        
+        std::sort(level.begin(), level.end(), centreX);
+        std::vector<Entry> parents;
+        parents.reserve(pages);
+        for (size_t sliceStart = 0; sliceStart < level.size(); sliceStart += sliceSize) {
+            size_t sliceEnd = std::min(sliceStart + sliceSize, level.size());
+            std::sort(level.begin() + sliceStart, level.begin() + sliceEnd, centreY);
+            
+            for (size_t start = sliceStart; start < sliceEnd; start += MAX_ENTRIES) {
+                size_t end = std::min(start + MAX_ENTRIES, sliceEnd);
+                int index = allocateNode(leafLevel);
+                Node& node = nodes[index];
+                for (size_t i = start; i < end; ++i) {
+                    node.entries[node.count++] = level[i];
+                    if (leafLevel) leafOf[level[i].child] = index;
+                    else nodes[level[i].child].parent = index;
+                }
+                parents.push_back({nodeBox(index), index});
+            }
+        }
+        
+        if (parents.size() == 1) {
+            root = parents[0].child;
+            return;
+        }
+        level.swap(parents);
+        leafLevel = false;
+    }
+}
+
+void RTree::insert(int id, const RTreeBox& box) {
+    if (id < 0) return;
+    if (id >= static_cast<int>(leafOf.size())) leafOf.resize(id + 1, -1);
+    if (leafOf[id] >= 0) remove(id);
+    
+    addEntry(chooseLeaf(box), {box, id});
+    count++;
+}
+
+bool RTree::remove(int id) {
+    if (id < 0 || id >= static_cast<int>(leafOf.size()) || leafOf[id] < 0) return false;
+    
+    int leaf = leafOf[id];
+    for (int i = 0; i < nodes[leaf].count; ++i) {
+        if (nodes[leaf].entries[i].child == id) {
+            nodes[leaf].entries[i] = nodes[leaf].entries[--nodes[leaf].count];
+            break;
+        }
+    }
+    leafOf[id] = -1;
+    count--;
+    
+    // Dissolve underfull nodes on the way up and reinsert what they held
+    std::vector<Entry> orphans;
+    int index = leaf;
+    while (index != root) {
+        int parent = nodes[index].parent;
+        if (nodes[index].count < MIN_ENTRIES) {
+            removeChild(parent, index);
+            collectItems(index, orphans);
+        } else {
+            for (int i = 0; i < nodes[parent].count; ++i) {
+                if (nodes[parent].entries[i].child == index) nodes[parent].entries[i].box = nodeBox(index);
+            }
+        }
+        index = parent;
+    }
+    
+    // Shorten the tree while the root only forwards to one child
+    while (!nodes[root].leaf && nodes[root].count <= 1) {
+        int oldRoot = root;
+        if (nodes[root].count == 1) {
+            root = nodes[root].entries[0].child;
+            nodes[root].parent = -1;
+        } else {
+            root = allocateNode(true);
+        }
+        releaseNode(oldRoot);
+    }
+    
+    for (const auto& orphan : orphans) insert(orphan.child, orphan.box);
+    return true;
+}
+
+void RTree::update(int id, const RTreeBox& box) {
+    remove(id);
+    insert(id, box);
+}
+
+void RTree::queryPoint(const glm::vec2& point, std::vector<int>& result) const {
+    queryRect(RTreeBox(point, point), result);
+}
+
+void RTree::queryRect(const RTreeBox& rect, std::vector<int>& result) const {
+    result.clear();
+    if (count == 0) return;
+    
+    int stack[256];         // Deeper than any tree that fits in memory needs
+    int top = 0;
+    stack[top++] = root;
+    while (top > 0) {
+        const Node& node = nodes[stack[--top]];
+        for (int i = 0; i < node.count; ++i) {
+            if (!node.entries[i].box.intersects(rect)) continue;
+            if (node.leaf) result.push_back(node.entries[i].child);
+            else stack[top++] = node.entries[i].child;
+        }
+    }
+}
+
+// Best-first search: boxes come off the queue closest first, so the first
+// item popped is the nearest
+int RTree::nearest(const glm::vec2& point, float* distanceSquaredOut) const {
+    if (count == 0) return -1;
+    
+    struct Candidate {
+        float distance;
+        int index;
+        bool item;
+        bool operator>(const Candidate& other) const { return distance > other.distance; }
+    };
+    std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> queue;
+    queue.push({0.0f, root, false});
+    
+    while (!queue.empty()) {
+        Candidate candidate = queue.top();
+        queue.pop();
+        if (candidate.item) {
+            if (distanceSquaredOut) *distanceSquaredOut = candidate.distance;
+            return candidate.index;
+        }
+        
+        const Node& node = nodes[candidate.index];
+        for (int i = 0; i < node.count; ++i) {
+            queue.push({distanceSquared(node.entries[i].box, point), node.entries[i].child, node.leaf});
+        }
+    }
+    return -1;
+}
+
+int RTree::chooseLeaf(const RTreeBox& box) const {
+    int index = root;
+    while (!nodes[index].leaf) {
+        const Node& node = nodes[index];
+        int best = 0;
+        float bestGrowth = std::numeric_limits<float>::max();
+        float bestArea = std::numeric_limits<float>::max();
+        for (int i = 0; i < node.count; ++i) {
+            float growth = enlargement(node.entries[i].box, box);
+            float size = area(node.entries[i].box);
+            if (growth < bestGrowth || (growth == bestGrowth && size < bestArea)) {
+                best = i;
+                bestGrowth = growth;
+                bestArea = size;
+            }
+        }
+        index = node.entries[best].child;
+    }
+    return index;
+}
+
+void RTree::addEntry(int index, const Entry& entry) {
+    if (nodes[index].count < MAX_ENTRIES) {
+        nodes[index].entries[nodes[index].count++] = entry;
+        if (nodes[index].leaf) leafOf[entry.child] = index;
+        else nodes[entry.child].parent = index;
+        refitUpwards(index);
+        return;
+    }
+    
+    // Full: split and hand the new sibling to the parent, growing a new
+    // root when the root itself splits
+    int sibling = split(index, entry);
+    int parent = nodes[index].parent;
+    if (parent < 0) {
+        int newRoot = allocateNode(false);
+        nodes[newRoot].entries[0] = {nodeBox(index), index};
+        nodes[newRoot].entries[1] = {nodeBox(sibling), sibling};
+        nodes[newRoot].count = 2;
+        nodes[index].parent = newRoot;
+        nodes[sibling].parent = newRoot;
+        root = newRoot;
+        return;
+    }
+    for (int i = 0; i < nodes[parent].count; ++i) {
+        if (nodes[parent].entries[i].child == index) nodes[parent].entries[i].box = nodeBox(index);
+    }
+    addEntry(parent, {nodeBox(sibling), sibling});
+}
+
+// Guttman's quadratic split of a full node plus one extra entry; the node
+// keeps one group and the returned new sibling takes the other
+int RTree::split(int index, const Entry& extra) {
+    Entry all[MAX_ENTRIES + 1];
+    std::copy(nodes[index].entries, nodes[index].entries + MAX_ENTRIES, all);
+    all[MAX_ENTRIES] = extra;
+    const int total = MAX_ENTRIES + 1;
+    
+    // Seeds: the pair that would waste the most area together
+    int seedA = 0, seedB = 1;
+    float worst = -std::numeric_limits<float>::max();
+    for (int i = 0; i < total; ++i) {
+        for (int j = i + 1; j < total; ++j) {
+            float waste = area(unite(all[i].box, all[j].box)) - area(all[i].box) - area(all[j].box);
+            if (waste > worst) {
+                worst = waste;
+                seedA = i;
+                seedB = j;
+            }
+        }
+    }
+    
+    int group[MAX_ENTRIES + 1];
+    std::fill(group, group + total, -1);
+    group[seedA] = 0;
+    group[seedB] = 1;
+    RTreeBox groupBox[2] = {all[seedA].box, all[seedB].box};
+    int groupCount[2] = {1, 1};
+    int remaining = total - 2;
+    
+    while (remaining > 0) {
+        // A group that needs every remaining entry to reach the minimum gets them
+        int forced = -1;
+        if (groupCount[0] + remaining == MIN_ENTRIES) forced = 0;
+        if (groupCount[1] + remaining == MIN_ENTRIES) forced = 1;
+        
+        // Otherwise place the entry with the strongest preference first
+        int pick = -1;
+        float bestDifference = -1.0f;
+        for (int i = 0; i < total; ++i) {
+            if (group[i] >= 0) continue;
+            float difference = std::fabs(enlargement(groupBox[0], all[i].box) - enlargement(groupBox[1], all[i].box));
+            if (difference > bestDifference) {
+                bestDifference = difference;
+                pick = i;
+            }
+        }
+        
+        int target = forced;
+        if (target < 0) {
+            float growthA = enlargement(groupBox[0], all[pick].box);
+            float growthB = enlargement(groupBox[1], all[pick].box);
+            if (growthA != growthB) target = growthA < growthB ? 0 : 1;
+            else if (area(groupBox[0]) != area(groupBox[1])) target = area(groupBox[0]) < area(groupBox[1]) ? 0 : 1;
+            else target = groupCount[0] <= groupCount[1] ? 0 : 1;
+        }
+        group[pick] = target;
+        groupBox[target] = unite(groupBox[target], all[pick].box);
+        groupCount[target]++;
+        remaining--;
+    }
+    
+    bool leaf = nodes[index].leaf;
+    int sibling = allocateNode(leaf);
+    nodes[sibling].parent = nodes[index].parent;
+    nodes[index].count = 0;
+    for (int i = 0; i < total; ++i) {
+        int target = group[i] == 0 ? index : sibling;
+        nodes[target].entries[nodes[target].count++] = all[i];
+        if (leaf) leafOf[all[i].child] = target;
+        else nodes[all[i].child].parent = target;
+    }
+    return sibling;
+}
+
+void RTree::refitUpwards(int index) {
+    while (nodes[index].parent >= 0) {
+        int parent = nodes[index].parent;
+        for (int i = 0; i < nodes[parent].count; ++i) {
+            if (nodes[parent].entries[i].child == index) nodes[parent].entries[i].box = nodeBox(index);
+        }
+        index = parent;
+    }
+}
+
+// Moves every item under the node into items and frees the subtree
+void RTree::collectItems(int index, std::vector<Entry>& items) {
+    const Node& node = nodes[index];
+    for (int i = 0; i < node.count; ++i) {
+        if (node.leaf) {
+            items.push_back(node.entries[i]);
+            leafOf[node.entries[i].child] = -1;
+            count--;
+        } else {
+            collectItems(node.entries[i].child, items);
+        }
+    }
+    releaseNode(index);
+}
+
+void RTree::removeChild(int parent, int child) {
+    Node& node = nodes[parent];
+    for (int i = 0; i < node.count; ++i) {
+        if (node.entries[i].child == child) {
+            node.entries[i] = node.entries[--node.count];
+            return;
+        }
+    }
+}
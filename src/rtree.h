@@ -0,0 +1,81 @@
+#ifndef RTREE_H
+#define RTREE_H
+
+#include <glm/glm.hpp>
+#include <vector>
+
+// Axis-aligned rectangle, edges inclusive
+struct RTreeBox {
+    glm::vec2 min, max;
+    RTreeBox() : min(0.0f), max(0.0f) {}
+    RTreeBox(const glm::vec2& min, const glm::vec2& max) : min(min), max(max) {}
+    
+    bool contains(const glm::vec2& point) const {
+        return point.x >= min.x && point.x <= max.x && point.y >= min.y && point.y <= max.y;
+    }
+    bool intersects(const RTreeBox& other) const {
+        return min.x <= other.max.x && max.x >= other.min.x && min.y <= other.max.y && max.y >= other.min.y;
+    }
+};
+
+// Dynamic R-tree over rectangles identified by small non-negative ids
+// (building indices). Bulk loading uses Sort-Tile-Recursive packing; after
+// that single rectangles are inserted, moved and removed in place with
+// Guttman's least-enlargement insert and quadratic split. Nodes live in one
+// vector and refer to each other by index, so the tree copies by value.
+class RTree {
+public:
+    static const int MAX_ENTRIES = 8;
+    static const int MIN_ENTRIES = 3;
+    
+    RTree();
+    
+    // Replaces the contents; boxes[i] gets id i
+    void build(const std::vector<RTreeBox>& boxes);
+    void clear();
+    
+    void insert(int id, const RTreeBox& box);
+    bool remove(int id);
+    void update(int id, const RTreeBox& box);
+    
+    // Ids whose box contains the point / overlaps the rectangle (any order)
+    void queryPoint(const glm::vec2& point, std::vector<int>& result) const;
+    void queryRect(const RTreeBox& rect, std::vector<int>& result) const;
+    // Id of the box closest to point (0 inside it), or -1 if empty;
+    // squared distance optional
+    int nearest(const glm::vec2& point, float* distanceSquared = nullptr) const;
+    
+    int size() const { return count; }
+    
+private:
+    struct Entry {
+        RTreeBox box;
+        int child;              // Node index in inner nodes, item id in leaves
+    };
+    
+    struct Node {
+        bool leaf;
+        int parent;             // -1 for the root
+        int count;
+        Entry entries[MAX_ENTRIES];
+    };
+    
+    std::vector<Node> nodes;
+    std::vector<int> freeNodes;
+    std::vector<int> leafOf;        // Leaf holding each id (-1 = absent)
+    int root;
+    int count;
+    
+    int allocateNode(bool leaf);
+    void releaseNode(int index);
+    RTreeBox nodeBox(int index) const;
+    
+    int chooseLeaf(const RTreeBox& box) const;
+    void addEntry(int index, const Entry& entry);
+    int split(int index, const Entry& extra);
+    void refitUpwards(int index);
+    void collectItems(int index, std::vector<Entry>& items);
+    void removeChild(int parent, int child);
+};
+
+#endif
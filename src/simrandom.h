@@ -0,0 +1,42 @@
+#ifndef SIMRANDOM_H
+#define SIMRANDOM_H
+
+#include <cstdint>
+
+// Seeded xorshift64* generator. Unlike std::rand its sequence is the same on
+// every platform and standard library, and its state is a plain value that
+// can be snapshotted, which deterministic recording and replay rely on.
+class SimRandom {
+public:
+    explicit SimRandom(uint64_t seed = 1) { setSeed(seed); }
+    
+    void setSeed(uint64_t seed) {
+        // SplitMix64 scramble so nearby seeds give unrelated sequences
+        uint64_t z = seed + 0x9E3779B97F4A7C15ull;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        state = z ^ (z >> 31);
+        if (state == 0) state = 0x9E3779B97F4A7C15ull; // xorshift must not start at zero
+    }
+    
+    uint32_t nextU32() {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return static_cast<uint32_t>((state * 0x2545F4914F6CDD1Dull) >> 32);
+    }
+    
+    // Uniform integer in [0, bound)
+    int nextInt(int bound) {
+        if (bound <= 0) return 0;
+        return static_cast<int>((static_cast<uint64_t>(nextU32()) * static_cast<uint64_t>(bound)) >> 32);
+    }
+    
+    // Uniform float in [0, 1)
+    float nextFloat() { return (nextU32() >> 8) * (1.0f / 16777216.0f); }
+    
+private:
+    uint64_t state;
+};
+
+#endif
@@ -0,0 +1,463 @@
+#include "simrecorder.h"
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace {
+
+const uint32_t RECORDING_MAGIC = 0x43455253; // "SREC"
+const uint32_t RECORDING_VERSION = 2;
+const float QUANTISATION = 256.0f;           // Steps per world unit
+const float DEFAULT_TICK_LENGTH = 1.0f / 60.0f;
+
+void writeVarint(std::vector<uint8_t>& out, uint32_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+uint32_t readVarint(const std::vector<uint8_t>& in, size_t& offset) {
+    uint32_t value = 0;
+    int shift = 0;
+    while (offset < in.size() && shift < 35) {
+        uint8_t byte = in[offset++];
+        value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) break;
+        shift += 7;
+    }
+    return value;
+}
+
+template <typename T>
+void writeValue(std::ofstream& file, const T& value) {
+    file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+bool readValue(std::ifstream& file, T& value) {
+    file.read(reinterpret_cast<char*>(&value), sizeof(T));
+    return static_cast<bool>(file);
+}
+
+// Only for element types without padding
+template <typename T>
+void writeVector(std::ofstream& file, const std::vector<T>& values) {
+    uint32_t count = static_cast<uint32_t>(values.size());
+    writeValue(file, count);
+    file.write(reinterpret_cast<const char*>(values.data()), count * sizeof(T));
+}
+
+template <typename T>
+bool readVector(std::ifstream& file, std::vector<T>& values) {
+    uint32_t count = 0;
+    if (!readValue(file, count)) return false;
+    values.resize(count);
+    file.read(reinterpret_cast<char*>(values.data()), count * sizeof(T));
+    return static_cast<bool>(file);
+}
+
+static_assert(sizeof(glm::vec3) == 3 * sizeof(float), "focus track is written as packed floats");
+
+// Setups and edits go field by field in a fixed layout, so files do not
+// depend on struct padding or enum sizes
+void writeSetup(std::ofstream& file, const SimSetup& setup) {
+    writeValue(file, setup.seed);
+    writeValue(file, static_cast<int32_t>(setup.numBuildings));
+    writeValue(file, static_cast<int32_t>(setup.layoutSize));
+    writeValue(file, static_cast<int32_t>(setup.parkRadius));
+    writeValue(file, static_cast<int32_t>(setup.numPedestrians));
+    writeValue(file, static_cast<uint8_t>(setup.roadType));
+    writeValue(file, static_cast<uint8_t>(setup.skylineType));
+}
+
+bool readSetup(std::ifstream& file, SimSetup& setup) {
+    int32_t numBuildings = 0, layoutSize = 0, parkRadius = 0, numPedestrians = 0;
+    uint8_t roadType = 0, skylineType = 0;
+    bool ok = readValue(file, setup.seed) && readValue(file, numBuildings) && readValue(file, layoutSize) &&
+              readValue(file, parkRadius) && readValue(file, numPedestrians) &&
+              readValue(file, roadType) && readValue(file, skylineType);
+    if (!ok || roadType > static_cast<uint8_t>(RoadType::RANDOM) ||
+        skylineType > static_cast<uint8_t>(SkylineType::SKYSCRAPER)) {
+        return false;
+    }
+    
+    setup.numBuildings = numBuildings;
+    setup.layoutSize = layoutSize;
+    setup.parkRadius = parkRadius;
+    setup.numPedestrians = numPedestrians;
+    setup.roadType = static_cast<RoadType>(roadType);
+    setup.skylineType = static_cast<SkylineType>(skylineType);
+    return true;
+}
+
+void writeEdits(std::ofstream& file, const std::vector<SimEdit>& edits) {
+    writeValue(file, static_cast<uint32_t>(edits.size()));
+    for (const auto& edit : edits) {
+        writeValue(file, edit.tick);
+        writeValue(file, static_cast<uint8_t>(edit.type));
+        writeValue(file, static_cast<int32_t>(edit.buildingIndex));
+        writeValue(file, edit.building.position.x);
+        writeValue(file, edit.building.position.y);
+        writeValue(file, edit.building.size.x);
+        writeValue(file, edit.building.size.y);
+        writeValue(file, edit.building.height);
+        writeValue(file, static_cast<int32_t>(edit.building.textureIndex));
+        writeValue(file, static_cast<uint8_t>(edit.roadType));
+        writeValue(file, static_cast<uint8_t>(edit.skylineType));
+    }
+}
+
+bool readEdits(std::ifstream& file, std::vector<SimEdit>& edits) {
+    uint32_t count = 0;
+    if (!readValue(file, count)) return false;
+    
+    edits.clear();
+    for (uint32_t i = 0; i < count; ++i) {
+        SimEdit edit;
+        uint8_t type = 0, roadType = 0, skylineType = 0;
+        int32_t buildingIndex = 0, textureIndex = 0;
+        bool ok = readValue(file, edit.tick) && readValue(file, type) && readValue(file, buildingIndex) &&
+                  readValue(file, edit.building.position.x) && readValue(file, edit.building.position.y) &&
+                  readValue(file, edit.building.size.x) && readValue(file, edit.building.size.y) &&
+                  readValue(file, edit.building.height) && readValue(file, textureIndex) &&
+                  readValue(file, roadType) && readValue(file, skylineType);
+        if (!ok || type > static_cast<uint8_t>(SimEditType::SET_SKYLINE) ||
+            roadType > static_cast<uint8_t>(RoadType::RANDOM) ||
+            skylineType > static_cast<uint8_t>(SkylineType::SKYSCRAPER)) {
+            return false;
+        }
+        
+        edit.type = static_cast<SimEditType>(type);
+        edit.buildingIndex = buildingIndex;
+        edit.building.textureIndex = textureIndex;
+        edit.roadType = static_cast<RoadType>(roadType);
+        edit.skylineType = static_cast<SkylineType>(skylineType);
+        edits.push_back(edit);
+    }
+    return true;
+}
+
+}
+
+bool applySimEdit(const SimEdit& edit, CityGenerator& city, CrowdSimulation& crowd) {
+    const auto& buildings = city.getBuildings();
+    
+    switch (edit.type) {
+        case SimEditType::MOVE_BUILDING: {
+            if (edit.buildingIndex < 0 || edit.buildingIndex >= static_cast<int>(buildings.size())) return false;
+            const Building& building = buildings[edit.buildingIndex];
+            glm::vec2 oldPosition = building.position;
+            city.moveBuilding(edit.buildingIndex, edit.building.position);
+            
+            // Pedestrians re-route around both the old and the new footprint
+            crowd.onAreaChanged(city, glm::min(oldPosition, building.position),
+                                glm::max(oldPosition, building.position) + building.size);
+            return true;
+        }
+        case SimEditType::ADD_BUILDING: {
+            size_t beforeCount = buildings.size();
+            city.addBuilding(edit.building);
+            if (buildings.size() == beforeCount) return false;
+            crowd.onAreaChanged(city, edit.building.position, edit.building.position + edit.building.size);
+            return true;
+        }
+        case SimEditType::REMOVE_BUILDING: {
+            if (buildings.size() <= 1) return false;
+            Building removed = buildings.back();
+            city.removeLastBuilding();
+            crowd.onAreaChanged(city, removed.position, removed.position + removed.size);
+            return true;
+        }
+        case SimEditType::SET_ROAD_PATTERN:
+            city.generateRoads(edit.roadType, city.getLayoutSize());
+            city.generateStreetLights();
+            // Sidewalks moved: rebuild the walkable grid and all flow fields
+            crowd.build(city);
+            return true;
+        case SimEditType::SET_SKYLINE:
+            city.setSkylineType(edit.skylineType);
+            return true;
+    }
+    return false;
+}
+
+SimRecorder::SimRecorder()
+    : mode(Mode::IDLE), tick(0), tickLength(DEFAULT_TICK_LENGTH), setup(), nextEdit(0), keyframeSpacing(KEYFRAME_INTERVAL),
+      recordDeltas(false), replayEntry(-1), divergenceReported(false) {}
+
+void SimRecorder::advance(CityGenerator& city, CrowdSimulation& crowd, const glm::vec3& liveFocus) {
+    glm::vec3 focus = liveFocus;
+    if (mode == Mode::REPLAYING) {
+        applyEditsForTick(city, crowd);
+        focus = focusTrack[tick];
+    }
+    
+    city.updateVehicles(tickLength, focus);
+    crowd.update(tickLength);
+    
+    if (mode == Mode::RECORDING) {
+        focusTrack.push_back(focus);
+        tick++;
+        if (recordDeltas) appendDelta(city);
+        if (tick % keyframeSpacing == 0) captureKeyframe(city, crowd);
+    } else if (mode == Mode::REPLAYING) {
+        tick++;
+        if (recordDeltas) verifyReplay(city);
+        if (tick % keyframeSpacing == 0) captureKeyframe(city, crowd);
+        
+        if (tick >= getRecordedTicks()) {
+            std::cout << "[REPLAY] Finished at tick " << tick << ", simulation continues live" << std::endl;
+            mode = Mode::IDLE;
+        }
+    } else {
+        tick++;
+    }
+}
+
+void SimRecorder::startRecording(const SimSetup& newSetup, const CityGenerator& city,
+                                 const CrowdSimulation& crowd, bool recordVehicleDeltas) {
+    mode = Mode::RECORDING;
+    setup = newSetup;
+    tick = 0;
+    tickLength = DEFAULT_TICK_LENGTH;
+    focusTrack.clear();
+    edits.clear();
+    keyframes.clear();
+    keyframeSpacing = KEYFRAME_INTERVAL;
+    
+    recordDeltas = recordVehicleDeltas;
+    deltaStream.clear();
+    deltaOffsets.clear();
+    previousQuantised.clear();
+    
+    captureKeyframe(city, crowd);
+    std::cout << "[RECORD] Recording started (seed " << setup.seed << ")" << std::endl;
+}
+
+void SimRecorder::stopRecording() {
+    if (mode != Mode::RECORDING) return;
+    mode = Mode::IDLE;
+    std::cout << "[RECORD] Recorded " << getRecordedTicks() << " ticks, " << edits.size() << " edits, "
+              << deltaStream.size() << " bytes of vehicle deltas" << std::endl;
+}
+
+void SimRecorder::recordEdit(const SimEdit& edit) {
+    if (mode != Mode::RECORDING) return;
+    edits.push_back(edit);
+    edits.back().tick = static_cast<uint32_t>(tick);
+}
+
+bool SimRecorder::startReplay(CityGenerator& city, CrowdSimulation& crowd) {
+    if (mode == Mode::RECORDING) stopRecording();
+    if (focusTrack.empty()) {
+        std::cout << "[REPLAY] Nothing recorded yet" << std::endl;
+        return false;
+    }
+    
+    // A loaded recording has no snapshots yet: the caller regenerated tick 0
+    if (keyframes.empty()) {
+        tick = 0;
+        captureKeyframe(city, crowd);
+    }
+    
+    divergenceReported = false;
+    std::cout << "[REPLAY] Replaying " << getRecordedTicks() << " ticks (seed " << setup.seed << ")" << std::endl;
+    return seek(0, city, crowd);
+}
+
+void SimRecorder::stopReplay() {
+    if (mode != Mode::REPLAYING) return;
+    mode = Mode::IDLE;
+    std::cout << "[REPLAY] Stopped at tick " << tick << ", simulation continues live" << std::endl;
+}
+
+bool SimRecorder::seek(int target, CityGenerator& city, CrowdSimulation& crowd) {
+    if (keyframes.empty() || mode == Mode::RECORDING) return false;
+    target = std::max(0, std::min(target, getRecordedTicks()));
+    
+    // Latest snapshot at or before the target
+    auto after = std::upper_bound(keyframes.begin(), keyframes.end(), target,
+                                  [](int t, const Keyframe& keyframe) { return t < keyframe.tick; });
+    const Keyframe& keyframe = *(after - 1);
+    city = keyframe.city;
+    crowd = keyframe.crowd;
+    tick = keyframe.tick;
+    
+    // Edits tagged with the keyframe's tick happened after it was taken
+    nextEdit = 0;
+    while (nextEdit < edits.size() && static_cast<int>(edits[nextEdit].tick) < tick) nextEdit++;
+    replayEntry = -1;
+    
+    mode = Mode::REPLAYING;
+    while (tick < target && mode == Mode::REPLAYING) {
+        advance(city, crowd, glm::vec3(0.0f));
+    }
+    return true;
+}
+
+void SimRecorder::applyEditsForTick(CityGenerator& city, CrowdSimulation& crowd) {
+    while (nextEdit < edits.size() && static_cast<int>(edits[nextEdit].tick) <= tick) {
+        applySimEdit(edits[nextEdit], city, crowd);
+        nextEdit++;
+    }
+}
+
+// Over the cap, keep only ticks on the doubled spacing (tick 0 always is)
+void SimRecorder::captureKeyframe(const CityGenerator& city, const CrowdSimulation& crowd) {
+    if (!keyframes.empty() && keyframes.back().tick >= tick) return; // Already have it
+    keyframes.push_back({tick, city, crowd});
+    
+    while (static_cast<int>(keyframes.size()) > MAX_KEYFRAMES) {
+        keyframeSpacing *= 2;
+        int spacing = keyframeSpacing;
+        keyframes.erase(std::remove_if(keyframes.begin(), keyframes.end(),
+                                       [spacing](const Keyframe& keyframe) { return keyframe.tick % spacing != 0; }),
+                        keyframes.end());
+    }
+}
+
+void SimRecorder::quantiseVehicles(const CityGenerator& city, std::vector<int32_t>& out) const {
+    const auto& vehicles = city.getVehicles();
+    out.resize(vehicles.size() * 3);
+    for (size_t i = 0; i < vehicles.size(); ++i) {
+        out[i * 3 + 0] = static_cast<int32_t>(std::lround(vehicles[i].position.x * QUANTISATION));
+        out[i * 3 + 1] = static_cast<int32_t>(std::lround(vehicles[i].position.y * QUANTISATION));
+        out[i * 3 + 2] = static_cast<int32_t>(std::lround(vehicles[i].position.z * QUANTISATION));
+    }
+}
+
+// Vehicles mostly move a little per tick, so XOR against the previous tick
+// leaves small numbers (and exact zeros for parked and queued vehicles)
+// that varints store in one or two bytes
+void SimRecorder::appendDelta(const CityGenerator& city) {
+    int entry = static_cast<int>(deltaOffsets.size());
+    deltaOffsets.push_back(static_cast<uint32_t>(deltaStream.size()));
+    
+    quantiseVehicles(city, scratchQuantised);
+    if (entry % KEYFRAME_INTERVAL == 0 || previousQuantised.size() != scratchQuantised.size()) {
+        previousQuantised.assign(scratchQuantised.size(), 0);
+    }
+    
+    writeVarint(deltaStream, static_cast<uint32_t>(scratchQuantised.size() / 3));
+    for (size_t i = 0; i < scratchQuantised.size(); ++i) {
+        writeVarint(deltaStream, static_cast<uint32_t>(scratchQuantised[i] ^ previousQuantised[i]));
+    }
+    previousQuantised.swap(scratchQuantised);
+}
+
+bool SimRecorder::decodeVehiclePositions(int atTick, std::vector<int32_t>& quantised) const {
+    // Stream entry i holds the state after i + 1 ticks
+    int entry = atTick - 1;
+    if (entry < 0 || entry >= static_cast<int>(deltaOffsets.size())) return false;
+    
+    quantised.clear();
+    for (int i = entry - entry % KEYFRAME_INTERVAL; i <= entry; ++i) {
+        size_t offset = deltaOffsets[i];
+        size_t count = readVarint(deltaStream, offset) * 3;
+        if (i % KEYFRAME_INTERVAL == 0 || quantised.size() != count) quantised.assign(count, 0);
+        for (size_t j = 0; j < count; ++j) {
+            quantised[j] ^= static_cast<int32_t>(readVarint(deltaStream, offset));
+        }
+    }
+    return true;
+}
+
+void SimRecorder::verifyReplay(const CityGenerator& city) {
+    int entry = tick - 1;
+    if (entry >= static_cast<int>(deltaOffsets.size())) return;
+    
+    // Continue decoding from the previous tick when we have it
+    if (replayEntry == entry - 1 && entry % KEYFRAME_INTERVAL != 0) {
+        size_t offset = deltaOffsets[entry];
+        size_t count = readVarint(deltaStream, offset) * 3;
+        if (replayQuantised.size() != count) replayQuantised.assign(count, 0);
+        for (size_t j = 0; j < count; ++j) {
+            replayQuantised[j] ^= static_cast<int32_t>(readVarint(deltaStream, offset));
+        }
+    } else {
+        decodeVehiclePositions(tick, replayQuantised);
+    }
+    replayEntry = entry;
+    
+    quantiseVehicles(city, scratchQuantised);
+    if (scratchQuantised != replayQuantised && !divergenceReported) {
+        std::cerr << "WARNING::SIMRECORDER::REPLAY_DIVERGED at tick " << tick << std::endl;
+        divergenceReported = true;
+    }
+}
+
+bool SimRecorder::save(const std::string& path) const {
+    if (focusTrack.empty()) return false;
+    
+    std::error_code error;
+    std::filesystem::path parent = std::filesystem::path(path).parent_path();
+    if (!parent.empty()) std::filesystem::create_directories(parent, error);
+    
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        std::cerr << "ERROR::SIMRECORDER::FILE_NOT_WRITTEN: " << path << std::endl;
+        return false;
+    }
+    
+    writeValue(file, RECORDING_MAGIC);
+    writeValue(file, RECORDING_VERSION);
+    writeSetup(file, setup);
+    writeValue(file, tickLength);
+    writeVector(file, focusTrack);
+    writeEdits(file, edits);
+    
+    uint8_t hasDeltas = recordDeltas ? 1 : 0;
+    writeValue(file, hasDeltas);
+    writeVector(file, deltaOffsets);
+    writeVector(file, deltaStream);
+    
+    if (!file) return false;
+    std::cout << "[RECORD] Saved " << getRecordedTicks() << " ticks to " << path << std::endl;
+    return true;
+}
+
+bool SimRecorder::load(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "ERROR::SIMRECORDER::FILE_NOT_FOUND: " << path << std::endl;
+        return false;
+    }
+    
+    uint32_t magic = 0, version = 0;
+    SimSetup loadedSetup;
+    float loadedTickLength = 0.0f;
+    std::vector<glm::vec3> loadedFocus;
+    std::vector<SimEdit> loadedEdits;
+    uint8_t hasDeltas = 0;
+    std::vector<uint32_t> loadedOffsets;
+    std::vector<uint8_t> loadedStream;
+    
+    bool ok = readValue(file, magic) && readValue(file, version) &&
+              magic == RECORDING_MAGIC && version == RECORDING_VERSION &&
+              readSetup(file, loadedSetup) && readValue(file, loadedTickLength) &&
+              readVector(file, loadedFocus) && readEdits(file, loadedEdits) &&
+              readValue(file, hasDeltas) && readVector(file, loadedOffsets) && readVector(file, loadedStream);
+    if (!ok || loadedTickLength <= 0.0f) {
+        std::cerr << "ERROR::SIMRECORDER::INVALID_FILE: " << path << std::endl;
+        return false;
+    }
+    
+    mode = Mode::IDLE;
+    tick = 0;
+    setup = loadedSetup;
+    tickLength = loadedTickLength;
+    focusTrack.swap(loadedFocus);
+    edits.swap(loadedEdits);
+    keyframes.clear();
+    keyframeSpacing = KEYFRAME_INTERVAL;
+    recordDeltas = hasDeltas != 0;
+    deltaOffsets.swap(loadedOffsets);
+    deltaStream.swap(loadedStream);
+    
+    std::cout << "[RECORD] Loaded " << getRecordedTicks() << " ticks from " << path << std::endl;
+    return true;
+}
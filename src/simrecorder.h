@@ -0,0 +1,131 @@
+#ifndef SIMRECORDER_H
+#define SIMRECORDER_H
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "citygenerator.h"
+#include "crowd.h"
+
+// Everything needed to regenerate the starting city of a recording
+struct SimSetup {
+    uint64_t seed;
+    int numBuildings;
+    int layoutSize;
+    int parkRadius;
+    int numPedestrians;
+    RoadType roadType;
+    SkylineType skylineType;
+};
+
+enum class SimEditType : uint8_t {
+    MOVE_BUILDING,
+    ADD_BUILDING,
+    REMOVE_BUILDING, // Removes the last building
+    SET_ROAD_PATTERN,
+    SET_SKYLINE
+};
+
+// A user edit, recorded as its outcome (not the key press) so replay does
+// not depend on UI state
+struct SimEdit {
+    uint32_t tick;          // Applied after this many ticks have run
+    SimEditType type;
+    int buildingIndex;      // MOVE_BUILDING
+    Building building;      // MOVE_BUILDING (position) and ADD_BUILDING
+    RoadType roadType;      // SET_ROAD_PATTERN
+    SkylineType skylineType; // SET_SKYLINE
+};
+
+// Applies an edit to the simulation; false if it had no effect (e.g. an
+// added building would overlap). Live edits and replay both go through here.
+bool applySimEdit(const SimEdit& edit, CityGenerator& city, CrowdSimulation& crowd);
+
+// Deterministic fixed-step simulation with recording and replay. The sim
+// only advances through advance(), one fixed tick at a time; a recording
+// holds the setup (seed), the camera focus of each tick (it drives traffic
+// LOD) and all edits, which is enough to re-simulate a run bit-exactly.
+// Keyframes (full snapshots, at most MAX_KEYFRAMES of them) make seeking
+// cheap: they start KEYFRAME_INTERVAL ticks apart, and every time the cap
+// is hit every other one is dropped and the spacing doubles. Optionally every tick's vehicle positions are also kept, quantised
+// and XOR/varint delta-compressed, so a replay can verify itself.
+class SimRecorder {
+public:
+    enum class Mode { IDLE, RECORDING, REPLAYING };
+    
+    static const int KEYFRAME_INTERVAL = 300; // Also where the delta stream restarts
+    static const int MAX_KEYFRAMES = 32;
+    
+    SimRecorder();
+    
+    // Runs one tick. While replaying, the recorded focus and edits are used
+    // and the live focus is ignored.
+    void advance(CityGenerator& city, CrowdSimulation& crowd, const glm::vec3& liveFocus);
+    
+    // city and crowd must have just been generated from setup
+    void startRecording(const SimSetup& setup, const CityGenerator& city, const CrowdSimulation& crowd,
+                        bool recordVehicleDeltas);
+    void stopRecording();
+    
+    // Edits made while recording must be reported after they are applied
+    void recordEdit(const SimEdit& edit);
+    
+    // Restores tick 0 of the current recording and plays it back
+    bool startReplay(CityGenerator& city, CrowdSimulation& crowd);
+    void stopReplay();
+    // Jump to any recorded tick: nearest keyframe, then re-simulate forward
+    bool seek(int tick, CityGenerator& city, CrowdSimulation& crowd);
+    
+    bool save(const std::string& path) const;
+    // Loads into this recorder; regenerate the city from getSetup() before replaying
+    bool load(const std::string& path);
+    
+    Mode getMode() const { return mode; }
+    int getTick() const { return tick; }
+    int getRecordedTicks() const { return static_cast<int>(focusTrack.size()); }
+    const SimSetup& getSetup() const { return setup; }
+    float getTickLength() const { return tickLength; }
+    size_t getDeltaBytes() const { return deltaStream.size(); }
+    
+    // Quantised vehicle positions (x, y, z in 1/256 unit steps) after a recorded tick
+    bool decodeVehiclePositions(int tick, std::vector<int32_t>& quantised) const;
+    
+private:
+    struct Keyframe {
+        int tick;
+        CityGenerator city;
+        CrowdSimulation crowd;
+    };
+    
+    Mode mode;
+    int tick;               // Ticks run since the recording started
+    float tickLength;
+    SimSetup setup;
+    
+    std::vector<glm::vec3> focusTrack; // Camera focus per tick
+    std::vector<SimEdit> edits;        // Sorted by tick
+    size_t nextEdit;                   // Replay cursor into edits
+    std::vector<Keyframe> keyframes;   // Sorted by tick
+    int keyframeSpacing;               // A multiple of KEYFRAME_INTERVAL
+    
+    // Vehicle delta stream: per tick a varint vehicle count, then XOR of
+    // each quantised coordinate against the previous tick (against zero on
+    // keyframe ticks, so decoding starts at any keyframe)
+    bool recordDeltas;
+    std::vector<uint8_t> deltaStream;
+    std::vector<uint32_t> deltaOffsets; // Start of each tick in deltaStream
+    std::vector<int32_t> previousQuantised;
+    std::vector<int32_t> scratchQuantised;
+    std::vector<int32_t> replayQuantised; // Decoded stream entry replayEntry
+    int replayEntry;
+    bool divergenceReported;
+    
+    void captureKeyframe(const CityGenerator& city, const CrowdSimulation& crowd);
+    void quantiseVehicles(const CityGenerator& city, std::vector<int32_t>& out) const;
+    void appendDelta(const CityGenerator& city);
+    void verifyReplay(const CityGenerator& city);
+    void applyEditsForTick(CityGenerator& city, CrowdSimulation& crowd);
+};
+
+#endif
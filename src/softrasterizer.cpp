@@ -0,0 +1,310 @@
+#include "softrasterizer.h"
+#include "pngwriter.h"
+#include "threadpool.h"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+namespace {
+
+const int GRID_CELL = 50;
+const glm::vec3 GRID_COLOR(0.2f, 0.2f, 0.2f);
+
+const float MIN_ZOOM = 0.25f;
+const float MAX_ZOOM = 8.0f;
+
+// Square tiles; small enough to balance across cores, big enough that
+// most primitives land in only a few
+const int TILE_SIZE = 64;
+
+}
+
+Camera2D::Camera2D() : offset(0.0f), zoom(1.0f) {}
+
+glm::vec2 Camera2D::worldToScreen(const glm::vec2& world) const {
+    return (world - offset) * zoom;
+}
+
+glm::vec2 Camera2D::screenToWorld(const glm::vec2& screen) const {
+    return screen / zoom + offset;
+}
+
+void Camera2D::zoomAt(const glm::vec2& screenPoint, float factor) {
+    glm::vec2 anchor = screenToWorld(screenPoint);
+    zoom = glm::clamp(zoom * factor, MIN_ZOOM, MAX_ZOOM);
+    offset = anchor - screenPoint / zoom;
+}
+
+void Camera2D::pan(const glm::vec2& screenDelta) {
+    offset -= screenDelta / zoom;
+}
+
+SoftwareRasterizer::SoftwareRasterizer() : width(0), height(0) {}
+
+void SoftwareRasterizer::resize(int newWidth, int newHeight) {
+    width = newWidth;
+    height = newHeight;
+    pixels.assign(static_cast<size_t>(width) * height, 0);
+}
+
+void SoftwareRasterizer::render(const std::vector<Line2D>& lines, const std::vector<Circle2D>& circles,
+                                const std::vector<Polygon2D>& polygons) {
+    buildPrimitives(lines, circles, polygons);
+    
+    int tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+    int tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+    int tileCount = tilesX * tilesY;
+    if (tileCount == 0) return;
+    
+    // Bin by bounds with a counting sort: count, prefix sum, scatter. The
+    // scatter walks primitives in order, so each tile keeps draw order.
+    auto tileRange = [&](const RasterRect& r, int& tx0, int& ty0, int& tx1, int& ty1) {
+        RasterRect c = r.intersection(bounds());
+        if (c.isEmpty()) return false;
+        tx0 = c.x0 / TILE_SIZE;
+        ty0 = c.y0 / TILE_SIZE;
+        tx1 = (c.x1 - 1) / TILE_SIZE;
+        ty1 = (c.y1 - 1) / TILE_SIZE;
+        return true;
+    };
+    
+    tileStart.assign(tileCount + 1, 0);
+    for (const auto& primitive : primitives) {
+        int tx0, ty0, tx1, ty1;
+        if (!tileRange(primitive.bounds, tx0, ty0, tx1, ty1)) continue;
+        for (int ty = ty0; ty <= ty1; ++ty) {
+            for (int tx = tx0; tx <= tx1; ++tx) tileStart[ty * tilesX + tx + 1]++;
+        }
+    }
+    for (int t = 0; t < tileCount; ++t) tileStart[t + 1] += tileStart[t];
+    
+    tileEntries.resize(tileStart[tileCount]);
+    std::vector<uint32_t> cursor(tileStart.begin(), tileStart.end() - 1);
+    for (size_t i = 0; i < primitives.size(); ++i) {
+        int tx0, ty0, tx1, ty1;
+        if (!tileRange(primitives[i].bounds, tx0, ty0, tx1, ty1)) continue;
+        for (int ty = ty0; ty <= ty1; ++ty) {
+            for (int tx = tx0; tx <= tx1; ++tx) tileEntries[cursor[ty * tilesX + tx]++] = static_cast<int>(i);
+        }
+    }
+    
+    // Tiles write disjoint pixels, so they need no synchronisation
+    ThreadPool::shared().parallelFor(tileCount, [&](int begin, int end) {
+        for (int t = begin; t < end; ++t) {
+            int tx = t % tilesX;
+            int ty = t / tilesX;
+            RasterRect clip(tx * TILE_SIZE, ty * TILE_SIZE,
+                            std::min(width, (tx + 1) * TILE_SIZE), std::min(height, (ty + 1) * TILE_SIZE));
+            rasterise(clip, tileEntries.data() + tileStart[t], tileStart[t + 1] - tileStart[t]);
+        }
+    });
+}
+
+void SoftwareRasterizer::renderRect(const RasterRect& clip, const std::vector<Line2D>& lines,
+                                    const std::vector<Circle2D>& circles, const std::vector<Polygon2D>& polygons) {
+    RasterRect r = clip.intersection(bounds());
+    if (r.isEmpty()) return;
+    
+    buildPrimitives(lines, circles, polygons);
+    tileEntries.clear();
+    for (size_t i = 0; i < primitives.size(); ++i) {
+        if (primitives[i].bounds.intersects(r)) tileEntries.push_back(static_cast<int>(i));
+    }
+    rasterise(r, tileEntries.data(), tileEntries.size());
+}
+
+void SoftwareRasterizer::clear(const RasterRect& rect) {
+    fill(rect, 0u);
+}
+
+void SoftwareRasterizer::fill(const RasterRect& rect, uint32_t color) {
+    RasterRect r = rect.intersection(bounds());
+    if (r.isEmpty()) return;
+    
+    for (int y = r.y0; y < r.y1; ++y) {
+        std::fill(pixels.begin() + static_cast<size_t>(y) * width + r.x0,
+                  pixels.begin() + static_cast<size_t>(y) * width + r.x1, color);
+    }
+}
+
+void SoftwareRasterizer::copyPixels(const SoftwareRasterizer& source) {
+    if (source.width != width || source.height != height) return;
+    std::copy(source.pixels.begin(), source.pixels.end(), pixels.begin());
+}
+
+void SoftwareRasterizer::drawImage(const RasterRect& dest, const std::vector<uint32_t>& image, int imageWidth,
+                                   int imageHeight, const glm::vec2& uvMin, const glm::vec2& uvMax) {
+    RasterRect r = dest.intersection(bounds());
+    if (r.isEmpty()) return;
+    
+    // Texture coordinate at each pixel centre, then the texel it falls in
+    glm::vec2 destSize(dest.x1 - dest.x0, dest.y1 - dest.y0);
+    glm::vec2 uvStep = (uvMax - uvMin) / destSize;
+    auto texel = [](float coord, int size) { return std::max(0, std::min(size - 1, static_cast<int>(std::floor(coord * size)))); };
+    for (int y = r.y0; y < r.y1; ++y) {
+        int ty = texel(uvMin.y + (y + 0.5f - dest.y0) * uvStep.y, imageHeight);
+        const uint32_t* row = image.data() + static_cast<size_t>(ty) * imageWidth;
+        uint32_t* out = pixels.data() + static_cast<size_t>(y) * width;
+        for (int x = r.x0; x < r.x1; ++x) {
+            uint32_t color = row[texel(uvMin.x + (x + 0.5f - dest.x0) * uvStep.x, imageWidth)];
+            if (color) out[x] = color;
+        }
+    }
+}
+
+bool SoftwareRasterizer::savePNG(const std::string& path, uint32_t background) const {
+    if (background == 0) return writePNG(path, width, height, pixels);
+    
+    std::vector<uint32_t> flattened(pixels);
+    for (auto& pixel : flattened) {
+        if (pixel == 0) pixel = background;
+    }
+    return writePNG(path, width, height, flattened);
+}
+
+RasterRect SoftwareRasterizer::pointFootprint(const RasterSpan& span) {
+    return RasterRect(span.x0 - 1, span.y0 - 1, span.x1 + 1, span.y1 + 1);
+}
+
+RasterRect SoftwareRasterizer::plotArea(const RasterRect& pixelRect) {
+    return RasterRect(pixelRect.x0, pixelRect.y0, pixelRect.x1 + 1, pixelRect.y1 + 1);
+}
+
+bool SoftwareRasterizer::circleTouches(int cx, int cy, int radius, const RasterRect& rect) {
+    RasterRect circleBounds = pointFootprint(RasterSpan(cx - radius, cy - radius, cx + radius, cy + radius));
+    if (!rect.intersects(circleBounds)) return false;
+    
+    long long inner = std::max(0, radius - 2);
+    auto inside = [&](int x, int y) {
+        long long dx = x - cx;
+        long long dy = y - cy;
+        return dx * dx + dy * dy < inner * inner;
+    };
+    return !(inside(rect.x0, rect.y0) && inside(rect.x1, rect.y0) &&
+             inside(rect.x0, rect.y1) && inside(rect.x1, rect.y1));
+}
+
+uint32_t SoftwareRasterizer::packColor(const glm::vec3& color) {
+    glm::vec3 c = glm::clamp(color, 0.0f, 1.0f) * 255.0f + 0.5f;
+    // Bytes in memory: R, G, B, A (little-endian)
+    return static_cast<uint32_t>(c.r) | (static_cast<uint32_t>(c.g) << 8) |
+           (static_cast<uint32_t>(c.b) << 16) | (0xFFu << 24);
+}
+
+Point2D SoftwareRasterizer::snapToPixel(const glm::vec2& screen) {
+    return Point2D(static_cast<int>(std::floor(screen.x + 0.5f)), static_cast<int>(std::floor(screen.y + 0.5f)));
+}
+
+Point2D SoftwareRasterizer::toScreen(const Point2D& world) const {
+    return snapToPixel(camera.worldToScreen(glm::vec2(world.x, world.y)));
+}
+
+void SoftwareRasterizer::buildPrimitives(const std::vector<Line2D>& lines, const std::vector<Circle2D>& circles,
+                                         const std::vector<Polygon2D>& polygons) {
+    primitives.clear();
+    primitives.reserve(lines.size() + circles.size() + polygons.size());
+    screenVertices.clear();
+    
+    for (const auto& polygon : polygons) {
+        if (polygon.points.size() < 3) continue;
+        ScreenPrimitive primitive;
+        primitive.kind = PrimitiveKind::POLYGON;
+        primitive.radius = 0;
+        primitive.firstVertex = static_cast<int>(screenVertices.size());
+        primitive.vertexCount = static_cast<int>(polygon.points.size());
+        primitive.color = packColor(polygon.color);
+        
+        Point2D lo(INT_MAX, INT_MAX), hi(INT_MIN, INT_MIN);
+        for (const auto& point : polygon.points) {
+            Point2D screen = toScreen(point);
+            lo = Point2D(std::min(lo.x, screen.x), std::min(lo.y, screen.y));
+            hi = Point2D(std::max(hi.x, screen.x), std::max(hi.y, screen.y));
+            screenVertices.push_back(screen);
+        }
+        primitive.bounds = RasterRect(lo.x, lo.y, hi.x, hi.y);
+        primitives.push_back(primitive);
+    }
+    
+    // Discs before the lines and circle outlines after, so fills stay underneath
+    auto addCircles = [&](bool filled) {
+        for (const auto& circle : circles) {
+            if (circle.filled != filled) continue;
+            ScreenPrimitive primitive;
+            primitive.kind = filled ? PrimitiveKind::DISC : PrimitiveKind::CIRCLE;
+            primitive.start = toScreen(circle.center);
+            primitive.end = primitive.start;
+            primitive.radius = static_cast<int>(std::lround(circle.radius * camera.zoom));
+            primitive.color = packColor(circle.color);
+            primitive.bounds = pointFootprint(RasterSpan(primitive.start.x - primitive.radius, primitive.start.y - primitive.radius,
+                                                         primitive.start.x + primitive.radius, primitive.start.y + primitive.radius));
+            primitives.push_back(primitive);
+        }
+    };
+    addCircles(true);
+    
+    for (const auto& line : lines) {
+        ScreenPrimitive primitive;
+        primitive.kind = PrimitiveKind::LINE;
+        primitive.start = toScreen(line.start);
+        primitive.end = toScreen(line.end);
+        primitive.radius = 0;
+        primitive.color = packColor(line.color);
+        primitive.bounds = pointFootprint(RasterSpan(std::min(primitive.start.x, primitive.end.x),
+                                                     std::min(primitive.start.y, primitive.end.y),
+                                                     std::max(primitive.start.x, primitive.end.x),
+                                                     std::max(primitive.start.y, primitive.end.y)));
+        primitives.push_back(primitive);
+    }
+    
+    addCircles(false);
+}
+
+// Paints one rectangle from scratch: grid first, then the given primitives
+// in order, so overlaps come out the same however the frame is split up.
+// Lines are clipped exactly, so only pixels inside the rectangle are walked.
+void SoftwareRasterizer::rasterise(const RasterRect& clip, const int* indices, size_t count) {
+    clear(clip);
+    RasterRect plotClip = plotArea(clip);
+    
+    // World-aligned grid, only the lines crossing the rectangle
+    uint32_t gridColor = packColor(GRID_COLOR);
+    auto fillGrid = [&](const RasterSpan& span) { fill(pointFootprint(span).intersection(clip), gridColor); };
+    glm::vec2 worldMin = camera.screenToWorld(glm::vec2(plotClip.x0, plotClip.y0));
+    glm::vec2 worldMax = camera.screenToWorld(glm::vec2(plotClip.x1, plotClip.y1));
+    for (int gx = static_cast<int>(std::floor(worldMin.x / GRID_CELL)); gx * GRID_CELL <= worldMax.x; ++gx) {
+        int x = toScreen(Point2D(gx * GRID_CELL, 0)).x;
+        rasterBresenhamSpans(x, plotClip.y0, x, plotClip.y1 - 1, plotClip, fillGrid);
+    }
+    for (int gy = static_cast<int>(std::floor(worldMin.y / GRID_CELL)); gy * GRID_CELL <= worldMax.y; ++gy) {
+        int y = toScreen(Point2D(0, gy * GRID_CELL)).y;
+        rasterBresenhamSpans(plotClip.x0, y, plotClip.x1 - 1, y, plotClip, fillGrid);
+    }
+    
+    for (size_t i = 0; i < count; ++i) {
+        const ScreenPrimitive& primitive = primitives[indices[i]];
+        // Outlines come as point runs, fills as pixel runs already in clip
+        auto fillSpan = [&](const RasterSpan& span) { fill(pointFootprint(span).intersection(clip), primitive.color); };
+        auto fillRun = [&](const RasterSpan& span) { fill(RasterRect(span.x0, span.y0, span.x1 + 1, span.y1 + 1), primitive.color); };
+        
+        switch (primitive.kind) {
+            case PrimitiveKind::LINE:
+                if (!clip.intersects(primitive.bounds)) continue;
+                rasterBresenhamSpans(primitive.start.x, primitive.start.y, primitive.end.x, primitive.end.y,
+                                     plotClip, fillSpan);
+                break;
+            case PrimitiveKind::CIRCLE:
+                if (!circleTouches(primitive.start.x, primitive.start.y, primitive.radius, clip)) continue;
+                rasterMidpointCircleSpans(primitive.start.x, primitive.start.y, primitive.radius, plotClip, fillSpan);
+                break;
+            case PrimitiveKind::DISC:
+                if (!clip.intersects(primitive.bounds)) continue;
+                rasterFillCircleSpans(primitive.start.x, primitive.start.y, primitive.radius, clip, fillRun);
+                break;
+            case PrimitiveKind::POLYGON:
+                if (!clip.intersects(primitive.bounds)) continue;
+                rasterFillPolygonSpans(screenVertices.data() + primitive.firstVertex, primitive.vertexCount,
+                                       clip, fillRun);
+                break;
+        }
+    }
+}
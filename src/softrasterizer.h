@@ -0,0 +1,130 @@
+#ifndef SOFTRASTERIZER_H
+#define SOFTRASTERIZER_H
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "raster2d.h"
+
+struct Point2D {
+    int x, y;
+    Point2D(int x = 0, int y = 0) : x(x), y(y) {}
+};
+
+struct Line2D {
+    Point2D start, end;
+    glm::vec3 color;
+    Line2D(Point2D s, Point2D e, glm::vec3 c = glm::vec3(1.0f))
+        : start(s), end(e), color(c) {}
+};
+
+struct Circle2D {
+    Point2D center;
+    int radius;
+    glm::vec3 color;
+    bool filled;    // Solid disc instead of the midpoint outline
+    Circle2D(Point2D c, int r, glm::vec3 col = glm::vec3(0.0f, 1.0f, 0.0f), bool fill = false)
+        : center(c), radius(r), color(col), filled(fill) {}
+};
+
+// Filled area (building footprints); outlines are separate lines
+struct Polygon2D {
+    std::vector<Point2D> points;
+    glm::vec3 color;
+    Polygon2D(const std::vector<Point2D>& p, glm::vec3 c = glm::vec3(1.0f))
+        : points(p), color(c) {}
+};
+
+// Pan/zoom for the 2D view. Screen pixel = (world - offset) * zoom.
+struct Camera2D {
+    glm::vec2 offset;   // World point at the top-left corner of the screen
+    float zoom;         // Screen pixels per world unit
+    
+    Camera2D();
+    glm::vec2 worldToScreen(const glm::vec2& world) const;
+    glm::vec2 screenToWorld(const glm::vec2& screen) const;
+    void zoomAt(const glm::vec2& screenPoint, float factor); // Keeps screenPoint fixed
+    void pan(const glm::vec2& screenDelta);
+    bool operator==(const Camera2D& other) const { return offset == other.offset && zoom == other.zoom; }
+};
+
+// GL-free renderer for the 2D plan (grid, fills, lines, circles) into an
+// RGBA8 framebuffer. Fills go under outlines: polygons, discs, lines, then
+// circle outlines, each group in list order. Whole frames are binned into tiles rasterised in parallel;
+// a tile runs the same clipped code as a single-rectangle repaint, so the
+// image does not depend on the tiling. Renderer2D uses it for its cached
+// layer, which is how the GL and CPU backends stay pixel-identical.
+class SoftwareRasterizer {
+public:
+    SoftwareRasterizer();
+    
+    void resize(int newWidth, int newHeight);
+    void setCamera(const Camera2D& newCamera) { camera = newCamera; }
+    const Camera2D& getCamera() const { return camera; }
+    
+    // Whole frame, tiled and parallel
+    void render(const std::vector<Line2D>& lines, const std::vector<Circle2D>& circles,
+                const std::vector<Polygon2D>& polygons);
+    // Repaint one rectangle on the calling thread
+    void renderRect(const RasterRect& clip, const std::vector<Line2D>& lines, const std::vector<Circle2D>& circles,
+                    const std::vector<Polygon2D>& polygons);
+    
+    void clear(const RasterRect& rect); // Back to transparent
+    void fill(const RasterRect& rect, uint32_t color); // Clipped to the framebuffer
+    void copyPixels(const SoftwareRasterizer& source); // Same size
+    // Part [uvMin, uvMax] of an image stretched over dest, sampled like
+    // GL_NEAREST on a quad covering dest; transparent texels are skipped
+    void drawImage(const RasterRect& dest, const std::vector<uint32_t>& image, int imageWidth, int imageHeight,
+                   const glm::vec2& uvMin, const glm::vec2& uvMax);
+    
+    // Transparent pixels are written as background unless it is 0
+    bool savePNG(const std::string& path, uint32_t background = 0) const;
+    
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    RasterRect bounds() const { return RasterRect(0, 0, width, height); }
+    const std::vector<uint32_t>& getPixels() const { return pixels; }
+    
+    // Pixels a run of GL points of size 2 covers: a point at x paints x-1
+    // and x, so the span grows by one pixel left/up and ends one past
+    static RasterRect pointFootprint(const RasterSpan& span);
+    // Point positions whose footprint touches the pixel rectangle
+    static RasterRect plotArea(const RasterRect& pixelRect);
+    // Whether any of the circle's outline can land in rect: its bounds
+    // must touch rect and rect must not sit entirely inside the ring
+    static bool circleTouches(int cx, int cy, int radius, const RasterRect& rect);
+    static uint32_t packColor(const glm::vec3& color); // RGBA8, R in the low byte
+    // Nearest pixel, halves rounded up: shifting the input by whole pixels
+    // shifts the result the same, which keeps tiles and the screen in step
+    static Point2D snapToPixel(const glm::vec2& screen);
+    
+private:
+    enum class PrimitiveKind { LINE, CIRCLE, DISC, POLYGON };
+    
+    // An element already in screen space
+    struct ScreenPrimitive {
+        PrimitiveKind kind;
+        Point2D start, end;     // Line endpoints; start is a circle's center
+        int radius;
+        int firstVertex, vertexCount; // Polygon corners in screenVertices
+        uint32_t color;
+        RasterRect bounds;      // Pixels it can touch
+    };
+    
+    int width, height;
+    std::vector<uint32_t> pixels; // Row 0 at the top of the screen
+    Camera2D camera;
+    
+    std::vector<ScreenPrimitive> primitives;
+    std::vector<Point2D> screenVertices;
+    std::vector<uint32_t> tileStart;  // Tile t owns tileEntries[tileStart[t], tileStart[t + 1])
+    std::vector<int> tileEntries;     // Primitive indices, in draw order per tile
+    
+    Point2D toScreen(const Point2D& world) const;
+    void buildPrimitives(const std::vector<Line2D>& lines, const std::vector<Circle2D>& circles,
+                         const std::vector<Polygon2D>& polygons);
+    void rasterise(const RasterRect& clip, const int* indices, size_t count);
+};
+
+#endif
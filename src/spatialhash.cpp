@@ -0,0 +1,211 @@
+#include "spatialhash.h"
+#include "threadpool.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+
+namespace {
+
+// Below this many points a single-threaded sort beats waking the pool
+const int PARALLEL_THRESHOLD = 4096;
+const int MIN_CHUNK_SIZE = 2048;
+
+}
+
+SpatialHash::SpatialHash(float size) : tableMask(0), minCell(0), maxCell(-1) {
+    setCellSize(size);
+}
+
+void SpatialHash::setCellSize(float size) {
+    cellSize = std::max(size, 0.001f);
+    inverseCellSize = 1.0f / cellSize;
+}
+
+glm::ivec2 SpatialHash::cellOf(const glm::vec2& position) const {
+    return glm::ivec2(static_cast<int>(std::floor(position.x * inverseCellSize)),
+                      static_cast<int>(std::floor(position.y * inverseCellSize)));
+}
+
+uint32_t SpatialHash::bucketOf(const glm::ivec2& cell) const {
+    uint32_t h = static_cast<uint32_t>(cell.x) * 73856093u ^ static_cast<uint32_t>(cell.y) * 19349663u;
+    return (h ^ (h >> 16)) & tableMask;
+}
+
+void SpatialHash::build(const std::vector<glm::vec2>& positions) {
+    int count = static_cast<int>(positions.size());
+    
+    // About two buckets per point keeps collisions rare
+    uint32_t tableSize = 16;
+    while (tableSize < 2u * static_cast<uint32_t>(count)) tableSize <<= 1;
+    tableMask = tableSize - 1;
+    
+    entries.resize(count);
+    entryPositions.resize(count);
+    pointBucket.resize(count);
+    bucketStart.assign(tableSize + 1, 0);
+    
+    ThreadPool& pool = ThreadPool::shared();
+    int numChunks = 1;
+    if (count >= PARALLEL_THRESHOLD) {
+        numChunks = std::min(static_cast<int>(pool.size()) + 1, count / MIN_CHUNK_SIZE);
+        numChunks = std::max(numChunks, 1);
+    }
+    int chunkSize = (count + numChunks - 1) / std::max(numChunks, 1);
+    chunkCounts.assign(static_cast<size_t>(numChunks) * tableSize, 0);
+    
+    std::vector<glm::ivec2> chunkMin(numChunks, glm::ivec2(std::numeric_limits<int>::max()));
+    std::vector<glm::ivec2> chunkMax(numChunks, glm::ivec2(std::numeric_limits<int>::min()));
+    
+    auto forEachChunk = [&](const std::function<void(int chunk, int begin, int end)>& body) {
+        auto run = [&](int firstChunk, int lastChunk) {
+            for (int c = firstChunk; c < lastChunk; ++c) {
+                body(c, c * chunkSize, std::min(count, (c + 1) * chunkSize));
+            }
+        };
+        if (numChunks > 1) pool.parallelFor(numChunks, run);
+        else run(0, numChunks);
+    };
+    
+    // 1. Per-chunk histograms of bucket sizes
+    forEachChunk([&](int chunk, int begin, int end) {
+        uint32_t* counts = &chunkCounts[static_cast<size_t>(chunk) * tableSize];
+        for (int i = begin; i < end; ++i) {
+            glm::ivec2 cell = cellOf(positions[i]);
+            chunkMin[chunk] = glm::min(chunkMin[chunk], cell);
+            chunkMax[chunk] = glm::max(chunkMax[chunk], cell);
+            pointBucket[i] = bucketOf(cell);
+            counts[pointBucket[i]]++;
+        }
+    });
+    
+    // 2. Exclusive prefix sum, bucket-major then chunk-major, so each chunk
+    // gets its own write cursor per bucket and the sort stays stable
+    uint32_t total = 0;
+    for (uint32_t b = 0; b < tableSize; ++b) {
+        bucketStart[b] = total;
+        for (int c = 0; c < numChunks; ++c) {
+            uint32_t& slot = chunkCounts[static_cast<size_t>(c) * tableSize + b];
+            uint32_t size = slot;
+            slot = total;
+            total += size;
+        }
+    }
+    bucketStart[tableSize] = total;
+    
+    // 3. Scatter; chunks write disjoint slots
+    forEachChunk([&](int chunk, int begin, int end) {
+        uint32_t* cursor = &chunkCounts[static_cast<size_t>(chunk) * tableSize];
+        for (int i = begin; i < end; ++i) {
+            uint32_t slot = cursor[pointBucket[i]]++;
+            entries[slot] = i;
+            entryPositions[slot] = positions[i];
+        }
+    });
+    
+    minCell = glm::ivec2(0);
+    maxCell = glm::ivec2(-1);
+    if (count > 0) {
+        minCell = chunkMin[0];
+        maxCell = chunkMax[0];
+        for (int c = 1; c < numChunks; ++c) {
+            minCell = glm::min(minCell, chunkMin[c]);
+            maxCell = glm::max(maxCell, chunkMax[c]);
+        }
+    }
+}
+
+void SpatialHash::queryRadius(const glm::vec2& center, float radius, std::vector<int>& result) const {
+    result.clear();
+    if (entries.empty()) return;
+    float radiusSq = radius * radius;
+    
+    glm::ivec2 low = glm::max(cellOf(center - glm::vec2(radius)), minCell);
+    glm::ivec2 high = glm::min(cellOf(center + glm::vec2(radius)), maxCell);
+    if (low.x > high.x || low.y > high.y) return;
+    
+    // A query wider than the table is cheaper as a plain scan
+    int64_t numCells = static_cast<int64_t>(high.x - low.x + 1) * (high.y - low.y + 1);
+    if (numCells > static_cast<int64_t>(tableMask) + 1) {
+        for (size_t s = 0; s < entries.size(); ++s) {
+            glm::vec2 d = entryPositions[s] - center;
+            if (glm::dot(d, d) <= radiusSq) result.push_back(entries[s]);
+        }
+        return;
+    }
+    
+    for (int cy = low.y; cy <= high.y; ++cy) {
+        for (int cx = low.x; cx <= high.x; ++cx) {
+            glm::ivec2 cell(cx, cy);
+            uint32_t bucket = bucketOf(cell);
+            for (uint32_t s = bucketStart[bucket]; s < bucketStart[bucket + 1]; ++s) {
+                // Buckets are shared by colliding cells; only take this cell's points
+                if (cellOf(entryPositions[s]) != cell) continue;
+                glm::vec2 d = entryPositions[s] - center;
+                if (glm::dot(d, d) <= radiusSq) result.push_back(entries[s]);
+            }
+        }
+    }
+}
+
+// Grows square rings of cells around the center; stops once the ring is
+// farther away than the current k-th neighbour
+void SpatialHash::queryNearest(const glm::vec2& center, int k, float maxRadius, int exclude,
+                               std::vector<int>& result) const {
+    result.clear();
+    if (k <= 0 || entries.empty()) return;
+    
+    static thread_local std::vector<std::pair<float, int>> best; // Max-heap on distance
+    best.clear();
+    float maxRadiusSq = maxRadius * maxRadius;
+    
+    glm::ivec2 origin = cellOf(center);
+    glm::ivec2 reach = glm::max(glm::abs(origin - minCell), glm::abs(maxCell - origin));
+    int gridRing = std::max(reach.x, reach.y);
+    // Clamped while still a float: an unbounded (infinite) radius must not
+    // reach the int conversion
+    float radiusRing = std::ceil(maxRadius * inverseCellSize) + 1.0f;
+    int maxRing = radiusRing < static_cast<float>(gridRing) ? static_cast<int>(radiusRing) : gridRing;
+    
+    auto visit = [&](const glm::ivec2& cell) {
+        uint32_t bucket = bucketOf(cell);
+        for (uint32_t s = bucketStart[bucket]; s < bucketStart[bucket + 1]; ++s) {
+            if (entries[s] == exclude || cellOf(entryPositions[s]) != cell) continue;
+            glm::vec2 d = entryPositions[s] - center;
+            float distSq = glm::dot(d, d);
+            if (distSq > maxRadiusSq) continue;
+            
+            std::pair<float, int> candidate(distSq, entries[s]);
+            if (static_cast<int>(best.size()) < k) {
+                best.push_back(candidate);
+                std::push_heap(best.begin(), best.end());
+            } else if (candidate < best.front()) {
+                std::pop_heap(best.begin(), best.end());
+                best.back() = candidate;
+                std::push_heap(best.begin(), best.end());
+            }
+        }
+    };
+    
+    for (int ring = 0; ring <= maxRing; ++ring) {
+        // Every point in this ring is at least (ring - 1) cells away
+        float ringDistance = (ring - 1) * cellSize;
+        if (ring > 1 && static_cast<int>(best.size()) == k && ringDistance * ringDistance > best.front().first) break;
+        
+        if (ring == 0) {
+            visit(origin);
+            continue;
+        }
+        for (int dx = -ring; dx <= ring; ++dx) {
+            visit(origin + glm::ivec2(dx, -ring));
+            visit(origin + glm::ivec2(dx, ring));
+        }
+        for (int dy = -ring + 1; dy <= ring - 1; ++dy) {
+            visit(origin + glm::ivec2(-ring, dy));
+            visit(origin + glm::ivec2(ring, dy));
+        }
+    }
+    
+    std::sort(best.begin(), best.end());
+    for (const auto& entry : best) result.push_back(entry.second);
+}
@@ -0,0 +1,44 @@
+#ifndef SPATIALHASH_H
+#define SPATIALHASH_H
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+// Broadphase for neighbour queries on moving points, rebuilt from scratch
+// every tick. Points are bucketed by a hash of their grid cell using a
+// (parallel) counting sort, so each bucket is a contiguous run of one flat
+// array: no per-cell allocations and a rebuild that is linear in the count.
+class SpatialHash {
+public:
+    explicit SpatialHash(float cellSize = 20.0f);
+    
+    void setCellSize(float size);
+    void build(const std::vector<glm::vec2>& positions);
+    
+    // Indices (into the positions passed to build) within radius of center
+    void queryRadius(const glm::vec2& center, float radius, std::vector<int>& result) const;
+    // Up to k nearest indices within maxRadius (may be infinite), closest
+    // first. exclude is skipped (pass the querying point's own index, or -1).
+    void queryNearest(const glm::vec2& center, int k, float maxRadius, int exclude,
+                      std::vector<int>& result) const;
+    
+    int getPointCount() const { return static_cast<int>(entries.size()); }
+    
+private:
+    float cellSize;
+    float inverseCellSize;
+    uint32_t tableMask;                  // Table size is a power of two
+    glm::ivec2 minCell, maxCell;         // Occupied cell range, bounds kNN ring growth
+    
+    std::vector<uint32_t> bucketStart;   // Size table + 1; bucket b is [start[b], start[b + 1])
+    std::vector<int> entries;            // Point indices grouped by bucket
+    std::vector<glm::vec2> entryPositions; // Positions in the same order, for locality
+    std::vector<uint32_t> pointBucket;   // Scratch: bucket per input point
+    std::vector<uint32_t> chunkCounts;   // Scratch: per-chunk histograms
+    
+    glm::ivec2 cellOf(const glm::vec2& position) const;
+    uint32_t bucketOf(const glm::ivec2& cell) const;
+};
+
+#endif
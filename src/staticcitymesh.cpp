@@ -0,0 +1,249 @@
+#include "staticcitymesh.h"
+#include <glad/glad.h>
+#include <algorithm>
+
+namespace {
+
+// Starting room per batch; grows by doubling
+const uint32_t INITIAL_VERTICES = 1024;
+const uint32_t INITIAL_INDICES = 2048;
+
+}
+
+bool StaticCityMesh::FreeList::allocate(uint32_t size, uint32_t& offset) {
+    for (size_t i = 0; i < ranges.size(); ++i) {
+        if (ranges[i].second < size) continue;
+        offset = ranges[i].first;
+        ranges[i].first += size;
+        ranges[i].second -= size;
+        if (ranges[i].second == 0) ranges.erase(ranges.begin() + i);
+        return true;
+    }
+    return false;
+}
+
+void StaticCityMesh::FreeList::release(uint32_t offset, uint32_t size) {
+    if (size == 0) return;
+    auto next = std::lower_bound(ranges.begin(), ranges.end(), std::make_pair(offset, 0u));
+    next = ranges.insert(next, std::make_pair(offset, size));
+    
+    // Merge with the following range, then with the preceding one
+    auto after = next + 1;
+    if (after != ranges.end() && next->first + next->second == after->first) {
+        next->second += after->second;
+        ranges.erase(after);
+    }
+    if (next != ranges.begin()) {
+        auto before = next - 1;
+        if (before->first + before->second == next->first) {
+            before->second += next->second;
+            ranges.erase(next);
+        }
+    }
+}
+
+void StaticCityMesh::FreeList::grow(uint32_t newCapacity) {
+    release(capacity, newCapacity - capacity);
+    capacity = newCapacity;
+}
+
+uint32_t StaticCityMesh::FreeList::usedEnd() const {
+    if (!ranges.empty() && ranges.back().first + ranges.back().second == capacity) return ranges.back().first;
+    return capacity;
+}
+
+StaticCityMesh::StaticCityMesh() {}
+
+StaticCityMesh::~StaticCityMesh() {
+    for (auto& batch : batches) {
+        if (batch.VAO) glDeleteVertexArrays(1, &batch.VAO);
+        if (batch.VBO) glDeleteBuffers(1, &batch.VBO);
+        if (batch.EBO) glDeleteBuffers(1, &batch.EBO);
+    }
+}
+
+void StaticCityMesh::init(int materialCount) {
+    batches.resize(materialCount);
+    for (auto& batch : batches) {
+        glGenVertexArrays(1, &batch.VAO);
+        glGenBuffers(1, &batch.VBO);
+        glGenBuffers(1, &batch.EBO);
+        
+        // Mesh::setup layout, then the building box at the instanced locations
+        glBindVertexArray(batch.VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, batch.VBO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, batch.EBO);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, FLOATS_PER_VERTEX * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, FLOATS_PER_VERTEX * sizeof(float), (void*)(3 * sizeof(float)));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, FLOATS_PER_VERTEX * sizeof(float), (void*)(6 * sizeof(float)));
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, FLOATS_PER_VERTEX * sizeof(float), (void*)(8 * sizeof(float)));
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(4, 1, GL_FLOAT, GL_FALSE, FLOATS_PER_VERTEX * sizeof(float), (void*)(12 * sizeof(float)));
+        glEnableVertexAttribArray(4);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        
+        batch.vertexSpace.grow(INITIAL_VERTICES);
+        batch.indexSpace.grow(INITIAL_INDICES);
+        batch.vertices.resize(INITIAL_VERTICES * FLOATS_PER_VERTEX);
+        batch.indices.resize(INITIAL_INDICES);
+        batch.reupload = true;
+    }
+}
+
+void StaticCityMesh::setObject(uint64_t key, int material, const std::vector<float>& vertices,
+                               const std::vector<unsigned int>& indices, const glm::mat4& model,
+                               const glm::vec4& footprint, float height) {
+    if (material < 0 || material >= static_cast<int>(batches.size())) return;
+    Batch& batch = batches[material];
+    uint32_t vertexCount = static_cast<uint32_t>(vertices.size() / MESH_FLOATS);
+    uint32_t indexCount = static_cast<uint32_t>(indices.size());
+    
+    // Reuse the object's ranges when it keeps its size and material
+    ObjectRange range;
+    auto existing = objects.find(key);
+    if (existing != objects.end() && existing->second.material == material &&
+        existing->second.vertexCount == vertexCount && existing->second.indexCount == indexCount) {
+        range = existing->second;
+    } else {
+        if (existing != objects.end()) removeObject(key);
+        allocate(batch, vertexCount, indexCount, range);
+        range.material = material;
+        objects[key] = range;
+    }
+    
+    // Bake into world space
+    glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(model)));
+    for (uint32_t v = 0; v < vertexCount; ++v) {
+        const float* in = &vertices[v * MESH_FLOATS];
+        float* out = &batch.vertices[(range.firstVertex + v) * FLOATS_PER_VERTEX];
+        glm::vec3 position = glm::vec3(model * glm::vec4(in[0], in[1], in[2], 1.0f));
+        glm::vec3 normal = normalMatrix * glm::vec3(in[3], in[4], in[5]);
+        float length = glm::length(normal);
+        if (length > 0.0f) normal /= length;
+        out[0] = position.x; out[1] = position.y; out[2] = position.z;
+        out[3] = normal.x; out[4] = normal.y; out[5] = normal.z;
+        out[6] = in[6]; out[7] = in[7];
+        out[8] = footprint.x; out[9] = footprint.y; out[10] = footprint.z; out[11] = footprint.w;
+        out[12] = height;
+    }
+    for (uint32_t i = 0; i < indexCount; ++i) {
+        batch.indices[range.firstIndex + i] = range.firstVertex + indices[i];
+    }
+    upload(batch, range);
+}
+
+void StaticCityMesh::removeObject(uint64_t key) {
+    auto existing = objects.find(key);
+    if (existing == objects.end()) return;
+    
+    Batch& batch = batches[existing->second.material];
+    release(batch, existing->second);
+    objects.erase(existing);
+}
+
+void StaticCityMesh::draw(int material) {
+    if (material < 0 || material >= static_cast<int>(batches.size())) return;
+    Batch& batch = batches[material];
+    
+    uint32_t indexCount = batch.indexSpace.usedEnd();
+    if (indexCount == 0) return;
+    
+    bindForDraw(batch);
+    glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(indexCount), GL_UNSIGNED_INT, 0);
+    glBindVertexArray(0);
+}
+
+void StaticCityMesh::drawObjects(int material, const std::vector<uint64_t>& keys) {
+    if (material < 0 || material >= static_cast<int>(batches.size())) return;
+    Batch& batch = batches[material];
+    
+    drawRuns.clear();
+    for (uint64_t key : keys) {
+        auto object = objects.find(key);
+        if (object == objects.end() || object->second.material != material) continue;
+        drawRuns.emplace_back(object->second.firstIndex, object->second.indexCount);
+    }
+    if (drawRuns.empty()) return;
+    
+    // Objects placed one after another in the buffer become a single run
+    std::sort(drawRuns.begin(), drawRuns.end());
+    drawCounts.clear();
+    drawOffsets.clear();
+    uint32_t runStart = drawRuns[0].first, runEnd = runStart;
+    for (const auto& run : drawRuns) {
+        if (run.first != runEnd) {
+            drawCounts.push_back(static_cast<int>(runEnd - runStart));
+            drawOffsets.push_back(reinterpret_cast<const void*>(static_cast<size_t>(runStart) * sizeof(unsigned int)));
+            runStart = run.first;
+        }
+        runEnd = run.first + run.second;
+    }
+    drawCounts.push_back(static_cast<int>(runEnd - runStart));
+    drawOffsets.push_back(reinterpret_cast<const void*>(static_cast<size_t>(runStart) * sizeof(unsigned int)));
+    
+    bindForDraw(batch);
+    glMultiDrawElements(GL_TRIANGLES, drawCounts.data(), GL_UNSIGNED_INT, drawOffsets.data(),
+                        static_cast<GLsizei>(drawCounts.size()));
+    glBindVertexArray(0);
+}
+
+// Binds the batch, first uploading it whole if its storage grew
+void StaticCityMesh::bindForDraw(Batch& batch) {
+    glBindVertexArray(batch.VAO);
+    if (batch.reupload) {
+        glBindBuffer(GL_ARRAY_BUFFER, batch.VBO);
+        glBufferData(GL_ARRAY_BUFFER, batch.vertices.size() * sizeof(float), batch.vertices.data(), GL_DYNAMIC_DRAW);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, batch.indices.size() * sizeof(unsigned int), batch.indices.data(), GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        batch.reupload = false;
+    }
+}
+
+// Doubles the batch's storage until both ranges fit; the whole batch is
+// then uploaded again at its next draw
+void StaticCityMesh::allocate(Batch& batch, uint32_t vertexCount, uint32_t indexCount, ObjectRange& range) {
+    while (!batch.vertexSpace.allocate(vertexCount, range.firstVertex)) {
+        batch.vertexSpace.grow(batch.vertexSpace.capacity * 2);
+        batch.vertices.resize(static_cast<size_t>(batch.vertexSpace.capacity) * FLOATS_PER_VERTEX);
+        batch.reupload = true;
+    }
+    while (!batch.indexSpace.allocate(indexCount, range.firstIndex)) {
+        batch.indexSpace.grow(batch.indexSpace.capacity * 2);
+        batch.indices.resize(batch.indexSpace.capacity, 0);
+        batch.reupload = true;
+    }
+    range.vertexCount = vertexCount;
+    range.indexCount = indexCount;
+}
+
+void StaticCityMesh::release(Batch& batch, const ObjectRange& range) {
+    // Degenerate triangles until the range is handed out again
+    std::fill(batch.indices.begin() + range.firstIndex, batch.indices.begin() + range.firstIndex + range.indexCount, 0u);
+    upload(batch, ObjectRange{range.material, range.firstVertex, 0, range.firstIndex, range.indexCount});
+    
+    batch.vertexSpace.release(range.firstVertex, range.vertexCount);
+    batch.indexSpace.release(range.firstIndex, range.indexCount);
+}
+
+// Sub-range upload; skipped while a full upload is pending anyway
+void StaticCityMesh::upload(Batch& batch, const ObjectRange& range) {
+    if (batch.reupload) return;
+    
+    glBindVertexArray(batch.VAO);
+    if (range.vertexCount > 0) {
+        glBindBuffer(GL_ARRAY_BUFFER, batch.VBO);
+        glBufferSubData(GL_ARRAY_BUFFER, static_cast<size_t>(range.firstVertex) * FLOATS_PER_VERTEX * sizeof(float),
+                        static_cast<size_t>(range.vertexCount) * FLOATS_PER_VERTEX * sizeof(float),
+                        &batch.vertices[static_cast<size_t>(range.firstVertex) * FLOATS_PER_VERTEX]);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+    if (range.indexCount > 0) {
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, range.firstIndex * sizeof(unsigned int),
+                        range.indexCount * sizeof(unsigned int), &batch.indices[range.firstIndex]);
+    }
+    glBindVertexArray(0);
+}
@@ -0,0 +1,84 @@
+#ifndef STATICCITYMESH_H
+#define STATICCITYMESH_H
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Merged vertex and index buffers for the static city, one batch per
+// material, so everything that shares a texture is a single draw. Objects
+// are baked into world space and live in sub-ranges of their batch found
+// through an offset table; a first-fit free list hands out and reclaims
+// those ranges, so an edit rewrites only the object's own bytes. Freed
+// index ranges are zeroed into degenerate triangles until reused.
+class StaticCityMesh {
+public:
+    static const int MESH_FLOATS = 8;        // Input: position, normal, texcoord (as Mesh)
+    static const int FLOATS_PER_VERTEX = 13; // Baked: plus building footprint and height
+    
+    StaticCityMesh();
+    ~StaticCityMesh();
+    StaticCityMesh(const StaticCityMesh&) = delete;
+    StaticCityMesh& operator=(const StaticCityMesh&) = delete;
+    
+    void init(int materialCount); // Needs a current context
+    
+    // Bakes the shape transformed by model under key (chosen by the caller
+    // and stable across edits). An existing object of the same size and
+    // material is overwritten in place. Footprint (x, z, width, depth) and
+    // height are copied to every vertex for the facade shader.
+    void setObject(uint64_t key, int material, const std::vector<float>& vertices,
+                   const std::vector<unsigned int>& indices, const glm::mat4& model,
+                   const glm::vec4& footprint = glm::vec4(0.0f), float height = 0.0f);
+    void removeObject(uint64_t key);
+    bool hasObject(uint64_t key) const { return objects.count(key) != 0; }
+    
+    void draw(int material);
+    // Only the listed objects of the material (others are skipped), as one
+    // multi-draw over their index ranges with neighbouring ranges joined
+    void drawObjects(int material, const std::vector<uint64_t>& keys);
+    
+    size_t getObjectCount() const { return objects.size(); }
+    
+private:
+    // Free ranges of a buffer as sorted, coalesced (offset, size) pairs
+    struct FreeList {
+        uint32_t capacity;
+        std::vector<std::pair<uint32_t, uint32_t>> ranges;
+        
+        FreeList() : capacity(0) {}
+        bool allocate(uint32_t size, uint32_t& offset);
+        void release(uint32_t offset, uint32_t size);
+        void grow(uint32_t newCapacity);
+        uint32_t usedEnd() const; // One past the last allocated element
+    };
+    
+    struct Batch {
+        unsigned int VAO, VBO, EBO;
+        std::vector<float> vertices;        // CPU mirror of the buffers
+        std::vector<unsigned int> indices;
+        FreeList vertexSpace, indexSpace;
+        bool reupload;                      // Storage grew; upload it all before drawing
+    };
+    
+    struct ObjectRange {
+        int material;
+        uint32_t firstVertex, vertexCount;
+        uint32_t firstIndex, indexCount;
+    };
+    
+    std::vector<Batch> batches;
+    std::unordered_map<uint64_t, ObjectRange> objects;
+    std::vector<std::pair<uint32_t, uint32_t>> drawRuns; // Scratch: (first index, count)
+    std::vector<int> drawCounts;
+    std::vector<const void*> drawOffsets;
+    
+    void allocate(Batch& batch, uint32_t vertexCount, uint32_t indexCount, ObjectRange& range);
+    void release(Batch& batch, const ObjectRange& range);
+    void upload(Batch& batch, const ObjectRange& range);
+    void bindForDraw(Batch& batch);
+};
+
+#endif
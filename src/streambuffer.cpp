@@ -0,0 +1,110 @@
+#include "streambuffer.h"
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+// A second is already a hung GPU; give up waiting rather than freeze
+const GLuint64 FENCE_TIMEOUT_NS = 1000000000ull;
+
+}
+
+StreamBuffer::StreamBuffer() : buffer(0), segmentSize(0), segment(0), head(0) {
+    for (auto& fence : fences) fence = nullptr;
+}
+
+StreamBuffer::~StreamBuffer() {
+    release();
+}
+
+void StreamBuffer::init(size_t bytesPerFrame) {
+    if (buffer) return;
+    
+    glGenBuffers(1, &buffer);
+    orphan(bytesPerFrame);
+}
+
+void StreamBuffer::release() {
+    if (!buffer) return;
+    
+    for (auto& fence : fences) {
+        if (fence) glDeleteSync(fence);
+        fence = nullptr;
+    }
+    glDeleteBuffers(1, &buffer);
+    buffer = 0;
+}
+
+size_t StreamBuffer::write(const void* data, size_t size, size_t alignment) {
+    if (!buffer) init();
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    
+    size_t segmentStart = segment * segmentSize;
+    size_t offset = (head + alignment - 1) / alignment * alignment;
+    if (offset + size > segmentStart + segmentSize) {
+        // Grow for next time; the orphaned storage lives on until the GPU
+        // is done with it, so this frame's earlier draws are unaffected
+        size_t needed = offset - segmentStart + size;
+        size_t grown = segmentSize;
+        while (grown < needed) grown *= 2;
+        orphan(grown);
+        std::cout << "[STREAM] Grew stream buffer to " << (grown * FRAMES_IN_FLIGHT) / 1024 << " KB" << std::endl;
+        segmentStart = segment * segmentSize;
+        offset = segmentStart;
+    }
+    
+    // The fence waited for at the start of the frame guarantees the GPU is
+    // done with this segment, so no implicit synchronisation is needed
+    void* target = glMapBufferRange(GL_ARRAY_BUFFER, offset, size,
+                                    GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+    if (!target) {
+        std::cerr << "ERROR::STREAMBUFFER::MAP_FAILED" << std::endl;
+        glBufferSubData(GL_ARRAY_BUFFER, offset, size, data);
+    } else {
+        std::memcpy(target, data, size);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+    }
+    head = offset + size;
+    return offset;
+}
+
+void StreamBuffer::endFrame() {
+    if (!buffer) return;
+    
+    if (fences[segment]) glDeleteSync(fences[segment]);
+    fences[segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    
+    segment = (segment + 1) % FRAMES_IN_FLIGHT;
+    head = segment * segmentSize;
+    waitForSegment(segment);
+}
+
+StreamBuffer& StreamBuffer::shared() {
+    static StreamBuffer stream;
+    return stream;
+}
+
+// Usually already signalled: the fence is FRAMES_IN_FLIGHT - 1 frames old
+void StreamBuffer::waitForSegment(int index) {
+    if (!fences[index]) return;
+    
+    GLenum result = glClientWaitSync(fences[index], GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT_NS);
+    if (result == GL_TIMEOUT_EXPIRED || result == GL_WAIT_FAILED) {
+        std::cerr << "WARNING::STREAMBUFFER::FENCE_WAIT_FAILED" << std::endl;
+    }
+    glDeleteSync(fences[index]);
+    fences[index] = nullptr;
+}
+
+// Fresh storage: fences on the old one no longer matter
+void StreamBuffer::orphan(size_t newSegmentSize) {
+    for (auto& fence : fences) {
+        if (fence) glDeleteSync(fence);
+        fence = nullptr;
+    }
+    segmentSize = newSegmentSize;
+    head = segment * segmentSize;
+    
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glBufferData(GL_ARRAY_BUFFER, segmentSize * FRAMES_IN_FLIGHT, nullptr, GL_STREAM_DRAW);
+}
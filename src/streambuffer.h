@@ -0,0 +1,45 @@
+#ifndef STREAMBUFFER_H
+#define STREAMBUFFER_H
+
+#include <glad/glad.h>
+#include <cstddef>
+
+// Shared ring of vertex memory for geometry rewritten every frame (2D
+// spans, HUD text). The ring is split into one segment per frame in
+// flight; each frame writes only its own segment through unsynchronised
+// mapped ranges, and a fence per segment keeps the CPU from overwriting
+// what the GPU is still reading. A frame that outgrows its segment orphans
+// the buffer for a larger one, so nothing ever stalls mid-frame.
+class StreamBuffer {
+public:
+    static const int FRAMES_IN_FLIGHT = 3;
+    
+    StreamBuffer();
+    ~StreamBuffer();
+    
+    // Needs a current context; write() calls it on first use
+    void init(size_t bytesPerFrame = 1 << 20);
+    void release(); // Before the context goes away
+    
+    // Copies data into this frame's segment and returns its byte offset in
+    // getBuffer(), which is left bound to GL_ARRAY_BUFFER
+    size_t write(const void* data, size_t size, size_t alignment = 16);
+    // Fences this frame's writes and moves on to the next segment
+    void endFrame();
+    
+    unsigned int getBuffer() const { return buffer; }
+    
+    static StreamBuffer& shared();
+    
+private:
+    unsigned int buffer;
+    size_t segmentSize;
+    int segment;            // Segment the current frame writes to
+    size_t head;            // Next free byte in it
+    GLsync fences[FRAMES_IN_FLIGHT];
+    
+    void waitForSegment(int index);
+    void orphan(size_t newSegmentSize);
+};
+
+#endif
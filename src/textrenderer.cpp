@@ -1,4 +1,5 @@
 #include "textrenderer.h"
+#include "streambuffer.h"
 #include <glm/gtc/matrix_transform.hpp>
 
 // Simple 5x7 bitmap font data for ASCII characters 32-126
@@ -100,11 +101,10 @@ static const unsigned char font_data[95][7] = {
     {0x00, 0x00, 0x08, 0x15, 0x02, 0x00, 0x00}, // ~
 };
 
-TextRenderer::TextRenderer() : width(800), height(600), VAO(0), VBO(0) {}
+TextRenderer::TextRenderer() : width(800), height(600), VAO(0) {}
 
 TextRenderer::~TextRenderer() {
     if (VAO) glDeleteVertexArrays(1, &VAO);
-    if (VBO) glDeleteBuffers(1, &VBO);
 }
 
 void TextRenderer::init(int screenWidth, int screenHeight) {
@@ -149,18 +149,10 @@ void TextRenderer::init(int screenWidth, int screenHeight) {
     
     shader.ID = shaderProgram;
     
-    // Setup VAO/VBO
+    // Setup VAO; vertices live in the shared stream buffer
     glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    
     glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * 12, NULL, GL_DYNAMIC_DRAW);
-    
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), 0);
     glEnableVertexAttribArray(0);
-    
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindVertexArray(0);
     
     setProjection(width, height);
@@ -177,12 +169,10 @@ void TextRenderer::setProjection(int w, int h) {
     shader.setMat4("projection", projection);
 }
 
+// Every lit font pixel of the string becomes two triangles in one vertex
+// array, uploaded once and drawn with a single call
 void TextRenderer::renderText(const std::string& text, float x, float y, float scale, const glm::vec3& color) {
-    shader.use();
-    shader.setVec3("textColor", color);
-    
-    glBindVertexArray(VAO);
-    
+    vertices.clear();
     float startX = x;
     for (char c : text) {
         if (c == '\n') {
@@ -192,7 +182,15 @@ void TextRenderer::renderText(const std::string& text, float x, float y, float s
         }
         renderChar(c, x, y, scale, color);
     }
+    if (vertices.empty()) return;
     
+    shader.use();
+    shader.setVec3("textColor", color);
+    glBindVertexArray(VAO);
+    size_t offset = StreamBuffer::shared().write(vertices.data(), vertices.size() * sizeof(float));
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)offset);
+    glDrawArrays(GL_TRIANGLES, 0, static_cast<GLsizei>(vertices.size() / 2));
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindVertexArray(0);
 }
 
@@ -210,7 +208,7 @@ void TextRenderer::renderChar(char c, float& x, float y, float scale, const glm:
                 float px = x + col * scale;
                 float py = y + row * scale;
                 
-                float vertices[] = {
+                float quad[] = {
                     px, py,
                     px + scale, py,
                     px, py + scale,
@@ -219,12 +217,7 @@ void TextRenderer::renderChar(char c, float& x, float y, float scale, const glm:
                     px + scale, py + scale,
                     px, py + scale
                 };
-                
-                glBindBuffer(GL_ARRAY_BUFFER, VBO);
-                glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
-                glBindBuffer(GL_ARRAY_BUFFER, 0);
-                
-                glDrawArrays(GL_TRIANGLES, 0, 6);
+                vertices.insert(vertices.end(), quad, quad + 12);
             }
         }
     }
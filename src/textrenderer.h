@@ -4,6 +4,7 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <string>
+#include <vector>
 #include "shader.h"
 
 class TextRenderer {
@@ -17,10 +18,11 @@ public:
     
 private:
     Shader shader;
-    unsigned int VAO, VBO;
+    unsigned int VAO;
     int width, height;
+    std::vector<float> vertices; // Current string, reused between calls
     
-    void renderChar(char c, float& x, float y, float scale, const glm::vec3& color);
+    void renderChar(char c, float& x, float y, float scale, const glm::vec3& color); // Appends to vertices
 };
 
 #endif
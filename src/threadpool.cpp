@@ -0,0 +1,96 @@
+#include "threadpool.h"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+ThreadPool::ThreadPool(unsigned int numThreads) : stopping(false) {
+    if (numThreads == 0) {
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    
+    for (unsigned int i = 0; i < numThreads; ++i) {
+        workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    jobAvailable.notify_all();
+    
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+ThreadPool& ThreadPool::shared() {
+    static ThreadPool pool;
+    return pool;
+}
+
+void ThreadPool::submit(std::function<void()> job) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push(std::move(job));
+    }
+    jobAvailable.notify_one();
+}
+
+void ThreadPool::workerLoop() {
+    while (true) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            jobAvailable.wait(lock, [this] { return stopping || !jobs.empty(); });
+            if (stopping && jobs.empty()) return;
+            job = std::move(jobs.front());
+            jobs.pop();
+        }
+        job();
+    }
+}
+
+void ThreadPool::parallelFor(int count, const std::function<void(int begin, int end)>& body) {
+    if (count <= 0) return;
+    
+    // A few chunks per thread evens out uneven work
+    int numChunks = std::min(count, static_cast<int>(size()) * 4);
+    if (numChunks <= 1) {
+        body(0, count);
+        return;
+    }
+    
+    struct Batch {
+        std::atomic<int> nextChunk{0};
+        std::atomic<int> finishedChunks{0};
+        std::mutex mutex;
+        std::condition_variable done;
+    };
+    auto batch = std::make_shared<Batch>();
+    
+    auto runChunks = [batch, numChunks, count, &body]() {
+        int chunk;
+        while ((chunk = batch->nextChunk.fetch_add(1)) < numChunks) {
+            int begin = static_cast<int>(static_cast<long long>(count) * chunk / numChunks);
+            int end = static_cast<int>(static_cast<long long>(count) * (chunk + 1) / numChunks);
+            body(begin, end);
+            
+            if (batch->finishedChunks.fetch_add(1) + 1 == numChunks) {
+                std::lock_guard<std::mutex> lock(batch->mutex);
+                batch->done.notify_all();
+            }
+        }
+    };
+    
+    int helpers = std::min(static_cast<int>(size()), numChunks - 1);
+    for (int i = 0; i < helpers; ++i) {
+        submit(runChunks);
+    }
+    runChunks();
+    
+    // Helpers that start after all chunks are taken exit without touching body
+    std::unique_lock<std::mutex> lock(batch->mutex);
+    batch->done.wait(lock, [&] { return batch->finishedChunks.load() == numChunks; });
+}
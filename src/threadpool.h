@@ -0,0 +1,38 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads shared by the CPU-heavy subsystems
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned int numThreads = 0); // 0 = one per hardware thread
+    ~ThreadPool();
+    
+    // Fire-and-forget job
+    void submit(std::function<void()> job);
+    
+    // Split [0, count) into chunks and run body(begin, end) on all cores.
+    // The calling thread helps, so this is safe to call from a worker.
+    void parallelFor(int count, const std::function<void(int begin, int end)>& body);
+    
+    unsigned int size() const { return static_cast<unsigned int>(workers.size()); }
+    
+    static ThreadPool& shared();
+    
+private:
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> jobs;
+    std::mutex mutex;
+    std::condition_variable jobAvailable;
+    bool stopping;
+    
+    void workerLoop();
+};
+
+#endif
@@ -0,0 +1,340 @@
+#include "tilepyramid.h"
+#include "threadpool.h"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+namespace {
+
+// World units per bin of the scene index. Roughly one level-0 tile, so a
+// tile query reads a handful of bins at any level.
+const float INDEX_CELL = 256.0f;
+
+// Renders queued at once; the rest wait for a later frame, so a fast pan
+// doesn't bury the pool in tiles that have already scrolled away
+const size_t MAX_IN_FLIGHT = 16;
+
+int floorDiv(int value, int divisor) {
+    int quotient = value / divisor;
+    return (value % divisor != 0 && (value < 0) != (divisor < 0)) ? quotient - 1 : quotient;
+}
+
+// World rectangle whose primitives can reach the tile: the 2x2 point
+// footprint and rounding spill up to two tile pixels past its edge
+void tileWorldBounds(const TileKey& key, glm::vec2& minCorner, glm::vec2& maxCorner) {
+    float size = TilePyramid::tileWorldSize(key.level);
+    float margin = 2.0f / TilePyramid::levelScale(key.level);
+    minCorner = glm::vec2(key.x, key.y) * size - margin;
+    maxCorner = glm::vec2(key.x + 1, key.y + 1) * size + margin;
+}
+
+bool tileOverlaps(const TileKey& key, const glm::vec2& minCorner, const glm::vec2& maxCorner) {
+    glm::vec2 tileMin, tileMax;
+    tileWorldBounds(key, tileMin, tileMax);
+    return tileMin.x <= maxCorner.x && minCorner.x <= tileMax.x &&
+           tileMin.y <= maxCorner.y && minCorner.y <= tileMax.y;
+}
+
+}
+
+TilePyramid::TilePyramid(size_t tileCapacity) : capacity(tileCapacity), runningJobs(0) {
+    scene = buildScene(std::vector<Line2D>(), std::vector<Circle2D>(), std::vector<Polygon2D>());
+}
+
+TilePyramid::~TilePyramid() {
+    // Jobs write into this object, so let them finish
+    std::unique_lock<std::mutex> lock(finishedMutex);
+    jobsDone.wait(lock, [this]() { return runningJobs == 0; });
+}
+
+void TilePyramid::setScene(const std::vector<Line2D>& lines, const std::vector<Circle2D>& circles,
+                           const std::vector<Polygon2D>& polygons) {
+    // Jobs already running keep the snapshot they started with
+    scene = buildScene(lines, circles, polygons);
+}
+
+void TilePyramid::invalidateArea(const glm::vec2& minCorner, const glm::vec2& maxCorner) {
+    for (auto& entry : cache) {
+        if (tileOverlaps(entry.first, minCorner, maxCorner)) entry.second.tile.stale = true;
+    }
+    for (auto& request : inFlight) {
+        if (tileOverlaps(request.first, minCorner, maxCorner)) request.second = true;
+    }
+}
+
+void TilePyramid::invalidateAll() {
+    for (auto& entry : cache) entry.second.tile.stale = true;
+    for (auto& request : inFlight) request.second = true;
+}
+
+void TilePyramid::requestVisible(const Camera2D& camera, int screenWidth, int screenHeight,
+                                 std::vector<TileKey>& visible) {
+    visible.clear();
+    int level = levelForZoom(camera.zoom);
+    float size = tileWorldSize(level);
+    glm::vec2 worldMin = camera.screenToWorld(glm::vec2(0.0f)) / size;
+    glm::vec2 worldMax = camera.screenToWorld(glm::vec2(screenWidth, screenHeight)) / size;
+    
+    int x0 = static_cast<int>(std::floor(worldMin.x));
+    int y0 = static_cast<int>(std::floor(worldMin.y));
+    int x1 = static_cast<int>(std::ceil(worldMax.x));
+    int y1 = static_cast<int>(std::ceil(worldMax.y));
+    for (int y = y0; y < y1; ++y) {
+        for (int x = x0; x < x1; ++x) {
+            TileKey key(level, x, y);
+            visible.push_back(key);
+            
+            Tile* tile = find(key);
+            if (tile && !tile->stale) continue;
+            if (inFlight.size() < MAX_IN_FLIGHT && inFlight.find(key) == inFlight.end()) submit(key);
+        }
+    }
+}
+
+void TilePyramid::collectFinished(std::vector<TileKey>& arrived) {
+    arrived.clear();
+    std::vector<FinishedTile> done;
+    {
+        std::lock_guard<std::mutex> lock(finishedMutex);
+        done.swap(finished);
+    }
+    
+    for (auto& result : done) {
+        // An edit during the render means the result is already stale
+        bool outdated = false;
+        auto request = inFlight.find(result.key);
+        if (request != inFlight.end()) {
+            outdated = request->second;
+            inFlight.erase(request);
+        }
+        
+        auto entry = cache.find(result.key);
+        if (entry == cache.end()) {
+            lru.push_front(result.key);
+            CacheEntry created;
+            created.lruPosition = lru.begin();
+            entry = cache.emplace(result.key, std::move(created)).first;
+        } else {
+            lru.splice(lru.begin(), lru, entry->second.lruPosition);
+        }
+        entry->second.tile.pixels = std::move(result.pixels);
+        entry->second.tile.stale = outdated;
+        arrived.push_back(result.key);
+    }
+    evictOverflow();
+}
+
+Tile* TilePyramid::find(const TileKey& key) {
+    auto entry = cache.find(key);
+    if (entry == cache.end()) return nullptr;
+    lru.splice(lru.begin(), lru, entry->second.lruPosition);
+    return &entry->second.tile;
+}
+
+Tile* TilePyramid::findOrAncestor(const TileKey& key, glm::vec2& uvMin, glm::vec2& uvMax) {
+    // Each level up halves the resolution; the tile is one quadrant of its
+    // parent, one sixteenth of its grandparent, and so on
+    for (int up = 0; key.level - up >= MIN_LEVEL; ++up) {
+        int span = 1 << up;
+        TileKey ancestor(key.level - up, floorDiv(key.x, span), floorDiv(key.y, span));
+        Tile* tile = find(ancestor);
+        if (!tile) continue;
+        
+        uvMin = glm::vec2(key.x - ancestor.x * span, key.y - ancestor.y * span) / static_cast<float>(span);
+        uvMax = uvMin + glm::vec2(1.0f / span);
+        return tile;
+    }
+    return nullptr;
+}
+
+void TilePyramid::takeEvictedTextures(std::vector<unsigned int>& textures) {
+    textures.swap(evictedTextures);
+    evictedTextures.clear();
+}
+
+void TilePyramid::takeAllTextures(std::vector<unsigned int>& textures) {
+    takeEvictedTextures(textures);
+    for (auto& entry : cache) {
+        if (entry.second.tile.texture) textures.push_back(entry.second.tile.texture);
+        entry.second.tile.texture = 0;
+    }
+}
+
+// Never magnify: the level is the first at or above the zoom, so tiles are
+// shown at 0.5-1x and a 2-pixel line always keeps at least one texel
+int TilePyramid::levelForZoom(float zoom) {
+    int level = static_cast<int>(std::ceil(std::log2(zoom) - 1e-4f));
+    if (level < MIN_LEVEL) return MIN_LEVEL;
+    if (level > MAX_LEVEL) return MAX_LEVEL;
+    return level;
+}
+
+float TilePyramid::levelScale(int level) {
+    return std::ldexp(1.0f, level);
+}
+
+float TilePyramid::tileWorldSize(int level) {
+    return TILE_SIZE / levelScale(level);
+}
+
+RasterRect TilePyramid::screenRect(const TileKey& key, const Camera2D& camera) {
+    float size = tileWorldSize(key.level);
+    Point2D topLeft = SoftwareRasterizer::snapToPixel(camera.worldToScreen(glm::vec2(key.x, key.y) * size));
+    Point2D bottomRight = SoftwareRasterizer::snapToPixel(camera.worldToScreen(glm::vec2(key.x + 1, key.y + 1) * size));
+    return RasterRect(topLeft.x, topLeft.y, bottomRight.x, bottomRight.y);
+}
+
+void TilePyramid::submit(const TileKey& key) {
+    inFlight[key] = false;
+    {
+        std::lock_guard<std::mutex> lock(finishedMutex);
+        runningJobs++;
+    }
+    
+    std::shared_ptr<const Scene> snapshot = scene;
+    ThreadPool::shared().submit([this, snapshot, key]() {
+        FinishedTile result;
+        result.key = key;
+        renderTile(*snapshot, key, result.pixels);
+        
+        // Notify under the lock so the destructor can't run in between
+        std::lock_guard<std::mutex> lock(finishedMutex);
+        finished.push_back(std::move(result));
+        runningJobs--;
+        jobsDone.notify_all();
+    });
+}
+
+// Same rasteriser as the screen layer, with the camera on the tile's corner.
+// Tile pixels are level pixels shifted by whole tiles, so neighbouring
+// tiles round every vertex identically and meet without seams.
+void TilePyramid::renderTile(const Scene& scene, const TileKey& key, std::vector<uint32_t>& pixels) {
+    glm::vec2 queryMin, queryMax;
+    tileWorldBounds(key, queryMin, queryMax);
+    
+    std::vector<int> candidates;
+    if (scene.cellCount.x > 0 && scene.cellCount.y > 0) {
+        glm::ivec2 cellMin = glm::max(glm::ivec2(glm::floor(queryMin / scene.cellSize)) - scene.minCell, glm::ivec2(0));
+        glm::ivec2 cellMax = glm::min(glm::ivec2(glm::floor(queryMax / scene.cellSize)) - scene.minCell,
+                                      scene.cellCount - 1);
+        for (int cy = cellMin.y; cy <= cellMax.y; ++cy) {
+            for (int cx = cellMin.x; cx <= cellMax.x; ++cx) {
+                int cell = cy * scene.cellCount.x + cx;
+                candidates.insert(candidates.end(), scene.cellEntries.begin() + scene.cellStart[cell],
+                                  scene.cellEntries.begin() + scene.cellStart[cell + 1]);
+            }
+        }
+        // Back to list order, once each (long roads sit in many cells)
+        std::sort(candidates.begin(), candidates.end());
+        candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+    }
+    
+    std::vector<Line2D> lines;
+    std::vector<Circle2D> circles;
+    std::vector<Polygon2D> polygons;
+    int lineCount = static_cast<int>(scene.lines.size());
+    int circleEnd = lineCount + static_cast<int>(scene.circles.size());
+    for (int index : candidates) {
+        if (index < lineCount) {
+            lines.push_back(scene.lines[index]);
+        } else if (index < circleEnd) {
+            circles.push_back(scene.circles[index - lineCount]);
+        } else {
+            polygons.push_back(scene.polygons[index - circleEnd]);
+        }
+    }
+    
+    Camera2D camera;
+    camera.zoom = levelScale(key.level);
+    camera.offset = glm::vec2(key.x, key.y) * tileWorldSize(key.level);
+    
+    SoftwareRasterizer raster;
+    raster.resize(TILE_SIZE, TILE_SIZE);
+    raster.setCamera(camera);
+    raster.renderRect(raster.bounds(), lines, circles, polygons);
+    pixels = raster.getPixels();
+}
+
+// Uniform grid over the scene's bounds, filled with a counting sort like
+// SoftwareRasterizer's tile binning
+std::shared_ptr<const TilePyramid::Scene> TilePyramid::buildScene(const std::vector<Line2D>& lines,
+                                                                  const std::vector<Circle2D>& circles,
+                                                                  const std::vector<Polygon2D>& polygons) {
+    std::shared_ptr<Scene> built = std::make_shared<Scene>();
+    built->lines = lines;
+    built->circles = circles;
+    built->polygons = polygons;
+    built->cellSize = INDEX_CELL;
+    built->minCell = glm::ivec2(0);
+    built->cellCount = glm::ivec2(0);
+    
+    size_t circleEnd = lines.size() + circles.size();
+    size_t count = circleEnd + polygons.size();
+    if (count == 0) return built;
+    
+    std::vector<glm::ivec2> cellMin(count), cellMax(count);
+    for (size_t i = 0; i < count; ++i) {
+        glm::vec2 lo, hi;
+        if (i < lines.size()) {
+            const Line2D& line = lines[i];
+            lo = glm::min(glm::vec2(line.start.x, line.start.y), glm::vec2(line.end.x, line.end.y));
+            hi = glm::max(glm::vec2(line.start.x, line.start.y), glm::vec2(line.end.x, line.end.y));
+        } else if (i < circleEnd) {
+            const Circle2D& circle = circles[i - lines.size()];
+            lo = glm::vec2(circle.center.x - circle.radius, circle.center.y - circle.radius);
+            hi = glm::vec2(circle.center.x + circle.radius, circle.center.y + circle.radius);
+        } else {
+            const Polygon2D& polygon = polygons[i - circleEnd];
+            lo = glm::vec2(INT_MAX);
+            hi = glm::vec2(INT_MIN);
+            for (const auto& point : polygon.points) {
+                lo = glm::min(lo, glm::vec2(point.x, point.y));
+                hi = glm::max(hi, glm::vec2(point.x, point.y));
+            }
+            if (polygon.points.empty()) lo = hi = glm::vec2(0.0f);
+        }
+        cellMin[i] = glm::ivec2(glm::floor(lo / INDEX_CELL));
+        cellMax[i] = glm::ivec2(glm::floor(hi / INDEX_CELL));
+    }
+    
+    glm::ivec2 gridMin = cellMin[0];
+    glm::ivec2 gridMax = cellMax[0];
+    for (size_t i = 1; i < count; ++i) {
+        gridMin = glm::min(gridMin, cellMin[i]);
+        gridMax = glm::max(gridMax, cellMax[i]);
+    }
+    built->minCell = gridMin;
+    built->cellCount = gridMax - gridMin + 1;
+    
+    int cells = built->cellCount.x * built->cellCount.y;
+    built->cellStart.assign(cells + 1, 0);
+    for (size_t i = 0; i < count; ++i) {
+        for (int cy = cellMin[i].y; cy <= cellMax[i].y; ++cy) {
+            for (int cx = cellMin[i].x; cx <= cellMax[i].x; ++cx) {
+                built->cellStart[(cy - gridMin.y) * built->cellCount.x + (cx - gridMin.x) + 1]++;
+            }
+        }
+    }
+    for (int c = 0; c < cells; ++c) built->cellStart[c + 1] += built->cellStart[c];
+    
+    built->cellEntries.resize(built->cellStart[cells]);
+    std::vector<uint32_t> cursor(built->cellStart.begin(), built->cellStart.end() - 1);
+    for (size_t i = 0; i < count; ++i) {
+        for (int cy = cellMin[i].y; cy <= cellMax[i].y; ++cy) {
+            for (int cx = cellMin[i].x; cx <= cellMax[i].x; ++cx) {
+                int cell = (cy - gridMin.y) * built->cellCount.x + (cx - gridMin.x);
+                built->cellEntries[cursor[cell]++] = static_cast<int>(i);
+            }
+        }
+    }
+    return built;
+}
+
+void TilePyramid::evictOverflow() {
+    while (cache.size() > capacity) {
+        auto entry = cache.find(lru.back());
+        if (entry->second.tile.texture) evictedTextures.push_back(entry->second.tile.texture);
+        cache.erase(entry);
+        lru.pop_back();
+    }
+}
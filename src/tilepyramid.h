@@ -0,0 +1,123 @@
+#ifndef TILEPYRAMID_H
+#define TILEPYRAMID_H
+
+#include <glm/glm.hpp>
+#include <condition_variable>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "softrasterizer.h"
+
+// One tile of the pyramid. Level L is rasterised at 2^L pixels per world
+// unit, so tile (L, x, y) covers world [x, x + 1) * tileWorldSize(L) and
+// likewise in y. Levels below zero are the zoomed-out ones.
+struct TileKey {
+    int level, x, y;
+    TileKey(int level = 0, int x = 0, int y = 0) : level(level), x(x), y(y) {}
+    bool operator==(const TileKey& other) const { return level == other.level && x == other.x && y == other.y; }
+};
+
+struct TileKeyHash {
+    size_t operator()(const TileKey& key) const {
+        return (static_cast<size_t>(key.level + 16) * 73856093u) ^
+               (static_cast<size_t>(key.x) * 19349663u) ^ (static_cast<size_t>(key.y) * 83492791u);
+    }
+};
+
+struct Tile {
+    std::vector<uint32_t> pixels;   // TILE_SIZE x TILE_SIZE RGBA8, row 0 at the top
+    unsigned int texture;           // GPU copy owned by the caller (0 = none)
+    bool stale;                     // Covers an edit; still shown until its replacement arrives
+    Tile() : texture(0), stale(false) {}
+};
+
+// Slippy-map style quadtree of pre-rasterised tiles for 2D views of huge
+// cities. Tiles are rendered lazily on the shared thread pool from an
+// immutable snapshot of the scene, kept in an LRU cache and invalidated
+// per tile, so panning and zooming only touch what is on screen.
+class TilePyramid {
+public:
+    static const int TILE_SIZE = 256;
+    static const int MIN_LEVEL = -2;
+    static const int MAX_LEVEL = 3;
+    
+    explicit TilePyramid(size_t tileCapacity = 128);
+    ~TilePyramid(); // Waits for tiles still being rendered
+    
+    // Snapshot and index the elements; call invalidate* for what changed
+    void setScene(const std::vector<Line2D>& lines, const std::vector<Circle2D>& circles,
+                  const std::vector<Polygon2D>& polygons);
+    void invalidateArea(const glm::vec2& minCorner, const glm::vec2& maxCorner);
+    void invalidateAll();
+    
+    // Tiles covering the screen at the level for camera.zoom. Missing and
+    // stale ones are queued for rendering.
+    void requestVisible(const Camera2D& camera, int screenWidth, int screenHeight, std::vector<TileKey>& visible);
+    // Moves rendered tiles into the cache (call once per frame)
+    void collectFinished(std::vector<TileKey>& arrived);
+    // Cached tile or nullptr; counts as a use for the LRU
+    Tile* find(const TileKey& key);
+    // The tile, or else the nearest cached ancestor with the part of it
+    // the tile covers as [uvMin, uvMax] (stand-in while the tile renders)
+    Tile* findOrAncestor(const TileKey& key, glm::vec2& uvMin, glm::vec2& uvMax);
+    // Textures of tiles dropped from the cache, for the caller to free
+    void takeEvictedTextures(std::vector<unsigned int>& textures);
+    // Every texture still referenced, cached tiles' included (for shutdown)
+    void takeAllTextures(std::vector<unsigned int>& textures);
+    
+    static int levelForZoom(float zoom);
+    static float levelScale(int level);
+    static float tileWorldSize(int level);
+    // Screen pixels a tile covers; neighbours share edges exactly
+    static RasterRect screenRect(const TileKey& key, const Camera2D& camera);
+    
+    size_t getCachedCount() const { return cache.size(); }
+    
+private:
+    // Immutable once built; render jobs hold a reference while they run
+    struct Scene {
+        std::vector<Line2D> lines;
+        std::vector<Circle2D> circles;
+        std::vector<Polygon2D> polygons;
+        float cellSize;
+        glm::ivec2 minCell, cellCount;
+        std::vector<uint32_t> cellStart;    // Cell c owns cellEntries[cellStart[c], cellStart[c + 1])
+        std::vector<int> cellEntries;       // Indices into lines, then circles, then polygons
+    };
+    
+    struct CacheEntry {
+        Tile tile;
+        std::list<TileKey>::iterator lruPosition;
+    };
+    
+    struct FinishedTile {
+        TileKey key;
+        std::vector<uint32_t> pixels;
+    };
+    
+    size_t capacity;
+    std::shared_ptr<const Scene> scene;
+    
+    std::unordered_map<TileKey, CacheEntry, TileKeyHash> cache;
+    std::list<TileKey> lru;                 // Most recently used first
+    std::vector<unsigned int> evictedTextures;
+    
+    // Requested tiles; true once an edit has made the pending render outdated
+    std::unordered_map<TileKey, bool, TileKeyHash> inFlight;
+    
+    std::mutex finishedMutex;
+    std::condition_variable jobsDone;
+    std::vector<FinishedTile> finished;
+    int runningJobs;
+    
+    void submit(const TileKey& key);
+    static void renderTile(const Scene& scene, const TileKey& key, std::vector<uint32_t>& pixels);
+    static std::shared_ptr<const Scene> buildScene(const std::vector<Line2D>& lines, const std::vector<Circle2D>& circles,
+                                                   const std::vector<Polygon2D>& polygons);
+    void evictOverflow();
+};
+
+#endif
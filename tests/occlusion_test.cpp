@@ -0,0 +1,76 @@
+// Checks that the occlusion culler stays conservative: nothing is reported
+// hidden unless the occluders cover it entirely. Needs no GL context.
+//
+//   occlusion_test
+//
+// Prints each failed case to stderr and exits non-zero if any failed.
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <cstdio>
+#include "occlusionculler.h"
+
+namespace {
+
+int failures = 0;
+
+void expect(bool condition, const char* name) {
+    if (!condition) {
+        std::fprintf(stderr, "FAIL: %s\n", name);
+        ++failures;
+    }
+}
+
+// View-space x at depth distance that projects to pixel column x
+float viewX(const glm::mat4& projection, float pixel, float distance) {
+    float ndc = pixel / OcclusionCuller::WIDTH * 2.0f - 1.0f;
+    return ndc * distance / projection[0][0];
+}
+
+}
+
+int main() {
+    // Looking down -z from the origin, so view and world space coincide
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f),
+                                            static_cast<float>(OcclusionCuller::WIDTH) / OcclusionCuller::HEIGHT,
+                                            0.1f, 1000.0f);
+    glm::vec3 eye(0.0f);
+    
+    // A wall at z = -20 whose right silhouette edge crosses pixel column 160
+    // at x = 160.7, so that column is only partly covered
+    const int column = 160;
+    float edge = viewX(projection, column + 0.7f, 20.0f);
+    
+    OcclusionCuller culler;
+    culler.begin(projection, eye);
+    culler.addOccluder(BVHBox(glm::vec3(-100.0f, -50.0f, -21.0f), glm::vec3(edge, 50.0f, -20.0f)));
+    culler.rasterize();
+    expect(culler.getOccluderCount() == 1, "wall is queued as an occluder");
+    
+    // Behind the wall and inside column 160, but past the edge at x = 160.7
+    BVHBox pastEdge(glm::vec3(viewX(projection, column + 0.76f, 40.01f), -1.0f, -40.01f),
+                    glm::vec3(viewX(projection, column + 0.88f, 40.0f), 1.0f, -40.0f));
+    expect(!culler.isOccluded(pastEdge), "box just past the silhouette is visible");
+    
+    // Same column, but left of the edge: not decidable at this resolution
+    // either, and must not be hidden on a partly covered pixel
+    BVHBox straddling(glm::vec3(viewX(projection, column + 0.5f, 40.01f), -1.0f, -40.01f),
+                      glm::vec3(viewX(projection, column + 0.9f, 40.0f), 1.0f, -40.0f));
+    expect(!culler.isOccluded(straddling), "box straddling the silhouette is visible");
+    
+    BVHBox behind(glm::vec3(-5.0f, -2.0f, -60.0f), glm::vec3(5.0f, 2.0f, -50.0f));
+    expect(culler.isOccluded(behind), "box wholly behind the wall is hidden");
+    
+    BVHBox inFront(glm::vec3(-5.0f, -2.0f, -15.0f), glm::vec3(5.0f, 2.0f, -10.0f));
+    expect(!culler.isOccluded(inFront), "box in front of the wall is visible");
+    
+    BVHBox beside(glm::vec3(edge + 10.0f, -2.0f, -60.0f), glm::vec3(edge + 15.0f, 2.0f, -50.0f));
+    expect(!culler.isOccluded(beside), "box beside the wall is visible");
+    
+    // Reaching into the wall's depth range: partly in front, so visible
+    BVHBox through(glm::vec3(-5.0f, -2.0f, -30.0f), glm::vec3(5.0f, 2.0f, -19.0f));
+    expect(!culler.isOccluded(through), "box crossing the wall is visible");
+    
+    if (failures == 0) std::fprintf(stderr, "occlusion_test: all cases passed\n");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,168 @@
+// Checks contraction hierarchy distances against plain Dijkstra on the same
+// road graph, for single queries and the batched OD matrix, including pairs
+// with no connection. Needs no GL context.
+//
+//   roadgraph_test
+//
+// Prints each failed case to stderr and exits non-zero if any failed.
+
+#include <glm/glm.hpp>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <string>
+#include <vector>
+#include "citygenerator.h"
+#include "roadgraph.h"
+
+namespace {
+
+const float INF = std::numeric_limits<float>::infinity();
+
+int failures = 0;
+
+void expect(bool condition, const char* name) {
+    if (!condition) {
+        std::fprintf(stderr, "FAIL: %s\n", name);
+        ++failures;
+    }
+}
+
+bool sameDistance(float a, float b) {
+    if (std::isinf(a) || std::isinf(b)) return a == b;
+    return std::fabs(a - b) <= 1e-3f * std::max(1.0f, b);
+}
+
+// Reference distances from source over the graph's own nodes and segments
+std::vector<float> dijkstra(const RoadGraph& graph, int source) {
+    const auto& nodes = graph.getNodes();
+    std::vector<std::vector<std::pair<int, float>>> adjacent(nodes.size());
+    for (const auto& segment : graph.getSegments()) {
+        float weight = glm::length(nodes[segment.first] - nodes[segment.second]);
+        adjacent[segment.first].push_back({segment.second, weight});
+        adjacent[segment.second].push_back({segment.first, weight});
+    }
+    
+    std::vector<float> dist(nodes.size(), INF);
+    typedef std::pair<float, int> Entry;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> heap;
+    dist[source] = 0.0f;
+    heap.push({0.0f, source});
+    while (!heap.empty()) {
+        Entry top = heap.top();
+        heap.pop();
+        if (top.first > dist[top.second]) continue;
+        for (const auto& edge : adjacent[top.second]) {
+            float candidate = top.first + edge.second;
+            if (candidate < dist[edge.first]) {
+                dist[edge.first] = candidate;
+                heap.push({candidate, edge.first});
+            }
+        }
+    }
+    return dist;
+}
+
+// Every node as both source and target
+void checkAllPairs(const RoadGraph& graph, const char* name) {
+    int numNodes = static_cast<int>(graph.getNodes().size());
+    std::vector<int> all(numNodes);
+    for (int i = 0; i < numNodes; ++i) all[i] = i;
+    
+    std::vector<float> matrix = graph.queryMatrix(all, all);
+    bool matrixMatches = matrix.size() == static_cast<size_t>(numNodes) * numNodes;
+    bool queryMatches = true;
+    for (int s = 0; s < numNodes && matrixMatches; ++s) {
+        std::vector<float> reference = dijkstra(graph, s);
+        for (int t = 0; t < numNodes; ++t) {
+            if (!sameDistance(matrix[static_cast<size_t>(s) * numNodes + t], reference[t])) matrixMatches = false;
+            // Single queries on a sample of pairs
+            if ((s * 7 + t) % 13 == 0 && !sameDistance(graph.query(s, t), reference[t])) queryMatches = false;
+        }
+    }
+    
+    std::string label(name);
+    expect(matrixMatches, (label + ": queryMatrix matches Dijkstra").c_str());
+    expect(queryMatches, (label + ": query matches Dijkstra").c_str());
+}
+
+std::vector<Road> gridRoads() {
+    std::vector<Road> roads;
+    for (int i = 1; i < 6; ++i) {
+        roads.push_back({Point2D(i * 100, 0), Point2D(i * 100, 600)});
+        roads.push_back({Point2D(0, i * 100), Point2D(600, i * 100)});
+    }
+    return roads;
+}
+
+// Crossing segments of all lengths and angles, split into many nodes
+std::vector<Road> randomRoads() {
+    std::vector<Road> roads;
+    uint32_t state = 12345;
+    auto next = [&state](int bound) {
+        state = state * 1664525u + 1013904223u;
+        return static_cast<int>((state >> 8) % static_cast<uint32_t>(bound));
+    };
+    for (int i = 0; i < 40; ++i) {
+        roads.push_back({Point2D(next(600), next(600)), Point2D(next(600), next(600))});
+    }
+    return roads;
+}
+
+// Two separate grids, so half of all pairs are unreachable
+std::vector<Road> disconnectedRoads() {
+    std::vector<Road> roads;
+    for (int i = 0; i < 3; ++i) {
+        roads.push_back({Point2D(i * 50, 0), Point2D(i * 50, 100)});
+        roads.push_back({Point2D(0, i * 50), Point2D(100, i * 50)});
+        roads.push_back({Point2D(500 + i * 50, 500), Point2D(500 + i * 50, 600)});
+        roads.push_back({Point2D(500, 500 + i * 50), Point2D(600, 500 + i * 50)});
+    }
+    return roads;
+}
+
+}
+
+int main() {
+    RoadGraph grid;
+    grid.build(gridRoads());
+    expect(!grid.isContracted(), "grid: no hierarchy before contraction");
+    expect(std::isinf(grid.query(0, 1)), "grid: queries without a hierarchy are unreachable");
+    grid.contract();
+    expect(grid.isContracted(), "grid: contracted");
+    checkAllPairs(grid, "grid");
+    
+    RoadGraph random;
+    random.build(randomRoads());
+    random.contract();
+    checkAllPairs(random, "random");
+    
+    RoadGraph disconnected;
+    disconnected.build(disconnectedRoads());
+    disconnected.contract();
+    checkAllPairs(disconnected, "disconnected");
+    int near = disconnected.nearestNode(glm::vec2(0.0f, 0.0f));
+    int far = disconnected.nearestNode(glm::vec2(600.0f, 600.0f));
+    expect(std::isinf(disconnected.query(near, far)), "disconnected: separate grids are unreachable");
+    
+    // Background build, then a second graph served from the cache it wrote
+    std::filesystem::path cacheDir = std::filesystem::temp_directory_path() / "roadgraph_test_cache";
+    std::filesystem::remove_all(cacheDir);
+    RoadGraph built;
+    built.build(randomRoads());
+    built.prepare(cacheDir.string());
+    RoadGraph copy = built; // Shares the pending hierarchy
+    checkAllPairs(copy, "prepared copy");
+    
+    RoadGraph cached;
+    cached.build(randomRoads());
+    cached.prepare(cacheDir.string());
+    checkAllPairs(cached, "cached");
+    std::filesystem::remove_all(cacheDir);
+    
+    if (failures == 0) std::fprintf(stderr, "roadgraph_test: all cases passed\n");
+    return failures == 0 ? 0 : 1;
+}
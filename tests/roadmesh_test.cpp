@@ -0,0 +1,186 @@
+// Checks that the road surface mesh covers no point twice and leaves no
+// hole along the roads, on the generator's grid, radial and random layouts
+// and on roads passing closer than a road width without crossing. Needs no
+// GL context.
+//
+//   roadmesh_test
+//
+// Prints each failed case to stderr and exits non-zero if any failed.
+
+#include <glm/glm.hpp>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "citygenerator.h"
+#include "roadgraph.h"
+#include "roadmesh.h"
+
+namespace {
+
+const float HALF_WIDTH = 4.0f;          // RoadMesh's
+const float NODE_CLEARANCE = 20.0f;     // Sharp junctions may leave notches closer to a node
+const float MARGIN = 1e-2f;             // Pieces may share edges
+const int SAMPLES = 100000;
+
+int failures = 0;
+
+void expect(bool condition, const char* name) {
+    if (!condition) {
+        std::fprintf(stderr, "FAIL: %s\n", name);
+        ++failures;
+    }
+}
+
+struct Random {
+    uint32_t state;
+    explicit Random(uint32_t seed) : state(seed) {}
+    uint32_t next() {
+        state = state * 1664525u + 1013904223u;
+        return state >> 8;
+    }
+    int nextInt(int bound) { return static_cast<int>(next() % static_cast<uint32_t>(bound)); }
+    float nextFloat() { return static_cast<float>(next() & 0xffff) / 65535.0f; }
+};
+
+float cross(const glm::vec2& a, const glm::vec2& b) {
+    return a.x * b.y - a.y * b.x;
+}
+
+// Inside the triangle by more than margin (negative margins widen it)
+bool inTriangle(const glm::vec2& p, const glm::vec2& a, const glm::vec2& b, const glm::vec2& c, float margin) {
+    float area = cross(b - a, c - a);
+    if (std::fabs(area) < 1e-6f) return false;
+    float sign = area > 0.0f ? 1.0f : -1.0f;
+    auto edgeDistance = [&](const glm::vec2& u, const glm::vec2& v) {
+        return sign * cross(v - u, p - u) / glm::length(v - u);
+    };
+    return edgeDistance(a, b) > margin && edgeDistance(b, c) > margin && edgeDistance(c, a) > margin;
+}
+
+// Pieces with a triangle containing p
+int coverCount(const RoadMesh& mesh, const glm::vec2& p, float margin) {
+    int count = 0;
+    for (const auto& piece : mesh.getPieces()) {
+        if (p.x < piece.box.min.x - 1.0f || p.x > piece.box.max.x + 1.0f ||
+            p.y < piece.box.min.z - 1.0f || p.y > piece.box.max.z + 1.0f) continue;
+        const auto& v = piece.vertices;
+        for (size_t i = 0; i < piece.indices.size(); i += 3) {
+            auto corner = [&](size_t k) { return glm::vec2(v[8 * piece.indices[i + k]], v[8 * piece.indices[i + k] + 2]); };
+            if (inTriangle(p, corner(0), corner(1), corner(2), margin)) {
+                ++count;
+                break;
+            }
+        }
+    }
+    return count;
+}
+
+void checkMesh(const std::vector<Road>& roads, const std::string& name) {
+    RoadGraph graph;
+    graph.build(roads);
+    RoadMesh mesh;
+    mesh.build(graph);
+    const auto& nodes = graph.getNodes();
+    const auto& segments = graph.getSegments();
+    
+    bool finite = true;
+    for (const auto& piece : mesh.getPieces()) {
+        for (float value : piece.vertices) finite = finite && std::isfinite(value);
+    }
+    
+    // Points across and just beside random spots on the roads
+    Random random(7);
+    int overlaps = 0, holes = 0;
+    for (int s = 0; s < SAMPLES; ++s) {
+        const auto& segment = segments[random.nextInt(static_cast<int>(segments.size()))];
+        glm::vec2 a = nodes[segment.first];
+        glm::vec2 b = nodes[segment.second];
+        glm::vec2 direction = glm::normalize(b - a);
+        glm::vec2 side(-direction.y, direction.x);
+        float offset = (random.nextFloat() * 2.0f - 1.0f) * 1.5f * HALF_WIDTH;
+        glm::vec2 point = a + (b - a) * random.nextFloat() + side * offset;
+        
+        if (coverCount(mesh, point, MARGIN) > 1) ++overlaps;
+        if (std::fabs(offset) > 0.9f * HALF_WIDTH) continue;
+        bool clear = true;
+        for (const auto& node : nodes) clear = clear && glm::length(node - point) >= NODE_CLEARANCE;
+        if (clear && coverCount(mesh, point, -MARGIN) == 0) ++holes;
+    }
+    
+    expect(!mesh.getPieces().empty(), (name + ": has pieces").c_str());
+    expect(finite, (name + ": vertices are finite").c_str());
+    expect(overlaps == 0, (name + ": no point covered twice").c_str());
+    expect(holes == 0, (name + ": roads covered away from nodes").c_str());
+    if (overlaps != 0 || holes != 0) {
+        std::fprintf(stderr, "  %s: %d overlapping and %d uncovered samples\n", name.c_str(), overlaps, holes);
+    }
+}
+
+// The generator's three layouts (CityGenerator::generateRoads)
+std::vector<Road> gridRoads(int size) {
+    std::vector<Road> roads;
+    for (int x = 100; x < size; x += 100) roads.push_back({Point2D(x, 0), Point2D(x, size)});
+    for (int y = 100; y < size; y += 100) roads.push_back({Point2D(0, y), Point2D(size, y)});
+    return roads;
+}
+
+std::vector<Road> radialRoads(int size) {
+    std::vector<Road> roads;
+    int center = size / 2;
+    int radius = size / 2;
+    for (int i = 0; i < 8; ++i) {
+        float angle = (2.0f * 3.14159f * i) / 8;
+        roads.push_back({Point2D(center, center),
+                         Point2D(center + static_cast<int>(radius * cos(angle)), center + static_cast<int>(radius * sin(angle)))});
+    }
+    for (int ring = 1; ring <= 3; ++ring) {
+        int ringRadius = (radius * ring) / 4;
+        for (int i = 0; i < 32; ++i) {
+            float angle1 = (2.0f * 3.14159f * i) / 32;
+            float angle2 = (2.0f * 3.14159f * (i + 1)) / 32;
+            roads.push_back({Point2D(center + static_cast<int>(ringRadius * cos(angle1)), center + static_cast<int>(ringRadius * sin(angle1))),
+                             Point2D(center + static_cast<int>(ringRadius * cos(angle2)), center + static_cast<int>(ringRadius * sin(angle2)))});
+        }
+    }
+    return roads;
+}
+
+std::vector<Road> randomRoads(int size, uint32_t seed) {
+    Random random(seed);
+    std::vector<Road> roads;
+    for (int i = 0; i < 15; ++i) {
+        roads.push_back({Point2D(random.nextInt(size), random.nextInt(size)), Point2D(random.nextInt(size), random.nextInt(size))});
+    }
+    return roads;
+}
+
+// Parallel roads a few units apart, joined by a crossing road, and a fan of
+// roads meeting at shallow angles
+std::vector<Road> closeRoads() {
+    return {
+        {Point2D(0, 100), Point2D(300, 100)},
+        {Point2D(20, 105), Point2D(280, 105)},
+        {Point2D(150, 0), Point2D(150, 200)},
+        {Point2D(400, 100), Point2D(600, 110)},
+        {Point2D(400, 100), Point2D(600, 120)},
+        {Point2D(400, 100), Point2D(600, 80)},
+        {Point2D(400, 100), Point2D(402, 101)},
+    };
+}
+
+}
+
+int main() {
+    checkMesh(gridRoads(600), "grid");
+    checkMesh(radialRoads(600), "radial 600");
+    checkMesh(radialRoads(1000), "radial 1000");
+    for (uint32_t seed = 1; seed <= 6; ++seed) {
+        checkMesh(randomRoads(600, seed), "random seed " + std::to_string(seed));
+    }
+    checkMesh(closeRoads(), "close roads");
+    
+    if (failures == 0) std::fprintf(stderr, "roadmesh_test: all cases passed\n");
+    return failures == 0 ? 0 : 1;
+}